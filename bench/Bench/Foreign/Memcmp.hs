@@ -3,6 +3,7 @@
 module Bench.Foreign.Memcmp (
     memcmp8_simple_bench
   , memcmp64_simple_bench
+  , memcmp128_simple_bench
   , memcmp128_unsafe_simple_bench
   , memcmp_partial_load64_simple_bench
   , memcmp_simple_bench
@@ -10,6 +11,7 @@ module Bench.Foreign.Memcmp (
 
   , memcmp8_regs_bench
   , memcmp64_regs_bench
+  , memcmp128_regs_bench
   , memcmp128_unsafe_regs_bench
   , memcmp_partial_load64_regs_bench
   , memcmp_regs_bench
@@ -30,6 +32,11 @@ foreign import ccall unsafe
     memcmp64_simple_bench
     :: MembenchT
 
+foreign import ccall unsafe
+    "anemone_memcmp128_simple_bench"
+    memcmp128_simple_bench
+    :: MembenchT
+
 foreign import ccall unsafe
     "anemone_memcmp128_unsafe_simple_bench"
     memcmp128_unsafe_simple_bench
@@ -61,6 +68,11 @@ foreign import ccall unsafe
     memcmp64_regs_bench
     :: MembenchT
 
+foreign import ccall unsafe
+    "anemone_memcmp128_regs_bench"
+    memcmp128_regs_bench
+    :: MembenchT
+
 foreign import ccall unsafe
     "anemone_memcmp128_unsafe_regs_bench"
     memcmp128_unsafe_regs_bench
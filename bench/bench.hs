@@ -68,15 +68,19 @@ bench_memcmp
  [ bgroup "Simple bench"
      [ go_all "memcmp8"                 FoMemcmp.memcmp8_simple_bench
      , go_all "memcmp64"                FoMemcmp.memcmp64_simple_bench
-     , go_all "memcmp128"               FoMemcmp.memcmp128_unsafe_simple_bench
+     , go_all "memcmp128"               FoMemcmp.memcmp128_simple_bench
+     , go_all "memcmp128_unsafe"        FoMemcmp.memcmp128_unsafe_simple_bench
      , go_all "memcmp_partial_load64"   FoMemcmp.memcmp_partial_load64_simple_bench
+     , go_all "memcmp"                  FoMemcmp.memcmp_simple_bench
      , go_all "memcmp std"              FoMemcmp.memcmp_std_simple_bench
      ]
  , bgroup "Register pressure"
      [ go_all "memcmp8"                 FoMemcmp.memcmp8_regs_bench
      , go_all "memcmp64"                FoMemcmp.memcmp64_regs_bench
-     , go_all "memcmp128"               FoMemcmp.memcmp128_unsafe_regs_bench
+     , go_all "memcmp128"               FoMemcmp.memcmp128_regs_bench
+     , go_all "memcmp128_unsafe"        FoMemcmp.memcmp128_unsafe_regs_bench
      , go_all "memcmp_partial_load64"   FoMemcmp.memcmp_partial_load64_regs_bench
+     , go_all "memcmp"                  FoMemcmp.memcmp_regs_bench
      , go_all "memcmp std"              FoMemcmp.memcmp_std_regs_bench
      ]
   ]
@@ -89,6 +93,7 @@ bench_memcmp
    , bench "10" $ check2 f 10
    , bench "40" $ check2 f 40
    , bench "160" $ check2 f 160
+   , bench "330" $ check2 f 330
    ]
 
   check2 f n
@@ -1,6 +1,7 @@
 #!/usr/bin/env runghc
 
 import Data.Bits (shiftL)
+import Data.List (intercalate)
 import Data.Monoid ((<>))
 import Data.Word (Word64)
 import System.IO (IOMode(..), withFile, hPutStrLn)
@@ -21,6 +22,33 @@ bytesReq bits =
   else
     (inputCount * bits + 7) `div` 8
 
+-- | A block codec, which transforms values as they are packed and unpacked.
+data Codec =
+  Codec {
+      codecSuffix :: String
+    , codecConst :: String
+    }
+
+raw :: Codec
+raw =
+  Codec "" "ANEMONE_CODEC_RAW"
+
+frameOfReference :: Codec
+frameOfReference =
+  Codec "_for" "ANEMONE_CODEC_FOR"
+
+delta :: Codec
+delta =
+  Codec "_delta" "ANEMONE_CODEC_DELTA"
+
+zigzag :: Codec
+zigzag =
+  Codec "_zigzag" "ANEMONE_CODEC_ZIGZAG"
+
+codecs :: [Codec]
+codecs =
+  [raw, frameOfReference, delta, zigzag]
+
 packFnName :: Int -> String
 packFnName bits =
   "pack64_" <> show inputCount <> "_" <> show bits
@@ -29,20 +57,80 @@ unpackFnName :: Int -> String
 unpackFnName bits =
   "unpack64_" <> show inputCount <> "_" <> show bits
 
-packFn :: Int -> [String] -> [String]
-packFn bits body =
-  [ "/* pack " <> show inputCount <> " x " <> show bits <> "-bit integers */"
-  , "static void " <> packFnName bits <> " (const uint64_t **pin, uint8_t **pout) {" ] <>
-  fmap ("  " <>) body <>
-  [ "}" ]
+gatherFnName :: Int -> String
+gatherFnName bits =
+  "gather64_" <> show inputCount <> "_" <> show bits
+
+aggregateFnName :: Int -> String
+aggregateFnName bits =
+  "aggregate64_" <> show inputCount <> "_" <> show bits
+
+selectFnName :: Int -> String
+selectFnName bits =
+  "select64_" <> show inputCount <> "_" <> show bits
 
-unpackFn :: Int -> [String] -> [String]
-unpackFn bits body =
-  [ "/* unpack " <> show inputCount <> " x " <> show bits <> "-bit integers */"
-  , "static void " <> unpackFnName bits <> " (const uint8_t **pin, uint64_t **pout) {" ] <>
+pack32FnName :: Int -> String
+pack32FnName bits =
+  "pack32_" <> show inputCount <> "_" <> show bits
+
+unpack32FnName :: Int -> String
+unpack32FnName bits =
+  "unpack32_" <> show inputCount <> "_" <> show bits
+
+pack128FnName :: Int -> String
+pack128FnName bits =
+  "pack64_" <> show (2 * inputCount) <> "_" <> show bits
+
+unpack128FnName :: Int -> String
+unpack128FnName bits =
+  "unpack64_" <> show (2 * inputCount) <> "_" <> show bits
+
+packSig :: String -> String
+packSig name =
+  "static void " <> name <> " (const uint64_t **pin, uint8_t **pout, uint64_t *acc) {"
+
+unpackSig :: String -> String
+unpackSig name =
+  "static void " <> name <> " (const uint8_t **pin, uint64_t **pout, uint64_t *acc) {"
+
+packArgs :: String
+packArgs =
+  "const int codec, const uint64_t **pin, uint8_t **pout, uint64_t *acc"
+
+unpackArgs :: String
+unpackArgs =
+  "const int codec, const uint8_t **pin, uint64_t **pout, uint64_t *acc"
+
+-- | A kernel which is always inlined in to its instances, so that the codec is a constant.
+withFn :: String -> String -> String -> [String] -> [String]
+withFn comment name args body =
+  [ "/* " <> comment <> " */"
+  , "static ANEMONE_INLINE void " <> name <> " (" <> args <> ") {" ] <>
   fmap ("  " <>) body <>
   [ "}" ]
 
+-- | Instantiate a kernel for a particular codec.
+instantiate :: (String -> String) -> String -> Codec -> String -> [String]
+instantiate sig withName codec name =
+  [ sig name
+  , "  " <> withName <> " (" <> codecConst codec <> ", pin, pout, acc);"
+  , "}" ]
+
+tableUpTo :: Int -> String -> String -> (Int -> String) -> [String]
+tableUpTo top ty name entry =
+  [ "static " <> ty <> " " <> name <> "[] = {" ] <>
+  [ "  &" <> entry bits <> "," | bits <- [0..top-1] ] <>
+  [ "  &" <> entry top
+  , "};" ]
+
+table :: String -> String -> (Int -> String) -> [String]
+table =
+  tableUpTo 64
+
+tableName :: String -> String -> Codec -> String
+tableName prefix isa codec =
+  prefix <> "64_" <> show inputCount <> isa <> codecSuffix codec <> "_table"
+
 fstWord :: Int -> Int -> Int
 fstWord bits i =
   i * bits `div` 64
@@ -59,17 +147,17 @@ sndShift :: Int -> Int -> Int
 sndShift bits i =
   64 - fstShift bits i
 
-pack :: Int -> [String]
-pack bits =
+-- | Pack a block in to words, reading value |i| with |get i|.
+packWords :: Int -> (Int -> String) -> [String]
+packWords bits get =
   let
     nwords = wordsReq bits
-    nbytes = bytesReq bits
 
     defWord w =
       "uint64_t out" <> show w <> ";"
 
     copyWord w =
-      "pout64[" <> show w <> "] = out" <> show w <> ";"
+      "anemone_store64 (out + " <> show (w * 8) <> ", out" <> show w <> ");"
 
     packWordFrom i =
       let
@@ -79,92 +167,152 @@ pack bits =
         shift0 = fstShift bits i
         shift1 = sndShift bits i
 
-        inp = "(uint64_t) in[" <> show i <> "]"
+        inp = "x = " <> get i <> ";"
       in
         if out0 == out1 then
           if shift0 == 0 then
-            [ out0 <> "  = " <> inp <> ";" ]
+            [ inp
+            , out0 <> "  = x;" ]
           else
-            [ out0 <> " |= " <> inp <> " << " <> show shift0 <> ";" ]
+            [ inp
+            , out0 <> " |= x << " <> show shift0 <> ";" ]
         else
-          [ out0 <> " |= " <> inp <> " << " <> show shift0 <> ";"
-          , out1 <> "  = " <> inp <> " >> " <> show shift1 <> ";" ]
+          [ inp
+          , out0 <> " |= x << " <> show shift0 <> ";"
+          , out1 <> "  = x >> " <> show shift1 <> ";" ]
+  in
+    [ "uint64_t x;" ] <>
+    fmap defWord [0..nwords-1] <>
+    concatMap packWordFrom [0..inputCount-1] <>
+    fmap copyWord [0..nwords-1]
+
+pack :: Int -> [String]
+pack bits =
+  let
+    nwords = wordsReq bits
+    nbytes = bytesReq bits
   in
-    packFn bits $
-      [ "uint64_t *pout64 = *(uint64_t **) pout;"
+    withFn
+      ("pack " <> show inputCount <> " x " <> show bits <> "-bit integers, encoding each with |codec|")
+      (packFnName bits <> "_with")
+      packArgs $
+      [ "uint8_t *out = *pout;"
       , "const uint64_t *in = *pin;"
       , "/* packing in to " <>
           show nwords <> " words / " <>
           show nbytes <> " bytes */"
       ] <>
-      fmap defWord [0..nwords-1] <>
-      concatMap packWordFrom [0..inputCount-1] <>
-      fmap copyWord [0..nwords-1] <>
+      packWords bits (\i -> "anemone_encode (codec, in[" <> show i <> "], acc)") <>
       [ "*pin  += " <> show inputCount <> "; " <>
           "/* consumed " <> show inputCount <> " integers */"
       , "*pout += " <> show nbytes <> "; " <>
           "/* produced " <> show nbytes <> " bytes */"
       ]
 
-unpack :: Int -> [String]
-unpack bits =
+-- | Pack a block of 32-bit values, in the same layout as 64-bit values.
+pack32 :: Int -> [String]
+pack32 bits =
   let
     nwords = wordsReq bits
     nbytes = bytesReq bits
+  in
+    [ "/* pack " <> show inputCount <> " x " <> show bits <> "-bit integers from 32-bit values */"
+    , "static void " <> pack32FnName bits <> " (const uint32_t **pin, uint8_t **pout) {" ] <>
+    fmap ("  " <>)
+      ([ "uint8_t *out = *pout;"
+       , "const uint32_t *in = *pin;"
+       , "/* packing in to " <>
+           show nwords <> " words / " <>
+           show nbytes <> " bytes */"
+       ] <>
+       packWords bits (\i -> "in[" <> show i <> "]") <>
+       [ "*pin  += " <> show inputCount <> "; " <>
+           "/* consumed " <> show inputCount <> " integers */"
+       , "*pout += " <> show nbytes <> "; " <>
+           "/* produced " <> show nbytes <> " bytes */"
+       ]) <>
+    [ "}" ]
 
+-- | The mask for values of |bits| bits, which is not needed for 64 bits.
+maskDef :: Int -> [String]
+maskDef bits =
+  let
     mask :: Word64
     mask =
       (1 `shiftL` bits) - 1
+  in
+    if bits < 64 then
+      [ printf "const uint64_t mask = UINT64_C(0x%0X);" mask ]
+    else
+      []
 
-    (applyMask, defMask) =
-      if bits < 64 then
-        (" & mask", [ printf "const uint64_t mask = UINT64_C(0x%0X);" mask ])
-      else
-        ("", [])
-
+-- | Load the words a block is packed in to.
+loadDefs :: Int -> [String]
+loadDefs bits =
+  let
     defCopyWord w =
-      "uint64_t in" <> show w <> " = pin64[" <> show w <> "];"
+      "uint64_t in" <> show w <> " = anemone_load64 (in + " <> show (w * 8) <> ");"
+  in
+    fmap defCopyWord [0 .. wordsReq bits - 1]
 
-    unpackWordFrom i =
-      let
-        in0 = "in" <> show (fstWord bits i)
-        in1 = "in" <> show (sndWord bits i)
+-- | An expression for value |i| of a block, from the words it is packed in to.
+valueExpr :: Int -> Int -> String
+valueExpr bits i =
+  let
+    in0 = "in" <> show (fstWord bits i)
+    in1 = "in" <> show (sndWord bits i)
 
-        shift0 = fstShift bits i
-        shift1 = sndShift bits i
+    shift0 = fstShift bits i
+    shift1 = sndShift bits i
 
-        applyShift0 =
-          if shift0 == 0 then
-            ""
-          else
-            " >> " <> show shift0
+    applyMask =
+      if bits < 64 then
+        " & mask"
+      else
+        ""
 
-        applyShift1 =
-          " << " <> show shift1
+    applyShift0 =
+      if shift0 == 0 then
+        ""
+      else
+        " >> " <> show shift0
 
-        out = "out[" <> show i <> "]"
-      in
-        if in0 == in1 then
-          if shift0 + bits == 64 then
-            out <> " = (uint64_t) (" <> in0 <> applyShift0 <> ");"
-          else
-            out <> " = (uint64_t) ((" <> in0 <> applyShift0 <> ")" <> applyMask <> ");"
-        else
-          out <> " = (uint64_t) (((" <>
-            in0 <> applyShift0 <> ") | (" <>
-            in1 <> applyShift1 <> "))" <>
-            applyMask <> ");"
+    applyShift1 =
+      " << " <> show shift1
   in
-    unpackFn bits $
-      [ "const uint64_t *pin64 = *(const uint64_t **) pin;"
+    if in0 == in1 then
+      if shift0 + bits == 64 then
+        "(uint64_t) (" <> in0 <> applyShift0 <> ")"
+      else
+        "(uint64_t) ((" <> in0 <> applyShift0 <> ")" <> applyMask <> ")"
+    else
+      "(uint64_t) (((" <>
+        in0 <> applyShift0 <> ") | (" <>
+        in1 <> applyShift1 <> "))" <>
+        applyMask <> ")"
+
+unpack :: Int -> [String]
+unpack bits =
+  let
+    nwords = wordsReq bits
+    nbytes = bytesReq bits
+
+    unpackWordFrom i =
+      "anemone_decode (codec, out + " <> show i <> ", " <> valueExpr bits i <> ", acc);"
+  in
+    withFn
+      ("unpack " <> show inputCount <> " x " <> show bits <> "-bit integers, decoding each with |codec|")
+      (unpackFnName bits <> "_with")
+      unpackArgs $
+      [ "const uint8_t *in = *pin;"
       , "uint64_t *out = *pout;"
       ] <>
-      defMask <>
+      maskDef bits <>
       [ "/* unpacking from " <>
           show nwords <> " words / " <>
           show nbytes <> " bytes */"
       ] <>
-      fmap defCopyWord [0..nwords-1] <>
+      loadDefs bits <>
       [ "*pin += " <> show nbytes <> "; " <>
           "/* consumed " <> show nbytes <> " bytes */"
       ] <>
@@ -173,56 +321,544 @@ unpack bits =
           "/* produced " <> show inputCount <> " integers */"
       ]
 
+-- | Unpack a block to 32-bit values.
+unpack32 :: Int -> [String]
+unpack32 bits =
+  let
+    nwords = wordsReq bits
+    nbytes = bytesReq bits
+
+    unpackWordFrom i =
+      "out[" <> show i <> "] = (uint32_t) " <> valueExpr bits i <> ";"
+  in
+    [ "/* unpack " <> show inputCount <> " x " <> show bits <> "-bit integers to 32-bit values */"
+    , "static void " <> unpack32FnName bits <> " (const uint8_t **pin, uint32_t **pout) {" ] <>
+    fmap ("  " <>)
+      ([ "const uint8_t *in = *pin;"
+       , "uint32_t *out = *pout;"
+       ] <>
+       maskDef bits <>
+       [ "/* unpacking from " <>
+           show nwords <> " words / " <>
+           show nbytes <> " bytes */"
+       ] <>
+       loadDefs bits <>
+       [ "*pin += " <> show nbytes <> "; " <>
+           "/* consumed " <> show nbytes <> " bytes */"
+       ] <>
+       fmap unpackWordFrom [0..inputCount-1] <>
+       [ "*pout += " <> show inputCount <> "; " <>
+           "/* produced " <> show inputCount <> " integers */"
+       ]) <>
+    [ "}" ]
+
+-- | A block of twice as many values has the same layout as two blocks, so
+--   its kernel is two direct calls rather than two trips through a table.
+twice :: String -> (String -> String) -> Int -> String -> String -> [String]
+twice verb sig bits name kernel =
+  [ "/* " <> verb <> " " <> show (2 * inputCount) <> " x " <> show bits <> "-bit integers, as two blocks of " <> show inputCount <> " */"
+  , sig name
+  , "  " <> kernel <> " (pin, pout, acc);"
+  , "  " <> kernel <> " (pin, pout, acc);"
+  , "}" ]
+
+-- | Fold a block in to its sum, min and max, straight from the packed words.
+aggregate :: Int -> [String]
+aggregate bits =
+  let
+    nwords = wordsReq bits
+    nbytes = bytesReq bits
+
+    aggregateFrom i =
+      "anemone_aggregate (" <> valueExpr bits i <> ", &sum, &min, &max);"
+  in
+    [ "/* sum, min and max of " <> show inputCount <> " x " <> show bits <> "-bit integers, without unpacking them */"
+    , "static void " <> aggregateFnName bits <> " (const uint8_t **pin, uint64_t *psum, uint64_t *pmin, uint64_t *pmax) {" ] <>
+    fmap ("  " <>)
+      ([ "const uint8_t *in = *pin;" ] <>
+       maskDef bits <>
+       [ "/* reading from " <>
+           show nwords <> " words / " <>
+           show nbytes <> " bytes */"
+       ] <>
+       loadDefs bits <>
+       [ "uint64_t sum = *psum;"
+       , "uint64_t min = *pmin;"
+       , "uint64_t max = *pmax;"
+       ] <>
+       fmap aggregateFrom [0..inputCount-1] <>
+       [ "*psum = sum;"
+       , "*pmin = min;"
+       , "*pmax = max;"
+       , "*pin += " <> show nbytes <> "; " <>
+           "/* consumed " <> show nbytes <> " bytes */"
+       ]) <>
+    [ "}" ]
+
+-- | Compare a block against a range, straight from the packed words.
+select :: Int -> [String]
+select bits =
+  let
+    nwords = wordsReq bits
+    nbytes = bytesReq bits
+
+    selectFrom i =
+      "anemone_select (&selection, " <> show i <> ", " <> valueExpr bits i <> ", lo, range);"
+  in
+    [ "/* select which of " <> show inputCount <> " x " <> show bits <> "-bit integers are between |lo| and |lo + range|, without unpacking them */"
+    , "static uint64_t " <> selectFnName bits <> " (const uint8_t **pin, uint64_t lo, uint64_t range) {" ] <>
+    fmap ("  " <>)
+      ([ "const uint8_t *in = *pin;" ] <>
+       maskDef bits <>
+       [ "/* reading from " <>
+           show nwords <> " words / " <>
+           show nbytes <> " bytes */"
+       ] <>
+       loadDefs bits <>
+       [ "uint64_t selection = 0;"
+       , "*pin += " <> show nbytes <> "; " <>
+           "/* consumed " <> show nbytes <> " bytes */"
+       ] <>
+       fmap selectFrom [0..inputCount-1] <>
+       [ "return selection;" ]) <>
+    [ "}" ]
+
+-- | An instruction set with vectorised unpack kernels.
+data Isa =
+  Isa {
+      isaName :: String
+    , isaConst :: String
+    , isaLanes :: Int
+    , isaAttribute :: String
+    , isaVector :: String
+    , isaStore :: String
+    , isaSetIndex :: String
+    , isaSetShift :: String
+    , isaSet1 :: String
+    , isaHelper :: String
+    }
+
+avx2 :: Isa
+avx2 =
+  Isa "avx2" "ANEMONE_PACK_AVX2" 4 "ANEMONE_AVX2" "__m256i"
+    "_mm256_storeu_si256" "_mm256_setr_epi32" "_mm256_setr_epi64x" "_mm256_set1_epi64x"
+    "anemone_unpack_avx2"
+
+avx512 :: Isa
+avx512 =
+  Isa "avx512" "ANEMONE_PACK_AVX512" 8 "ANEMONE_AVX512" "__m512i"
+    "_mm512_storeu_si512" "_mm512_setr_epi64" "_mm512_setr_epi64" "_mm512_set1_epi64"
+    "anemone_unpack_avx512"
+
+isas :: [Isa]
+isas =
+  [avx2, avx512]
+
+-- | Delta decoding is a prefix sum, so it only has a scalar kernel.
+vecCodecs :: [Codec]
+vecCodecs =
+  [raw, frameOfReference, zigzag]
+
+vecFnName :: Isa -> Int -> String
+vecFnName isa bits =
+  unpackFnName bits <> "_" <> isaName isa
+
+-- | A group of lanes reads from two overlapping vectors of words, the words the values
+--   start in and the words after. Both must fit in the input, so there must be at least
+--   as many words as lanes. For 64 bits the scalar kernel is just a copy.
+hasVecFn :: Isa -> Int -> Bool
+hasVecFn isa bits =
+  bits >= isaLanes isa && bits < 64
+
+vecIndex :: Isa -> [Int] -> String
+vecIndex isa ks =
+  isaSetIndex isa <> " (" <> intercalate ", " (fmap index ks) <> ")"
+ where
+  -- AVX2 permutes 32-bit lanes, so each 64-bit word is a pair of indices
+  index k =
+    if isaLanes isa == 4 then
+      show (2 * k) <> ", " <> show (2 * k + 1)
+    else
+      show k
+
+unpackVec :: Isa -> Int -> [String]
+unpackVec isa bits =
+  let
+    nwords = wordsReq bits
+    nbytes = bytesReq bits
+    lanes = isaLanes isa
+
+    mask :: Word64
+    mask =
+      (1 `shiftL` bits) - 1
+
+    unpackGroup g =
+      let
+        ixs = [g * lanes .. (g + 1) * lanes - 1]
+        base = fstWord bits (g * lanes)
+        lo = min base (nwords - lanes)
+        hi = min (base + 1) (nwords - lanes)
+
+        loIndex i =
+          fstWord bits i - lo
+
+        -- The last value can end in its first word, then there is no next word
+        -- and the index doesn't matter, as shifting pushes it past the mask
+        hiIndex i =
+          if fstWord bits i + 1 < nwords then
+            fstWord bits i + 1 - hi
+          else
+            0
+
+        shifts =
+          fmap (fstShift bits) ixs
+      in
+        isaStore isa <> " (out + " <> show g <> ", " <> isaHelper isa <>
+          " (codec, in + " <> show (lo * 8) <> ", in + " <> show (hi * 8) <> ", " <>
+          vecIndex isa (fmap loIndex ixs) <> ", " <>
+          vecIndex isa (fmap hiIndex ixs) <> ", " <>
+          isaSetShift isa <> " (" <> intercalate ", " (fmap show shifts) <> "), mask, base));"
+  in
+    [ "/* unpack " <> show inputCount <> " x " <> show bits <> "-bit integers " <> show lanes <> " at a time, decoding each with |codec| */"
+    , isaAttribute isa
+    , "static ANEMONE_INLINE void " <> vecFnName isa bits <> "_with (" <> unpackArgs <> ") {" ] <>
+    fmap ("  " <>)
+      ([ "const uint8_t *in = *pin;"
+       , isaVector isa <> " *out = (" <> isaVector isa <> " *) *pout;"
+       , printf "const %s mask = %s (UINT64_C(0x%0X));" (isaVector isa) (isaSet1 isa) mask
+       , "const " <> isaVector isa <> " base = " <> isaSet1 isa <> " (*acc);"
+       , "/* unpacking from " <>
+           show nwords <> " words / " <>
+           show nbytes <> " bytes */"
+       ] <>
+       fmap unpackGroup [0 .. inputCount `div` lanes - 1] <>
+       [ "*pin += " <> show nbytes <> "; " <>
+           "/* consumed " <> show nbytes <> " bytes */"
+       , "*pout += " <> show inputCount <> "; " <>
+           "/* produced " <> show inputCount <> " integers */"
+       ]) <>
+    [ "}" ]
+
+-- | The best kernel for a codec from a list of instruction sets in order of preference.
+vecFallback :: [Isa] -> Codec -> Int -> String
+vecFallback preferred codec bits =
+  case filter (\isa -> hasVecFn isa bits) preferred of
+    isa : _ ->
+      vecFnName isa bits <> codecSuffix codec
+    [] ->
+      unpackFnName bits <> codecSuffix codec
+
 main :: IO ()
 main = do
   withFile "cbits/anemone_pack.c" WriteMode $ \h -> do
     hPutStrLn h . unlines $
       [ "#include \"anemone_pack.h\""
+      , "#include \"anemone_cpu.h\""
       , ""
       , "#include <string.h>"
+      , ""
+      , "#if defined(__x86_64__)"
+      , "#include <immintrin.h>"
+      , "#define ANEMONE_PACK_X86 1"
+      , "#else"
+      , "#define ANEMONE_PACK_X86 0"
+      , "#endif"
       ]
 
     hPutStrLn h . unlines $
-      [ "typedef void (*pack64fn)(const uint64_t **pin, uint8_t **pout);"
-      , "typedef void (*unpack64fn)(const uint8_t **pin, uint64_t **pout);"
+      [ "typedef void (*pack64fn)(const uint64_t **pin, uint8_t **pout, uint64_t *acc);"
+      , "typedef void (*unpack64fn)(const uint8_t **pin, uint64_t **pout, uint64_t *acc);"
+      , "typedef void (*gather64fn)(const uint8_t *in, uint64_t count, const uint64_t *indices, uint64_t *out);"
+      , "typedef void (*aggregate64fn)(const uint8_t **pin, uint64_t *psum, uint64_t *pmin, uint64_t *pmax);"
+      , "typedef uint64_t (*select64fn)(const uint8_t **pin, uint64_t lo, uint64_t range);"
+      , "typedef void (*pack32fn)(const uint32_t **pin, uint8_t **pout);"
+      , "typedef void (*unpack32fn)(const uint8_t **pin, uint32_t **pout);"
       ]
 
-    hPutStrLn h . unlines . packFn 0 $
-      [ "(void) pout;"
-      , "*pin  += " <> show inputCount <> "; " <>
-          "/* consumed " <> show inputCount <> " integers */"
+    hPutStrLn h . unlines $
+      [ "/* packed words are not necessarily aligned, as encoded blocks start with a header. */"
+      , "static ANEMONE_INLINE uint64_t anemone_load64 (const uint8_t *p) {"
+      , "  uint64_t x;"
+      , "  memcpy (&x, p, 8);"
+      , "  return x;"
+      , "}"
+      , ""
+      , "static ANEMONE_INLINE void anemone_store64 (uint8_t *p, uint64_t x) {"
+      , "  memcpy (p, &x, 8);"
+      , "}"
+      ]
+
+    hPutStrLn h . unlines $
+      [ "/* transform a value before packing it with |codec|, |acc| starts as the base of the block. */"
+      , "static ANEMONE_INLINE uint64_t anemone_encode (const int codec, uint64_t x, uint64_t *acc) {"
+      , "  uint64_t prev;"
+      , "  switch (codec) {"
+      , "    case ANEMONE_CODEC_FOR:"
+      , "      return x - *acc;"
+      , "    case ANEMONE_CODEC_DELTA:"
+      , "      prev = *acc;"
+      , "      *acc = x;"
+      , "      return x - prev;"
+      , "    case ANEMONE_CODEC_ZIGZAG:"
+      , "      return (x << 1) ^ (uint64_t) ((int64_t) x >> 63);"
+      , "    default:"
+      , "      return x;"
+      , "  }"
+      , "}"
+      , ""
+      , "/* write an unpacked value to |out|, decoding it with |codec|, |acc| starts as the base of the block. */"
+      , "static ANEMONE_INLINE void anemone_decode (const int codec, uint64_t *out, uint64_t x, uint64_t *acc) {"
+      , "  switch (codec) {"
+      , "    case ANEMONE_CODEC_FOR:"
+      , "      *out = *acc + x;"
+      , "      break;"
+      , "    case ANEMONE_CODEC_DELTA:"
+      , "      *acc += x;"
+      , "      *out = *acc;"
+      , "      break;"
+      , "    case ANEMONE_CODEC_ZIGZAG:"
+      , "      *out = (x >> 1) ^ (0 - (x & 1));"
+      , "      break;"
+      , "    default:"
+      , "      *out = x;"
+      , "      break;"
+      , "  }"
+      , "}"
       ]
 
+    hPutStrLn h . unlines $
+      withFn
+        ("pack " <> show inputCount <> " x 0-bit integers, encoding each with |codec|")
+        (packFnName 0 <> "_with")
+        packArgs
+        [ "(void) codec;"
+        , "(void) pout;"
+        , "(void) acc;"
+        , "*pin  += " <> show inputCount <> "; " <>
+            "/* consumed " <> show inputCount <> " integers */"
+        ]
+
     mapM_ (hPutStrLn h . unlines . pack) [1..64]
 
-    hPutStrLn h . unlines . unpackFn 0 $
-      [ "(void) pin;"
-      , "memset (*pout, 0, " <> show (inputCount * 8) <> ");"
-      , "*pout += " <> show inputCount <> "; " <>
-          "/* produced " <> show inputCount <> " integers */"
-      ]
+    hPutStrLn h . unlines $
+      withFn
+        ("unpack " <> show inputCount <> " x 0-bit integers, decoding each with |codec|")
+        (unpackFnName 0 <> "_with")
+        unpackArgs
+        [ "(void) pin;"
+        , "for (int i = 0; i < " <> show inputCount <> "; i++) {"
+        , "  anemone_decode (codec, *pout + i, 0, acc);"
+        , "}"
+        , "*pout += " <> show inputCount <> "; " <>
+            "/* produced " <> show inputCount <> " integers */"
+        ]
 
     mapM_ (hPutStrLn h . unlines . unpack) [1..64]
 
+    sequence_
+      [ hPutStrLn h . unlines $
+          instantiate packSig (packFnName bits <> "_with") codec (packFnName bits <> codecSuffix codec)
+      | codec <- codecs
+      , bits <- [0..64] ]
+
+    sequence_
+      [ hPutStrLn h . unlines $
+          instantiate unpackSig (unpackFnName bits <> "_with") codec (unpackFnName bits <> codecSuffix codec)
+      | codec <- codecs
+      , bits <- [0..64] ]
+
+    sequence_
+      [ hPutStrLn h . unlines $
+          table "pack64fn" (tableName "pack" "" codec) (\bits -> packFnName bits <> codecSuffix codec)
+      | codec <- codecs ]
+
+    sequence_
+      [ hPutStrLn h . unlines $
+          table "unpack64fn" (tableName "unpack" "" codec) (\bits -> unpackFnName bits <> codecSuffix codec)
+      | codec <- codecs ]
+
+    hPutStrLn h . unlines $
+      [ "/* pack " <> show inputCount <> " x 0-bit integers from 32-bit values */"
+      , "static void " <> pack32FnName 0 <> " (const uint32_t **pin, uint8_t **pout) {"
+      , "  (void) pout;"
+      , "  *pin  += " <> show inputCount <> "; " <>
+          "/* consumed " <> show inputCount <> " integers */"
+      , "}" ]
+
+    mapM_ (hPutStrLn h . unlines . pack32) [1..32]
+
+    hPutStrLn h . unlines $
+      [ "/* unpack " <> show inputCount <> " x 0-bit integers to 32-bit values */"
+      , "static void " <> unpack32FnName 0 <> " (const uint8_t **pin, uint32_t **pout) {"
+      , "  (void) pin;"
+      , "  memset (*pout, 0, " <> show inputCount <> " * 4);"
+      , "  *pout += " <> show inputCount <> "; " <>
+          "/* produced " <> show inputCount <> " integers */"
+      , "}" ]
+
+    mapM_ (hPutStrLn h . unlines . unpack32) [1..32]
+
+    hPutStrLn h . unlines $
+      tableUpTo 32 "pack32fn" ("pack32_" <> show inputCount <> "_table") pack32FnName
+
+    hPutStrLn h . unlines $
+      tableUpTo 32 "unpack32fn" ("unpack32_" <> show inputCount <> "_table") unpack32FnName
+
+    sequence_
+      [ hPutStrLn h . unlines $
+          twice "pack" packSig bits (pack128FnName bits) (packFnName bits)
+      | bits <- [0..64] ]
+
+    sequence_
+      [ hPutStrLn h . unlines $
+          twice "unpack" unpackSig bits (unpack128FnName bits) (unpackFnName bits)
+      | bits <- [0..64] ]
+
+    hPutStrLn h . unlines $
+      table "pack64fn" ("pack64_" <> show (2 * inputCount) <> "_table") pack128FnName
+
+    hPutStrLn h . unlines $
+      table "unpack64fn" ("unpack64_" <> show (2 * inputCount) <> "_table") unpack128FnName
+
     hPutStrLn h . unlines $
-      [ "static pack64fn pack64_" <> show inputCount <> "_table[] = {" ] <>
-      [ "  &" <> packFnName bits <> "," | bits <- [0..63] ] <>
-      [ "  &" <> packFnName 64
-      , "};" ]
+      [ "#if ANEMONE_PACK_X86"
+      , ""
+      , "#define ANEMONE_AVX2   __attribute__((target(\"avx2\")))"
+      , "#define ANEMONE_AVX512 __attribute__((target(\"avx512f\")))"
+      , ""
+      , "/* unpack 4 values, reading the words they start in from |lo_in|, and the words after from |hi_in|. */"
+      , "ANEMONE_AVX2"
+      , "static ANEMONE_INLINE __m256i anemone_unpack_avx2 ("
+      , "  const int codec, const uint8_t *lo_in, const uint8_t *hi_in,"
+      , "  __m256i lo_index, __m256i hi_index, __m256i shift, __m256i mask, __m256i base) {"
+      , "  __m256i lo = _mm256_permutevar8x32_epi32 (_mm256_loadu_si256 ((const __m256i *) lo_in), lo_index);"
+      , "  __m256i hi = _mm256_permutevar8x32_epi32 (_mm256_loadu_si256 ((const __m256i *) hi_in), hi_index);"
+      , "  /* shifting by 64 gives zero, which is what we want for values starting on a word boundary */"
+      , "  __m256i hi_shift = _mm256_sub_epi64 (_mm256_set1_epi64x (64), shift);"
+      , "  __m256i x = _mm256_and_si256 (_mm256_or_si256 (_mm256_srlv_epi64 (lo, shift), _mm256_sllv_epi64 (hi, hi_shift)), mask);"
+      , "  switch (codec) {"
+      , "    case ANEMONE_CODEC_FOR:"
+      , "      return _mm256_add_epi64 (x, base);"
+      , "    case ANEMONE_CODEC_ZIGZAG:"
+      , "      return _mm256_xor_si256 (_mm256_srli_epi64 (x, 1), _mm256_sub_epi64 (_mm256_setzero_si256 (), _mm256_and_si256 (x, _mm256_set1_epi64x (1))));"
+      , "    default:"
+      , "      return x;"
+      , "  }"
+      , "}"
+      , ""
+      , "/* unpack 8 values, reading the words they start in from |lo_in|, and the words after from |hi_in|. */"
+      , "ANEMONE_AVX512"
+      , "static ANEMONE_INLINE __m512i anemone_unpack_avx512 ("
+      , "  const int codec, const uint8_t *lo_in, const uint8_t *hi_in,"
+      , "  __m512i lo_index, __m512i hi_index, __m512i shift, __m512i mask, __m512i base) {"
+      , "  __m512i lo = _mm512_permutexvar_epi64 (lo_index, _mm512_loadu_si512 ((const void *) lo_in));"
+      , "  __m512i hi = _mm512_permutexvar_epi64 (hi_index, _mm512_loadu_si512 ((const void *) hi_in));"
+      , "  __m512i hi_shift = _mm512_sub_epi64 (_mm512_set1_epi64 (64), shift);"
+      , "  __m512i x = _mm512_and_si512 (_mm512_or_si512 (_mm512_srlv_epi64 (lo, shift), _mm512_sllv_epi64 (hi, hi_shift)), mask);"
+      , "  switch (codec) {"
+      , "    case ANEMONE_CODEC_FOR:"
+      , "      return _mm512_add_epi64 (x, base);"
+      , "    case ANEMONE_CODEC_ZIGZAG:"
+      , "      return _mm512_xor_si512 (_mm512_srli_epi64 (x, 1), _mm512_sub_epi64 (_mm512_setzero_si512 (), _mm512_and_si512 (x, _mm512_set1_epi64 (1))));"
+      , "    default:"
+      , "      return x;"
+      , "  }"
+      , "}" ]
+
+    sequence_
+      [ hPutStrLn h . unlines $ unpackVec isa bits
+      | isa <- isas
+      , bits <- filter (hasVecFn isa) [1..64] ]
+
+    sequence_
+      [ hPutStrLn h . unlines $
+          [ isaAttribute isa ] <>
+          instantiate unpackSig (vecFnName isa bits <> "_with") codec (vecFnName isa bits <> codecSuffix codec)
+      | isa <- isas
+      , codec <- vecCodecs
+      , bits <- filter (hasVecFn isa) [1..64] ]
+
+    -- Each table falls back to the best instruction set below it which has a kernel
+    sequence_
+      [ hPutStrLn h . unlines $
+          table "unpack64fn" (tableName "unpack" ("_" <> isaName isa) codec) (vecFallback (reverse preferred) codec)
+      | (isa, preferred) <- zip isas (drop 1 $ scanl (\acc i -> acc <> [i]) [] isas)
+      , codec <- vecCodecs ]
+
+    sequence_ $
+      [ do
+          sequence_
+            [ hPutStrLn h . unlines $
+                twice "unpack" unpackSig bits (unpack128FnName bits <> "_" <> isaName isa) (vecFallback (reverse preferred) raw bits)
+            | bits <- [0..64] ]
+          hPutStrLn h . unlines $
+            table "unpack64fn" ("unpack64_" <> show (2 * inputCount) <> "_" <> isaName isa <> "_table") (\bits -> unpack128FnName bits <> "_" <> isaName isa)
+      | (isa, preferred) <- zip isas (drop 1 $ scanl (\acc i -> acc <> [i]) [] isas) ]
 
     hPutStrLn h . unlines $
-      [ "static unpack64fn unpack64_" <> show inputCount <> "_table[] = {" ] <>
-      [ "  &" <> unpackFnName bits <> "," | bits <- [0..63] ] <>
-      [ "  &" <> unpackFnName 64
-      , "};" ]
+      [ "#endif" ]
+
+    hPutStrLn h . unlines $
+      [ "/* the best instruction set the kernels can use on this CPU, found once when the library is loaded. */"
+      , "static uint64_t resolved_pack_isa = ANEMONE_PACK_SCALAR;"
+      , ""
+      , "ANEMONE_CONSTRUCTOR"
+      , "static void anemone_pack_init () {"
+      , "#if ANEMONE_PACK_X86"
+      , "  if (anemone_cpu_supports (ANEMONE_CPU_AVX512F)) {"
+      , "    resolved_pack_isa = ANEMONE_PACK_AVX512;"
+      , "  } else if (anemone_cpu_supports (ANEMONE_CPU_AVX2)) {"
+      , "    resolved_pack_isa = ANEMONE_PACK_AVX2;"
+      , "  }"
+      , "#endif"
+      , "}"
+      , ""
+      , "uint64_t anemone_pack_isa () {"
+      , "  return resolved_pack_isa;"
+      , "}" ]
+
+    hPutStrLn h . unlines $
+      [ "/* get the pack kernel for |bits| and |codec|. */"
+      , "static pack64fn pack64_" <> show inputCount <> "_kernel (uint64_t codec, uint64_t bits) {"
+      , "  switch (codec) {" ] <>
+      concat
+        [ [ "    case " <> codecConst codec <> ":"
+          , "      return " <> tableName "pack" "" codec <> "[bits];" ]
+        | codec <- drop 1 codecs ] <>
+      [ "    default:"
+      , "      return " <> tableName "pack" "" raw <> "[bits];"
+      , "  }"
+      , "}" ]
+
+    hPutStrLn h . unlines $
+      [ "/* get the unpack kernel for |bits| and |codec| using the instruction set |isa|. */"
+      , "static unpack64fn unpack64_" <> show inputCount <> "_kernel (uint64_t isa, uint64_t codec, uint64_t bits) {"
+      , "#if ANEMONE_PACK_X86" ] <>
+      concat
+        [ [ "  if (isa == " <> isaConst isa <> ") {" ] <>
+          [ "    if (codec == " <> codecConst codec <> ") return " <> tableName "unpack" ("_" <> isaName isa) codec <> "[bits];"
+          | codec <- vecCodecs ] <>
+          [ "  }" ]
+        | isa <- reverse isas ] <>
+      [ "#endif"
+      , "  switch (codec) {" ] <>
+      concat
+        [ [ "    case " <> codecConst codec <> ":"
+          , "      return " <> tableName "unpack" "" codec <> "[bits];" ]
+        | codec <- drop 1 codecs ] <>
+      [ "    default:"
+      , "      return " <> tableName "unpack" "" raw <> "[bits];"
+      , "  }"
+      , "}" ]
 
     hPutStrLn h . unlines $
       [ "/* write |count| blocks of " <> show inputCount <> " x 64-bit values from |in| at |bits| bits per value to |out|. */"
       , "error_t anemone_pack64_" <> show inputCount <> " (uint64_t blocks, const uint64_t bits, const uint64_t *in, uint8_t *out) {"
       , "  if (bits > 64) return 1;"
       , "  pack64fn pack = pack64_" <> show inputCount <> "_table[bits];"
+      , "  uint64_t acc = 0;"
       , "  for (uint64_t b = 0; b < blocks; b++) {"
-      , "      pack (&in, &out);"
+      , "      pack (&in, &out, &acc);"
       , "  }"
       , "  return 0;"
       , "}" ]
@@ -230,20 +866,272 @@ main = do
     hPutStrLn h . unlines $
       [ "/* read |count| blocks of " <> show inputCount <> " values from |in| at |bits| bits per value, and write 64-bit values to |out|. */"
       , "error_t anemone_unpack64_" <> show inputCount <> " (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t *out) {"
-      , "  if (bits > 64) return 1;"
-      , "  unpack64fn unpack = unpack64_" <> show inputCount <> "_table[bits];"
+      , "  return anemone_unpack64_" <> show inputCount <> "_isa (anemone_pack_isa (), blocks, bits, in, out);"
+      , "}" ]
+
+    hPutStrLn h . unlines $
+      [ "/* unpack using the kernels for a particular instruction set, which must be supported by this CPU. */"
+      , "error_t anemone_unpack64_" <> show inputCount <> "_isa (uint64_t isa, uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t *out) {"
+      , "  if (bits > 64 || isa > anemone_pack_isa ()) return 1;"
+      , "  unpack64fn unpack = unpack64_" <> show inputCount <> "_kernel (isa, ANEMONE_CODEC_RAW, bits);"
+      , "  uint64_t acc = 0;"
+      , "  for (uint64_t b = 0; b < blocks; b++) {"
+      , "    unpack (&in, &out, &acc);"
+      , "  }"
+      , "  return 0;"
+      , "}" ]
+
+    hPutStrLn h . unlines $
+      [ "/* write |count| blocks of " <> show inputCount <> " x 32-bit values from |in| at |bits| bits per value to |out|, in the same layout as anemone_pack64_" <> show inputCount <> ". */"
+      , "error_t anemone_pack32_" <> show inputCount <> " (uint64_t blocks, const uint64_t bits, const uint32_t *in, uint8_t *out) {"
+      , "  if (bits > 32) return 1;"
+      , "  pack32fn pack = pack32_" <> show inputCount <> "_table[bits];"
+      , "  for (uint64_t b = 0; b < blocks; b++) {"
+      , "    pack (&in, &out);"
+      , "  }"
+      , "  return 0;"
+      , "}" ]
+
+    hPutStrLn h . unlines $
+      [ "/* read |count| blocks of " <> show inputCount <> " values from |in| at |bits| bits per value, and write 32-bit values to |out|. */"
+      , "error_t anemone_unpack32_" <> show inputCount <> " (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint32_t *out) {"
+      , "  if (bits > 32) return 1;"
+      , "  unpack32fn unpack = unpack32_" <> show inputCount <> "_table[bits];"
       , "  for (uint64_t b = 0; b < blocks; b++) {"
       , "    unpack (&in, &out);"
       , "  }"
       , "  return 0;"
       , "}" ]
 
+    hPutStrLn h . unlines $
+      [ "/* write |count| blocks of " <> show (2 * inputCount) <> " x 64-bit values from |in| at |bits| bits per value to |out|. */"
+      , "error_t anemone_pack64_" <> show (2 * inputCount) <> " (uint64_t blocks, const uint64_t bits, const uint64_t *in, uint8_t *out) {"
+      , "  if (bits > 64) return 1;"
+      , "  pack64fn pack = pack64_" <> show (2 * inputCount) <> "_table[bits];"
+      , "  uint64_t acc = 0;"
+      , "  for (uint64_t b = 0; b < blocks; b++) {"
+      , "    pack (&in, &out, &acc);"
+      , "  }"
+      , "  return 0;"
+      , "}" ]
+
+    hPutStrLn h . unlines $
+      [ "/* read |count| blocks of " <> show (2 * inputCount) <> " values from |in| at |bits| bits per value, and write 64-bit values to |out|. */"
+      , "error_t anemone_unpack64_" <> show (2 * inputCount) <> " (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t *out) {"
+      , "  return anemone_unpack64_" <> show (2 * inputCount) <> "_isa (anemone_pack_isa (), blocks, bits, in, out);"
+      , "}" ]
+
+    hPutStrLn h . unlines $
+      [ "/* unpack using the kernels for a particular instruction set, which must be supported by this CPU. */"
+      , "error_t anemone_unpack64_" <> show (2 * inputCount) <> "_isa (uint64_t isa, uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t *out) {"
+      , "  if (bits > 64 || isa > anemone_pack_isa ()) return 1;"
+      , "  unpack64fn unpack = unpack64_" <> show (2 * inputCount) <> "_table[bits];"
+      , "#if ANEMONE_PACK_X86" ] <>
+      [ "  if (isa == " <> isaConst isa <> ") unpack = unpack64_" <> show (2 * inputCount) <> "_" <> isaName isa <> "_table[bits];"
+      | isa <- isas ] <>
+      [ "#endif"
+      , "  uint64_t acc = 0;"
+      , "  for (uint64_t b = 0; b < blocks; b++) {"
+      , "    unpack (&in, &out, &acc);"
+      , "  }"
+      , "  return 0;"
+      , "}" ]
+
+    -- The same arithmetic as fstWord and fstShift, but over the whole input rather than a block
+    hPutStrLn h . unlines $
+      [ "/* read value |index| from blocks packed at |bits| bits per value, without unpacking its block. */"
+      , "static ANEMONE_INLINE uint64_t anemone_pack_get_with (const uint64_t bits, const uint8_t *in, uint64_t index) {"
+      , "  /* blocks are a whole number of words, so the value starts at bit |index * bits| of the input */"
+      , "  uint64_t offset = index * bits;"
+      , "  uint64_t word = offset / 64;"
+      , "  uint64_t shift = offset % 64;"
+      , "  uint64_t x;"
+      , "  if (bits == 0) return 0;"
+      , "  x = anemone_load64 (in + word * 8) >> shift;"
+      , "  /* the value straddles two words, the next word is in the same block */"
+      , "  if (shift + bits > 64) {"
+      , "    x |= anemone_load64 (in + word * 8 + 8) << (64 - shift);"
+      , "  }"
+      , "  return bits == 64 ? x : x & ((UINT64_C(1) << bits) - 1);"
+      , "}" ]
+
+    sequence_
+      [ hPutStrLn h . unlines $
+          [ "/* gather values at |bits| = " <> show bits <> " from the |count| indices at |indices|. */"
+          , "static void " <> gatherFnName bits <> " (const uint8_t *in, uint64_t count, const uint64_t *indices, uint64_t *out) {"
+          , "  for (uint64_t i = 0; i < count; i++) {"
+          , "    out[i] = anemone_pack_get_with (" <> show bits <> ", in, indices[i]);"
+          , "  }"
+          , "}" ]
+      | bits <- [0..64] ]
+
+    hPutStrLn h . unlines $
+      table "gather64fn" ("gather64_" <> show inputCount <> "_table") gatherFnName
+
+    hPutStrLn h . unlines $
+      [ "/* read value |index| from |in|, which holds blocks of " <> show inputCount <> " values packed at |bits| bits per value by anemone_pack64_" <> show inputCount <> ". */"
+      , "uint64_t anemone_pack_get (uint64_t bits, const uint8_t *in, uint64_t index) {"
+      , "  return bits > 64 ? 0 : anemone_pack_get_with (bits, in, index);"
+      , "}" ]
+
+    hPutStrLn h . unlines $
+      [ "/* read the |count| values at |indices| from |in|, which holds blocks of " <> show inputCount <> " values packed at |bits| bits per value, and write them to |out|. */"
+      , "error_t anemone_pack_gather (uint64_t bits, const uint8_t *in, uint64_t count, const uint64_t *indices, uint64_t *out) {"
+      , "  if (bits > 64) return 1;"
+      , "  gather64_" <> show inputCount <> "_table[bits] (in, count, indices, out);"
+      , "  return 0;"
+      , "}" ]
+
+    hPutStrLn h . unlines $
+      [ "/* add |x| to the sum, min and max of a block. */"
+      , "static ANEMONE_INLINE void anemone_aggregate (uint64_t x, uint64_t *sum, uint64_t *min, uint64_t *max) {"
+      , "  *sum += x;"
+      , "  *min = x < *min ? x : *min;"
+      , "  *max = x > *max ? x : *max;"
+      , "}"
+      , ""
+      , "/* set bit |i| of |selection| if |x| is between |lo| and |lo + range|, a single unsigned comparison. */"
+      , "static ANEMONE_INLINE void anemone_select (uint64_t *selection, int i, uint64_t x, uint64_t lo, uint64_t range) {"
+      , "  *selection |= (uint64_t) (x - lo <= range) << i;"
+      , "}" ]
+
+    hPutStrLn h . unlines $
+      [ "/* sum, min and max of " <> show inputCount <> " x 0-bit integers, which are all zero */"
+      , "static void " <> aggregateFnName 0 <> " (const uint8_t **pin, uint64_t *psum, uint64_t *pmin, uint64_t *pmax) {"
+      , "  (void) pin;"
+      , "  (void) psum;"
+      , "  (void) pmax;"
+      , "  *pmin = 0;"
+      , "}" ]
+
+    mapM_ (hPutStrLn h . unlines . aggregate) [1..64]
+
+    hPutStrLn h . unlines $
+      [ "/* select which of " <> show inputCount <> " x 0-bit integers are between |lo| and |lo + range|, which are all zero */"
+      , "static uint64_t " <> selectFnName 0 <> " (const uint8_t **pin, uint64_t lo, uint64_t range) {"
+      , "  (void) pin;"
+      , "  return 0 - lo <= range ? UINT64_MAX : 0;"
+      , "}" ]
+
+    mapM_ (hPutStrLn h . unlines . select) [1..64]
+
+    hPutStrLn h . unlines $
+      table "aggregate64fn" ("aggregate64_" <> show inputCount <> "_table") aggregateFnName
+
+    hPutStrLn h . unlines $
+      table "select64fn" ("select64_" <> show inputCount <> "_table") selectFnName
+
+    hPutStrLn h . unlines $
+      [ "/* sum, min and max of |blocks| blocks of " <> show inputCount <> " values packed at |bits| bits per value by anemone_pack64_" <> show inputCount <> ". */"
+      , "/* the sum wraps on overflow, and without any values the min is UINT64_MAX and the max is zero. */"
+      , "error_t anemone_pack_aggregate (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t *sum, uint64_t *min, uint64_t *max) {"
+      , "  if (bits > 64) return 1;"
+      , "  aggregate64fn aggregate = aggregate64_" <> show inputCount <> "_table[bits];"
+      , "  *sum = 0;"
+      , "  *min = UINT64_MAX;"
+      , "  *max = 0;"
+      , "  for (uint64_t b = 0; b < blocks; b++) {"
+      , "    aggregate (&in, sum, min, max);"
+      , "  }"
+      , "  return 0;"
+      , "}" ]
+
+    hPutStrLn h . unlines $
+      [ "/* write a mask for each of |blocks| blocks of " <> show inputCount <> " values packed at |bits| bits per value to |out|, where bit i is set if value i is between |lo| and |hi| inclusive. */"
+      , "error_t anemone_pack_between (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t lo, uint64_t hi, uint64_t *out) {"
+      , "  if (bits > 64) return 1;"
+      , "  if (hi < lo) {"
+      , "    memset (out, 0, blocks * 8);"
+      , "    return 0;"
+      , "  }"
+      , "  select64fn kernel = select64_" <> show inputCount <> "_table[bits];"
+      , "  for (uint64_t b = 0; b < blocks; b++) {"
+      , "    out[b] = kernel (&in, lo, hi - lo);"
+      , "  }"
+      , "  return 0;"
+      , "}"
+      , ""
+      , "/* like anemone_pack_between, selecting values equal to |value|. */"
+      , "error_t anemone_pack_eq (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t value, uint64_t *out) {"
+      , "  return anemone_pack_between (blocks, bits, in, value, value, out);"
+      , "}"
+      , ""
+      , "/* like anemone_pack_between, selecting values less than |value|. */"
+      , "error_t anemone_pack_lt (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t value, uint64_t *out) {"
+      , "  return value ? anemone_pack_between (blocks, bits, in, 0, value - 1, out) : anemone_pack_between (blocks, bits, in, 1, 0, out);"
+      , "}" ]
+
     hPutStrLn h . unlines $
       [ "/* calculate number of bits required to store |value|. */"
       , "uint64_t anemone_bitsof (uint64_t value) {"
       , "  return value ? 64 - __builtin_clzll (value) : 0;"
       , "}" ]
 
+    hPutStrLn h . unlines $
+      [ "/* choose the base and bit width for encoding the " <> show inputCount <> " values at |in| with |codec|. */"
+      , "static uint64_t anemone_encode64_" <> show inputCount <> "_bits (uint64_t codec, const uint64_t *in, uint64_t *base) {"
+      , "  uint64_t acc = 0;"
+      , "  uint64_t any = 0;"
+      , "  if (codec == ANEMONE_CODEC_FOR) {"
+      , "    acc = in[0];"
+      , "    for (int i = 1; i < " <> show inputCount <> "; i++) {"
+      , "      acc = in[i] < acc ? in[i] : acc;"
+      , "    }"
+      , "  } else if (codec == ANEMONE_CODEC_DELTA) {"
+      , "    acc = in[0];"
+      , "  }"
+      , "  *base = acc;"
+      , "  for (int i = 0; i < " <> show inputCount <> "; i++) {"
+      , "    any |= anemone_encode (codec, in[i], &acc);"
+      , "  }"
+      , "  return anemone_bitsof (any);"
+      , "}" ]
+
+    hPutStrLn h . unlines $
+      [ "/* the most bytes that encoding |blocks| blocks of " <> show inputCount <> " values can take. */"
+      , "uint64_t anemone_encode64_" <> show inputCount <> "_bound (uint64_t blocks) {"
+      , "  return blocks * (ANEMONE_CODEC_HEADER_SIZE + " <> show inputCount <> " * 8);"
+      , "}" ]
+
+    hPutStrLn h . unlines $
+      [ "/* encode |blocks| blocks of " <> show inputCount <> " x 64-bit values from |in| with |codec| to |out|, choosing the bits per value for each block, and write the number of bytes used to |out_size|. */"
+      , "error_t anemone_encode64_" <> show inputCount <> " (uint64_t codec, uint64_t blocks, const uint64_t *in, uint8_t *out, uint64_t *out_size) {"
+      , "  if (codec > ANEMONE_CODEC_ZIGZAG) return 1;"
+      , "  uint8_t *start = out;"
+      , "  for (uint64_t b = 0; b < blocks; b++) {"
+      , "    uint64_t base;"
+      , "    uint64_t bits = anemone_encode64_" <> show inputCount <> "_bits (codec, in, &base);"
+      , "    out[0] = (uint8_t) bits;"
+      , "    anemone_store64 (out + 1, base);"
+      , "    out += ANEMONE_CODEC_HEADER_SIZE;"
+      , "    pack64_" <> show inputCount <> "_kernel (codec, bits) (&in, &out, &base);"
+      , "  }"
+      , "  *out_size = out - start;"
+      , "  return 0;"
+      , "}" ]
+
+    hPutStrLn h . unlines $
+      [ "/* decode |blocks| blocks of " <> show inputCount <> " values encoded with |codec| from the |in_size| bytes at |in|, and write 64-bit values to |out|. */"
+      , "error_t anemone_decode64_" <> show inputCount <> " (uint64_t codec, uint64_t blocks, const uint8_t *in, uint64_t in_size, uint64_t *out) {"
+      , "  return anemone_decode64_" <> show inputCount <> "_isa (anemone_pack_isa (), codec, blocks, in, in_size, out);"
+      , "}" ]
+
+    hPutStrLn h . unlines $
+      [ "/* decode using the kernels for a particular instruction set, which must be supported by this CPU. */"
+      , "error_t anemone_decode64_" <> show inputCount <> "_isa (uint64_t isa, uint64_t codec, uint64_t blocks, const uint8_t *in, uint64_t in_size, uint64_t *out) {"
+      , "  if (codec > ANEMONE_CODEC_ZIGZAG || isa > anemone_pack_isa ()) return 1;"
+      , "  const uint8_t *end = in + in_size;"
+      , "  for (uint64_t b = 0; b < blocks; b++) {"
+      , "    if (end - in < ANEMONE_CODEC_HEADER_SIZE) return 1;"
+      , "    uint64_t bits = in[0];"
+      , "    uint64_t base = anemone_load64 (in + 1);"
+      , "    in += ANEMONE_CODEC_HEADER_SIZE;"
+      , "    if (bits > 64 || (uint64_t) (end - in) < bits * 8) return 1;"
+      , "    unpack64_" <> show inputCount <> "_kernel (isa, codec, bits) (&in, &out, &base);"
+      , "  }"
+      , "  return in == end ? 0 : 1;"
+      , "}" ]
+
   withFile "cbits/anemone_pack.h" WriteMode $ \h -> do
     hPutStrLn h . unlines $
       [ "#ifndef __ANEMONE_PACK_H"
@@ -251,9 +1139,63 @@ main = do
       , ""
       , "#include \"anemone_base.h\""
       , ""
+      , "/* instruction sets which the unpack kernels are specialised for, in order of preference. */"
+      , "#define ANEMONE_PACK_SCALAR 0"
+      , "#define ANEMONE_PACK_AVX2   1"
+      , "#define ANEMONE_PACK_AVX512 2"
+      , ""
+      , "/* block codecs for anemone_encode64_" <> show inputCount <> ", each block has a header with its bits per value and its base. */"
+      , "/* raw: values are packed as they are, and the base is zero */"
+      , "#define ANEMONE_CODEC_RAW    0"
+      , "/* frame of reference: the base is the minimum, and offsets from it are packed */"
+      , "#define ANEMONE_CODEC_FOR    1"
+      , "/* delta: the base is the first value, and differences from the previous value are packed, for sorted values */"
+      , "#define ANEMONE_CODEC_DELTA  2"
+      , "/* zigzag: values are signed, and packed so that small magnitudes take few bits */"
+      , "#define ANEMONE_CODEC_ZIGZAG 3"
+      , ""
+      , "/* a block header is one byte for the bits per value followed by the 64-bit base. */"
+      , "#define ANEMONE_CODEC_HEADER_SIZE 9"
+      , ""
+      , "uint64_t anemone_pack_isa ();"
+      , ""
+      , "uint64_t anemone_bitsof (uint64_t value);"
+      , ""
       , "error_t anemone_pack64_" <> show inputCount <> " (uint64_t blocks, const uint64_t bits, const uint64_t *in, uint8_t *out);"
       , ""
       , "error_t anemone_unpack64_" <> show inputCount <> " (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t *out);"
       , ""
+      , "error_t anemone_unpack64_" <> show inputCount <> "_isa (uint64_t isa, uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t *out);"
+      , ""
+      , "error_t anemone_pack32_" <> show inputCount <> " (uint64_t blocks, const uint64_t bits, const uint32_t *in, uint8_t *out);"
+      , ""
+      , "error_t anemone_unpack32_" <> show inputCount <> " (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint32_t *out);"
+      , ""
+      , "error_t anemone_pack64_" <> show (2 * inputCount) <> " (uint64_t blocks, const uint64_t bits, const uint64_t *in, uint8_t *out);"
+      , ""
+      , "error_t anemone_unpack64_" <> show (2 * inputCount) <> " (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t *out);"
+      , ""
+      , "error_t anemone_unpack64_" <> show (2 * inputCount) <> "_isa (uint64_t isa, uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t *out);"
+      , ""
+      , "uint64_t anemone_pack_get (uint64_t bits, const uint8_t *in, uint64_t index);"
+      , ""
+      , "error_t anemone_pack_gather (uint64_t bits, const uint8_t *in, uint64_t count, const uint64_t *indices, uint64_t *out);"
+      , ""
+      , "error_t anemone_pack_aggregate (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t *sum, uint64_t *min, uint64_t *max);"
+      , ""
+      , "error_t anemone_pack_between (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t lo, uint64_t hi, uint64_t *out);"
+      , ""
+      , "error_t anemone_pack_eq (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t value, uint64_t *out);"
+      , ""
+      , "error_t anemone_pack_lt (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t value, uint64_t *out);"
+      , ""
+      , "uint64_t anemone_encode64_" <> show inputCount <> "_bound (uint64_t blocks);"
+      , ""
+      , "error_t anemone_encode64_" <> show inputCount <> " (uint64_t codec, uint64_t blocks, const uint64_t *in, uint8_t *out, uint64_t *out_size);"
+      , ""
+      , "error_t anemone_decode64_" <> show inputCount <> " (uint64_t codec, uint64_t blocks, const uint8_t *in, uint64_t in_size, uint64_t *out);"
+      , ""
+      , "error_t anemone_decode64_" <> show inputCount <> "_isa (uint64_t isa, uint64_t codec, uint64_t blocks, const uint8_t *in, uint64_t in_size, uint64_t *out);"
+      , ""
       , "#endif//__ANEMONE_PACK_H"
       ]
@@ -0,0 +1,181 @@
+#define _GNU_SOURCE 1
+
+#include "anemone_bench.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <x86intrin.h>
+
+ANEMONE_STATIC
+uint64_t bench_now_ns ()
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// The time stamp counter ticks at a fixed rate, not the core clock, so this
+// is only the same as cycles when the core is running at its base frequency.
+ANEMONE_STATIC
+double bench_ticks_per_ns ()
+{
+    const uint64_t t0 = bench_now_ns ();
+    const uint64_t c0 = __rdtsc ();
+    while (bench_now_ns () - t0 < 10000000) { }
+    const uint64_t t1 = bench_now_ns ();
+    const uint64_t c1 = __rdtsc ();
+    return (double) (c1 - c0) / (double) (t1 - t0);
+}
+
+ANEMONE_STATIC
+int bench_compare_double (const void *a, const void *b)
+{
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+// The sample at the given percentile of a sorted array, rounding up.
+ANEMONE_STATIC
+double bench_percentile (const double *sorted, int n, int percent)
+{
+    int i = (n * percent + 99) / 100 - 1;
+    if (i < 0) i = 0;
+    if (i >= n) i = n - 1;
+    return sorted[i];
+}
+
+error_t anemone_bench_open (anemone_bench_t *bench, const char *json_path, const char *filter, int repetitions)
+{
+    bench->json = NULL;
+    bench->filter = filter;
+    bench->repetitions = repetitions > 0 ? repetitions : ANEMONE_BENCH_REPETITIONS;
+    bench->results = 0;
+    bench->ticks_per_ns = bench_ticks_per_ns ();
+    bench->sink = 0;
+
+    if (json_path) {
+        bench->json = fopen (json_path, "w");
+        if (bench->json == NULL) return 1;
+
+        fprintf (bench->json, "{\"tsc_ghz\": %.4f, \"repetitions\": %d, \"results\": [", bench->ticks_per_ns, bench->repetitions);
+    }
+
+    printf ("%-24s %-8s %-20s %10s %10s %10s %10s\n", "name", "variant", "params", "ns/op", "p99", "cycles/op", "GB/s");
+
+    return 0;
+}
+
+void anemone_bench_close (anemone_bench_t *bench)
+{
+    if (bench->json) {
+        fprintf (bench->json, "\n]}\n");
+        fclose (bench->json);
+        bench->json = NULL;
+    }
+}
+
+void anemone_bench_run (
+    anemone_bench_t *bench
+  , const char *name
+  , const char *variant
+  , const char *params
+  , uint64_t ops
+  , uint64_t bytes
+  , anemone_bench_fn_t fn
+  , void *env
+  )
+{
+    if (bench->filter &&
+        !strstr (name, bench->filter) &&
+        !strstr (variant, bench->filter) &&
+        !strstr (params, bench->filter)) {
+        return;
+    }
+
+    uint64_t sink = 0;
+
+    // warm up the caches and branch predictors, counting calls to find out
+    // how many are needed for a sample to be long enough
+    uint64_t warmup_calls = 0;
+    const uint64_t warmup_start = bench_now_ns ();
+    uint64_t warmup_ns;
+    do {
+        sink += fn (env);
+        warmup_calls++;
+        warmup_ns = bench_now_ns () - warmup_start;
+    } while (warmup_ns < ANEMONE_BENCH_WARMUP_NS);
+
+    uint64_t batch = warmup_calls * ANEMONE_BENCH_SAMPLE_NS / warmup_ns;
+    if (batch == 0) batch = 1;
+
+    const int n = bench->repetitions;
+    double *ns = malloc (2 * n * sizeof (double));
+    if (ns == NULL) return;
+    double *ticks = ns + n;
+
+    for (int r = 0; r != n; ++r) {
+        const uint64_t t0 = bench_now_ns ();
+        const uint64_t c0 = __rdtsc ();
+        for (uint64_t i = 0; i != batch; ++i) {
+            sink += fn (env);
+        }
+        const uint64_t c1 = __rdtsc ();
+        const uint64_t t1 = bench_now_ns ();
+
+        ns[r] = (double) (t1 - t0) / (double) (batch * ops);
+        ticks[r] = (double) (c1 - c0) / (double) (batch * ops);
+    }
+
+    qsort (ns, n, sizeof (double), bench_compare_double);
+    qsort (ticks, n, sizeof (double), bench_compare_double);
+
+    const double ns_min = ns[0];
+    const double ns_median = bench_percentile (ns, n, 50);
+    const double ns_p99 = bench_percentile (ns, n, 99);
+    const double ticks_median = bench_percentile (ticks, n, 50);
+    const double ticks_p99 = bench_percentile (ticks, n, 99);
+
+    // bytes per nanosecond is the same as gigabytes per second
+    const double gb_per_s = (double) bytes / (double) ops / ns_median;
+
+    printf ("%-24s %-8s %-20s %10.3f %10.3f %10.3f %10.3f\n", name, variant, params, ns_median, ns_p99, ticks_median, gb_per_s);
+    fflush (stdout);
+
+    if (bench->json) {
+        fprintf (bench->json,
+            "%s\n  {\"name\": \"%s\", \"variant\": \"%s\", \"params\": \"%s\""
+            ", \"ops_per_call\": %" PRIu64 ", \"bytes_per_call\": %" PRIu64 ", \"calls_per_sample\": %" PRIu64
+            ", \"ns_per_op\": {\"min\": %.4f, \"median\": %.4f, \"p99\": %.4f}"
+            ", \"cycles_per_op\": {\"median\": %.4f, \"p99\": %.4f}"
+            ", \"gb_per_s\": %.4f}",
+            bench->results == 0 ? "" : ",",
+            name, variant, params,
+            ops, bytes, batch,
+            ns_min, ns_median, ns_p99,
+            ticks_median, ticks_p99,
+            gb_per_s);
+    }
+
+    bench->results++;
+    bench->sink += sink;
+
+    free (ns);
+}
+
+error_t anemone_bench_main (const char *json_path, const char *filter, int repetitions)
+{
+    anemone_bench_t bench;
+
+    if (anemone_bench_open (&bench, json_path, filter, repetitions)) {
+        fprintf (stderr, "anemone_bench: could not open %s\n", json_path);
+        return 1;
+    }
+
+    anemone_bench_kernels (&bench);
+    anemone_bench_close (&bench);
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+#ifndef __ANEMONE_BENCH_H
+#define __ANEMONE_BENCH_H
+
+//
+// A harness for timing the C kernels on their own, without going through
+// the FFI.
+//
+// Each benchmark is a function which does one call's worth of work on
+// inputs set up before hand, and says how many operations and bytes that is.
+// The harness warms it up, picks how many calls to make per sample so the
+// timer's resolution does not matter, then takes a number of samples timed
+// with both the monotonic clock and the time stamp counter.
+//
+// Results are printed as a table, and written as JSON, so runs on different
+// releases or machines can be compared. Names, variants and parameters are
+// written to the JSON as they are, so they must not need escaping.
+//
+
+#include "anemone_base.h"
+
+#include <stdio.h>
+
+// Each benchmark is warmed up for this long before it is timed
+#define ANEMONE_BENCH_WARMUP_NS 20000000
+
+// Calls are batched so each sample takes at least this long
+#define ANEMONE_BENCH_SAMPLE_NS 100000
+
+// Number of samples taken when none is given
+#define ANEMONE_BENCH_REPETITIONS 101
+
+// One call's worth of work, returning something which depends on its result
+// so that it can not be optimised away.
+typedef uint64_t (*anemone_bench_fn_t) (void *env);
+
+typedef struct {
+  FILE *json;
+  // Only benchmarks with this in their name, variant or parameters are run
+  const char *filter;
+  int repetitions;
+  // Number of results written, for the commas in the JSON
+  int64_t results;
+  // Time stamp counter ticks per nanosecond, measured when opened
+  double ticks_per_ns;
+  // Results of every call, so none of them can be optimised away
+  uint64_t sink;
+} anemone_bench_t;
+
+//
+// Start a run, writing JSON to 'json_path' unless it is null. A null filter
+// runs everything, and zero repetitions means ANEMONE_BENCH_REPETITIONS.
+// Returns 0 on success, or 1 if the file could not be opened.
+//
+error_t anemone_bench_open (anemone_bench_t *bench, const char *json_path, const char *filter, int repetitions);
+
+// Finish the run and close the JSON file.
+void anemone_bench_close (anemone_bench_t *bench);
+
+//
+// Time 'fn', which does 'ops' operations on 'bytes' bytes of input each time
+// it is called, and report the time per operation.
+//
+// The 'variant' says which implementation it is, such as "scalar", "avx2"
+// or "libc", and 'params' describes the input, such as "bits=13".
+//
+void anemone_bench_run (
+    anemone_bench_t *bench
+  , const char *name
+  , const char *variant
+  , const char *params
+  , uint64_t ops
+  , uint64_t bytes
+  , anemone_bench_fn_t fn
+  , void *env
+  );
+
+//
+// A small, fast random number generator (xorshift64*), so inputs are the same
+// on every run.
+//
+ANEMONE_INLINE
+uint64_t anemone_bench_random (uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+// A random number from 'lo' up to and including 'hi'.
+ANEMONE_INLINE
+uint64_t anemone_bench_range (uint64_t *state, uint64_t lo, uint64_t hi)
+{
+    return lo + anemone_bench_random (state) % (hi - lo + 1);
+}
+
+// Run every benchmark in bench_kernels.c.
+void anemone_bench_kernels (anemone_bench_t *bench);
+
+// Open a run, run every benchmark and close it, as anemone_bench_open.
+error_t anemone_bench_main (const char *json_path, const char *filter, int repetitions);
+
+#endif//__ANEMONE_BENCH_H
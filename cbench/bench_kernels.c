@@ -0,0 +1,795 @@
+#define _GNU_SOURCE 1
+
+#include "anemone_bench.h"
+
+#include "anemone_atoi.h"
+#include "anemone_atoi_sse.h"
+#include "anemone_chunk.h"
+#include "anemone_grisu2.h"
+#include "anemone_hash.h"
+#include "anemone_itoa.h"
+#include "anemone_memcmp.h"
+#include "anemone_mempool.h"
+#include "anemone_pack.h"
+#include "anemone_ryu.h"
+#include "anemone_strtod.h"
+#include "anemone_time.h"
+#include "anemone_tokenize.h"
+#include "anemone_vint.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Number of values each call works on, small enough to stay in L1 or L2
+#define BENCH_N 4096
+
+// Room for one rendered number
+#define BENCH_NUMBER_SIZE 64
+
+//
+// Text inputs: BENCH_N numbers, each at a fixed offset so that a call can
+// walk through them without scanning for the end.
+//
+typedef struct {
+    char text[BENCH_N][BENCH_NUMBER_SIZE];
+    size_t lens[BENCH_N];
+    uint64_t bytes;
+} bench_text_t;
+
+ANEMONE_STATIC
+void bench_text_push (bench_text_t *text, int64_t i, const char *str)
+{
+    size_t len = strlen (str);
+    memcpy (text->text[i], str, len);
+    text->lens[i] = len;
+    text->bytes += len;
+}
+
+//
+// Bit packing, with every width, as columns are packed at the width of their
+// largest value.
+//
+typedef struct {
+    uint64_t bits;
+    uint64_t isa;
+    uint64_t values[BENCH_N];
+    uint8_t packed[BENCH_N * 8];
+    uint64_t unpacked[BENCH_N];
+} bench_pack_t;
+
+ANEMONE_STATIC
+uint64_t bench_pack64_64 (void *env)
+{
+    bench_pack_t *b = env;
+    anemone_pack64_64 (BENCH_N / 64, b->bits, b->values, b->packed);
+    return b->packed[0];
+}
+
+ANEMONE_STATIC
+uint64_t bench_unpack64_64 (void *env)
+{
+    bench_pack_t *b = env;
+    anemone_unpack64_64_isa (b->isa, BENCH_N / 64, b->bits, b->packed, b->unpacked);
+    return b->unpacked[BENCH_N - 1];
+}
+
+ANEMONE_STATIC
+void bench_pack (anemone_bench_t *bench)
+{
+    static const uint64_t widths[] = { 1, 3, 7, 13, 23, 32, 47, 64 };
+    static const char *isa_names[] = { "scalar", "avx2", "avx512" };
+
+    bench_pack_t *b = malloc (sizeof (bench_pack_t));
+    if (b == NULL) return;
+
+    uint64_t seed = 1;
+    char params[32];
+
+    for (size_t w = 0; w != sizeof (widths) / sizeof (widths[0]); ++w) {
+        b->bits = widths[w];
+        const uint64_t mask = b->bits == 64 ? UINT64_MAX : (1ULL << b->bits) - 1;
+        for (int64_t i = 0; i != BENCH_N; ++i) {
+            b->values[i] = anemone_bench_random (&seed) & mask;
+        }
+        anemone_pack64_64 (BENCH_N / 64, b->bits, b->values, b->packed);
+
+        snprintf (params, sizeof (params), "bits=%" PRIu64, b->bits);
+
+        anemone_bench_run (bench, "pack64_64", "scalar", params, BENCH_N, BENCH_N * 8, bench_pack64_64, b);
+
+        // every instruction set this machine supports
+        for (b->isa = ANEMONE_PACK_SCALAR; b->isa <= anemone_pack_isa (); ++b->isa) {
+            anemone_bench_run (bench, "unpack64_64", isa_names[b->isa], params, BENCH_N, BENCH_N * 8, bench_unpack64_64, b);
+        }
+    }
+
+    free (b);
+}
+
+//
+// Variable length integers, with a mix of widths
+//
+typedef struct {
+    int64_t values[BENCH_N];
+    uint8_t encoded[BENCH_N * 10];
+    int64_t decoded[BENCH_N];
+    uint64_t size;
+} bench_vint_t;
+
+ANEMONE_STATIC
+uint64_t bench_write_vint (void *env)
+{
+    bench_vint_t *b = env;
+    uint8_t *end = anemone_write_vint_array (BENCH_N, b->values, b->encoded);
+    return end - b->encoded;
+}
+
+ANEMONE_STATIC
+uint64_t bench_read_vint (void *env)
+{
+    bench_vint_t *b = env;
+    const uint8_t *p = b->encoded;
+    anemone_read_vint_array (&p, b->encoded + b->size, BENCH_N, b->decoded);
+    return b->decoded[BENCH_N - 1];
+}
+
+ANEMONE_STATIC
+void bench_vint (anemone_bench_t *bench)
+{
+    // the largest number of bits in a value, picked uniformly for each value
+    static const struct { const char *params; int lo; int hi; } mixes[] = {
+        { "bits=1-6",   1, 6  },
+        { "bits=1-20",  1, 20 },
+        { "bits=1-63",  1, 63 },
+        { "bits=50-63", 50, 63 },
+    };
+
+    bench_vint_t *b = malloc (sizeof (bench_vint_t));
+    if (b == NULL) return;
+
+    uint64_t seed = 2;
+
+    for (size_t m = 0; m != sizeof (mixes) / sizeof (mixes[0]); ++m) {
+        for (int64_t i = 0; i != BENCH_N; ++i) {
+            const uint64_t bits = anemone_bench_range (&seed, mixes[m].lo, mixes[m].hi);
+            const int64_t magnitude = (int64_t) (anemone_bench_random (&seed) >> (64 - bits));
+            b->values[i] = anemone_bench_random (&seed) & 1 ? -magnitude : magnitude;
+        }
+        b->size = anemone_write_vint_array (BENCH_N, b->values, b->encoded) - b->encoded;
+
+        anemone_bench_run (bench, "write_vint_array", "scalar", mixes[m].params, BENCH_N, b->size, bench_write_vint, b);
+        anemone_bench_run (bench, "read_vint_array", "scalar", mixes[m].params, BENCH_N, b->size, bench_read_vint, b);
+    }
+
+    free (b);
+}
+
+//
+// Hashing, over lengths like those of join and group-by keys
+//
+typedef struct {
+    uint8_t *data;
+    const uint8_t *ptrs[BENCH_N];
+    size_t lens[BENCH_N];
+    uint64_t hashes[BENCH_N];
+    uint64_t bytes;
+} bench_hash_t;
+
+ANEMONE_STATIC
+uint64_t bench_fasthash64 (void *env)
+{
+    bench_hash_t *b = env;
+    uint64_t h = 0;
+    for (int64_t i = 0; i != BENCH_N; ++i) {
+        h ^= anemone_fasthash64 (0, b->ptrs[i], b->lens[i]);
+    }
+    return h;
+}
+
+ANEMONE_STATIC
+uint64_t bench_fasthash64_batch (void *env)
+{
+    bench_hash_t *b = env;
+    anemone_fasthash64_batch (0, b->ptrs, b->lens, BENCH_N, b->hashes);
+    return b->hashes[BENCH_N - 1];
+}
+
+ANEMONE_STATIC
+void bench_hash (anemone_bench_t *bench)
+{
+    static const struct { const char *params; size_t lo; size_t hi; } dists[] = {
+        { "len=8",      8,   8   },
+        { "len=16",     16,  16  },
+        { "len=1-32",   1,   32  },
+        { "len=4-128",  4,   128 },
+        { "len=256",    256, 256 },
+    };
+
+    bench_hash_t *b = malloc (sizeof (bench_hash_t));
+    if (b == NULL) return;
+    b->data = malloc (BENCH_N * 256);
+    if (b->data == NULL) {
+        free (b);
+        return;
+    }
+
+    uint64_t seed = 3;
+    for (int64_t i = 0; i != BENCH_N * 256; ++i) {
+        b->data[i] = (uint8_t) anemone_bench_random (&seed);
+    }
+
+    for (size_t d = 0; d != sizeof (dists) / sizeof (dists[0]); ++d) {
+        b->bytes = 0;
+        for (int64_t i = 0; i != BENCH_N; ++i) {
+            b->ptrs[i] = b->data + i * 256;
+            b->lens[i] = anemone_bench_range (&seed, dists[d].lo, dists[d].hi);
+            b->bytes += b->lens[i];
+        }
+
+        anemone_bench_run (bench, "fasthash64", "scalar", dists[d].params, BENCH_N, b->bytes, bench_fasthash64, b);
+        anemone_bench_run (bench, "fasthash64_batch", "scalar", dists[d].params, BENCH_N, b->bytes, bench_fasthash64_batch, b);
+    }
+
+    free (b->data);
+    free (b);
+}
+
+//
+// Memory pool allocation, then a reset, which is how a pool is used per batch
+//
+typedef struct {
+    anemone_mempool_t *pool;
+    size_t sizes[BENCH_N];
+} bench_mempool_t;
+
+ANEMONE_STATIC
+uint64_t bench_mempool_alloc (void *env)
+{
+    bench_mempool_t *b = env;
+    uint64_t x = 0;
+    for (int64_t i = 0; i != BENCH_N; ++i) {
+        x ^= (uintptr_t) anemone_mempool_alloc (b->pool, b->sizes[i]);
+    }
+    anemone_mempool_reset (b->pool);
+    return x;
+}
+
+ANEMONE_STATIC
+uint64_t bench_malloc (void *env)
+{
+    bench_mempool_t *b = env;
+    void *ptrs[BENCH_N];
+    uint64_t x = 0;
+    for (int64_t i = 0; i != BENCH_N; ++i) {
+        ptrs[i] = malloc (b->sizes[i]);
+        x ^= (uintptr_t) ptrs[i];
+    }
+    for (int64_t i = 0; i != BENCH_N; ++i) {
+        free (ptrs[i]);
+    }
+    return x;
+}
+
+ANEMONE_STATIC
+void bench_mempool (anemone_bench_t *bench)
+{
+    static const struct { const char *params; size_t lo; size_t hi; } dists[] = {
+        { "size=16",     16, 16   },
+        { "size=8-256",  8,  256  },
+        { "size=8-4096", 8,  4096 },
+    };
+
+    bench_mempool_t *b = malloc (sizeof (bench_mempool_t));
+    if (b == NULL) return;
+    b->pool = anemone_mempool_create ();
+
+    uint64_t seed = 4;
+
+    for (size_t d = 0; d != sizeof (dists) / sizeof (dists[0]); ++d) {
+        for (int64_t i = 0; i != BENCH_N; ++i) {
+            b->sizes[i] = anemone_bench_range (&seed, dists[d].lo, dists[d].hi);
+        }
+
+        anemone_bench_run (bench, "mempool_alloc", "scalar", dists[d].params, BENCH_N, 0, bench_mempool_alloc, b);
+        anemone_bench_run (bench, "mempool_alloc", "libc", dists[d].params, BENCH_N, 0, bench_malloc, b);
+    }
+
+    anemone_mempool_free (b->pool);
+    free (b);
+}
+
+//
+// Integer parsing and rendering, with mixes of digit counts
+//
+typedef struct {
+    bench_text_t text;
+    int64_t values[BENCH_N];
+    error_t (*parse) (char **pp, char *pe, int64_t *out);
+} bench_int_t;
+
+ANEMONE_STATIC
+uint64_t bench_atoi (void *env)
+{
+    bench_int_t *b = env;
+    uint64_t x = 0;
+    for (int64_t i = 0; i != BENCH_N; ++i) {
+        char *p = b->text.text[i];
+        int64_t out;
+        x += b->parse (&p, p + b->text.lens[i], &out);
+        x += out;
+    }
+    return x;
+}
+
+ANEMONE_STATIC
+uint64_t bench_itoa (void *env)
+{
+    bench_int_t *b = env;
+    char out[BENCH_NUMBER_SIZE];
+    uint64_t x = 0;
+    for (int64_t i = 0; i != BENCH_N; ++i) {
+        x += anemone_i64_to_string (b->values[i], out);
+        x += out[0];
+    }
+    return x;
+}
+
+ANEMONE_STATIC
+uint64_t bench_itoa_libc (void *env)
+{
+    bench_int_t *b = env;
+    char out[BENCH_NUMBER_SIZE];
+    uint64_t x = 0;
+    for (int64_t i = 0; i != BENCH_N; ++i) {
+        x += snprintf (out, sizeof (out), "%" PRId64, b->values[i]);
+        x += out[0];
+    }
+    return x;
+}
+
+ANEMONE_STATIC
+error_t bench_strtoll (char **pp, char *pe, int64_t *out)
+{
+    (void) pe;
+    *out = strtoll (*pp, pp, 10);
+    return 0;
+}
+
+ANEMONE_STATIC
+void bench_int (anemone_bench_t *bench)
+{
+    static const struct { const char *params; int lo; int hi; } mixes[] = {
+        { "digits=1-3",  1,  3  },
+        { "digits=1-19", 1,  19 },
+        { "digits=19",   19, 19 },
+    };
+
+    bench_int_t *b = malloc (sizeof (bench_int_t));
+    if (b == NULL) return;
+
+    uint64_t seed = 5;
+
+    for (size_t m = 0; m != sizeof (mixes) / sizeof (mixes[0]); ++m) {
+        memset (&b->text, 0, sizeof (b->text));
+        for (int64_t i = 0; i != BENCH_N; ++i) {
+            const int digits = (int) anemone_bench_range (&seed, mixes[m].lo, mixes[m].hi);
+            int64_t x = (int64_t) anemone_bench_range (&seed, 1, 9);
+            for (int d = 1; d != digits; ++d) {
+                x = x * 10 + (int64_t) anemone_bench_range (&seed, 0, 9);
+            }
+            b->values[i] = anemone_bench_random (&seed) & 1 ? -x : x;
+
+            char str[BENCH_NUMBER_SIZE];
+            snprintf (str, sizeof (str), "%" PRId64, b->values[i]);
+            bench_text_push (&b->text, i, str);
+        }
+
+        b->parse = anemone_string_to_i64;
+        anemone_bench_run (bench, "string_to_i64", "scalar", mixes[m].params, BENCH_N, b->text.bytes, bench_atoi, b);
+        b->parse = anemone_string_to_i64_v128;
+        anemone_bench_run (bench, "string_to_i64", "sse42", mixes[m].params, BENCH_N, b->text.bytes, bench_atoi, b);
+        b->parse = bench_strtoll;
+        anemone_bench_run (bench, "string_to_i64", "libc", mixes[m].params, BENCH_N, b->text.bytes, bench_atoi, b);
+
+        anemone_bench_run (bench, "i64_to_string", "scalar", mixes[m].params, BENCH_N, b->text.bytes, bench_itoa, b);
+        anemone_bench_run (bench, "i64_to_string", "libc", mixes[m].params, BENCH_N, b->text.bytes, bench_itoa_libc, b);
+    }
+
+    free (b);
+}
+
+//
+// Float parsing and rendering, with short decimals like prices, and doubles
+// which need all 17 digits
+//
+typedef struct {
+    bench_text_t text;
+    double values[BENCH_N];
+    error_t (*parse) (char **pp, char *pe, double *out);
+    size_t (*render) (double x, char *out);
+} bench_double_t;
+
+ANEMONE_STATIC
+uint64_t bench_strtod (void *env)
+{
+    bench_double_t *b = env;
+    uint64_t x = 0;
+    for (int64_t i = 0; i != BENCH_N; ++i) {
+        char *p = b->text.text[i];
+        double out;
+        x += b->parse (&p, p + b->text.lens[i], &out);
+        x += (uint64_t) out;
+    }
+    return x;
+}
+
+ANEMONE_STATIC
+uint64_t bench_dtoa (void *env)
+{
+    bench_double_t *b = env;
+    char out[BENCH_NUMBER_SIZE];
+    uint64_t x = 0;
+    for (int64_t i = 0; i != BENCH_N; ++i) {
+        x += b->render (b->values[i], out);
+        x += out[0];
+    }
+    return x;
+}
+
+ANEMONE_STATIC
+error_t bench_strtod_libc (char **pp, char *pe, double *out)
+{
+    (void) pe;
+    *out = strtod (*pp, pp);
+    return 0;
+}
+
+ANEMONE_STATIC
+size_t bench_dtoa_libc (double x, char *out)
+{
+    return snprintf (out, BENCH_NUMBER_SIZE, "%.17g", x);
+}
+
+ANEMONE_STATIC
+void bench_double (anemone_bench_t *bench)
+{
+    bench_double_t *b = malloc (sizeof (bench_double_t));
+    if (b == NULL) return;
+
+    uint64_t seed = 6;
+
+    for (int mix = 0; mix != 2; ++mix) {
+        const char *params = mix == 0 ? "digits=1-8" : "digits=17";
+
+        memset (&b->text, 0, sizeof (b->text));
+        for (int64_t i = 0; i != BENCH_N; ++i) {
+            char str[BENCH_NUMBER_SIZE];
+            if (mix == 0) {
+                // up to six digits with two after the point
+                const int64_t cents = (int64_t) anemone_bench_range (&seed, 0, 99999999);
+                b->values[i] = (double) cents / 100;
+                snprintf (str, sizeof (str), "%" PRId64 ".%02" PRId64, cents / 100, cents % 100);
+            } else {
+                // uniform bits gives every exponent, so take the mantissa and pick a milder one
+                const uint64_t bits = (anemone_bench_random (&seed) & 0x800FFFFFFFFFFFFFULL) | ((uint64_t) anemone_bench_range (&seed, 1023 - 60, 1023 + 60) << 52);
+                memcpy (&b->values[i], &bits, sizeof (double));
+                snprintf (str, sizeof (str), "%.17g", b->values[i]);
+            }
+            bench_text_push (&b->text, i, str);
+        }
+
+        b->parse = anemone_strtod;
+        anemone_bench_run (bench, "strtod", "dispatch", params, BENCH_N, b->text.bytes, bench_strtod, b);
+        b->parse = anemone_strtod_scalar;
+        anemone_bench_run (bench, "strtod", "scalar", params, BENCH_N, b->text.bytes, bench_strtod, b);
+        b->parse = bench_strtod_libc;
+        anemone_bench_run (bench, "strtod", "libc", params, BENCH_N, b->text.bytes, bench_strtod, b);
+
+        b->render = anemone_grisu2;
+        anemone_bench_run (bench, "grisu2", "scalar", params, BENCH_N, b->text.bytes, bench_dtoa, b);
+        b->render = anemone_ryu;
+        anemone_bench_run (bench, "ryu", "scalar", params, BENCH_N, b->text.bytes, bench_dtoa, b);
+        b->render = bench_dtoa_libc;
+        anemone_bench_run (bench, "dtoa", "libc", params, BENCH_N, b->text.bytes, bench_dtoa, b);
+    }
+
+    free (b);
+}
+
+//
+// Date and timestamp columns
+//
+typedef struct {
+    char *text;
+    uint64_t bytes;
+    int64_t days[BENCH_N];
+    anemone_timestamp_t timestamps[BENCH_N];
+    uint64_t valid[BENCH_N / 64];
+} bench_time_t;
+
+ANEMONE_STATIC
+uint64_t bench_date_column (void *env)
+{
+    bench_time_t *b = env;
+    const char *p = b->text;
+    anemone_parse_gregorian_as_modified_julian_column (&p, b->text + b->bytes, ',', '\n', BENCH_N, b->days, b->valid);
+    return b->days[BENCH_N - 1];
+}
+
+ANEMONE_STATIC
+uint64_t bench_timestamp_column (void *env)
+{
+    bench_time_t *b = env;
+    const char *p = b->text;
+    anemone_parse_timestamp_column (&p, b->text + b->bytes, ',', '\n', BENCH_N, b->timestamps, b->valid);
+    return b->timestamps[BENCH_N - 1].seconds;
+}
+
+ANEMONE_STATIC
+void bench_time (anemone_bench_t *bench)
+{
+    bench_time_t *b = malloc (sizeof (bench_time_t));
+    if (b == NULL) return;
+    b->text = malloc (BENCH_N * BENCH_NUMBER_SIZE);
+    if (b->text == NULL) {
+        free (b);
+        return;
+    }
+
+    uint64_t seed = 7;
+
+    for (int timestamps = 0; timestamps != 2; ++timestamps) {
+        char *p = b->text;
+        for (int64_t i = 0; i != BENCH_N; ++i) {
+            const char delim = i == BENCH_N - 1 ? '\n' : ',';
+            const int year = (int) anemone_bench_range (&seed, 1970, 2050);
+            const int month = (int) anemone_bench_range (&seed, 1, 12);
+            const int day = (int) anemone_bench_range (&seed, 1, 28);
+            if (timestamps) {
+                p += sprintf (p, "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ%c", year, month, day
+                    , (int) anemone_bench_range (&seed, 0, 23)
+                    , (int) anemone_bench_range (&seed, 0, 59)
+                    , (int) anemone_bench_range (&seed, 0, 59)
+                    , (int) anemone_bench_range (&seed, 0, 999)
+                    , delim);
+            } else {
+                p += sprintf (p, "%04d-%02d-%02d%c", year, month, day, delim);
+            }
+        }
+        b->bytes = p - b->text;
+
+        if (timestamps) {
+            anemone_bench_run (bench, "timestamp_column", "dispatch", "ms,utc", BENCH_N, b->bytes, bench_timestamp_column, b);
+        } else {
+            anemone_bench_run (bench, "date_column", "dispatch", "yyyy-mm-dd", BENCH_N, b->bytes, bench_date_column, b);
+        }
+    }
+
+    free (b->text);
+    free (b);
+}
+
+//
+// Memory comparison of equal strings, so every byte is compared
+//
+typedef struct {
+    uint8_t *as;
+    uint8_t *bs;
+    size_t len;
+    int (*cmp) (const void *a, const void *b, size_t len);
+} bench_memcmp_t;
+
+ANEMONE_STATIC
+uint64_t bench_memcmp_run (void *env)
+{
+    bench_memcmp_t *b = env;
+    uint64_t x = 0;
+    for (int64_t i = 0; i != 256; ++i) {
+        x += b->cmp (b->as + i, b->bs + i, b->len);
+    }
+    return x;
+}
+
+ANEMONE_STATIC
+int bench_memcmp_blessed (const void *a, const void *b, size_t len)
+{
+    return anemone_memcmp (a, b, len);
+}
+
+ANEMONE_STATIC
+int bench_memcmp_64 (const void *a, const void *b, size_t len)
+{
+    return anemone_memcmp64 (a, b, len);
+}
+
+ANEMONE_STATIC
+void bench_memcmp (anemone_bench_t *bench)
+{
+    static const size_t lens[] = { 5, 16, 40, 100, 330, 1000 };
+
+    bench_memcmp_t b;
+    b.as = malloc (256 + 1024);
+    b.bs = malloc (256 + 1024);
+    if (b.as == NULL || b.bs == NULL) {
+        free (b.as);
+        free (b.bs);
+        return;
+    }
+    memset (b.as, 'x', 256 + 1024);
+    memset (b.bs, 'x', 256 + 1024);
+
+    char params[32];
+
+    for (size_t l = 0; l != sizeof (lens) / sizeof (lens[0]); ++l) {
+        b.len = lens[l];
+        snprintf (params, sizeof (params), "len=%zu", b.len);
+
+        b.cmp = bench_memcmp_blessed;
+        anemone_bench_run (bench, "memcmp", "sse2", params, 256, 256 * b.len, bench_memcmp_run, &b);
+        b.cmp = bench_memcmp_64;
+        anemone_bench_run (bench, "memcmp", "scalar", params, 256, 256 * b.len, bench_memcmp_run, &b);
+        b.cmp = memcmp;
+        anemone_bench_run (bench, "memcmp", "libc", params, 256, 256 * b.len, bench_memcmp_run, &b);
+    }
+
+    free (b.as);
+    free (b.bs);
+}
+
+//
+// Chunked parsing of a buffer too big for the cache, one integer per line,
+// with each call parsing the whole buffer in to a new pool.
+//
+#define BENCH_CHUNK_BYTES (16 << 20)
+
+typedef struct {
+    char *text;
+    size_t bytes;
+    int threads;
+} bench_chunk_t;
+
+ANEMONE_STATIC
+uint64_t bench_chunk_parse (void *env)
+{
+    bench_chunk_t *b = env;
+    anemone_mempool_t *pool = anemone_mempool_create ();
+    anemone_chunk_t *chunks;
+    int64_t count;
+
+    uint64_t x = anemone_chunk_parse (pool, anemone_chunk_parser_i64, sizeof (int64_t), b->text, b->text + b->bytes, '\n', '\n', 0, b->threads, &chunks, &count);
+    x += anemone_chunk_total (chunks, count);
+
+    anemone_mempool_free (pool);
+    return x;
+}
+
+ANEMONE_STATIC
+void bench_chunk (anemone_bench_t *bench)
+{
+    static const int threads[] = { 1, 2, 4, 8 };
+
+    bench_chunk_t b;
+    b.text = malloc (BENCH_CHUNK_BYTES + BENCH_NUMBER_SIZE);
+    b.bytes = 0;
+    if (b.text == NULL) return;
+
+    uint64_t seed = 11;
+    int64_t fields = 0;
+    while (b.bytes < BENCH_CHUNK_BYTES) {
+        const int64_t x = (int64_t) anemone_bench_random (&seed) >> (anemone_bench_random (&seed) % 64);
+        b.bytes += snprintf (b.text + b.bytes, BENCH_NUMBER_SIZE, "%" PRId64 "\n", x);
+        fields++;
+    }
+
+    for (size_t t = 0; t != sizeof (threads) / sizeof (threads[0]); ++t) {
+        char params[32];
+        snprintf (params, sizeof (params), "threads=%d", threads[t]);
+        b.threads = threads[t];
+        anemone_bench_run (bench, "chunk_parse_i64", "sse42", params, fields, b.bytes, bench_chunk_parse, &b);
+    }
+
+    free (b.text);
+}
+
+//
+// Finding the delimiters of CSV text, as a bitmap and as offsets, against a
+// byte at a time loop which tracks the quotes.
+//
+#define BENCH_TOKENIZE_BYTES (64 << 10)
+
+typedef struct {
+    char text[BENCH_TOKENIZE_BYTES];
+    uint64_t delims[BENCH_TOKENIZE_BYTES / 64];
+    int64_t offsets[BENCH_TOKENIZE_BYTES + 64];
+} bench_tokenize_t;
+
+ANEMONE_STATIC
+uint64_t bench_tokenize_bitmap (void *env)
+{
+    bench_tokenize_t *b = env;
+    anemone_tokenize_state_t state;
+    anemone_tokenize_init (&state);
+    anemone_tokenize_bitmap (&state, b->text, b->text + BENCH_TOKENIZE_BYTES, ',', '\n', '"', b->delims, NULL);
+    return b->delims[0] + state.in_quote;
+}
+
+ANEMONE_STATIC
+uint64_t bench_tokenize_offsets (void *env)
+{
+    bench_tokenize_t *b = env;
+    anemone_tokenize_state_t state;
+    anemone_tokenize_init (&state);
+    const char *p = b->text;
+    return anemone_tokenize_offsets (&state, &p, b->text + BENCH_TOKENIZE_BYTES, ',', '\n', '"', b->offsets, BENCH_TOKENIZE_BYTES + 64);
+}
+
+ANEMONE_STATIC
+uint64_t bench_tokenize_bytes (void *env)
+{
+    bench_tokenize_t *b = env;
+    int64_t n = 0;
+    bool_t in_quote = ANEMONE_FALSE;
+    for (int64_t i = 0; i != BENCH_TOKENIZE_BYTES; ++i) {
+        const char c = b->text[i];
+        if (c == '"') {
+            in_quote = !in_quote;
+        } else if (!in_quote && (c == ',' || c == '\n')) {
+            b->offsets[n++] = i;
+        }
+    }
+    return n;
+}
+
+ANEMONE_STATIC
+void bench_tokenize (anemone_bench_t *bench)
+{
+    static const struct { const char *params; uint64_t quoted; } mixes[] = {
+        { "quoted=0%",  0  },
+        { "quoted=25%", 25 },
+    };
+
+    bench_tokenize_t *b = malloc (sizeof (bench_tokenize_t));
+    if (b == NULL) return;
+
+    uint64_t seed = 13;
+
+    for (size_t m = 0; m != sizeof (mixes) / sizeof (mixes[0]); ++m) {
+        // fields of 1 to 12 bytes, eight to a line
+        int64_t i = 0;
+        int64_t fields = 0;
+        while (i < BENCH_TOKENIZE_BYTES) {
+            const bool_t quoted = anemone_bench_range (&seed, 1, 100) <= mixes[m].quoted;
+            const int64_t len = (int64_t) anemone_bench_range (&seed, 1, 12);
+            for (int64_t j = 0; j != len && i < BENCH_TOKENIZE_BYTES; ++j) {
+                b->text[i++] = quoted && (j == 0 || j == len - 1) ? '"' :
+                               quoted && j == len / 2 ? ',' :
+                               (char) anemone_bench_range (&seed, 'a', 'z');
+            }
+            if (i < BENCH_TOKENIZE_BYTES) {
+                b->text[i++] = ++fields % 8 ? ',' : '\n';
+            }
+        }
+
+        anemone_bench_run (bench, "tokenize_bitmap", "dispatch", mixes[m].params, BENCH_TOKENIZE_BYTES, BENCH_TOKENIZE_BYTES, bench_tokenize_bitmap, b);
+        anemone_bench_run (bench, "tokenize_offsets", "dispatch", mixes[m].params, BENCH_TOKENIZE_BYTES, BENCH_TOKENIZE_BYTES, bench_tokenize_offsets, b);
+        anemone_bench_run (bench, "tokenize_offsets", "bytes", mixes[m].params, BENCH_TOKENIZE_BYTES, BENCH_TOKENIZE_BYTES, bench_tokenize_bytes, b);
+    }
+
+    free (b);
+}
+
+void anemone_bench_kernels (anemone_bench_t *bench)
+{
+    bench_pack (bench);
+    bench_vint (bench);
+    bench_hash (bench);
+    bench_mempool (bench);
+    bench_int (bench);
+    bench_double (bench);
+    bench_time (bench);
+    bench_memcmp (bench);
+    bench_chunk (bench);
+    bench_tokenize (bench);
+}
@@ -19,8 +19,29 @@ const char* rubbish
    "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
    "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
 
+/* The same bytes again, so equal strings can be compared without both
+ * pointers being the same */
+static const char rubbish_copy[]
+ = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+   "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+   "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+   "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+   "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+   "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+   "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+   "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+   "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+   "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+   "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+   "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+   "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+   "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+   "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
 #define NUM_BENCHES 10000000
-#define MKBENCH(memcmp_f)                                           \
+#define MKBENCH(memcmp_f) MKBENCH_TARGET(, memcmp_f)
+#define MKBENCH_TARGET(target, memcmp_f)                            \
+target                                                              \
 int64_t memcmp_f##_simple_bench (uint64_t len)                      \
 {                                                                   \
     const uint64_t mod_by = strlen(rubbish) - len;                  \
@@ -35,6 +56,7 @@ int64_t memcmp_f##_simple_bench (uint64_t len)                      \
     return ret;                                                     \
 }                                                                   \
                                                                     \
+target                                                              \
 int64_t memcmp_f##_regs_bench (uint64_t len)                        \
 {                                                                   \
     const uint64_t mod_by = strlen(rubbish) - len;                  \
@@ -71,12 +93,28 @@ int64_t memcmp_f##_regs_bench (uint64_t len)                        \
     }                                                               \
     return ret                                                      \
       + c + d + e + f + g + h + j + k + l + m + n;                  \
+}                                                                   \
+                                                                    \
+/* Equal strings, so every byte is compared, as when sorting keys   \
+ * with long common prefixes. */                                    \
+target                                                              \
+int64_t memcmp_f##_equal_bench (uint64_t len)                       \
+{                                                                   \
+    const uint64_t mod_by = strlen(rubbish) - len;                  \
+    uint64_t as = 0;                                                \
+    int64_t ret = 0;                                                \
+    for (uint64_t i = 0; i != NUM_BENCHES; ++i) {                   \
+        ret += memcmp_f(rubbish+as, rubbish_copy+as, len);          \
+        as = as + 1 == mod_by ? 0 : as + 1;                         \
+    }                                                               \
+    return ret;                                                     \
 }
 
 
 MKBENCH(anemone_memcmp8)
 MKBENCH(anemone_memcmp64)
-MKBENCH(anemone_memcmp128_unsafe)
+MKBENCH(anemone_memcmp128)
+MKBENCH_TARGET(ANEMONE_SSE42, anemone_memcmp128_unsafe)
 MKBENCH(anemone_memcmp_partial_load64)
 MKBENCH(anemone_memcmp)
 
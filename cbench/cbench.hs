@@ -0,0 +1,69 @@
+{-# LANGUAGE NoImplicitPrelude #-}
+{-# LANGUAGE ForeignFunctionInterface #-}
+
+import           Anemone.Foreign.Data (CError(..), CInt(..))
+
+import           Data.String (String)
+
+import           Foreign.C.String (CString, withCString)
+import           Foreign.Ptr (nullPtr)
+
+import           P
+
+import           System.Environment (getArgs)
+import           System.Exit (exitFailure)
+import           System.IO (IO, hPutStrLn, stderr)
+
+import           Text.Read (readMaybe)
+
+
+data Options =
+  Options {
+      optionsJson :: Maybe String
+    , optionsFilter :: Maybe String
+    , optionsRepetitions :: Int
+    }
+
+parseOptions :: Options -> [String] -> Maybe Options
+parseOptions options args =
+  case args of
+    [] ->
+      Just options
+    "--json" : path : rest ->
+      parseOptions options { optionsJson = Just path } rest
+    "--repetitions" : n : rest -> do
+      r <- readMaybe n
+      parseOptions options { optionsRepetitions = r } rest
+    name : rest ->
+      parseOptions options { optionsFilter = Just name } rest
+
+withMaybeCString :: Maybe String -> (CString -> IO a) -> IO a
+withMaybeCString mstr f =
+  case mstr of
+    Nothing ->
+      f nullPtr
+    Just str ->
+      withCString str f
+
+-- | Runs the C benchmarks in bench_kernels.c
+--
+--   cbench [--json FILE] [--repetitions N] [FILTER]
+--
+main :: IO ()
+main = do
+  args <- getArgs
+  case parseOptions (Options Nothing Nothing 0) args of
+    Nothing -> do
+      hPutStrLn stderr "usage: cbench [--json FILE] [--repetitions N] [FILTER]"
+      exitFailure
+    Just options -> do
+      err <-
+        withMaybeCString (optionsJson options) $ \json ->
+        withMaybeCString (optionsFilter options) $ \name ->
+          anemone_bench_main json name (fromIntegral $ optionsRepetitions options)
+      when (err /= 0)
+        exitFailure
+
+foreign import ccall safe
+    anemone_bench_main
+    :: CString -> CString -> CInt -> IO CError
@@ -7,10 +7,8 @@ error_t anemone_string_to_i64 (char **pp, char *pe, int64_t *output_ptr)
 
     /* handle negative */
     int sign      = 1;
-    int sign_size = 0;
     if (buffer_size > 0 && p[0] == '-') {
         sign      = -1;
-        sign_size = 1;
         p++;
         buffer_size--;
     }
@@ -76,7 +74,8 @@ error_t anemone_string_to_i64 (char **pp, char *pe, int64_t *output_ptr)
 
             int64_t value_signed = value * sign;
             *output_ptr = value_signed;
-            *pp = p + digits + sign_size;
+            /* p is already past the sign */
+            *pp = p + digits;
             return 0;
 
         default:
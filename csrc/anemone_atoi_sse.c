@@ -1,9 +1,12 @@
+#include "anemone_atoi.h"
 #include "anemone_atoi_sse.h"
 #include "anemone_atoi_sse_impl.h"
+#include "anemone_column.h"
 
 /*
   parse unsigned 64-bit integer.
  */
+ANEMONE_SSE42
 ANEMONE_INLINE
 ANEMONE_STATIC
 error_t anemone_string_to_ui64_v128 (char **pp, char *pe, uint64_t *out_val)
@@ -25,7 +28,10 @@ error_t anemone_string_to_ui64_v128 (char **pp, char *pe, uint64_t *out_val)
   parse string to signed 64-bit integer.
   does not strip whitespace.
  */
-error_t anemone_string_to_i64_v128 (char **pp, char *pe, int64_t *out_val)
+ANEMONE_SSE42
+ANEMONE_STATIC
+ANEMONE_INLINE
+error_t inline_string_to_i64_v128 (char **pp, char *pe, int64_t *out_val)
 {
     char* in = *pp;
     uint64_t buffer_size = pe - in;
@@ -55,3 +61,69 @@ error_t anemone_string_to_i64_v128 (char **pp, char *pe, int64_t *out_val)
     *out_val = int_out * sign;
     return 0;
 }
+
+ANEMONE_SSE42
+ANEMONE_STATIC
+error_t string_to_i64_sse42 (char **pp, char *pe, int64_t *out_val)
+{
+    return inline_string_to_i64_v128 (pp, pe, out_val);
+}
+
+ANEMONE_SSE42
+ANEMONE_STATIC
+ANEMONE_INLINE
+error_t string_to_i64_field_sse42 (const char **pp, const char *pe, void *out, int64_t i)
+{
+    int64_t *values = out;
+
+    return inline_string_to_i64_v128 ((char **) pp, (char *) pe, values + i);
+}
+
+ANEMONE_STATIC
+ANEMONE_INLINE
+error_t string_to_i64_field_scalar (const char **pp, const char *pe, void *out, int64_t i)
+{
+    int64_t *values = out;
+
+    return anemone_string_to_i64 ((char **) pp, (char *) pe, values + i);
+}
+
+ANEMONE_SSE42
+ANEMONE_STATIC
+int64_t string_to_i64_column_sse42 (const char **pp, const char *pe, char sep, char term, int64_t n, int64_t *out, uint64_t *valid)
+{
+    return anemone_column_parse (string_to_i64_field_sse42, anemone_column_delimiter_sse42, pp, pe, sep, term, n, out, sizeof (*out), valid);
+}
+
+ANEMONE_STATIC
+int64_t string_to_i64_column_scalar (const char **pp, const char *pe, char sep, char term, int64_t n, int64_t *out, uint64_t *valid)
+{
+    return anemone_column_parse (string_to_i64_field_scalar, anemone_column_delimiter_scalar, pp, pe, sep, term, n, out, sizeof (*out), valid);
+}
+
+//
+// Without SSE4.2 these fall back to the scalar parser, which accepts the
+// same strings.
+//
+static error_t (*resolved_string_to_i64) (char **pp, char *pe, int64_t *out_val) = anemone_string_to_i64;
+static int64_t (*resolved_string_to_i64_column) (const char **pp, const char *pe, char sep, char term, int64_t n, int64_t *out, uint64_t *valid) = string_to_i64_column_scalar;
+
+ANEMONE_CONSTRUCTOR
+ANEMONE_STATIC
+void anemone_atoi_sse_init ()
+{
+    if (anemone_cpu_supports (ANEMONE_CPU_SSE42)) {
+        resolved_string_to_i64 = string_to_i64_sse42;
+        resolved_string_to_i64_column = string_to_i64_column_sse42;
+    }
+}
+
+error_t anemone_string_to_i64_v128 (char **pp, char *pe, int64_t *out_val)
+{
+    return resolved_string_to_i64 (pp, pe, out_val);
+}
+
+int64_t anemone_string_to_i64_v128_column (const char **pp, const char *pe, char sep, char term, int64_t n, int64_t *out, uint64_t *valid)
+{
+    return resolved_string_to_i64_column (pp, pe, sep, term, n, out, valid);
+}
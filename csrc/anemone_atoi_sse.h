@@ -9,4 +9,38 @@
  */
 error_t anemone_string_to_i64_v128 (char **pp, char *pe, int64_t *out_val);
 
+//
+// Parses a buffer of delimited signed 64-bit integers in one call, as for a CSV or PSV
+// column.
+//
+// pp:
+//   pointer to start of buffer, moved past the last field parsed and its
+//   delimiter
+//
+// pe:
+//   pointer to end of buffer
+//
+// sep:
+//   field separator
+//
+// term:
+//   record terminator, a field ends at either this or 'sep'
+//
+// n:
+//   maximum number of fields to parse
+//
+// out:
+//   pointer to an array of at least 'n' values, the value of an invalid
+//   field is zero
+//
+// valid:
+//   pointer to a bitmap of at least (n + 63) / 64 words, bit i is set if
+//   field i was valid
+//
+// *returns*
+//   the number of fields parsed, which is less than 'n' if the end of the
+//   buffer was reached first
+//
+int64_t anemone_string_to_i64_v128_column (const char **pp, const char *pe, char sep, char term, int64_t n, int64_t *out, uint64_t *valid);
+
 #endif//__ANEMONE_ATOI_SSE_H
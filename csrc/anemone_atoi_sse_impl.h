@@ -1,3 +1,4 @@
+#include "anemone_atoi.h"
 #include "anemone_sse.h"
 
 
@@ -17,6 +18,7 @@
 
  where pow10[0] = 1, pow10[<0] = 0, pow10[1] = 10, ...
  */
+ANEMONE_SSE42
 ANEMONE_INLINE
 uint64_t anemone_string_to_i64_v128_first_eight (const __m128i m, unsigned int index)
 {
@@ -62,6 +64,7 @@ uint64_t anemone_string_to_i64_v128_first_eight (const __m128i m, unsigned int i
   this does not allow the full range of uint64, instead only up to 10^19, which is a little above 2^63
   the return value is 0 if successful parse, <0 on error, and >0 when the number won't fit in 10^19.
  */
+ANEMONE_SSE42
 ANEMONE_INLINE
 int64_t anemone_string_to_ui64_v128_floating (char **pp, char *pe, uint64_t *out_val, int64_t *out_exponent_spill, int64_t *out_significant_digits)
 {
@@ -175,3 +178,126 @@ int64_t anemone_string_to_ui64_v128_floating (char **pp, char *pe, uint64_t *out
     return 0;
 }
 
+/*
+ compute the value of the first |count| digits in m, where 1 <= count <= 16.
+
+ m = [ c0, c1, c2, ... c15 ]@8, already converted from characters to digits.
+
+ the digits are shifted to the end of the vector, so that the leading
+ positions are zero, then pairs of digits are combined in to two digit
+ numbers, then four, then eight:
+
+     [ 0, 0, c0, c1, ... ]@8 -> [ c0, c1*10+c2, ... ]@16 -> ... -> [ hi, lo ]@32
+
+     return hi * 10^8 + lo;
+ */
+ANEMONE_SSE42
+ANEMONE_INLINE
+uint64_t anemone_string_to_i64_v128_first_sixteen (const __m128i m, unsigned int count)
+{
+    static const int8_t shift_to_end[]
+     = { -1, -1, -1, -1, -1, -1, -1, -1
+       , -1, -1, -1, -1, -1, -1, -1, -1
+       ,  0,  1,  2,  3,  4,  5,  6,  7
+       ,  8,  9, 10, 11, 12, 13, 14, 15
+       };
+
+    const __m128i shuffle = anemone_sse_load128(shift_to_end + count);
+    const __m128i digits  = _mm_shuffle_epi8(m, shuffle);
+
+    const __m128i pairs   = _mm_maddubs_epi16(digits, _mm_set1_epi16(0x010A));
+    const __m128i quads   = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00010064));
+    const __m128i packed  = _mm_packus_epi32(quads, quads);
+    const __m128i eights  = _mm_madd_epi16(packed, _mm_set1_epi32(0x00012710));
+
+    const uint64_t hi     = (uint32_t) _mm_cvtsi128_si32(eights);
+    const uint64_t lo     = (uint32_t) _mm_extract_epi32(eights, 1);
+    return hi * 100000000 + lo;
+}
+
+/*
+  same as anemone_string_to_ui64_v128_floating, but classifies 32 bytes at
+  a time, so any number which fits in 19 digits needs a single load, and the
+  loop to count spilled digits only runs for numbers longer than 32 digits.
+ */
+ANEMONE_AVX2
+ANEMONE_INLINE
+int64_t anemone_string_to_ui64_v256_floating (char **pp, char *pe, uint64_t *out_val, int64_t *out_exponent_spill, int64_t *out_significant_digits)
+{
+    static const uint32_t powers_of_ten[]
+         = { 1, 10, 100, 1000 };
+
+    char* in = *pp;
+    if (pe - in == 0) {
+        return 1;
+    }
+
+    // We assume the common case has no leading zeros, so remove them
+    // one at a time.
+    if (ANEMONE_UNLIKELY(in[0] == '0')) {
+        do {
+            in++;
+        } while (pe - in > 0 && in[0] == '0');
+
+        if (pe - in == 0 || !anemone_is_digit(in[0])) {
+            *out_val = 0;
+            *pp      = in;
+            *out_exponent_spill = 0;
+            *out_significant_digits = 1;
+            return 0;
+        }
+    }
+
+    // > m = [ '1', '0', 'x', ... ]@8, padded with nulls past the end
+    __m256i m                = anemone_avx2_load_bytes256(in, pe);
+
+    // Bit i of the mask is set if byte i is a digit, so the number ends at
+    // the first clear bit, or at 32 if the whole vector is digits.
+    uint64_t index           = __builtin_ctzll(~(uint64_t) anemone_avx2_digits(m));
+
+    // If index is 0, there are no numbers here
+    if (ANEMONE_UNLIKELY(index == 0)) {
+        return 1;
+    }
+
+    // > lo = [ 1, 0, garbage, ... ]@8
+    const __m128i lo         = _mm_sub_epi8(_mm256_castsi256_si128(m), _mm_set1_epi8('0'));
+
+    uint64_t int_out;
+    uint64_t significant_digits;
+    uint64_t exponent_spill  = 0;
+
+    if (ANEMONE_LIKELY(index <= 16)) {
+        int_out              = anemone_string_to_i64_v128_first_sixteen(lo, index);
+        significant_digits   = index;
+    } else {
+        // We can only hold 19 digits (16+3 == 19), so the first sixteen are
+        // converted together, and up to three more one at a time
+        significant_digits   = index < 19 ? index : 19;
+        int_out              = anemone_string_to_i64_v128_first_sixteen(lo, 16);
+
+        uint64_t extra       = 0;
+        for (uint64_t i = 16; i < significant_digits; i++) {
+            extra            = extra * 10 + (in[i] - '0');
+        }
+
+        int_out              = int_out * powers_of_ten[significant_digits - 16] + extra;
+        exponent_spill       = index - significant_digits;
+    }
+
+    in                      += index;
+
+    // Count how many extra digits and throw them away
+    while (ANEMONE_UNLIKELY(index == 32)) {
+        m                    = anemone_avx2_load_bytes256(in, pe);
+        index                = __builtin_ctzll(~(uint64_t) anemone_avx2_digits(m));
+        in                  += index;
+        exponent_spill      += index;
+    }
+
+    *out_val = int_out;
+    *pp      = in;
+    *out_exponent_spill = exponent_spill;
+    *out_significant_digits = significant_digits;
+    return 0;
+}
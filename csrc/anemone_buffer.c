@@ -0,0 +1,61 @@
+#include "anemone_buffer.h"
+
+// Is the buffer the most recent allocation in its pool, so that it can change size in place
+ANEMONE_STATIC
+bool_t anemone_buffer_at_tip (anemone_buffer_t *buffer)
+{
+  return (void *) (buffer->data + buffer->capacity) == buffer->pool->current_ptr;
+}
+
+void anemone_buffer_init (anemone_buffer_t *buffer, anemone_mempool_t *pool, size_t capacity)
+{
+  buffer->pool     = pool;
+  buffer->capacity = round_up_allocation (capacity);
+  buffer->data     = anemone_mempool_alloc (pool, buffer->capacity);
+  buffer->size     = 0;
+}
+
+error_t anemone_buffer_grow (anemone_buffer_t *buffer, size_t num_bytes)
+{
+  anemone_mempool_t *pool = buffer->pool;
+
+  size_t needed   = buffer->size + num_bytes;
+  size_t capacity = buffer->capacity * 2;
+  if (capacity < needed) capacity = needed;
+  capacity = round_up_allocation (capacity);
+
+  // Grow in place if nothing has been allocated after us and the block has room,
+  // using the rest of the block if doubling would not fit
+  if (anemone_buffer_at_tip (buffer)) {
+    size_t available = ((uint8_t *) pool->maximum_ptr - buffer->data) & ~((size_t) ANEMONE_ALIGNMENT - 1);
+    if (capacity > available && needed <= available) capacity = available;
+
+    if (capacity <= available) {
+      size_t extra = capacity - buffer->capacity;
+      pool->current_ptr = buffer->data + capacity;
+      pool->stats.bytes_requested += extra;
+      pool->stats.bytes_rounded   += extra;
+      buffer->capacity = capacity;
+      return 0;
+    }
+  }
+
+  uint8_t *data = anemone_mempool_alloc (pool, capacity);
+  if (data == NULL) return 1;
+
+  memcpy (data, buffer->data, buffer->size);
+  buffer->data     = data;
+  buffer->capacity = capacity;
+  return 0;
+}
+
+void * anemone_buffer_freeze (anemone_buffer_t *buffer)
+{
+  if (anemone_buffer_at_tip (buffer)) {
+    size_t used = round_up_allocation (buffer->size);
+    buffer->pool->current_ptr = buffer->data + used;
+    buffer->capacity = used;
+  }
+
+  return buffer->data;
+}
@@ -0,0 +1,84 @@
+#ifndef __ANEMONE_BUFFER_H
+#define __ANEMONE_BUFFER_H
+
+#include "anemone_mempool.h"
+
+//
+// A growable buffer allocated from a memory pool, for building arrays and strings
+// whose length is not known up front.
+//
+// While the buffer is the most recent allocation in its pool, growing it just bumps the
+// pool's current pointer, so the usual pattern of appending everything and then freezing
+// the result never copies. Otherwise the contents are copied to a new allocation twice
+// the size, and the old allocation is left to be freed with the pool.
+//
+// Nothing else may be allocated from the pool between appends if the buffer is to grow in
+// place, but doing so is always safe.
+//
+typedef struct {
+  anemone_mempool_t *pool;
+  // Start of the contents
+  uint8_t *data;
+  // Number of bytes used
+  // size <= capacity
+  size_t   size;
+  // Number of bytes allocated from the pool, always a multiple of ANEMONE_ALIGNMENT
+  size_t   capacity;
+} anemone_buffer_t;
+
+// Start an empty buffer with room for at least capacity bytes.
+void anemone_buffer_init (anemone_buffer_t *buffer, anemone_mempool_t *pool, size_t capacity);
+
+// Make room for at least num_bytes more bytes. This is for internal use only, but must be exposed for inlining.
+error_t anemone_buffer_grow (anemone_buffer_t *buffer, size_t num_bytes);
+
+// Get a pointer to num_bytes of space at the end of the buffer, without using it.
+// Write into it and then call anemone_buffer_commit.
+// The pointer is invalidated by the next call which grows the buffer.
+ANEMONE_INLINE
+uint8_t * anemone_buffer_reserve (anemone_buffer_t *buffer, size_t num_bytes)
+{
+    if (ANEMONE_UNLIKELY(buffer->capacity - buffer->size < num_bytes)) {
+        if (anemone_buffer_grow (buffer, num_bytes)) return NULL;
+    }
+
+    return buffer->data + buffer->size;
+}
+
+// Use num_bytes of the space returned by anemone_buffer_reserve.
+ANEMONE_INLINE
+void anemone_buffer_commit (anemone_buffer_t *buffer, size_t num_bytes)
+{
+    buffer->size += num_bytes;
+}
+
+// Append some bytes to the end of the buffer.
+ANEMONE_INLINE
+error_t anemone_buffer_append (anemone_buffer_t *buffer, const void *src, size_t num_bytes)
+{
+    uint8_t *dst = anemone_buffer_reserve (buffer, num_bytes);
+    if (ANEMONE_UNLIKELY(dst == NULL)) return 1;
+
+    memcpy (dst, src, num_bytes);
+    buffer->size += num_bytes;
+    return 0;
+}
+
+// Append a single byte to the end of the buffer.
+ANEMONE_INLINE
+error_t anemone_buffer_append_byte (anemone_buffer_t *buffer, uint8_t byte)
+{
+    uint8_t *dst = anemone_buffer_reserve (buffer, 1);
+    if (ANEMONE_UNLIKELY(dst == NULL)) return 1;
+
+    *dst = byte;
+    buffer->size++;
+    return 0;
+}
+
+// Finish building, returning the contents. If the buffer is still the most recent
+// allocation, its unused capacity is given back to the pool.
+// The contents live as long as the pool, and the buffer must not be used afterwards.
+void * anemone_buffer_freeze (anemone_buffer_t *buffer);
+
+#endif//__ANEMONE_BUFFER_H
@@ -0,0 +1,247 @@
+#define _GNU_SOURCE 1
+
+#include "anemone_chunk.h"
+#include "anemone_atoi_sse.h"
+#include "anemone_sse.h"
+#include "anemone_strtod.h"
+#include "anemone_thread.h"
+#include "anemone_time.h"
+
+#include <string.h>
+
+int64_t anemone_chunk_parser_i64 (const char **pp, const char *pe, char sep, char term, int64_t n, void *out, uint64_t *valid)
+{
+    return anemone_string_to_i64_v128_column (pp, pe, sep, term, n, out, valid);
+}
+
+int64_t anemone_chunk_parser_double (const char **pp, const char *pe, char sep, char term, int64_t n, void *out, uint64_t *valid)
+{
+    return anemone_strtod_column (pp, pe, sep, term, n, out, valid);
+}
+
+int64_t anemone_chunk_parser_modified_julian (const char **pp, const char *pe, char sep, char term, int64_t n, void *out, uint64_t *valid)
+{
+    return anemone_parse_gregorian_as_modified_julian_column (pp, pe, sep, term, n, out, valid);
+}
+
+int64_t anemone_chunk_parser_timestamp (const char **pp, const char *pe, char sep, char term, int64_t n, void *out, uint64_t *valid)
+{
+    return anemone_parse_timestamp_column (pp, pe, sep, term, n, out, valid);
+}
+
+//
+// Each delimiter found takes one from a byte counter, and the byte counters
+// are added up before any of them can wrap around.
+//
+int64_t anemone_chunk_count_fields (const char *p, const char *pe, char sep, char term)
+{
+    if (p == pe) return 0;
+
+    const __m128i seps = _mm_set1_epi8 (sep);
+    const __m128i terms = _mm_set1_epi8 (term);
+
+    int64_t count = 0;
+
+    while (pe - p >= 16) {
+        __m128i counts = _mm_setzero_si128 ();
+
+        for (int i = 0; i < 255 && pe - p >= 16; i++, p += 16) {
+            const __m128i m = anemone_sse_load128 (p);
+            const __m128i found = _mm_or_si128 (_mm_cmpeq_epi8 (m, seps), _mm_cmpeq_epi8 (m, terms));
+            counts = _mm_sub_epi8 (counts, found);
+        }
+
+        const __m128i sums = _mm_sad_epu8 (counts, _mm_setzero_si128 ());
+        count += _mm_cvtsi128_si64 (sums) + _mm_cvtsi128_si64 (_mm_unpackhi_epi64 (sums, sums));
+    }
+
+    for (; p < pe; p++) {
+        count += *p == sep || *p == term;
+    }
+
+    // only a terminator at the very end does not start another field
+    if (pe[-1] != term) {
+        count++;
+    }
+
+    return count;
+}
+
+typedef struct {
+  anemone_mempool_t *pool;
+  anemone_chunk_parser_t parse;
+  size_t size;
+  char sep;
+  char term;
+
+  anemone_chunk_t *chunks;
+  int64_t count;
+  int threads;
+
+  // next chunk to parse, shared between the threads
+  int64_t next_chunk;
+  // set by any thread which could not allocate
+  int failed;
+} chunk_parallel_t;
+
+ANEMONE_STATIC
+void * chunk_parallel_parse (void *arg)
+{
+    chunk_parallel_t *shared = arg;
+    anemone_mempool_t *arena = NULL;
+
+    for (;;) {
+        const int64_t c = __atomic_fetch_add (&shared->next_chunk, 1, __ATOMIC_RELAXED);
+        if (c >= shared->count) break;
+
+        // only threads which get a chunk need an arena
+        if (arena == NULL) {
+            arena = anemone_mempool_arena_create (shared->pool);
+            if (ANEMONE_UNLIKELY (arena == NULL)) {
+                __atomic_store_n (&shared->failed, 1, __ATOMIC_RELAXED);
+                break;
+            }
+        }
+
+        anemone_chunk_t *chunk = &shared->chunks[c];
+        const int64_t n = anemone_chunk_count_fields (chunk->start, chunk->end, shared->sep, shared->term);
+
+        chunk->values = anemone_mempool_alloc (arena, n * shared->size);
+        chunk->valid = anemone_mempool_alloc (arena, ((n + 63) / 64) * sizeof (uint64_t));
+
+        if (ANEMONE_UNLIKELY (chunk->values == NULL || chunk->valid == NULL)) {
+            __atomic_store_n (&shared->failed, 1, __ATOMIC_RELAXED);
+            break;
+        }
+
+        const char *q = chunk->start;
+        chunk->count = shared->parse (&q, chunk->end, shared->sep, shared->term, n, chunk->values, chunk->valid);
+    }
+
+    return NULL;
+}
+
+error_t anemone_chunk_parse (
+    anemone_mempool_t *pool
+  , anemone_chunk_parser_t parse
+  , size_t size
+  , const char *p
+  , const char *pe
+  , char sep
+  , char term
+  , size_t chunk_bytes
+  , int threads
+  , anemone_chunk_t **out_chunks
+  , int64_t *out_count
+  )
+{
+    if (chunk_bytes == 0) chunk_bytes = ANEMONE_CHUNK_BYTES;
+    if (threads < 1) threads = 1;
+
+    // there is at most one chunk per 'chunk_bytes', as each ends at least
+    // that far in unless it is the last
+    const int64_t max_chunks = (pe - p) / chunk_bytes + 1;
+    anemone_chunk_t *chunks = anemone_mempool_alloc (pool, max_chunks * sizeof (anemone_chunk_t));
+    pthread_t *pthreads = anemone_mempool_alloc (pool, threads * sizeof (pthread_t));
+
+    if (ANEMONE_UNLIKELY (chunks == NULL || pthreads == NULL)) return 1;
+
+    int64_t count = 0;
+    while (p < pe) {
+        const char *end = pe;
+
+        if ((size_t) (pe - p) > chunk_bytes) {
+            const char *found = memchr (p + chunk_bytes, term, pe - (p + chunk_bytes));
+            if (found) end = found + 1;
+        }
+
+        chunks[count].start = p;
+        chunks[count].end = end;
+        chunks[count].count = 0;
+        chunks[count].values = NULL;
+        chunks[count].valid = NULL;
+        count++;
+
+        p = end;
+    }
+
+    chunk_parallel_t shared = {
+        .pool = pool
+      , .parse = parse
+      , .size = size
+      , .sep = sep
+      , .term = term
+      , .chunks = chunks
+      , .count = count
+      , .threads = threads < count ? threads : (int) count
+      , .next_chunk = 0
+      , .failed = 0
+    };
+
+    if (count > 0) {
+        anemone_thread_run (&shared, shared.threads, pthreads, chunk_parallel_parse);
+    }
+
+    if (ANEMONE_UNLIKELY (shared.failed)) return 1;
+
+    *out_chunks = chunks;
+    *out_count = count;
+    return 0;
+}
+
+int64_t anemone_chunk_total (const anemone_chunk_t *chunks, int64_t n)
+{
+    int64_t total = 0;
+    for (int64_t c = 0; c < n; c++) {
+        total += chunks[c].count;
+    }
+    return total;
+}
+
+//
+// Copy 'count' bits from 'src' to 'dst' starting at bit 'offset'. The bits
+// before 'offset' in its word have already been written, and the bits after
+// the last one copied are left as zero.
+//
+ANEMONE_STATIC
+void chunk_copy_bits (uint64_t *dst, int64_t offset, const uint64_t *src, int64_t count)
+{
+    const int shift = offset % 64;
+    const int64_t words = (count + 63) / 64;
+    const int64_t end = offset + count;
+
+    dst += offset / 64;
+
+    for (int64_t j = 0; j < words; j++) {
+        uint64_t w = src[j];
+
+        // the parsers leave the bits past the last field unset, but make sure
+        if (j == words - 1 && count % 64) {
+            w &= (1ULL << (count % 64)) - 1;
+        }
+
+        if (shift == 0) {
+            dst[j] = w;
+        } else {
+            dst[j] |= w << shift;
+            // only write the next word if any of the bits land in it
+            if ((offset / 64 + j + 1) * 64 < end) {
+                dst[j + 1] = w >> (64 - shift);
+            }
+        }
+    }
+}
+
+void anemone_chunk_concat (const anemone_chunk_t *chunks, int64_t n, size_t size, void *values, uint64_t *valid)
+{
+    int64_t offset = 0;
+
+    for (int64_t c = 0; c < n; c++) {
+        const anemone_chunk_t *chunk = &chunks[c];
+
+        memcpy ((char *) values + offset * size, chunk->values, chunk->count * size);
+        chunk_copy_bits (valid, offset, chunk->valid, chunk->count);
+
+        offset += chunk->count;
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef __ANEMONE_CHUNK_H
+#define __ANEMONE_CHUNK_H
+
+//
+// Parsing a large buffer of delimited fields on many threads.
+//
+// The buffer is split in to chunks of about the same size, each ending just
+// after a record terminator, so no field is split between two chunks. The
+// chunks are handed out to the threads one at a time from a shared counter,
+// so a thread which is held up just takes fewer of them. Each thread counts
+// the fields in its chunk, then parses them with one of the column parsers
+// in to its own thread arena of the pool.
+//
+// The chunks are kept in order, so the values can either be used a chunk at
+// a time where they are, or copied in to one array with anemone_chunk_concat.
+//
+
+#include "anemone_base.h"
+#include "anemone_mempool.h"
+
+// Size of a chunk when none is given
+#define ANEMONE_CHUNK_BYTES (1 << 20)
+
+//
+// A column parser, as anemone_string_to_i64_v128_column, with the type of
+// the values erased.
+//
+typedef int64_t (*anemone_chunk_parser_t) (const char **pp, const char *pe, char sep, char term, int64_t n, void *out, uint64_t *valid);
+
+typedef struct {
+  // The part of the buffer the chunk was parsed from
+  const char *start;
+  const char *end;
+  // Number of fields in the chunk
+  int64_t count;
+  // The values and the bitmap of which fields were valid, as from the
+  // column parser, allocated from one of the pool's thread arenas
+  void *values;
+  uint64_t *valid;
+} anemone_chunk_t;
+
+// The column parsers, as anemone_chunk_parser_t.
+int64_t anemone_chunk_parser_i64 (const char **pp, const char *pe, char sep, char term, int64_t n, void *out, uint64_t *valid);
+int64_t anemone_chunk_parser_double (const char **pp, const char *pe, char sep, char term, int64_t n, void *out, uint64_t *valid);
+int64_t anemone_chunk_parser_modified_julian (const char **pp, const char *pe, char sep, char term, int64_t n, void *out, uint64_t *valid);
+int64_t anemone_chunk_parser_timestamp (const char **pp, const char *pe, char sep, char term, int64_t n, void *out, uint64_t *valid);
+
+//
+// Count the fields between 'p' and 'pe', which is the number the column
+// parsers find when there is no limit. A terminator at the very end does not
+// start another field, but a separator does.
+//
+int64_t anemone_chunk_count_fields (const char *p, const char *pe, char sep, char term);
+
+//
+// Parse every field between 'p' and 'pe' with 'parse', whose values are
+// 'size' bytes each, using up to 'threads' threads.
+//
+// Chunks are split after a 'term' byte at least 'chunk_bytes' past the start
+// of the chunk, or ANEMONE_CHUNK_BYTES if it is zero. Everything is allocated
+// from 'pool', which must not be used by anyone else until this returns, and
+// which owns the chunks and their values afterwards.
+//
+// Returns 0 on success, writing the chunks and how many there are to
+// 'out_chunks' and 'out_count', or 1 if memory could not be allocated.
+//
+error_t anemone_chunk_parse (
+    anemone_mempool_t *pool
+  , anemone_chunk_parser_t parse
+  , size_t size
+  , const char *p
+  , const char *pe
+  , char sep
+  , char term
+  , size_t chunk_bytes
+  , int threads
+  , anemone_chunk_t **out_chunks
+  , int64_t *out_count
+  );
+
+// The total number of fields in the chunks.
+int64_t anemone_chunk_total (const anemone_chunk_t *chunks, int64_t n);
+
+//
+// Copy the values and validity bitmaps of the chunks in order, to 'values',
+// which must have room for anemone_chunk_total values of 'size' bytes, and
+// to 'valid', which must have room for that many bits rounded up to a word.
+//
+void anemone_chunk_concat (const anemone_chunk_t *chunks, int64_t n, size_t size, void *values, uint64_t *valid);
+
+#endif//__ANEMONE_CHUNK_H
@@ -0,0 +1,135 @@
+#ifndef __ANEMONE_COLUMN_H
+#define __ANEMONE_COLUMN_H
+
+#include "anemone_base.h"
+#include "anemone_sse.h"
+
+#include <string.h>
+
+//
+// Shared loop for the column parsers, which parse a whole buffer of fields in
+// one call rather than one field per call.
+//
+// A field ends at the separator, the record terminator, or the end of the
+// buffer. Fields are parsed in place, and a field is only valid if the parser
+// stops exactly at the end of it. As the parsers already scan for the first
+// byte which is not part of the value, checking for the delimiter is a single
+// load in the common case. A separate search for the delimiter, vectorised
+// where the CPU allows, only happens for invalid fields, to find where the
+// next field starts.
+//
+// The separator and terminator must not be able to appear inside a value.
+//
+// Every separator or terminator ends a field, even an empty one. After a
+// separator there is always another field, even when it is the last byte, so
+// "1," is two fields and the second is empty and so invalid. A terminator as
+// the very last byte ends the record without starting another field, so
+// "1\n" is one field, which lets a buffer be split after any terminator and
+// parsed in pieces, as anemone_chunk_count_fields relies on. When the
+// separator and terminator are the same byte, the terminator rule applies.
+//
+//
+// Parses one field starting at '*pp', writing the value to element 'i' of
+// 'out' and moving '*pp' to the first byte after the value, returning zero on
+// success. The element is reset to zero afterwards if the field was invalid.
+//
+typedef error_t (*anemone_column_field_t) (const char **pp, const char *pe, void *out, int64_t i);
+
+//
+// Finds the first separator or terminator at or after 'p', or 'pe' if there
+// is none.
+//
+typedef const char * (*anemone_column_delimiter_t) (const char *p, const char *pe, char sep, char term);
+
+ANEMONE_STATIC
+ANEMONE_INLINE
+const char * anemone_column_delimiter_scalar (const char *p, const char *pe, char sep, char term)
+{
+    while (p < pe && *p != sep && *p != term) {
+        p++;
+    }
+
+    return p;
+}
+
+ANEMONE_SSE42
+ANEMONE_STATIC
+ANEMONE_INLINE
+const char * anemone_column_delimiter_sse42 (const char *p, const char *pe, char sep, char term)
+{
+    const __m128i seps = _mm_set1_epi8 (sep);
+    const __m128i terms = _mm_set1_epi8 (term);
+
+    while (p < pe) {
+        __m128i m = anemone_sse_load_bytes128 (p, pe);
+
+        uint32_t found = _mm_movemask_epi8 (
+            _mm_or_si128 (_mm_cmpeq_epi8 (m, seps), _mm_cmpeq_epi8 (m, terms)));
+
+        // a short load is padded with zeros, which must not match a nul delimiter
+        if (pe - p < 16) {
+            found &= (1u << (pe - p)) - 1;
+        }
+
+        if (found) {
+            return p + __builtin_ctz (found);
+        }
+
+        p += 16;
+    }
+
+    return pe;
+}
+
+//
+// The loop is instantiated once per version of a parser, so that both the
+// field parser and the delimiter search are inlined in to it.
+//
+ANEMONE_INLINE
+int64_t anemone_column_parse (
+    anemone_column_field_t parse
+  , anemone_column_delimiter_t delimiter
+  , const char **pp
+  , const char *pe
+  , char sep
+  , char term
+  , int64_t n
+  , void *out
+  , size_t size
+  , uint64_t *valid
+  )
+{
+    const char *p = *pp;
+    int64_t i;
+
+    // whether there is another field, which may be empty at the very end
+    bool_t more = p < pe;
+
+    for (i = 0; i < n && more; i++) {
+        const char *q = p;
+
+        bool_t ok =
+            p < pe &&
+            parse (&q, pe, out, i) == 0 &&
+            (q == pe || *q == sep || *q == term);
+
+        if (ANEMONE_UNLIKELY (!ok)) {
+            memset ((char *) out + i * size, 0, size);
+            q = delimiter (p, pe, sep, term);
+        }
+
+        if (i % 64 == 0) {
+            valid[i / 64] = 0;
+        }
+
+        valid[i / 64] |= (uint64_t) ok << (i % 64);
+
+        more = q < pe && (q + 1 < pe || *q != term);
+        p = q == pe ? pe : q + 1;
+    }
+
+    *pp = p;
+    return i;
+}
+
+#endif//__ANEMONE_COLUMN_H
@@ -0,0 +1,39 @@
+#include "anemone_cpu.h"
+
+ANEMONE_STATIC
+uint64_t anemone_cpu_detect ()
+{
+    uint64_t features = 0;
+
+#if defined(__x86_64__)
+    // required when called from a constructor, which may run before the one
+    // that initialises the cpu model
+    __builtin_cpu_init ();
+
+    if (__builtin_cpu_supports ("sse4.2")) features |= ANEMONE_CPU_SSE42;
+    if (__builtin_cpu_supports ("avx2")) features |= ANEMONE_CPU_AVX2;
+    if (__builtin_cpu_supports ("avx512f")) features |= ANEMONE_CPU_AVX512F;
+#endif
+
+    return features;
+}
+
+//
+// The constructors which resolve entry points run in no particular order, so
+// the first one to ask does the detection rather than relying on a
+// constructor of our own. Every caller computes the same value, so a race to
+// fill the cache is harmless.
+//
+static int64_t anemone_cpu_cache = -1;
+
+uint64_t anemone_cpu_features ()
+{
+    int64_t features = __atomic_load_n (&anemone_cpu_cache, __ATOMIC_RELAXED);
+
+    if (ANEMONE_UNLIKELY (features < 0)) {
+        features = anemone_cpu_detect ();
+        __atomic_store_n (&anemone_cpu_cache, features, __ATOMIC_RELAXED);
+    }
+
+    return features;
+}
@@ -0,0 +1,33 @@
+#ifndef __ANEMONE_CPU_H
+#define __ANEMONE_CPU_H
+
+#include "anemone_base.h"
+
+//
+// Instruction set extensions which some functions have faster versions for.
+//
+// Everything is compiled for the baseline of the target, so that one binary
+// runs everywhere. The faster versions are compiled with a target attribute
+// instead of a command line flag, and each entry point is resolved to the
+// best version for the CPU once, when the library is loaded.
+//
+#define ANEMONE_CPU_SSE42   0x1
+#define ANEMONE_CPU_AVX2    0x2
+#define ANEMONE_CPU_AVX512F 0x4
+
+#define ANEMONE_SSE42 __attribute__((target("sse4.2")))
+#define ANEMONE_AVX2   __attribute__((target("avx2")))
+
+// Runs a function when the library is loaded, before any entry point can be called.
+#define ANEMONE_CONSTRUCTOR __attribute__((constructor))
+
+// The extensions supported by this CPU, which is safe to call from a constructor.
+uint64_t anemone_cpu_features ();
+
+ANEMONE_INLINE
+bool_t anemone_cpu_supports (uint64_t features)
+{
+    return (anemone_cpu_features () & features) == features;
+}
+
+#endif//__ANEMONE_CPU_H
@@ -26,6 +26,8 @@
 #include "anemone_base.h"
 #include "anemone_hash.h"
 
+#include <string.h>
+
 // Compression function for Merkle-Damgard construction.
 #define MIX(v) ({ (v) ^= (v) >> 23; \
                   (v) *= 0x2127599bf4325c37ULL; \
@@ -84,3 +86,182 @@ uint32_t anemone_fasthash32 (uint64_t seed, const uint8_t *buf, size_t len)
 
     return h64 - (h64 >> 32);
 }
+
+void anemone_fasthash64_init (anemone_fasthash_state_t *state, uint64_t seed, size_t total_len)
+{
+    const uint64_t m = 0x880355f21e6d1965ULL;
+
+    state->h = seed ^ (total_len * m);
+    state->pending = 0;
+    state->pending_size = 0;
+}
+
+void anemone_fasthash64_update (anemone_fasthash_state_t *state, const uint8_t *buf, size_t len)
+{
+    const uint64_t m = 0x880355f21e6d1965ULL;
+
+    uint64_t h = state->h;
+    uint64_t v;
+
+    // Finish the word left over from the last chunk
+    if (state->pending_size) {
+        while (len && state->pending_size < 8) {
+            state->pending |= (uint64_t) *buf << (8 * state->pending_size);
+            state->pending_size++;
+            buf++;
+            len--;
+        }
+
+        if (state->pending_size < 8) {
+            return;
+        }
+
+        v = state->pending;
+        h ^= MIX(v);
+        h *= m;
+
+        state->pending = 0;
+        state->pending_size = 0;
+    }
+
+    const uint8_t *end = buf + (len & ~(size_t) 7);
+
+    while (buf != end) {
+        memcpy (&v, buf, 8);
+        buf += 8;
+
+        h ^= MIX(v);
+        h *= m;
+    }
+
+    // The rest is kept for the next chunk, or for the tail if there is none
+    for (size_t i = 0; i < (len & 7); i++) {
+        state->pending |= (uint64_t) buf[i] << (8 * i);
+    }
+    state->pending_size = len & 7;
+    state->h = h;
+}
+
+uint64_t anemone_fasthash64_final (const anemone_fasthash_state_t *state)
+{
+    const uint64_t m = 0x880355f21e6d1965ULL;
+
+    uint64_t h = state->h;
+    uint64_t v = state->pending;
+
+    if (state->pending_size) {
+        h ^= MIX(v);
+        h *= m;
+    }
+
+    return MIX(h);
+}
+
+size_t hs_anemone_fasthash64_state_size ()
+{
+    return sizeof (anemone_fasthash_state_t);
+}
+
+//
+// The bytes after the last whole word, as fasthash reads them. A key with at
+// least one word has the last 8 bytes loaded at once and the bytes which
+// were already hashed shifted out, only short keys are read a byte at a time.
+//
+// len & 7 != 0
+//
+ANEMONE_STATIC
+ANEMONE_INLINE
+uint64_t fasthash_tail (const uint8_t *buf, size_t len)
+{
+    const size_t rest = len & 7;
+    uint64_t v = 0;
+
+    if (len >= 8) {
+        memcpy (&v, buf + len - 8, 8);
+        return v >> (8 * (8 - rest));
+    }
+
+    for (size_t i = rest; i > 0; i--) {
+        v = (v << 8) | buf[i - 1];
+    }
+    return v;
+}
+
+//
+// The keys are hashed four at a time, each with its own state, so the four
+// multiply chains are independent and can be in flight at once. A lane which
+// has run out of words keeps its state with a conditional move rather than a
+// branch, so keys of mixed lengths do not cause mispredictions, at the cost
+// of doing the work of the longest key in each group.
+//
+// AVX2 has no 64-bit multiply, and emulating one takes three 32-bit
+// multiplies and the shifts to put them together, which is slower than four
+// scalar multiplies.
+//
+#define ANEMONE_FASTHASH_LANES 4
+
+void anemone_fasthash64_batch (uint64_t seed, const uint8_t *const *ptrs, const size_t *lens, int64_t n, uint64_t *out)
+{
+    const uint64_t m = 0x880355f21e6d1965ULL;
+
+    // read in place of a word from a lane which has finished
+    static const uint64_t zero = 0;
+
+    int64_t i = 0;
+
+    for (; i + ANEMONE_FASTHASH_LANES <= n; i += ANEMONE_FASTHASH_LANES) {
+        uint64_t h[ANEMONE_FASTHASH_LANES];
+        size_t words[ANEMONE_FASTHASH_LANES];
+        size_t max_words = 0;
+
+        for (int l = 0; l < ANEMONE_FASTHASH_LANES; l++) {
+            h[l] = seed ^ (lens[i + l] * m);
+            words[l] = lens[i + l] / 8;
+            max_words = words[l] > max_words ? words[l] : max_words;
+        }
+
+        for (size_t w = 0; w < max_words; w++) {
+            for (int l = 0; l < ANEMONE_FASTHASH_LANES; l++) {
+                const bool_t live = w < words[l];
+                const uint8_t *src = live ? ptrs[i + l] + 8 * w : (const uint8_t *) &zero;
+
+                uint64_t v;
+                memcpy (&v, src, 8);
+
+                uint64_t next = h[l] ^ MIX(v);
+                next *= m;
+                h[l] = live ? next : h[l];
+            }
+        }
+
+        for (int l = 0; l < ANEMONE_FASTHASH_LANES; l++) {
+            if (lens[i + l] & 7) {
+                uint64_t v = fasthash_tail (ptrs[i + l], lens[i + l]);
+                h[l] ^= MIX(v);
+                h[l] *= m;
+            }
+            out[i + l] = MIX(h[l]);
+        }
+    }
+
+    for (; i < n; i++) {
+        out[i] = fasthash (seed, ptrs[i], lens[i]);
+    }
+}
+
+//
+// An 8 byte key is one word and no tail, so each hash is a fixed sequence of
+// operations with no loop, and consecutive keys are independent.
+//
+void anemone_fasthash64_u64_batch (uint64_t seed, const uint64_t *keys, int64_t n, uint64_t *out)
+{
+    const uint64_t m = 0x880355f21e6d1965ULL;
+    const uint64_t h0 = seed ^ (8 * m);
+
+    for (int64_t i = 0; i < n; i++) {
+        uint64_t v = keys[i];
+        uint64_t h = h0 ^ MIX(v);
+        h *= m;
+        out[i] = MIX(h);
+    }
+}
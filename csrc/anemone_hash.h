@@ -8,4 +8,45 @@ uint32_t anemone_fasthash32 (uint64_t seed, const uint8_t *buf, size_t len);
 
 uint64_t anemone_fasthash64 (uint64_t seed, const uint8_t *buf, size_t len);
 
+//
+// Hashes 'n' keys, key i is 'lens[i]' bytes at 'ptrs[i]', writing the same
+// hash as anemone_fasthash64 would to 'out[i]'. Several keys are hashed at
+// once, which is faster for many short keys than one call each.
+//
+void anemone_fasthash64_batch (uint64_t seed, const uint8_t *const *ptrs, const size_t *lens, int64_t n, uint64_t *out);
+
+//
+// Hashes 'n' 64-bit keys, writing the same hash as anemone_fasthash64 would
+// for the 8 bytes of 'keys[i]' to 'out[i]'.
+//
+void anemone_fasthash64_u64_batch (uint64_t seed, const uint64_t *keys, int64_t n, uint64_t *out);
+
+//
+// Incremental fasthash, for input which arrives in chunks. The hash of the
+// whole input is the same as anemone_fasthash64 on the chunks put together,
+// however the input is split.
+//
+// fasthash mixes the total length in to the state before the first word, so
+// it must be known up front and given to anemone_fasthash64_init, the hash
+// is only the same if the chunks add up to it.
+//
+typedef struct {
+  // State after the whole words seen so far
+  uint64_t h;
+  // Bytes after the last whole word, the first in the lowest byte
+  uint64_t pending;
+  // Number of bytes in 'pending'
+  // 0 <= pending_size < 8
+  size_t   pending_size;
+} anemone_fasthash_state_t;
+
+void anemone_fasthash64_init (anemone_fasthash_state_t *state, uint64_t seed, size_t total_len);
+
+void anemone_fasthash64_update (anemone_fasthash_state_t *state, const uint8_t *buf, size_t len);
+
+uint64_t anemone_fasthash64_final (const anemone_fasthash_state_t *state);
+
+// sizeof (anemone_fasthash_state_t), for allocating the state from Haskell
+size_t hs_anemone_fasthash64_state_size ();
+
 #endif//__ANEMONE_HASH_H
@@ -0,0 +1,313 @@
+#include "anemone_intern.h"
+#include "anemone_hash.h"
+#include "anemone_memcmp.h"
+#include "anemone_sse.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Keys are hashed and prefetched this many at a time by the batch functions
+#define ANEMONE_INTERN_BATCH 64
+
+ANEMONE_STATIC
+ANEMONE_INLINE
+uint8_t intern_tag (uint64_t hash)
+{
+    return (uint8_t) (hash >> 57);
+}
+
+// The first group to probe, from the low bits of the hash, so it is
+// independent of the tag
+ANEMONE_STATIC
+ANEMONE_INLINE
+size_t intern_group (size_t capacity, uint64_t hash)
+{
+    return hash & (capacity / ANEMONE_INTERN_GROUP - 1);
+}
+
+//
+// Returns the id of the key, or ANEMONE_INTERN_MISSING with 'out_slot' set to
+// the empty slot it would be inserted in to.
+//
+// The groups are probed with triangular steps, which visits every group
+// when the number of groups is a power of two.
+//
+ANEMONE_STATIC
+ANEMONE_INLINE
+uint32_t intern_find (const anemone_intern_t *intern, uint64_t hash, const uint8_t *key, size_t len, size_t *out_slot)
+{
+    const __m128i tag = _mm_set1_epi8 ((char) intern_tag (hash));
+    const size_t groups_mask = intern->capacity / ANEMONE_INTERN_GROUP - 1;
+
+    size_t group = intern_group (intern->capacity, hash);
+
+    for (size_t step = 1; ; step++) {
+        const size_t base = group * ANEMONE_INTERN_GROUP;
+        const __m128i ctrl = anemone_sse_load128 (intern->ctrl + base);
+
+        uint32_t match = _mm_movemask_epi8 (_mm_cmpeq_epi8 (ctrl, tag));
+        while (match) {
+            const anemone_intern_slot_t *slot = intern->slots + base + __builtin_ctz (match);
+
+            if (slot->hash == hash &&
+                slot->len == len &&
+                anemone_memcmp (intern->keys[slot->id], key, len) == 0) {
+                return slot->id;
+            }
+
+            match &= match - 1;
+        }
+
+        const uint32_t empty = _mm_movemask_epi8 (ctrl);
+        if (ANEMONE_LIKELY (empty)) {
+            *out_slot = base + __builtin_ctz (empty);
+            return ANEMONE_INTERN_MISSING;
+        }
+
+        group = (group + step) & groups_mask;
+    }
+}
+
+// The first empty slot for a hash, when the key is known not to be there.
+ANEMONE_STATIC
+ANEMONE_INLINE
+size_t intern_find_empty (const uint8_t *ctrl, size_t capacity, uint64_t hash)
+{
+    const size_t groups_mask = capacity / ANEMONE_INTERN_GROUP - 1;
+
+    size_t group = intern_group (capacity, hash);
+
+    for (size_t step = 1; ; step++) {
+        const size_t base = group * ANEMONE_INTERN_GROUP;
+        const uint32_t empty = _mm_movemask_epi8 (anemone_sse_load128 (ctrl + base));
+
+        if (ANEMONE_LIKELY (empty)) {
+            return base + __builtin_ctz (empty);
+        }
+
+        group = (group + step) & groups_mask;
+    }
+}
+
+// Move every key to a table with twice as many slots.
+ANEMONE_STATIC
+error_t intern_grow_slots (anemone_intern_t *intern)
+{
+    const size_t capacity = intern->capacity * 2;
+
+    uint8_t *ctrl = malloc (capacity);
+    anemone_intern_slot_t *slots = malloc (capacity * sizeof (anemone_intern_slot_t));
+
+    if (ANEMONE_UNLIKELY (ctrl == NULL || slots == NULL)) {
+        free (ctrl);
+        free (slots);
+        return 1;
+    }
+
+    memset (ctrl, ANEMONE_INTERN_EMPTY, capacity);
+
+    for (size_t i = 0; i < intern->capacity; i++) {
+        if (intern->ctrl[i] != ANEMONE_INTERN_EMPTY) {
+            const size_t slot = intern_find_empty (ctrl, capacity, intern->slots[i].hash);
+
+            ctrl[slot] = intern->ctrl[i];
+            slots[slot] = intern->slots[i];
+        }
+    }
+
+    free (intern->ctrl);
+    free (intern->slots);
+
+    intern->ctrl = ctrl;
+    intern->slots = slots;
+    intern->capacity = capacity;
+
+    return 0;
+}
+
+// Make room for twice as many ids.
+ANEMONE_STATIC
+error_t intern_grow_ids (anemone_intern_t *intern)
+{
+    if (ANEMONE_UNLIKELY (intern->ids_capacity > ANEMONE_INTERN_MISSING / 2)) {
+        return 1;
+    }
+
+    const size_t ids_capacity = (size_t) intern->ids_capacity * 2;
+
+    // each array is only replaced once it has been grown, so a failure part
+    // way leaves the interner as it was, with some arrays bigger than needed
+    const uint8_t **keys = realloc (intern->keys, ids_capacity * sizeof (const uint8_t *));
+    if (ANEMONE_UNLIKELY (keys == NULL)) return 1;
+    intern->keys = keys;
+
+    size_t *lens = realloc (intern->lens, ids_capacity * sizeof (size_t));
+    if (ANEMONE_UNLIKELY (lens == NULL)) return 1;
+    intern->lens = lens;
+
+    intern->ids_capacity = (uint32_t) ids_capacity;
+
+    return 0;
+}
+
+anemone_intern_t * anemone_intern_create (uint64_t seed)
+{
+    const size_t capacity = ANEMONE_INTERN_GROUP;
+    const uint32_t ids_capacity = 16;
+
+    anemone_intern_t *intern = calloc (1, sizeof (anemone_intern_t));
+    if (ANEMONE_UNLIKELY (intern == NULL)) return NULL;
+
+    intern->pool = anemone_mempool_create ();
+    intern->seed = seed;
+    intern->ctrl = malloc (capacity);
+    intern->slots = malloc (capacity * sizeof (anemone_intern_slot_t));
+    intern->capacity = capacity;
+    intern->keys = malloc (ids_capacity * sizeof (const uint8_t *));
+    intern->lens = malloc (ids_capacity * sizeof (size_t));
+    intern->count = 0;
+    intern->ids_capacity = ids_capacity;
+
+    if (ANEMONE_UNLIKELY (
+            intern->pool == NULL ||
+            intern->ctrl == NULL ||
+            intern->slots == NULL ||
+            intern->keys == NULL ||
+            intern->lens == NULL)) {
+        anemone_intern_free (intern);
+        return NULL;
+    }
+
+    memset (intern->ctrl, ANEMONE_INTERN_EMPTY, capacity);
+
+    return intern;
+}
+
+void anemone_intern_free (anemone_intern_t *intern)
+{
+    if (intern->pool) {
+        anemone_mempool_free (intern->pool);
+    }
+    free (intern->ctrl);
+    free (intern->slots);
+    free (intern->keys);
+    free (intern->lens);
+    free (intern);
+}
+
+uint32_t anemone_intern_size (const anemone_intern_t *intern)
+{
+    return intern->count;
+}
+
+const uint8_t * anemone_intern_key (const anemone_intern_t *intern, uint32_t id, size_t *out_len)
+{
+    *out_len = intern->lens[id];
+    return intern->keys[id];
+}
+
+ANEMONE_STATIC
+ANEMONE_INLINE
+error_t intern_insert_hashed (anemone_intern_t *intern, uint64_t hash, const uint8_t *key, size_t len, uint32_t *out_id)
+{
+    size_t slot = 0;
+    const uint32_t found = intern_find (intern, hash, key, len, &slot);
+
+    if (ANEMONE_LIKELY (found != ANEMONE_INTERN_MISSING)) {
+        *out_id = found;
+        return 0;
+    }
+
+    if (ANEMONE_UNLIKELY (len > UINT32_MAX)) {
+        return 1;
+    }
+
+    if (ANEMONE_UNLIKELY (intern->count + 1 == intern->ids_capacity)) {
+        if (intern_grow_ids (intern)) return 1;
+    }
+
+    // at most 7/8 full, so probes stay short
+    if (ANEMONE_UNLIKELY ((size_t) (intern->count + 1) * 8 > intern->capacity * 7)) {
+        if (intern_grow_slots (intern)) return 1;
+        slot = intern_find_empty (intern->ctrl, intern->capacity, hash);
+    }
+
+    uint8_t *copy = anemone_mempool_alloc (intern->pool, len);
+    if (ANEMONE_UNLIKELY (copy == NULL && len != 0)) return 1;
+    memcpy (copy, key, len);
+
+    const uint32_t id = intern->count;
+
+    intern->ctrl[slot] = intern_tag (hash);
+    intern->slots[slot].hash = hash;
+    intern->slots[slot].id = id;
+    intern->slots[slot].len = (uint32_t) len;
+    intern->keys[id] = copy;
+    intern->lens[id] = len;
+    intern->count = id + 1;
+
+    *out_id = id;
+    return 0;
+}
+
+error_t anemone_intern_insert (anemone_intern_t *intern, const uint8_t *key, size_t len, uint32_t *out_id)
+{
+    const uint64_t hash = anemone_fasthash64 (intern->seed, key, len);
+    return intern_insert_hashed (intern, hash, key, len, out_id);
+}
+
+uint32_t anemone_intern_lookup (const anemone_intern_t *intern, const uint8_t *key, size_t len)
+{
+    size_t slot;
+    const uint64_t hash = anemone_fasthash64 (intern->seed, key, len);
+    return intern_find (intern, hash, key, len, &slot);
+}
+
+// Start loading the first group each key will probe.
+ANEMONE_STATIC
+ANEMONE_INLINE
+void intern_prefetch (const anemone_intern_t *intern, const uint64_t *hashes, int64_t n)
+{
+    for (int64_t i = 0; i < n; i++) {
+        const size_t base = intern_group (intern->capacity, hashes[i]) * ANEMONE_INTERN_GROUP;
+        __builtin_prefetch (intern->ctrl + base);
+        __builtin_prefetch (intern->slots + base);
+    }
+}
+
+error_t anemone_intern_insert_batch (anemone_intern_t *intern, const uint8_t *const *ptrs, const size_t *lens, int64_t n, uint32_t *out_ids)
+{
+    uint64_t hashes[ANEMONE_INTERN_BATCH];
+
+    for (int64_t i = 0; i < n; i += ANEMONE_INTERN_BATCH) {
+        const int64_t count = n - i < ANEMONE_INTERN_BATCH ? n - i : ANEMONE_INTERN_BATCH;
+
+        anemone_fasthash64_batch (intern->seed, ptrs + i, lens + i, count, hashes);
+        intern_prefetch (intern, hashes, count);
+
+        for (int64_t j = 0; j < count; j++) {
+            if (ANEMONE_UNLIKELY (intern_insert_hashed (intern, hashes[j], ptrs[i + j], lens[i + j], out_ids + i + j))) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+void anemone_intern_lookup_batch (const anemone_intern_t *intern, const uint8_t *const *ptrs, const size_t *lens, int64_t n, uint32_t *out_ids)
+{
+    uint64_t hashes[ANEMONE_INTERN_BATCH];
+
+    for (int64_t i = 0; i < n; i += ANEMONE_INTERN_BATCH) {
+        const int64_t count = n - i < ANEMONE_INTERN_BATCH ? n - i : ANEMONE_INTERN_BATCH;
+
+        anemone_fasthash64_batch (intern->seed, ptrs + i, lens + i, count, hashes);
+        intern_prefetch (intern, hashes, count);
+
+        for (int64_t j = 0; j < count; j++) {
+            size_t slot;
+            out_ids[i + j] = intern_find (intern, hashes[j], ptrs[i + j], lens[i + j], &slot);
+        }
+    }
+}
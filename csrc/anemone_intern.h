@@ -0,0 +1,102 @@
+#ifndef __ANEMONE_INTERN_H
+#define __ANEMONE_INTERN_H
+
+//
+// An interner, which gives each distinct byte string a dense id, in the order
+// they were first seen, for dictionary encoding and removing duplicates.
+//
+// This is an open addressing table in the style of a Swiss table. There is a
+// control byte per slot, which is either empty or the top 7 bits of the hash
+// of the key in the slot, and slots are probed 16 at a time by comparing a
+// whole group of control bytes with one SSE2 compare. Each slot holds the
+// key's full hash and length next to its id, so a slot whose control byte
+// matches is checked without leaving the table, and the key bytes are only
+// looked at when the whole hash matches.
+//
+// Keys are never removed, so there are no tombstones, and the first group
+// with an empty slot ends a probe.
+//
+// The key bytes are copied in to a mempool owned by the interner, so the
+// keys passed in can be freed once they have been interned.
+//
+
+#include "anemone_base.h"
+#include "anemone_mempool.h"
+
+// The id given for a key which has not been interned.
+#define ANEMONE_INTERN_MISSING 0xFFFFFFFF
+
+// Control byte of an empty slot. Only empty slots have the high bit set.
+#define ANEMONE_INTERN_EMPTY 0x80
+
+// Slots are probed in groups of this many control bytes.
+#define ANEMONE_INTERN_GROUP 16
+
+typedef struct {
+  uint64_t hash;
+  uint32_t id;
+  uint32_t len;
+} anemone_intern_slot_t;
+
+typedef struct {
+  // Key bytes
+  anemone_mempool_t *pool;
+  uint64_t seed;
+
+  // One control byte per slot
+  uint8_t  *ctrl;
+  // The key in each slot, where the control byte is not empty
+  anemone_intern_slot_t *slots;
+  // Number of slots, a power of two and a multiple of ANEMONE_INTERN_GROUP
+  size_t    capacity;
+
+  // Key and length of each id
+  const uint8_t **keys;
+  size_t   *lens;
+  // Number of keys interned, the next id
+  // count < ids_capacity
+  uint32_t  count;
+  uint32_t  ids_capacity;
+} anemone_intern_t;
+
+// Create an empty interner, which hashes keys with the given seed for
+// anemone_fasthash64. Returns null if memory could not be allocated.
+anemone_intern_t * anemone_intern_create (uint64_t seed);
+
+// Free the interner and all the key bytes it holds.
+void anemone_intern_free (anemone_intern_t *intern);
+
+// Number of keys interned, ids are 0 up to this.
+uint32_t anemone_intern_size (const anemone_intern_t *intern);
+
+// The bytes of the key with the given id, which live as long as the interner.
+// id < anemone_intern_size (intern)
+const uint8_t * anemone_intern_key (const anemone_intern_t *intern, uint32_t id, size_t *out_len);
+
+//
+// Finds the id of a key, giving it the next id if it has not been seen before.
+//
+// Returns 0 on success, or 1 if memory could not be allocated, the key is
+// 4GB or more, or the interner already has 2^31 - 1 keys, in which case the
+// key is not added.
+//
+error_t anemone_intern_insert (anemone_intern_t *intern, const uint8_t *key, size_t len, uint32_t *out_id);
+
+// Finds the id of a key, or ANEMONE_INTERN_MISSING if it has not been interned.
+uint32_t anemone_intern_lookup (const anemone_intern_t *intern, const uint8_t *key, size_t len);
+
+//
+// The same as anemone_intern_insert on each of 'n' keys in order, key i is
+// 'lens[i]' bytes at 'ptrs[i]'. The keys are hashed several at a time, and their
+// groups are prefetched before they are probed, which hides most of the cache
+// misses on a large table.
+//
+// Returns 0 on success, or 1 on failure, in which case the keys before the
+// one which failed are interned and have their ids written.
+//
+error_t anemone_intern_insert_batch (anemone_intern_t *intern, const uint8_t *const *ptrs, const size_t *lens, int64_t n, uint32_t *out_ids);
+
+// The same as anemone_intern_lookup on each of 'n' keys.
+void anemone_intern_lookup_batch (const anemone_intern_t *intern, const uint8_t *const *ptrs, const size_t *lens, int64_t n, uint32_t *out_ids);
+
+#endif//__ANEMONE_INTERN_H
@@ -0,0 +1,43 @@
+#include "anemone_itoa.h"
+
+size_t hs_anemone_u64_to_string (uint64_t x, char *output_ptr)
+{
+    return anemone_u64_to_string (x, output_ptr);
+}
+
+size_t hs_anemone_i64_to_string (int64_t x, char *output_ptr)
+{
+    return anemone_i64_to_string (x, output_ptr);
+}
+
+error_t anemone_i64_column_to_string (anemone_buffer_t *buffer, const int64_t *values, int64_t n, uint8_t delim)
+{
+    static const int64_t chunk = 256;
+
+    for (int64_t i = 0; i < n; i += chunk) {
+        int64_t count = n - i < chunk ? n - i : chunk;
+
+        char *dst = (char *) anemone_buffer_reserve (buffer, count * (ANEMONE_I64_STRING_MAX + 1));
+        if (ANEMONE_UNLIKELY(dst == NULL)) return 1;
+
+        char *p = dst;
+        for (int64_t j = 0; j < count; j++) {
+            p += anemone_i64_to_string (values[i + j], p);
+            *p++ = delim;
+        }
+
+        anemone_buffer_commit (buffer, p - dst);
+    }
+
+    return 0;
+}
+
+void * hs_anemone_i64_column_to_string (anemone_mempool_t *pool, const int64_t *values, int64_t n, uint8_t delim, size_t *size)
+{
+    anemone_buffer_t buffer;
+    anemone_buffer_init (&buffer, pool, n * 8);
+    if (anemone_i64_column_to_string (&buffer, values, n, delim)) return NULL;
+
+    *size = buffer.size;
+    return anemone_buffer_freeze (&buffer);
+}
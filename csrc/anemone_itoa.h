@@ -0,0 +1,160 @@
+#ifndef __ANEMONE_ITOA_H
+#define __ANEMONE_ITOA_H
+
+#include "anemone_base.h"
+#include "anemone_buffer.h"
+
+#include <string.h>
+
+// The longest string anemone_i64_to_string writes, "-9223372036854775808".
+// anemone_u64_to_string writes at most 20 bytes as well, "18446744073709551615".
+#define ANEMONE_I64_STRING_MAX 20
+
+// Number of decimal digits in x, at least 1.
+ANEMONE_INLINE
+size_t anemone_u64_digits (uint64_t x)
+{
+    static const uint64_t pow10[] = {
+        1ULL,
+        10ULL,
+        100ULL,
+        1000ULL,
+        10000ULL,
+        100000ULL,
+        1000000ULL,
+        10000000ULL,
+        100000000ULL,
+        1000000000ULL,
+        10000000000ULL,
+        100000000000ULL,
+        1000000000000ULL,
+        10000000000000ULL,
+        100000000000000ULL,
+        1000000000000000ULL,
+        10000000000000000ULL,
+        100000000000000000ULL,
+        1000000000000000000ULL,
+        10000000000000000000ULL
+    };
+
+    // 1233 / 4096 is just above log10(2), so this is the number of digits in
+    // the smallest number with the same bit length, or one less than x has.
+    // Powers of ten above 1 are even, so or-ing in 1 only changes the count
+    // for zero, which has one digit.
+    size_t bits   = 64 - __builtin_clzll (x | 1);
+    size_t digits = (bits * 1233) >> 12;
+    return digits + ((x | 1) >= pow10[digits]);
+}
+
+// Write the eight digits of x < 10^8 to p, including leading zeros.
+ANEMONE_INLINE
+void anemone_u32_to_string_eight (uint32_t x, char *p)
+{
+    // "00" "01" ... "99", so two digits can be written with one table lookup
+    // and a single division by 100 instead of two divisions by 10
+    static const char digit_pairs[201] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+    uint32_t hi = x / 10000;
+    uint32_t lo = x - hi * 10000;
+    memcpy (p + 0, digit_pairs + 2 * (hi / 100), 2);
+    memcpy (p + 2, digit_pairs + 2 * (hi % 100), 2);
+    memcpy (p + 4, digit_pairs + 2 * (lo / 100), 2);
+    memcpy (p + 6, digit_pairs + 2 * (lo % 100), 2);
+}
+
+// Write the decimal representation of x to output_ptr, which must have room
+// for ANEMONE_I64_STRING_MAX bytes, returning the number of bytes written.
+// The output is not null terminated, and the bytes after it up to
+// ANEMONE_I64_STRING_MAX may be overwritten.
+//
+// The digits are written in groups of eight, so the only branches on the
+// length are whether there are one, two or three groups.
+ANEMONE_INLINE
+size_t anemone_u64_to_string (uint64_t x, char *output_ptr)
+{
+    size_t   digits = anemone_u64_digits (x);
+    uint64_t top    = x;
+    uint32_t mid    = 0;
+    uint32_t low    = 0;
+
+    if (digits > 8) {
+        low = (uint32_t)(top % 100000000);
+        top = top / 100000000;
+    }
+    if (digits > 16) {
+        mid = (uint32_t)(top % 100000000);
+        top = top / 100000000;
+    }
+
+    // The leading group has its zeros shifted out, then is stored as a whole
+    // word, the remaining groups overwrite whatever is past its end
+    size_t lead = ((digits - 1) & 7) + 1;
+    char   first[8];
+    anemone_u32_to_string_eight ((uint32_t)top, first);
+    uint64_t word;
+    memcpy (&word, first, 8);
+    word >>= 8 * (8 - lead);
+
+    char *p = output_ptr;
+    memcpy (p, &word, 8);
+    p += lead;
+
+    if (digits > 16) {
+        anemone_u32_to_string_eight (mid, p);
+        p += 8;
+    }
+    if (digits > 8) {
+        anemone_u32_to_string_eight (low, p);
+    }
+
+    return digits;
+}
+
+// Write the decimal representation of x, with a leading '-' if it is negative,
+// the same as anemone_string_to_i64 reads. The output has the same
+// requirements as for anemone_u64_to_string.
+ANEMONE_INLINE
+size_t anemone_i64_to_string (int64_t x, char *output_ptr)
+{
+    if (x < 0) {
+        // Negate as unsigned so INT64_MIN does not overflow
+        output_ptr[0] = '-';
+        return 1 + anemone_u64_to_string (0 - (uint64_t)x, output_ptr + 1);
+    }
+    return anemone_u64_to_string ((uint64_t)x, output_ptr);
+}
+
+// The same as anemone_u64_to_string and anemone_i64_to_string, for calling
+// from Haskell.
+size_t hs_anemone_u64_to_string (uint64_t x, char *output_ptr);
+size_t hs_anemone_i64_to_string (int64_t x, char *output_ptr);
+
+//
+// Writes a column of integers to the end of a buffer, each one followed by
+// 'delim', so a column written with '\n' has one value per line, and one
+// written with ',' can be read back by anemone_string_to_i64_v128_column.
+//
+// Space is reserved for the longest possible value 256 at a time, so the
+// buffer only needs to be grown every few thousand bytes.
+//
+// Returns 0 on success, or 1 if the buffer could not be grown, in which case
+// the values written before that are kept.
+//
+error_t anemone_i64_column_to_string (anemone_buffer_t *buffer, const int64_t *values, int64_t n, uint8_t delim);
+
+// Write a column to a new buffer in the pool, for calling from Haskell.
+// Returns the contents and sets 'size', or returns null if the pool could not
+// grow.
+void * hs_anemone_i64_column_to_string (anemone_mempool_t *pool, const int64_t *values, int64_t n, uint8_t delim, size_t *size);
+
+#endif//__ANEMONE_ITOA_H
@@ -11,16 +11,40 @@ int hs_anemone_memcmp64 (const void *as, const void *bs, size_t len)
     return anemone_memcmp64 (as, bs, len);
 }
 
+int hs_anemone_memcmp128 (const void *as, const void *bs, size_t len)
+{
+    return anemone_memcmp128 (as, bs, len);
+}
+
 int hs_anemone_memcmp_partial_load64 (const void *as, const void *bs, size_t len)
 {
     return anemone_memcmp_partial_load64 (as, bs, len);
 }
 
-int hs_anemone_memcmp128_unsafe (const void *as, const void *bs, size_t len)
+ANEMONE_SSE42
+ANEMONE_STATIC
+int memcmp128_unsafe_sse42 (const void *as, const void *bs, size_t len)
 {
     return anemone_memcmp128_unsafe (as, bs, len);
 }
 
+/* falls back to the blessed version when the CPU does not support SSE4.2 */
+static int (*resolved_memcmp128_unsafe) (const void *as, const void *bs, size_t len) = hs_anemone_memcmp64;
+
+ANEMONE_CONSTRUCTOR
+ANEMONE_STATIC
+void anemone_memcmp_init ()
+{
+    if (anemone_cpu_supports (ANEMONE_CPU_SSE42)) {
+        resolved_memcmp128_unsafe = memcmp128_unsafe_sse42;
+    }
+}
+
+int hs_anemone_memcmp128_unsafe (const void *as, const void *bs, size_t len)
+{
+    return resolved_memcmp128_unsafe (as, bs, len);
+}
+
 int hs_anemone_memcmp (const void *as, const void *bs, size_t len)
 {
     return anemone_memcmp (as, bs, len);
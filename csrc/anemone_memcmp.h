@@ -10,8 +10,31 @@
  */
 
 #include "anemone_base.h"
+#include "anemone_sse.h"
 #include "anemone_twiddle.h"
 
+#include <string.h>
+
+/* Loads are never allowed to cross a boundary of this size, as the next page
+ * may not be mapped. This is the smallest page size on x86-64. */
+#define ANEMONE_MEMCMP_PAGE_SIZE 4096
+
+/* Whether a short compare may load a whole block which stays inside a page,
+ * reading past the end of the buffers. AddressSanitizer can not tell that the
+ * extra bytes are masked off, and reports the load as an overflow, so it is
+ * turned off when building with it, and only the bytes in the buffers are read. */
+#if defined(__SANITIZE_ADDRESS__)
+#define ANEMONE_MEMCMP_OVER_READ 0
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define ANEMONE_MEMCMP_OVER_READ 0
+#endif
+#endif
+
+#ifndef ANEMONE_MEMCMP_OVER_READ
+#define ANEMONE_MEMCMP_OVER_READ 1
+#endif
+
 /* "Give me the best version" */
 ANEMONE_INLINE
 int anemone_memcmp (const void *as, const void *bs, size_t len);
@@ -79,10 +102,176 @@ int anemone_memcmp64 (const void *as, const void *bs, size_t len)
     return 0;
 }
 
+/* Whether a 16-byte load from 'p' stays inside the page 'p' is in */
+ANEMONE_INLINE
+bool_t anemone_memcmp_in_page128 (const void *p)
+{
+    return ((uintptr_t) p & (ANEMONE_MEMCMP_PAGE_SIZE - 1)) <= ANEMONE_MEMCMP_PAGE_SIZE - 16;
+}
+
+/* Bit i is set when byte i of the two 16-byte blocks differ */
+ANEMONE_INLINE
+uint32_t anemone_memcmp_mismatch128 (const uint8_t *a, const uint8_t *b)
+{
+    __m128i eq = _mm_cmpeq_epi8 (anemone_sse_load128 (a), anemone_sse_load128 (b));
+    return ~_mm_movemask_epi8 (eq) & 0xFFFF;
+}
+
+/* Compare 8 bytes as a big-endian number, so the first byte has the most weight */
+ANEMONE_INLINE
+int anemone_memcmp_word64 (const uint8_t *a, const uint8_t *b)
+{
+    uint64_t a_w, b_w;
+    memcpy (&a_w, a, 8);
+    memcpy (&b_w, b, 8);
+    a_w = anemone_bswap64 (a_w);
+    b_w = anemone_bswap64 (b_w);
+    return (a_w > b_w) - (a_w < b_w);
+}
+
+ANEMONE_INLINE
+int anemone_memcmp_word32 (const uint8_t *a, const uint8_t *b)
+{
+    uint32_t a_w, b_w;
+    memcpy (&a_w, a, 4);
+    memcpy (&b_w, b, 4);
+    a_w = __builtin_bswap32 (a_w);
+    b_w = __builtin_bswap32 (b_w);
+    return (a_w > b_w) - (a_w < b_w);
+}
+
+/*
+ * Fewer than 16 bytes, without reading past the end of either buffer.
+ * The first and last words overlap, so every byte is covered by two
+ * compares at most.
+ */
+ANEMONE_INLINE
+int anemone_memcmp_small (const uint8_t *a, const uint8_t *b, size_t len)
+{
+    int cmp;
+    if (len >= 8) {
+        cmp = anemone_memcmp_word64 (a, b);
+        if (cmp) return cmp;
+        return anemone_memcmp_word64 (a + len - 8, b + len - 8);
+    } else if (len >= 4) {
+        cmp = anemone_memcmp_word32 (a, b);
+        if (cmp) return cmp;
+        return anemone_memcmp_word32 (a + len - 4, b + len - 4);
+    }
+
+    for (size_t i = 0; i != len; ++i) {
+        if (a[i] != b[i]) return (int) a[i] - (int) b[i];
+    }
+    return 0;
+}
+
+/*
+ * SSE2 comparison, 64 bytes at a time.
+ *
+ * Unlike anemone_memcmp128_unsafe in the zoo, this never touches a page
+ * neither buffer reaches in to, so it is safe on the end of an mmap'd file:
+ *
+ *  - the last block is loaded so that it ends on the last byte, overlapping
+ *    the block before it, rather than running off the end;
+ *
+ *  - with fewer than 16 bytes, a whole block is only loaded when it stays in
+ *    the same page as the start of each buffer, and the bytes past the end are
+ *    masked off. Near the end of a page it uses overlapping 8 or 4 byte words.
+ *
+ * That short load can still read up to 15 bytes past the end of the buffer,
+ * inside a page which is mapped, which address sanitizers would report, so
+ * with ASan the short path always uses the words (ANEMONE_MEMCMP_OVER_READ).
+ */
+ANEMONE_INLINE
+int anemone_memcmp128 (const void *as, const void *bs, size_t len)
+{
+    const uint8_t *a = as;
+    const uint8_t *b = bs;
+    uint32_t mismatch;
+
+    if (ANEMONE_UNLIKELY (len < 16)) {
+        /* An empty buffer may point at the start of a page it does not own */
+        if (len == 0) return 0;
+        if (ANEMONE_MEMCMP_OVER_READ && ANEMONE_LIKELY (anemone_memcmp_in_page128 (a) && anemone_memcmp_in_page128 (b))) {
+            mismatch = anemone_memcmp_mismatch128 (a, b) & ((1u << len) - 1);
+            if (mismatch == 0) return 0;
+            uint32_t i = __builtin_ctz (mismatch);
+            return (int) a[i] - (int) b[i];
+        }
+        return anemone_memcmp_small (a, b, len);
+    }
+
+    /* Skip over equal bytes 64 at a time, stopping at the block with the
+     * first difference, which is then found 16 bytes at a time */
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m128i eq = _mm_and_si128 (
+            _mm_and_si128 (
+                _mm_cmpeq_epi8 (anemone_sse_load128 (a + i),      anemone_sse_load128 (b + i)),
+                _mm_cmpeq_epi8 (anemone_sse_load128 (a + i + 16), anemone_sse_load128 (b + i + 16))),
+            _mm_and_si128 (
+                _mm_cmpeq_epi8 (anemone_sse_load128 (a + i + 32), anemone_sse_load128 (b + i + 32)),
+                _mm_cmpeq_epi8 (anemone_sse_load128 (a + i + 48), anemone_sse_load128 (b + i + 48))));
+        if (_mm_movemask_epi8 (eq) != 0xFFFF) break;
+    }
+
+    for (; i + 16 <= len; i += 16) {
+        mismatch = anemone_memcmp_mismatch128 (a + i, b + i);
+        if (mismatch) {
+            i += __builtin_ctz (mismatch);
+            return (int) a[i] - (int) b[i];
+        }
+    }
+
+    if (i == len) return 0;
+
+    /* The last 16 bytes, some of which have already been compared */
+    i = len - 16;
+    mismatch = anemone_memcmp_mismatch128 (a + i, b + i);
+    if (mismatch) {
+        i += __builtin_ctz (mismatch);
+        return (int) a[i] - (int) b[i];
+    }
+    return 0;
+}
+
+/*
+ * Comparisons of keys with a fixed length, for sort comparators where the
+ * width of the key is known up front. These only load the key itself.
+ */
+ANEMONE_INLINE
+int anemone_memcmp_fixed8 (const void *as, const void *bs)
+{
+    return anemone_memcmp_word64 (as, bs);
+}
+
+ANEMONE_INLINE
+int anemone_memcmp_fixed16 (const void *as, const void *bs)
+{
+    const uint8_t *a = as;
+    const uint8_t *b = bs;
+    uint32_t mismatch = anemone_memcmp_mismatch128 (a, b);
+    if (mismatch == 0) return 0;
+    uint32_t i = __builtin_ctz (mismatch);
+    return (int) a[i] - (int) b[i];
+}
+
+ANEMONE_INLINE
+int anemone_memcmp_fixed32 (const void *as, const void *bs)
+{
+    const uint8_t *a = as;
+    const uint8_t *b = bs;
+    uint32_t mismatch = anemone_memcmp_mismatch128 (a, b)
+                      | anemone_memcmp_mismatch128 (a + 16, b + 16) << 16;
+    if (mismatch == 0) return 0;
+    uint32_t i = __builtin_ctz (mismatch);
+    return (int) a[i] - (int) b[i];
+}
+
 ANEMONE_INLINE
 int anemone_memcmp (const void *as, const void *bs, size_t len)
 {
-    return anemone_memcmp64(as, bs, len);
+    return anemone_memcmp128 (as, bs, len);
 }
 
 
@@ -66,6 +66,8 @@ int anemone_memcmp_partial_load64 (const void *as, const void *bs, size_t len)
 }
 
 
+/* needs SSE4.2, see anemone_sse.h */
+ANEMONE_SSE42
 ANEMONE_INLINE
 int anemone_memcmp128_unsafe (const void *buf1, const void *buf2, size_t len)
 {
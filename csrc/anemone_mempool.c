@@ -1,45 +1,243 @@
+// Needed for MAP_ANONYMOUS, MAP_HUGETLB and MADV_HUGEPAGE
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "anemone_mempool.h"
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+// The huge page size assumed for MAP_HUGETLB, which is the default on x86-64
+#define ANEMONE_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// The maximum number of free standard size blocks kept in the process-wide cache
+#define ANEMONE_BLOCK_CACHE_MAX 64
+
+// Process-wide cache of free standard size blocks, linked through prev.
+// Blocks are only ever touched by one thread at a time, so a simple spin lock is enough.
+static struct {
+  char             lock;
+  int64_t          count;
+  anemone_block_t *blocks;
+} anemone_block_cache;
+
+ANEMONE_STATIC
+void anemone_block_cache_lock ()
+{
+  while (__atomic_test_and_set (&anemone_block_cache.lock, __ATOMIC_ACQUIRE)) {
+  }
+}
+
+ANEMONE_STATIC
+void anemone_block_cache_unlock ()
+{
+  __atomic_clear (&anemone_block_cache.lock, __ATOMIC_RELEASE);
+}
+
+// Take a standard size block from the cache, or return null if it is empty
+ANEMONE_STATIC
+anemone_block_t * anemone_block_cache_take ()
+{
+  // Avoid taking the lock for an empty cache
+  if (__atomic_load_n (&anemone_block_cache.blocks, __ATOMIC_RELAXED) == NULL) return NULL;
+
+  anemone_block_cache_lock ();
+  anemone_block_t *block = anemone_block_cache.blocks;
+  if (block != NULL) {
+    // stored atomically as the empty check above reads it without the lock
+    __atomic_store_n (&anemone_block_cache.blocks, block->prev, __ATOMIC_RELAXED);
+    anemone_block_cache.count--;
+  }
+  anemone_block_cache_unlock ();
+
+  return block;
+}
+
+// Give a standard size block to the cache, returns false if the cache is full
+ANEMONE_STATIC
+bool_t anemone_block_cache_give (anemone_block_t *block)
+{
+  bool_t kept = ANEMONE_FALSE;
+
+  anemone_block_cache_lock ();
+  if (anemone_block_cache.count < ANEMONE_BLOCK_CACHE_MAX) {
+    block->prev = anemone_block_cache.blocks;
+    __atomic_store_n (&anemone_block_cache.blocks, block, __ATOMIC_RELAXED);
+    anemone_block_cache.count++;
+    kept = ANEMONE_TRUE;
+  }
+  anemone_block_cache_unlock ();
+
+  return kept;
+}
+
+ANEMONE_STATIC
+size_t anemone_round_up_to (size_t num_bytes, size_t multiple)
+{
+  return ((num_bytes + multiple - 1) / multiple) * multiple;
+}
+
+// Map some anonymous memory, returns null on failure
+ANEMONE_STATIC
+void * anemone_block_map (size_t footprint, int flags)
+{
+  void *mem = mmap (NULL, footprint, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+  return mem == MAP_FAILED ? NULL : mem;
+}
 
-// Allocate a new block with given predecessor
+// Allocate a new block with given predecessor and at least num_bytes of payload.
+// When the backing is not available we fall back to the next best one, ending with malloc.
 ANEMONE_STATIC
-anemone_block_t * anemone_block_create (anemone_block_t *prev, size_t num_bytes)
+anemone_block_t * anemone_block_create (anemone_block_t *prev, size_t num_bytes, anemone_mempool_backing_t backing)
 {
-  void     *ptr = malloc(num_bytes);
-  anemone_block_t  src = { ptr, prev };
+  size_t footprint = sizeof (anemone_block_t) + num_bytes;
+  void  *mem       = NULL;
 
-  anemone_block_t *dst = malloc (sizeof (anemone_block_t));
-  memcpy (dst, &src, sizeof (anemone_block_t));
+  switch (backing) {
+    case ANEMONE_BACKING_MMAP_HUGETLB:
+#if defined(MAP_HUGETLB)
+      footprint = anemone_round_up_to (sizeof (anemone_block_t) + num_bytes, ANEMONE_HUGE_PAGE_SIZE);
+      mem = anemone_block_map (footprint, MAP_HUGETLB);
+      if (mem != NULL) break;
+#endif
+      backing = ANEMONE_BACKING_MMAP_THP;
+      // fall through
+    case ANEMONE_BACKING_MMAP_THP:
+    case ANEMONE_BACKING_MMAP:
+      footprint = anemone_round_up_to (sizeof (anemone_block_t) + num_bytes, sysconf (_SC_PAGESIZE));
+      mem = anemone_block_map (footprint, 0);
+#if defined(MADV_HUGEPAGE)
+      // This is only advice, so failure is fine
+      if (mem != NULL && backing == ANEMONE_BACKING_MMAP_THP) madvise (mem, footprint, MADV_HUGEPAGE);
+#endif
+      if (mem != NULL) break;
+      backing = ANEMONE_BACKING_MALLOC;
+      // fall through
+    default:
+      footprint = sizeof (anemone_block_t) + num_bytes;
+      mem = malloc (footprint);
+      break;
+  }
+
+  // Any extra space from rounding up to pages is usable payload
+  anemone_block_t *block = mem;
+  block->prev      = prev;
+  block->size      = footprint - sizeof (anemone_block_t);
+  block->footprint = footprint;
+  block->backing   = backing;
+
+  ANEMONE_MEMPOOL_WHEN_DEBUG(fprintf (stderr, "anemone_block_create: %p\n", anemone_block_ptr (block)));
+
+  return block;
+}
+
+// Return a block's memory to where it came from
+ANEMONE_STATIC
+void anemone_block_destroy (anemone_block_t *block)
+{
+  ANEMONE_MEMPOOL_WHEN_DEBUG(fprintf (stderr, "anemone_block_free: %p\n", anemone_block_ptr (block)));
 
-  ANEMONE_MEMPOOL_WHEN_DEBUG(fprintf (stderr, "anemone_block_create: %p\n", dst->ptr));
+  if (block->backing == ANEMONE_BACKING_MALLOC) {
+    free (block);
+  } else {
+    munmap (block, block->footprint);
+  }
+}
+
+// Is this a default block, which can be shared through the cache
+ANEMONE_STATIC
+bool_t anemone_block_is_default (anemone_block_t *block)
+{
+  return block->backing == ANEMONE_BACKING_MALLOC && block->size == anemone_block_size;
+}
+
+// Release a block, default blocks go to the cache if there is room
+ANEMONE_STATIC
+void anemone_block_release (anemone_block_t *block)
+{
+  if (anemone_block_is_default (block) && anemone_block_cache_give (block)) return;
 
-  return dst;
+  anemone_block_destroy (block);
 }
 
 // Free a block and all its predecessors
 ANEMONE_STATIC
 void anemone_block_free (anemone_block_t *block)
 {
-  if (block == NULL) return;
+  while (block != NULL) {
+    anemone_block_t *prev = block->prev;
+    anemone_block_release (block);
+    block = prev;
+  }
+}
+
+ANEMONE_STATIC
+void anemone_mempool_update_high_water (anemone_mempool_t *pool)
+{
+  if ((uint64_t) pool->total_alloc_size > pool->stats.high_water) {
+    pool->stats.high_water = pool->total_alloc_size;
+  }
+}
+
+// Payload size of the pool's next standard block, following the growth policy
+ANEMONE_STATIC
+size_t anemone_mempool_next_block_size (anemone_mempool_t *pool)
+{
+  const anemone_mempool_config_t *config = &pool->config;
+
+  if (pool->last == NULL) return config->block_size;
+
+  size_t size = pool->last->size;
+  if (size >= config->max_block_size / config->growth_factor) return config->max_block_size;
+
+  // Blocks have rounded sizes, so this is only for safety, as for the configured sizes
+  return round_up_allocation (size * config->growth_factor);
+}
+
+// Get a standard block with given predecessor, reusing a spare or cached block if there is one
+ANEMONE_STATIC
+anemone_block_t * anemone_mempool_take_block (anemone_mempool_t *pool, anemone_block_t *prev, size_t num_bytes)
+{
+  anemone_block_t *block = pool->spare;
 
-  ANEMONE_MEMPOOL_WHEN_DEBUG(fprintf (stderr, "anemone_block_free: %p\n", block->ptr));
+  if (block != NULL && block->size >= num_bytes) {
+    pool->spare = block->prev;
+  } else if (num_bytes == anemone_block_size && pool->config.backing == ANEMONE_BACKING_MALLOC) {
+    block = anemone_block_cache_take ();
+  } else {
+    block = NULL;
+  }
 
-  free (block->ptr);
-  anemone_block_t *prev = block->prev;
-  free (block);
-  anemone_block_free (prev);
+  if (block == NULL) {
+    return anemone_block_create (prev, num_bytes, pool->config.backing);
+  }
+
+  block->prev = prev;
+  return block;
 }
 
 // Allocate a new block into a pool
 ANEMONE_STATIC
 void anemone_mempool_add_block (anemone_mempool_t *pool)
 {
-  anemone_block_t *next = anemone_block_create (pool->last, anemone_block_size);
+  anemone_block_t *next = anemone_mempool_take_block (pool, pool->last, anemone_mempool_next_block_size (pool));
+
+  if (pool->last != NULL) {
+    pool->stats.bytes_wasted += pool->maximum_ptr - pool->current_ptr;
+  }
 
-  pool->total_alloc_size += anemone_block_size;
+  pool->total_alloc_size += next->size;
   pool->last        = next;
-  pool->current_ptr = next->ptr;
-  pool->maximum_ptr = next->ptr + anemone_block_size;
+  pool->current_ptr = anemone_block_ptr (next);
+  pool->maximum_ptr = anemone_block_ptr (next) + next->size;
+
+  pool->stats.blocks++;
+  anemone_mempool_update_high_water (pool);
 
   ANEMONE_MEMPOOL_WHEN_DEBUG(fprintf (stderr, "anemone_mempool_add_block: total_alloc_size: %" PRId64 "\n", pool->total_alloc_size));
 }
@@ -50,7 +248,7 @@ void * anemone_mempool_alloc_block (anemone_mempool_t *pool, size_t num_bytes)
 {
   // Allocating into the current block failed, so we need a new block.
   // Will the requested amount fit in a single block?
-  if (num_bytes <= anemone_block_size) {
+  if (num_bytes <= anemone_mempool_next_block_size (pool)) {
 
 
     // If so, add a new block as usual, then set it as the current block
@@ -60,21 +258,19 @@ void * anemone_mempool_alloc_block (anemone_mempool_t *pool, size_t num_bytes)
     return NULL;
   } else {
     // The requested size is larger than a normal block.
-    // We will allocate a single block of the exact size and inject it before the current block.
+    // We will allocate a single block of the exact size and keep it in a separate list.
     // That way, any leftover parts in the current block can be used by the next allocation
-    anemone_block_t *last = pool->last;
+    anemone_block_t *inject = anemone_block_create (pool->large, num_bytes, pool->config.backing);
+    pool->total_alloc_size += inject->size;
+    pool->large = inject;
 
-    // anemone_mempool_t.last is always non-null, so dereference is safe
-    anemone_block_t *prev = last->prev;
-    // Create a new block that points to the previous block
-    anemone_block_t *inject = anemone_block_create (prev, num_bytes);
-    pool->total_alloc_size += num_bytes;
-    // and replace current previous with our new one
-    last->prev = inject;
+    pool->stats.large_blocks++;
+    pool->stats.large_bytes += inject->size;
+    anemone_mempool_update_high_water (pool);
 
     ANEMONE_MEMPOOL_WHEN_DEBUG(fprintf (stderr, "anemone_mempool_alloc_block: total_alloc_size: %" PRId64 "\n", pool->total_alloc_size));
 
-    return inject->ptr;
+    return anemone_block_ptr (inject);
   }
 }
 
@@ -92,11 +288,31 @@ void * hs_anemone_mempool_calloc (anemone_mempool_t *pool, size_t num_items, siz
 }
 
 
-// Create a new memory pool
-anemone_mempool_t * anemone_mempool_create ()
+// Fill in the default options
+void anemone_mempool_config_default (anemone_mempool_config_t *config)
+{
+  config->block_size     = anemone_block_size;
+  config->growth_factor  = 1;
+  config->max_block_size = anemone_block_size;
+  config->backing        = ANEMONE_BACKING_MALLOC;
+}
+
+// Create a new memory pool with the given options
+anemone_mempool_t * anemone_mempool_create_with (const anemone_mempool_config_t *config)
 {
   anemone_mempool_t *pool = calloc(1, sizeof(anemone_mempool_t));
   pool->total_alloc_size = 0;
+  pool->config = *config;
+
+  // Fix up options which would break the growth policy
+  if (pool->config.block_size == 0)                           pool->config.block_size     = anemone_block_size;
+  if (pool->config.growth_factor == 0)                        pool->config.growth_factor  = 1;
+  if (pool->config.max_block_size < pool->config.block_size)  pool->config.max_block_size = pool->config.block_size;
+
+  // Allocations are rounded up before they are fitted into a block, so the blocks must be too,
+  // otherwise an allocation which fits the requested block size may not fit the block
+  pool->config.block_size     = round_up_allocation (pool->config.block_size);
+  pool->config.max_block_size = round_up_allocation (pool->config.max_block_size);
 
   ANEMONE_MEMPOOL_WHEN_DEBUG(fprintf (stderr, "anemone_mempool_create: %p\n", pool));
 
@@ -105,6 +321,21 @@ anemone_mempool_t * anemone_mempool_create ()
   return pool;
 }
 
+// Create a new memory pool
+anemone_mempool_t * anemone_mempool_create ()
+{
+  anemone_mempool_config_t config;
+  anemone_mempool_config_default (&config);
+  return anemone_mempool_create_with (&config);
+}
+
+// External function for creating a pool from Haskell, without marshalling a struct.
+anemone_mempool_t * hs_anemone_mempool_create_with (size_t block_size, uint32_t growth_factor, size_t max_block_size, int backing)
+{
+  anemone_mempool_config_t config = { block_size, growth_factor, max_block_size, backing };
+  return anemone_mempool_create_with (&config);
+}
+
 
 #if ANEMONE_MEMPOOL_DEBUG
 // Debug function for printing out the different block sizes
@@ -114,7 +345,7 @@ void anemone_mempool_debug_block_usage (anemone_mempool_t *pool)
   uint64_t size = 0;
   uint64_t blocks = 0;
   while (block != NULL) {
-    size += anemone_block_size;
+    size += block->size;
     blocks++;
     block = block->prev;
   }
@@ -122,20 +353,169 @@ void anemone_mempool_debug_block_usage (anemone_mempool_t *pool)
 }
 #endif
 
+// Rewind to a mark after blocks have been added since it was taken.
+void anemone_mempool_rewind_blocks (anemone_mempool_t *pool, const anemone_mempool_mark_t *mark)
+{
+  // Standard size blocks which were added after the mark are kept as spares, so
+  // scratch allocation after a rewind reuses the same memory
+  anemone_block_t *block = pool->last;
+  while (block != mark->last) {
+    anemone_block_t *prev = block->prev;
+    block->prev = pool->spare;
+    pool->spare = block;
+    block = prev;
+  }
+
+  // Oversized blocks are freed
+  block = pool->large;
+  while (block != mark->large) {
+    anemone_block_t *prev = block->prev;
+    anemone_block_release (block);
+    block = prev;
+  }
+
+  pool->last             = mark->last;
+  pool->large            = mark->large;
+  pool->current_ptr      = mark->current_ptr;
+  pool->maximum_ptr      = mark->maximum_ptr;
+  pool->total_alloc_size = mark->total_alloc_size;
+
+  ANEMONE_MEMPOOL_WHEN_DEBUG(fprintf (stderr, "anemone_mempool_rewind_blocks: total_alloc_size: %" PRId64 "\n", pool->total_alloc_size));
+}
+
+// External functions for marking and rewinding from Haskell.
+void hs_anemone_mempool_mark (anemone_mempool_t *pool, anemone_mempool_mark_t *mark)
+{
+  anemone_mempool_mark (pool, mark);
+}
+
+void hs_anemone_mempool_rewind (anemone_mempool_t *pool, const anemone_mempool_mark_t *mark)
+{
+  anemone_mempool_rewind (pool, mark);
+}
+
+size_t hs_anemone_mempool_mark_size ()
+{
+  return sizeof (anemone_mempool_mark_t);
+}
+
+// Reset a single pool, not including its arenas
+ANEMONE_STATIC
+void anemone_mempool_reset_blocks (anemone_mempool_t *pool)
+{
+  // Anything still spare was not needed by the last batch
+  anemone_block_free (pool->spare);
+  pool->spare = NULL;
+
+  // Keep the standard blocks. Pushing from the last block backwards means
+  // the first block is on top, so the blocks are reused in the same order and sizes.
+  anemone_block_t *block = pool->last;
+  while (block != NULL) {
+    anemone_block_t *prev = block->prev;
+    block->prev = pool->spare;
+    pool->spare = block;
+    block = prev;
+  }
+
+  anemone_block_free (pool->large);
+  pool->large = NULL;
+
+  pool->last = NULL;
+  pool->total_alloc_size = 0;
+  anemone_mempool_add_block (pool);
+}
+
+// Reset a memory pool and its arenas
+void anemone_mempool_reset (anemone_mempool_t *pool)
+{
+  ANEMONE_MEMPOOL_WHEN_DEBUG(fprintf (stderr, "anemone_mempool_reset: %p\n", pool));
+
+  anemone_mempool_t *arena = __atomic_load_n (&pool->arenas, __ATOMIC_ACQUIRE);
+  while (arena != NULL) {
+    anemone_mempool_reset_blocks (arena);
+    arena = arena->next_arena;
+  }
+
+  anemone_mempool_reset_blocks (pool);
+}
+
+// Create a thread arena and link it in to the root's list of arenas
+anemone_mempool_t * anemone_mempool_arena_create (anemone_mempool_t *root)
+{
+  // Arenas of arenas belong to the original root
+  if (root->root) root = root->root;
+
+  anemone_mempool_t *arena = anemone_mempool_create_with (&root->config);
+  arena->root = root;
+
+  // Push on to the front of the list. Arenas are only removed when the root is freed,
+  // so there is no ABA problem here.
+  anemone_mempool_t *head = __atomic_load_n (&root->arenas, __ATOMIC_RELAXED);
+  do {
+    arena->next_arena = head;
+  } while (!__atomic_compare_exchange_n (&root->arenas, &head, arena, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+  ANEMONE_MEMPOOL_WHEN_DEBUG(fprintf (stderr, "anemone_mempool_arena_create: %p (root %p)\n", arena, root));
+
+  return arena;
+}
+
 // Free a memory pool and all its resources
 void anemone_mempool_free (anemone_mempool_t *pool)
 {
+  // Arenas are owned by their root
+  if (pool->root) return;
+
   ANEMONE_MEMPOOL_WHEN_DEBUG(fprintf (stderr, "anemone_mempool_free: %p\n", pool));
   ANEMONE_MEMPOOL_WHEN_DEBUG(anemone_mempool_debug_block_usage (pool));
 
+  anemone_mempool_t *arena = __atomic_load_n (&pool->arenas, __ATOMIC_ACQUIRE);
+  while (arena != NULL) {
+    anemone_mempool_t *next = arena->next_arena;
+    ANEMONE_MEMPOOL_WHEN_DEBUG(anemone_mempool_debug_block_usage (arena));
+    anemone_block_free (arena->last);
+    anemone_block_free (arena->large);
+    anemone_block_free (arena->spare);
+    free (arena);
+    arena = next;
+  }
+
   anemone_block_free (pool->last);
+  anemone_block_free (pool->large);
+  anemone_block_free (pool->spare);
   free(pool);
 }
 
 // Get the total alloc size - this is only necessary for calling from Haskell
 int64_t anemone_mempool_total_alloc_size (anemone_mempool_t *pool)
 {
-  return pool->total_alloc_size;
+  int64_t total = pool->total_alloc_size;
+
+  anemone_mempool_t *arena = __atomic_load_n (&pool->arenas, __ATOMIC_ACQUIRE);
+  while (arena != NULL) {
+    total += arena->total_alloc_size;
+    arena = arena->next_arena;
+  }
+
+  return total;
+}
+
+// Take a snapshot of a pool's counters, including its arenas
+void anemone_mempool_stats (anemone_mempool_t *pool, anemone_mempool_stats_t *stats)
+{
+  *stats = pool->stats;
+
+  anemone_mempool_t *arena = __atomic_load_n (&pool->arenas, __ATOMIC_ACQUIRE);
+  while (arena != NULL) {
+    stats->bytes_requested += arena->stats.bytes_requested;
+    stats->bytes_rounded   += arena->stats.bytes_rounded;
+    stats->bytes_wasted    += arena->stats.bytes_wasted;
+    stats->blocks          += arena->stats.blocks;
+    stats->large_blocks    += arena->stats.large_blocks;
+    stats->large_bytes     += arena->stats.large_bytes;
+    stats->high_water      += arena->stats.high_water;
+    arena = arena->next_arena;
+  }
 }
 
 // Return true if the pointer points to an aligned address.
@@ -1,3 +1,6 @@
+#ifndef __ANEMONE_MEMPOOL_H
+#define __ANEMONE_MEMPOOL_H
+
 #include "anemone_base.h"
 
 #include <string.h>
@@ -14,28 +17,104 @@
 // 16 byte alignment, but testing suggests 8 byte alignment is sufficient.
 #define ANEMONE_ALIGNMENT   8
 
+// The default payload size of a block
 static const size_t anemone_block_size = 1 * 1024 * 1024;
 
+// Where the memory for blocks comes from.
+// The mmap backings fall back to the next best option when the system refuses them.
+typedef enum {
+  // Plain malloc, the default
+  ANEMONE_BACKING_MALLOC            = 0,
+  // Anonymous mmap, returning memory straight to the OS when freed
+  ANEMONE_BACKING_MMAP              = 1,
+  // Anonymous mmap, asking for transparent huge pages with madvise(MADV_HUGEPAGE)
+  ANEMONE_BACKING_MMAP_THP          = 2,
+  // Anonymous mmap from the reserved huge page pool with MAP_HUGETLB, falling back to
+  // ANEMONE_BACKING_MMAP_THP when no huge pages are available
+  ANEMONE_BACKING_MMAP_HUGETLB      = 3,
+} anemone_mempool_backing_t;
+
+// Options for creating a memory pool, see anemone_mempool_config_default.
+typedef struct {
+  // Payload size of the first block.
+  // block_size > 0
+  size_t   block_size;
+  // Each new block is growth_factor times the size of the previous one, up to max_block_size.
+  // A growth_factor of 1 keeps every block the same size.
+  // growth_factor >= 1
+  uint32_t growth_factor;
+  // max_block_size >= block_size
+  size_t   max_block_size;
+  anemone_mempool_backing_t backing;
+} anemone_mempool_config_t;
+
+// Allocation counters for a pool, see anemone_mempool_stats.
+// These are cumulative over the life of the pool and are not affected by reset or rewind,
+// apart from high_water which tracks the largest total_alloc_size seen.
+typedef struct {
+  // Bytes asked for by anemone_mempool_alloc
+  uint64_t bytes_requested;
+  // Bytes asked for after rounding up for alignment
+  uint64_t bytes_rounded;
+  // Bytes left unused at the end of a block when the pool moved on to a new one
+  uint64_t bytes_wasted;
+  // Number of standard blocks the pool has started allocating from, including reused ones
+  uint64_t blocks;
+  // Number of blocks made for oversized allocations
+  uint64_t large_blocks;
+  // Total payload of the blocks made for oversized allocations
+  uint64_t large_bytes;
+  // The largest total_alloc_size the pool has reached
+  uint64_t high_water;
+} anemone_mempool_stats_t;
+
 // A single block containing some allocated data.
-// It keeps a link to the previous block so it can be freed.
+// The header sits at the start of the block and the payload follows it directly,
+// so a block is a single allocation. It keeps a link to the previous block so it can be freed.
 typedef struct anemone_block {
-  // Payload data
-  // ptr != 0
-  void * const ptr;
   // Previous block
   struct anemone_block * prev;
+  // Size of the payload
+  size_t size;
+  // Number of bytes taken from the backing, including this header
+  size_t footprint;
+  // The backing which the block was actually taken from
+  int64_t backing;
 } anemone_block_t;
 
+// Get the payload of a block.
+ANEMONE_INLINE
+void * anemone_block_ptr (anemone_block_t *block)
+{
+  return (void *) (block + 1);
+}
+
 // A memory pool which contains the current block, and how much of the block is used
 // We store usage information here because it is only relevant for the current block.
-typedef struct {
+typedef struct anemone_mempool {
   // last != 0
   anemone_block_t *last;
   int64_t   total_alloc_size;
-  // last->ptr <= current_ptr < maximum_ptr */
+  // anemone_block_ptr(last) <= current_ptr < maximum_ptr */
   void     *current_ptr;
-  // maxmimum_ptr - last->ptr >= anemone_block_size
+  // maxmimum_ptr - anemone_block_ptr(last) == last->size
   void     *maximum_ptr;
+  // Blocks made for oversized allocations, newest first
+  anemone_block_t *large;
+  // Standard size blocks kept by anemone_mempool_reset, to be used before allocating new ones
+  anemone_block_t *spare;
+  // The pool that owns this one, if this pool is a thread arena, otherwise null.
+  // root->root == 0
+  struct anemone_mempool *root;
+  // Lock-free list of the thread arenas created from this pool.
+  // Only a root pool has arenas, and they are never removed until the root is freed.
+  struct anemone_mempool *arenas;
+  // Next arena in the root's list
+  struct anemone_mempool *next_arena;
+  // Block options, shared with the pool's arenas
+  anemone_mempool_config_t config;
+  // Counters for this pool only, use anemone_mempool_stats to include arenas
+  anemone_mempool_stats_t stats;
 } anemone_mempool_t;
 
 
@@ -63,12 +142,46 @@ size_t round_up_allocation (size_t num_bytes)
     return ptr;                                                                                        \
   }
 
-// Create a new memory pool
+// Create a new memory pool with the default options
 anemone_mempool_t * anemone_mempool_create ();
 
-// Free the memory pool and all memory that was allocated from it
+// Fill in the default options: fixed size 1MB blocks taken from malloc.
+void anemone_mempool_config_default (anemone_mempool_config_t *config);
+
+// Create a new memory pool with the given options.
+//
+// Large pools should use a bigger or growing block size, as every block costs a trip to the
+// allocator and its own pages. With a huge page backing, block sizes which are a multiple of
+// the huge page size (usually 2MB) avoid wasting the end of the last page.
+anemone_mempool_t * anemone_mempool_create_with (const anemone_mempool_config_t *config);
+
+// Free the memory pool and all memory that was allocated from it.
+// Freeing a root pool also frees all of its thread arenas, and freeing an arena does nothing.
 void anemone_mempool_free (anemone_mempool_t *pool);
 
+// Reset the memory pool, so that all memory it has allocated can be reused.
+// Every pointer allocated from the pool is invalidated.
+//
+// The standard size blocks used since the previous reset are kept by the pool and
+// reused, in order, before any new blocks are taken. Blocks which were not needed are
+// returned to a process-wide cache, and blocks made for oversized allocations are freed,
+// so the memory kept by a pool follows the size of its most recent batch.
+//
+// Resetting a root pool also resets all of its thread arenas, which must not be in use.
+void anemone_mempool_reset (anemone_mempool_t *pool);
+
+// Create a thread arena which allocates on behalf of a shared root pool.
+// The arena uses the same options as the root.
+//
+// An arena is an ordinary pool with its own blocks, so allocation from it has the same
+// bump-pointer fast path, and like any pool it must only be used by one thread at a time.
+// Any number of threads can create arenas from the same root concurrently.
+//
+// Everything allocated from an arena lives until the root is freed, so pointers can be
+// handed between threads freely. The root itself is still single-threaded: only its owner
+// may allocate from it directly.
+anemone_mempool_t * anemone_mempool_arena_create (anemone_mempool_t *root);
+
 // Allocate data using a new block. This is for internal use only, but must be exposed for inlining.
 void * anemone_mempool_alloc_block (anemone_mempool_t *pool, size_t num_bytes);
 
@@ -76,6 +189,9 @@ void * anemone_mempool_alloc_block (anemone_mempool_t *pool, size_t num_bytes);
 ANEMONE_INLINE
 void * anemone_mempool_alloc (anemone_mempool_t *pool, size_t num_bytes)
 {
+    pool->stats.bytes_requested += num_bytes;
+    pool->stats.bytes_rounded   += round_up_allocation (num_bytes);
+
     ANEMONE_MEMPOOL_TRY_ALLOC(anemone_mempool_alloc);
 
     return anemone_mempool_alloc_block (pool, num_bytes);
@@ -91,8 +207,57 @@ void * anemone_mempool_calloc (anemone_mempool_t *pool, size_t num_items, size_t
     return ret;
 }
 
+// A checkpoint in a memory pool, see anemone_mempool_mark.
+typedef struct {
+  anemone_block_t *last;
+  anemone_block_t *large;
+  void            *current_ptr;
+  void            *maximum_ptr;
+  int64_t          total_alloc_size;
+} anemone_mempool_mark_t;
+
+// Save the current position of the pool, so that anything allocated afterwards can be
+// released with anemone_mempool_rewind. This is useful for scratch space which is only
+// needed while processing a single record.
+ANEMONE_INLINE
+void anemone_mempool_mark (anemone_mempool_t *pool, anemone_mempool_mark_t *mark)
+{
+    mark->last             = pool->last;
+    mark->large            = pool->large;
+    mark->current_ptr      = pool->current_ptr;
+    mark->maximum_ptr      = pool->maximum_ptr;
+    mark->total_alloc_size = pool->total_alloc_size;
+}
+
+// Rewind after blocks were added since the mark. This is for internal use only, but must be exposed for inlining.
+void anemone_mempool_rewind_blocks (anemone_mempool_t *pool, const anemone_mempool_mark_t *mark);
+
+// Release everything allocated since the mark was taken, invalidating those pointers.
+// Standard size blocks added since the mark are kept and reused by later allocations,
+// and oversized blocks are freed. A mark can be rewound to any number of times, but
+// not after rewinding to an earlier mark, or after the pool has been reset.
+ANEMONE_INLINE
+void anemone_mempool_rewind (anemone_mempool_t *pool, const anemone_mempool_mark_t *mark)
+{
+    if (ANEMONE_LIKELY(pool->last == mark->last && pool->large == mark->large)) {
+        pool->current_ptr      = mark->current_ptr;
+        pool->total_alloc_size = mark->total_alloc_size;
+    } else {
+        anemone_mempool_rewind_blocks (pool, mark);
+    }
+}
+
 // Get the total alloc size - this is only necessary for calling from Haskell
+// For a root pool this includes its thread arenas, so it is only accurate when no arenas are allocating.
 int64_t anemone_mempool_total_alloc_size (anemone_mempool_t *pool);
 
+// Take a snapshot of a pool's counters.
+// For a root pool the counters of its thread arenas are added in, so like
+// anemone_mempool_total_alloc_size it is only exact when no arenas are allocating,
+// and the high water mark is the sum of each pool's high water mark.
+void anemone_mempool_stats (anemone_mempool_t *pool, anemone_mempool_stats_t *stats);
+
 // Return true if the pointer points to an aligned address.
 bool_t anemone_is_pointer_aligned (const void *ptr);
+
+#endif//__ANEMONE_MEMPOOL_H
@@ -3,9 +3,63 @@
 
 #include "anemone_base.h"
 
+/* instruction sets which the unpack kernels are specialised for, in order of preference. */
+#define ANEMONE_PACK_SCALAR 0
+#define ANEMONE_PACK_AVX2   1
+#define ANEMONE_PACK_AVX512 2
+
+/* block codecs for anemone_encode64_64, each block has a header with its bits per value and its base. */
+/* raw: values are packed as they are, and the base is zero */
+#define ANEMONE_CODEC_RAW    0
+/* frame of reference: the base is the minimum, and offsets from it are packed */
+#define ANEMONE_CODEC_FOR    1
+/* delta: the base is the first value, and differences from the previous value are packed, for sorted values */
+#define ANEMONE_CODEC_DELTA  2
+/* zigzag: values are signed, and packed so that small magnitudes take few bits */
+#define ANEMONE_CODEC_ZIGZAG 3
+
+/* a block header is one byte for the bits per value followed by the 64-bit base. */
+#define ANEMONE_CODEC_HEADER_SIZE 9
+
+uint64_t anemone_pack_isa ();
+
+uint64_t anemone_bitsof (uint64_t value);
+
 error_t anemone_pack64_64 (uint64_t blocks, const uint64_t bits, const uint64_t *in, uint8_t *out);
 
 error_t anemone_unpack64_64 (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t *out);
 
+error_t anemone_unpack64_64_isa (uint64_t isa, uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t *out);
+
+error_t anemone_pack32_64 (uint64_t blocks, const uint64_t bits, const uint32_t *in, uint8_t *out);
+
+error_t anemone_unpack32_64 (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint32_t *out);
+
+error_t anemone_pack64_128 (uint64_t blocks, const uint64_t bits, const uint64_t *in, uint8_t *out);
+
+error_t anemone_unpack64_128 (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t *out);
+
+error_t anemone_unpack64_128_isa (uint64_t isa, uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t *out);
+
+uint64_t anemone_pack_get (uint64_t bits, const uint8_t *in, uint64_t index);
+
+error_t anemone_pack_gather (uint64_t bits, const uint8_t *in, uint64_t count, const uint64_t *indices, uint64_t *out);
+
+error_t anemone_pack_aggregate (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t *sum, uint64_t *min, uint64_t *max);
+
+error_t anemone_pack_between (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t lo, uint64_t hi, uint64_t *out);
+
+error_t anemone_pack_eq (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t value, uint64_t *out);
+
+error_t anemone_pack_lt (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t value, uint64_t *out);
+
+uint64_t anemone_encode64_64_bound (uint64_t blocks);
+
+error_t anemone_encode64_64 (uint64_t codec, uint64_t blocks, const uint64_t *in, uint8_t *out, uint64_t *out_size);
+
+error_t anemone_decode64_64 (uint64_t codec, uint64_t blocks, const uint8_t *in, uint64_t in_size, uint64_t *out);
+
+error_t anemone_decode64_64_isa (uint64_t isa, uint64_t codec, uint64_t blocks, const uint8_t *in, uint64_t in_size, uint64_t *out);
+
 #endif//__ANEMONE_PACK_H
 
@@ -0,0 +1,41 @@
+#ifndef __ANEMONE_RYU_H
+#define __ANEMONE_RYU_H
+
+#include "anemone_base.h"
+
+//
+// Writes the shortest decimal which reads back as exactly x, choosing the
+// closest when there is more than one, with the same layout and contract as
+// anemone_grisu2: the output is null terminated, needs at most 32 bytes, and
+// the length without the null is returned.
+//
+// Numbers from 10^-6 up to 10^21 are written without an exponent, "1.0",
+// "0.001", "123.45", others with one digit before the point, "1.5e-7",
+// "2e22". Zero of either sign is "0.0", and the rest are "nan", "inf" and
+// "-inf".
+//
+size_t anemone_ryu (double x, char *output_ptr);
+
+// The largest precision anemone_fixed handles without calling snprintf.
+#define ANEMONE_FIXED_EXACT_PRECISION 19
+
+// The most bytes anemone_fixed writes for a precision, including the null:
+// a sign, 309 digits, the point and the fractional digits.
+#define ANEMONE_FIXED_SIZE(precision) (312 + (precision))
+
+//
+// Writes x with exactly 'precision' digits after the point, the same as
+// printf's "%.*f": the exact value is rounded half to even, and there is no
+// point when the precision is 0. A negative precision is treated as 0.
+//
+// The output is null terminated, and the length without the null is
+// returned. The buffer needs ANEMONE_FIXED_SIZE(precision) bytes, although
+// numbers below 2^64 never need more than 42 + precision.
+//
+// Numbers of 2^64 and over, or precisions over ANEMONE_FIXED_EXACT_PRECISION,
+// are given to snprintf, which assumes the "C" locale for LC_NUMERIC. Unlike
+// printf, NaN is always "nan".
+//
+size_t anemone_fixed (double x, int precision, char *output_ptr);
+
+#endif//__ANEMONE_RYU_H
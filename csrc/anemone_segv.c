@@ -1,12 +1,20 @@
 #define _GNU_SOURCE 1
 
+#include "anemone_segv.h"
+
 #include <sys/types.h>
+#include <dlfcn.h>
+#include <errno.h>
 #include <execinfo.h>
 #include <signal.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/param.h>
+#include <sys/time.h>
+#include <sched.h>
+#include <ucontext.h>
 #include <unistd.h>
 
 /* this global is pretty nasty, don't know how else we can get
@@ -53,3 +61,279 @@ void anemone_segv_install_handler (const char *user_data, size_t user_data_size)
 
     sigaction (SIGSEGV, &act, 0);
 }
+
+
+//
+// Sampling profiler
+//
+// The ring is a bounded queue in the style of Dmitry Vyukov's, where each
+// slot has a sequence number saying whether it is free for the writer at a
+// given position or full for the reader at that position. A writer claims a
+// position with a compare and swap on the head, and only publishes the
+// sample with a release store of the sequence after it has been written, so
+// the reader never sees a part written sample.
+//
+// The timer can go off on any thread, so a handler may still be running
+// after the profiler has been stopped. Each handler is counted in before it
+// looks at the ring, and stopping waits for the count to drop to zero, so
+// the ring is never freed while a handler is writing to it.
+//
+
+typedef struct {
+    uint64_t sequence;
+    anemone_prof_sample_t sample;
+} prof_slot_t;
+
+typedef struct {
+    prof_slot_t *slots;
+    uint64_t mask;
+    uint64_t head;
+    uint64_t tail;
+    uint64_t dropped;
+    int depth;
+    /* is the handler allowed to write */
+    int active;
+    /* number of handlers running, on any thread */
+    int in_flight;
+    char *user_data;
+} prof_ring_t;
+
+static prof_ring_t prof_ring;
+static struct sigaction prof_old_action;
+
+/* Write one sample for the interrupted context, or count it as dropped if the
+ * ring is full */
+static void anemone_prof_record (prof_ring_t *ring, void *context)
+{
+    uint64_t pos = __atomic_load_n (&ring->head, __ATOMIC_RELAXED);
+    prof_slot_t *slot;
+
+    for (;;) {
+        slot = &ring->slots[pos & ring->mask];
+        uint64_t sequence = __atomic_load_n (&slot->sequence, __ATOMIC_ACQUIRE);
+
+        if (sequence == pos) {
+            if (__atomic_compare_exchange_n (&ring->head, &pos, pos + 1, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+        } else if (sequence < pos) {
+            /* the reader has not got to it yet, so the ring is full */
+            __atomic_fetch_add (&ring->dropped, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            pos = __atomic_load_n (&ring->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    anemone_prof_sample_t *sample = &slot->sample;
+    void *pc = (void *) ((ucontext_t *) context)->uc_mcontext.gregs[REG_RIP];
+
+    sample->frames[0] = pc;
+    sample->depth = 1;
+
+    if (ring->depth > 1) {
+        /* the handler and the signal trampoline are at the top of the stack,
+         * so the interrupted frame is found by its program counter */
+        void *frames[ANEMONE_PROF_MAX_DEPTH + 4];
+        int n_frames = backtrace (frames, ring->depth + 4);
+
+        for (int i = 0; i < n_frames; i++) {
+            if (frames[i] == pc) {
+                int depth = MIN (n_frames - i, ring->depth);
+                memcpy (sample->frames, frames + i, depth * sizeof (void *));
+                sample->depth = depth;
+                break;
+            }
+        }
+    }
+
+    __atomic_store_n (&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+}
+
+/* Only uses async-signal-safe functions, and backtrace, which is safe once
+ * it has been called outside the handler to load libgcc */
+static void anemone_prof_handler (int sig, siginfo_t *info, void *context)
+{
+    (void) sig;
+    (void) info;
+
+    prof_ring_t *ring = &prof_ring;
+
+    /* counted in before looking at 'active', and both are sequentially
+     * consistent, so either anemone_prof_stop waits for this handler or this
+     * handler sees that it has stopped */
+    __atomic_fetch_add (&ring->in_flight, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n (&ring->active, __ATOMIC_SEQ_CST)) {
+        /* signal handlers must leave errno as they found it */
+        int saved_errno = errno;
+        anemone_prof_record (ring, context);
+        errno = saved_errno;
+    }
+
+    __atomic_fetch_sub (&ring->in_flight, 1, __ATOMIC_RELEASE);
+}
+
+error_t anemone_prof_start (int hz, int depth, size_t capacity, const char *user_data, size_t user_data_size)
+{
+    prof_ring_t *ring = &prof_ring;
+
+    if (ring->active || hz <= 0 || hz > 1000000 || depth < 1 || depth > ANEMONE_PROF_MAX_DEPTH || capacity == 0) {
+        return 1;
+    }
+
+    /* round up to a power of two, so positions can be masked, and at least two,
+     * as with one slot a full slot looks the same as an empty one */
+    uint64_t size = 2;
+    while (size < capacity) size *= 2;
+
+    prof_slot_t *slots = malloc (size * sizeof (prof_slot_t));
+    char *data = malloc (user_data_size + 1);
+
+    if (slots == NULL || data == NULL) {
+        free (slots);
+        free (data);
+        return 1;
+    }
+
+    for (uint64_t i = 0; i != size; ++i) {
+        slots[i].sequence = i;
+    }
+    memcpy (data, user_data, user_data_size);
+    data[user_data_size] = '\0';
+
+    /* the samples from the last run are thrown away, no handler can be using
+     * them as anemone_prof_stop waited for the last one */
+    free (ring->slots);
+    free (ring->user_data);
+
+    ring->slots = slots;
+    ring->mask = size - 1;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->dropped = 0;
+    ring->depth = depth;
+    ring->user_data = data;
+
+    /* load the unwinder now, as it allocates the first time */
+    void *frames[1];
+    backtrace (frames, 1);
+
+    struct sigaction act;
+
+    sigemptyset (&act.sa_mask);
+    act.sa_flags     = SA_SIGINFO | SA_RESTART;
+    act.sa_sigaction = anemone_prof_handler;
+
+    if (sigaction (SIGPROF, &act, &prof_old_action)) {
+        return 1;
+    }
+
+    __atomic_store_n (&ring->active, 1, __ATOMIC_RELEASE);
+
+    /* tv_usec must be less than a second, so 1Hz is a whole second */
+    const long period = 1000000 / hz;
+
+    struct itimerval timer;
+    timer.it_interval.tv_sec  = period / 1000000;
+    timer.it_interval.tv_usec = period % 1000000;
+    timer.it_value = timer.it_interval;
+
+    if (setitimer (ITIMER_PROF, &timer, 0)) {
+        anemone_prof_stop ();
+        return 1;
+    }
+
+    return 0;
+}
+
+void anemone_prof_stop ()
+{
+    struct itimerval timer;
+    memset (&timer, 0, sizeof (timer));
+    setitimer (ITIMER_PROF, &timer, 0);
+
+    __atomic_store_n (&prof_ring.active, 0, __ATOMIC_SEQ_CST);
+
+    /* a SIGPROF from just before the timer was disarmed may still be pending
+     * on another thread, and the default action kills the process, so it is
+     * ignored, which also throws away any which are pending */
+    struct sigaction ignore;
+
+    sigemptyset (&ignore.sa_mask);
+    ignore.sa_flags   = 0;
+    ignore.sa_handler = SIG_IGN;
+
+    sigaction (SIGPROF, &ignore, 0);
+
+    /* a handler which got in before 'active' was cleared may still be
+     * writing a sample on another thread */
+    while (__atomic_load_n (&prof_ring.in_flight, __ATOMIC_ACQUIRE)) {
+        sched_yield ();
+    }
+
+    sigaction (SIGPROF, &prof_old_action, 0);
+}
+
+int64_t anemone_prof_drain (anemone_prof_sample_t *out, int64_t max)
+{
+    prof_ring_t *ring = &prof_ring;
+    if (ring->slots == NULL) return 0;
+
+    int64_t n = 0;
+    uint64_t pos = ring->tail;
+
+    while (n < max) {
+        prof_slot_t *slot = &ring->slots[pos & ring->mask];
+        uint64_t sequence = __atomic_load_n (&slot->sequence, __ATOMIC_ACQUIRE);
+
+        /* not written yet */
+        if (sequence != pos + 1) break;
+
+        out[n++] = slot->sample;
+        __atomic_store_n (&slot->sequence, pos + ring->mask + 1, __ATOMIC_RELEASE);
+        pos++;
+    }
+
+    ring->tail = pos;
+
+    return n;
+}
+
+uint64_t anemone_prof_dropped ()
+{
+    return __atomic_load_n (&prof_ring.dropped, __ATOMIC_RELAXED);
+}
+
+const char * anemone_prof_user_data ()
+{
+    return prof_ring.user_data ? prof_ring.user_data : "";
+}
+
+int anemone_prof_symbol (void *pc, char *out, size_t size)
+{
+    Dl_info info;
+
+    if (!dladdr (pc, &info) || info.dli_fname == NULL) {
+        return snprintf (out, size, "%p", pc);
+    }
+
+    if (info.dli_sname == NULL) {
+        return snprintf (out, size, "%s(+%#lx)", info.dli_fname, (unsigned long) ((char *) pc - (char *) info.dli_fbase));
+    }
+
+    return snprintf (out, size, "%s(%s+%#lx)", info.dli_fname, info.dli_sname, (unsigned long) ((char *) pc - (char *) info.dli_saddr));
+}
+
+size_t hs_anemone_prof_sample_size ()
+{
+    return sizeof (anemone_prof_sample_t);
+}
+
+size_t hs_anemone_prof_sample_frames_offset ()
+{
+    return offsetof (anemone_prof_sample_t, frames);
+}
+
+int hs_anemone_prof_max_depth ()
+{
+    return ANEMONE_PROF_MAX_DEPTH;
+}
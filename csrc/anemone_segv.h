@@ -1,10 +1,74 @@
 #ifndef __ANEMONE_SEGV_H
 #define __ANEMONE_SEGV_H
 
-#include <stdlib.h>
+#include "anemone_base.h"
 
 void anemone_segv_remove_handler ();
 
 void anemone_segv_install_handler (const char *user_data, size_t user_data_size);
 
+//
+// Sampling profiler.
+//
+// While it is running, a SIGPROF timer interrupts whichever thread is using
+// CPU time, and the handler writes the interrupted program counter, and
+// optionally a short stack, in to a ring buffer which was allocated up front.
+// Generated code loaded with dlopen is sampled like any other, which GHC's
+// profiler can not see.
+//
+// The ring can be written by several handlers at once, on different threads,
+// and drained at the same time. It is lock-free, so the handler never waits,
+// and when it is full new samples are dropped and counted.
+//
+
+// Most frames kept per sample.
+#define ANEMONE_PROF_MAX_DEPTH 16
+
+typedef struct {
+  // Number of frames, the first is the interrupted program counter
+  int32_t depth;
+  void *frames[ANEMONE_PROF_MAX_DEPTH];
+} anemone_prof_sample_t;
+
+//
+// Start sampling 'hz' times per second of CPU time, keeping up to 'depth'
+// frames per sample, and up to 'capacity' samples before they are drained,
+// rounded up to a power of two.
+// Only the program counter is taken when 'depth' is 1, which is the cheapest.
+//
+// The user data is kept with the samples, as it is for
+// anemone_segv_install_handler, to say what was being run.
+//
+// Returns 0 on success, or 1 if the profiler is already running, the
+// arguments are out of range, memory could not be allocated or the timer
+// could not be set.
+//
+error_t anemone_prof_start (int hz, int depth, size_t capacity, const char *user_data, size_t user_data_size);
+
+// Stop the timer, and wait for any handler which is still writing a sample on
+// another thread. Samples which have not been drained can still be drained.
+void anemone_prof_stop ();
+
+// Move up to 'max' samples out of the ring, oldest first, returning how many.
+int64_t anemone_prof_drain (anemone_prof_sample_t *out, int64_t max);
+
+// Number of samples dropped because the ring was full, since it was started.
+uint64_t anemone_prof_dropped ();
+
+// The user data given to anemone_prof_start, or an empty string.
+const char * anemone_prof_user_data ();
+
+//
+// Describe a program counter as "object(symbol+0xoffset)", truncated to fit
+// in 'size' bytes including the terminating null. Uses dladdr, so only
+// exported symbols have names, but the object always says which library the
+// code is in. Returns the length it wanted to write, as snprintf does.
+//
+int anemone_prof_symbol (void *pc, char *out, size_t size);
+
+// The layout of anemone_prof_sample_t, for reading samples from Haskell.
+size_t hs_anemone_prof_sample_size ();
+size_t hs_anemone_prof_sample_frames_offset ();
+int hs_anemone_prof_max_depth ();
+
 #endif//__ANEMONE_SEGV_H
@@ -0,0 +1,319 @@
+#define _GNU_SOURCE 1
+
+#include "anemone_sort.h"
+#include "anemone_memcmp.h"
+#include "anemone_thread.h"
+
+#include <string.h>
+
+// Keys are loaded by the parallel sort this many at a time
+#define ANEMONE_SORT_CHUNK 4096
+
+//
+// Compare two keys with equal prefixes.
+//
+// When either key is 8 bytes or shorter, the prefixes being equal means the
+// first min (a->len, b->len) bytes are, and the zero padding is the same, so
+// only the lengths are left to compare.
+//
+ANEMONE_STATIC
+ANEMONE_INLINE
+int sort_compare_tail (const anemone_sort_key_t *a, const anemone_sort_key_t *b)
+{
+    if (a->len > 8 && b->len > 8) {
+        const size_t len = a->len < b->len ? a->len : b->len;
+        const int cmp = anemone_memcmp (a->ptr + 8, b->ptr + 8, len - 8);
+        if (cmp) return cmp;
+    }
+
+    if (a->len != b->len) {
+        return a->len < b->len ? -1 : 1;
+    }
+
+    return a->index < b->index ? -1 : a->index > b->index;
+}
+
+ANEMONE_STATIC
+ANEMONE_INLINE
+bool_t sort_less (const anemone_sort_key_t *a, const anemone_sort_key_t *b)
+{
+    if (a->prefix != b->prefix) {
+        return a->prefix < b->prefix;
+    }
+    return sort_compare_tail (a, b) < 0;
+}
+
+ANEMONE_STATIC
+void sort_insertion (anemone_sort_key_t *keys, int64_t n)
+{
+    for (int64_t i = 1; i < n; i++) {
+        const anemone_sort_key_t key = keys[i];
+        int64_t j = i;
+        while (j > 0 && sort_less (&key, &keys[j - 1])) {
+            keys[j] = keys[j - 1];
+            j--;
+        }
+        keys[j] = key;
+    }
+}
+
+// Merge sort keys which all have the same prefix, when the radix sort has run
+// out of prefix bytes to split them on.
+ANEMONE_STATIC
+void sort_merge (anemone_sort_key_t *keys, anemone_sort_key_t *tmp, int64_t n)
+{
+    if (n <= ANEMONE_SORT_INSERTION) {
+        sort_insertion (keys, n);
+        return;
+    }
+
+    const int64_t mid = n / 2;
+    sort_merge (keys, tmp, mid);
+    sort_merge (keys + mid, tmp + mid, n - mid);
+
+    // already in order, as with many runs of duplicates
+    if (sort_compare_tail (&keys[mid - 1], &keys[mid]) <= 0) {
+        return;
+    }
+
+    int64_t i = 0;
+    int64_t j = mid;
+    int64_t k = 0;
+    while (i < mid && j < n) {
+        if (sort_compare_tail (&keys[j], &keys[i]) < 0) {
+            tmp[k++] = keys[j++];
+        } else {
+            tmp[k++] = keys[i++];
+        }
+    }
+    while (i < mid) {
+        tmp[k++] = keys[i++];
+    }
+
+    // whatever is left of the right half is already in place
+    memcpy (keys, tmp, k * sizeof (anemone_sort_key_t));
+}
+
+//
+// Split the keys in to 256 buckets on the byte of the prefix at 'shift',
+// leaving the buckets in order in 'keys' and their sizes in 'counts'.
+//
+ANEMONE_STATIC
+void sort_scatter (anemone_sort_key_t *keys, anemone_sort_key_t *tmp, int64_t n, int shift, const int64_t *counts)
+{
+    int64_t offsets[256];
+    int64_t offset = 0;
+    for (int b = 0; b < 256; b++) {
+        offsets[b] = offset;
+        offset += counts[b];
+    }
+
+    for (int64_t i = 0; i < n; i++) {
+        const uint8_t b = (uint8_t) (keys[i].prefix >> shift);
+        tmp[offsets[b]++] = keys[i];
+    }
+
+    memcpy (keys, tmp, n * sizeof (anemone_sort_key_t));
+}
+
+//
+// Count the keys in each bucket on the byte at 'shift', moving on to the next
+// byte while every key is in the same bucket. Returns the shift it stopped
+// at, or -8 if the whole prefix is the same for every key.
+//
+ANEMONE_STATIC
+int sort_count (const anemone_sort_key_t *keys, int64_t n, int shift, int64_t *counts)
+{
+    for (; shift >= 0; shift -= 8) {
+        memset (counts, 0, 256 * sizeof (int64_t));
+        for (int64_t i = 0; i < n; i++) {
+            counts[(uint8_t) (keys[i].prefix >> shift)]++;
+        }
+
+        if (counts[(uint8_t) (keys[0].prefix >> shift)] != n) {
+            return shift;
+        }
+    }
+
+    return shift;
+}
+
+ANEMONE_STATIC
+void sort_radix (anemone_sort_key_t *keys, anemone_sort_key_t *tmp, int64_t n, int shift)
+{
+    if (n <= ANEMONE_SORT_INSERTION) {
+        sort_insertion (keys, n);
+        return;
+    }
+
+    int64_t counts[256];
+    shift = sort_count (keys, n, shift, counts);
+
+    if (shift < 0) {
+        sort_merge (keys, tmp, n);
+        return;
+    }
+
+    sort_scatter (keys, tmp, n, shift, counts);
+
+    int64_t offset = 0;
+    for (int b = 0; b < 256; b++) {
+        if (counts[b] > 1) {
+            sort_radix (keys + offset, tmp + offset, counts[b], shift - 8);
+        }
+        offset += counts[b];
+    }
+}
+
+void anemone_sort_keys (anemone_sort_key_t *keys, anemone_sort_key_t *tmp, int64_t n)
+{
+    sort_radix (keys, tmp, n, 56);
+}
+
+error_t anemone_sort_bytes (const uint8_t *const *ptrs, const size_t *lens, int64_t n, int64_t *out_index)
+{
+    if (n <= 0) return 0;
+
+    anemone_sort_key_t *keys = malloc (2 * n * sizeof (anemone_sort_key_t));
+    if (ANEMONE_UNLIKELY (keys == NULL)) return 1;
+
+    for (int64_t i = 0; i < n; i++) {
+        anemone_sort_key_init (&keys[i], ptrs[i], lens[i], i);
+    }
+
+    anemone_sort_keys (keys, keys + n, n);
+
+    for (int64_t i = 0; i < n; i++) {
+        out_index[i] = keys[i].index;
+    }
+
+    free (keys);
+    return 0;
+}
+
+//
+// The parallel sort is done in three steps:
+//
+//  1. the threads take chunks of keys from a shared counter and load their
+//     prefixes;
+//  2. the first thread splits the keys in to buckets on their first
+//     byte which differs;
+//  3. the threads take buckets from a shared counter and sort them, then
+//     write their indices out.
+//
+typedef struct {
+  const uint8_t *const *ptrs;
+  const size_t *lens;
+  int64_t n;
+  int64_t *out_index;
+
+  anemone_sort_key_t *keys;
+  anemone_sort_key_t *tmp;
+
+  int threads;
+  int shift;
+  int64_t counts[256];
+  int64_t offsets[256];
+
+  // next keys to load and bucket to sort, shared between the threads
+  int64_t next_chunk;
+  int next_bucket;
+} sort_parallel_t;
+
+ANEMONE_STATIC
+void * sort_parallel_init (void *arg)
+{
+    sort_parallel_t *shared = arg;
+
+    for (;;) {
+        const int64_t start = __atomic_fetch_add (&shared->next_chunk, ANEMONE_SORT_CHUNK, __ATOMIC_RELAXED);
+        if (start >= shared->n) break;
+
+        const int64_t end = start + ANEMONE_SORT_CHUNK < shared->n ? start + ANEMONE_SORT_CHUNK : shared->n;
+        for (int64_t i = start; i < end; i++) {
+            anemone_sort_key_init (&shared->keys[i], shared->ptrs[i], shared->lens[i], i);
+        }
+    }
+
+    return NULL;
+}
+
+ANEMONE_STATIC
+void * sort_parallel_buckets (void *arg)
+{
+    sort_parallel_t *shared = arg;
+
+    for (;;) {
+        const int b = __atomic_fetch_add (&shared->next_bucket, 1, __ATOMIC_RELAXED);
+        if (b >= 256) break;
+
+        const int64_t offset = shared->offsets[b];
+        const int64_t count = shared->counts[b];
+
+        if (count > 1) {
+            sort_radix (shared->keys + offset, shared->tmp + offset, count, shared->shift - 8);
+        }
+
+        for (int64_t i = offset; i < offset + count; i++) {
+            shared->out_index[i] = shared->keys[i].index;
+        }
+    }
+
+    return NULL;
+}
+
+error_t anemone_sort_bytes_parallel (const uint8_t *const *ptrs, const size_t *lens, int64_t n, int64_t *out_index, int threads)
+{
+    if (threads <= 1 || n < ANEMONE_SORT_PARALLEL_MIN) {
+        return anemone_sort_bytes (ptrs, lens, n, out_index);
+    }
+
+    sort_parallel_t *shared = malloc (sizeof (sort_parallel_t));
+    anemone_sort_key_t *keys = malloc (2 * n * sizeof (anemone_sort_key_t));
+    pthread_t *pthreads = malloc (threads * sizeof (pthread_t));
+
+    if (ANEMONE_UNLIKELY (shared == NULL || keys == NULL || pthreads == NULL)) {
+        free (shared);
+        free (keys);
+        free (pthreads);
+        return 1;
+    }
+
+    shared->ptrs = ptrs;
+    shared->lens = lens;
+    shared->n = n;
+    shared->out_index = out_index;
+    shared->keys = keys;
+    shared->tmp = keys + n;
+    shared->threads = threads;
+    shared->next_chunk = 0;
+    shared->next_bucket = 0;
+
+    anemone_thread_run (shared, shared->threads, pthreads, sort_parallel_init);
+
+    shared->shift = sort_count (keys, n, 56, shared->counts);
+
+    if (shared->shift < 0) {
+        // every prefix is the same, so there is nothing to split on
+        sort_merge (keys, shared->tmp, n);
+        for (int64_t i = 0; i < n; i++) {
+            out_index[i] = keys[i].index;
+        }
+    } else {
+        sort_scatter (keys, shared->tmp, n, shared->shift, shared->counts);
+
+        int64_t offset = 0;
+        for (int b = 0; b < 256; b++) {
+            shared->offsets[b] = offset;
+            offset += shared->counts[b];
+        }
+
+        anemone_thread_run (shared, shared->threads, pthreads, sort_parallel_buckets);
+    }
+
+    free (shared);
+    free (keys);
+    free (pthreads);
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+#ifndef __ANEMONE_SORT_H
+#define __ANEMONE_SORT_H
+
+//
+// Sorting byte strings in memcmp order.
+//
+// A comparison sort on (ptr, len) pairs chases both pointers on every
+// compare, which almost always misses the cache. Instead each element keeps
+// the first 8 bytes of its key inline, loaded as a big-endian number, so most
+// compares are a single integer compare on memory which is already close by.
+//
+// The elements are sorted with an MSD radix sort on the prefix, one byte at a
+// time, and only keys whose whole prefix is equal are compared with
+// anemone_memcmp on the rest of their bytes. Small buckets are finished off
+// with an insertion sort.
+//
+// Equal keys keep their original order, so the sort is stable.
+//
+
+#include "anemone_base.h"
+#include "anemone_twiddle.h"
+
+// Buckets this small are insertion sorted instead of split further.
+#define ANEMONE_SORT_INSERTION 32
+
+// The parallel sort runs on one thread when there are fewer keys than this.
+#define ANEMONE_SORT_PARALLEL_MIN 65536
+
+typedef struct {
+  // First 8 bytes of the key as a big-endian number, padded with zeros
+  uint64_t prefix;
+  const uint8_t *ptr;
+  size_t len;
+  // Position of the key before sorting, which breaks ties
+  int64_t index;
+} anemone_sort_key_t;
+
+ANEMONE_INLINE
+void anemone_sort_key_init (anemone_sort_key_t *key, const uint8_t *ptr, size_t len, int64_t index)
+{
+    key->prefix = anemone_bswap64 (anemone_partial_load64 (ptr, len));
+    key->ptr = ptr;
+    key->len = len;
+    key->index = index;
+}
+
+//
+// Sorts 'n' keys in place, using 'tmp', which must have room for another 'n'
+// keys, as scratch space.
+//
+void anemone_sort_keys (anemone_sort_key_t *keys, anemone_sort_key_t *tmp, int64_t n);
+
+//
+// Sorts the 'n' byte strings where key i is 'lens[i]' bytes at 'ptrs[i]', and
+// writes the index of each key in sorted order to 'out_index'.
+//
+// Returns 0 on success, or 1 if memory could not be allocated.
+//
+error_t anemone_sort_bytes (const uint8_t *const *ptrs, const size_t *lens, int64_t n, int64_t *out_index);
+
+//
+// The same as anemone_sort_bytes, using up to 'threads' threads when there
+// are at least ANEMONE_SORT_PARALLEL_MIN keys.
+//
+// The keys are split on the first byte where they are not all equal, and the
+// buckets are shared out between the threads, so keys which mostly fall in
+// one bucket gain little.
+//
+error_t anemone_sort_bytes_parallel (const uint8_t *const *ptrs, const size_t *lens, int64_t n, int64_t *out_index, int threads);
+
+#endif//__ANEMONE_SORT_H
@@ -1,12 +1,17 @@
 #ifndef __ANEMONE_SSE_H
 #define __ANEMONE_SSE_H
 
-#ifndef __SSE4_2__
-#error "You must compile with SSE enabled!"
-#endif
+//
+// Helpers for the SSE versions of functions. Only anemone_sse_load128 is in the
+// x86-64 baseline, the rest need SSE4.2 and can only be called from functions
+// marked ANEMONE_SSE42, which must be chosen by checking anemone_cpu_features.
+// Likewise the 256-bit helpers need AVX2 and functions marked ANEMONE_AVX2.
+//
 
 #include "anemone_base.h"
+#include "anemone_cpu.h"
 
+#include <string.h>
 #include <x86intrin.h>
 
 ANEMONE_INLINE
@@ -18,6 +23,7 @@ __m128i anemone_sse_load128 (const void *mem)
 /*
   load some bytes, but be careful not to read past "end"
 */
+ANEMONE_SSE42
 ANEMONE_INLINE
 __m128i anemone_sse_load_bytes128 (const char *start, const char *end)
 {
@@ -76,6 +82,7 @@ __m128i anemone_sse_load_bytes128 (const char *start, const char *end)
   }
 }
 
+ANEMONE_SSE42
 ANEMONE_INLINE
 uint64_t anemone_sse_sum1_epi32 (const __m128i a)
 {
@@ -86,6 +93,7 @@ uint64_t anemone_sse_sum1_epi32 (const __m128i a)
 }
 
 /* return a[0] + a[1] + a[2] + a[3] + b[0] + b[1] + b[2] + b[3] */
+ANEMONE_SSE42
 ANEMONE_INLINE
 uint64_t anemone_sse_sum2_epi32 (const __m128i a, const __m128i b)
 {
@@ -96,6 +104,7 @@ uint64_t anemone_sse_sum2_epi32 (const __m128i a, const __m128i b)
     return _mm_extract_epi32(sum3, 0);
 }
 
+ANEMONE_SSE42
 ANEMONE_INLINE
 unsigned int anemone_sse_first_nondigit (const __m128i m)
 {
@@ -108,6 +117,7 @@ unsigned int anemone_sse_first_nondigit (const __m128i m)
 compute indices at the same time: index of the first non-digit (anything other than '0'-'9') and index of the first non-zero.
 idea is if first non-zero is 0 (ideal case), shouldn't need to cut off trailing zeros.
 */
+ANEMONE_SSE42
 ANEMONE_INLINE
 void anemone_sse_first_nondigit_first_nonzero (const __m128i m, unsigned int* out_first_nondigit, unsigned int* out_first_nonzero)
 {
@@ -118,4 +128,31 @@ void anemone_sse_first_nondigit_first_nonzero (const __m128i m, unsigned int* ou
     *out_first_nonzero  = nonzero;
 }
 
+/*
+  load some bytes, but be careful not to read past "end"
+*/
+ANEMONE_AVX2
+ANEMONE_INLINE
+__m256i anemone_avx2_load_bytes256 (const char *start, const char *end)
+{
+  if (ANEMONE_LIKELY(end - start >= 32)) {
+    return _mm256_loadu_si256((__m256i*)start);
+  } else {
+    /* there is not enough to load all 32 bytes, so pad with nulls as above */
+    char buffer[32] = { 0 };
+    memcpy(buffer, start, end - start);
+    return _mm256_loadu_si256((__m256i*)buffer);
+  }
+}
+
+/* mask with bit i set if byte i of m is a digit, '0'-'9' */
+ANEMONE_AVX2
+ANEMONE_INLINE
+uint32_t anemone_avx2_digits (const __m256i m)
+{
+    const __m256i values = _mm256_sub_epi8(m, _mm256_set1_epi8('0'));
+    const __m256i nines  = _mm256_set1_epi8(9);
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(values, nines), values));
+}
+
 #endif//__ANEMONE_SSE_H
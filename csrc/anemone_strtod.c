@@ -1,9 +1,14 @@
 #include "anemone_base.h"
+#include "anemone_atoi.h"
 #include "anemone_atoi_sse_impl.h"
+#include "anemone_column.h"
 #include "anemone_strtod.h"
+#include "anemone_strtod_pow5.h"
 
 #include <math.h>   // INFINITY, NAN
 #include <stddef.h> // size_t
+#include <stdlib.h> // strtod, malloc, free
+#include <string.h> // memcpy
 
 ANEMONE_STATIC
 ANEMONE_INLINE
@@ -74,38 +79,203 @@ int64_t anemone_strtod_unsafe_ipow10 (int n)
     return e[n];
 }
 
+//
+// Nearest double to w * 10^q, as raw bits with the sign bit clear, using the
+// Eisel-Lemire algorithm: one or two 64x64->128 multiplications by a truncated
+// 5^q, which Mushtak and Lemire show is always enough for a 64-bit w, so there
+// is no ambiguous case to fall back on.
+//
 ANEMONE_STATIC
 ANEMONE_INLINE
-double anemone_strtod_from_parts_fast (double significand, int exponent)
+uint64_t anemone_strtod_eisel_lemire (uint64_t w, int64_t q)
 {
-    if (exponent < -308)
-        return 0.0;
-    else if (exponent >= 0)
-        /* these unsafe calls are safe because abs exponent must be < 308, checked earlier */
-        return significand * anemone_strtod_unsafe_dpow10 (exponent);
-    else
-        return significand / anemone_strtod_unsafe_dpow10 (-exponent);
+    static const int mantissa_bits = 52;
+    static const int64_t infinite_power = 0x7ff;
+
+    if (w == 0 || q < ANEMONE_STRTOD_POW5_MIN)
+        return 0;
+    if (q > ANEMONE_STRTOD_POW5_MAX)
+        return (uint64_t)infinite_power << mantissa_bits;
+
+    int lz = __builtin_clzll (w);
+    w <<= lz;
+
+    // We need 55 good bits: the 53 of the mantissa, the rounding bit and the
+    // top bit which tells us how far to shift. The low word is only needed
+    // when the bits below those are all ones, and the carry could reach them.
+    const uint64_t *pow5 = anemone_strtod_pow5[q - ANEMONE_STRTOD_POW5_MIN];
+    static const uint64_t precision_mask = 0xffffffffffffffffULL >> (mantissa_bits + 3);
+
+    __uint128_t first = (__uint128_t)w * pow5[0];
+    uint64_t hi = (uint64_t)(first >> 64);
+    uint64_t lo = (uint64_t)first;
+    if ((hi & precision_mask) == precision_mask) {
+        uint64_t second_hi = (uint64_t)(((__uint128_t)w * pow5[1]) >> 64);
+        lo += second_hi;
+        if (second_hi > lo) hi++;
+    }
+
+    int upperbit = (int)(hi >> 63);
+    int shift    = upperbit + 64 - mantissa_bits - 3;
+    uint64_t mantissa = hi >> shift;
+
+    // floor(log2(10^q)) + 63, plus a bias of 1023
+    int64_t power2 = ((((152170 + 65536) * (int32_t)q) >> 16) + 63) + upperbit - lz + 1023;
+
+    if (power2 <= 0) {
+        // Subnormal, or zero if everything is below the smallest subnormal
+        if (-power2 + 1 >= 64)
+            return 0;
+        mantissa >>= -power2 + 1;
+        mantissa += mantissa & 1;
+        mantissa >>= 1;
+        // Rounding up may have made it the smallest normal number again, in
+        // which case the mantissa bit flows into the exponent
+        return mantissa;
+    }
+
+    // We round up, unless we fall exactly between two doubles and must round
+    // to even. That can only happen when 5^q fits in 64 bits, and nothing but
+    // zeros were shifted out.
+    if (lo <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1) {
+        if ((mantissa << shift) == hi)
+            mantissa &= ~(uint64_t)1;
+    }
+
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= ((uint64_t)2 << mantissa_bits)) {
+        mantissa = (uint64_t)1 << mantissa_bits;
+        power2++;
+    }
+    mantissa &= ~((uint64_t)1 << mantissa_bits);
+
+    if (power2 >= infinite_power)
+        return (uint64_t)infinite_power << mantissa_bits;
+
+    return mantissa | ((uint64_t)power2 << mantissa_bits);
+}
+
+//
+// The slow path, for when digits past the 19th were thrown away and they
+// change which way the value rounds. The token has already been checked
+// against our grammar, which is a subset of what the C library accepts, so it
+// reads exactly the same characters. This assumes the "C" locale for
+// LC_NUMERIC, which is the default for a program that never sets it.
+//
+ANEMONE_STATIC
+error_t anemone_strtod_slow (const char *start, const char *end, double *output_ptr)
+{
+    char   small[128];
+    size_t size = end - start;
+    char  *buffer = size < sizeof (small) ? small : malloc (size + 1);
+    if (!buffer) return 1;
+
+    memcpy (buffer, start, size);
+    buffer[size] = 0;
+
+    *output_ptr = strtod (buffer, NULL);
+
+    if (buffer != small) free (buffer);
+    return 0;
 }
 
+//
+// Parses the digits of one part of a double, the same as
+// anemone_string_to_ui64_v128_floating.
+//
+typedef int64_t (*anemone_strtod_digits_t) (char **pp, char *pe, uint64_t *out_val, int64_t *out_exponent_spill, int64_t *out_significant_digits);
+
+//
+// Scalar version of anemone_string_to_ui64_v128_floating, which gives the same
+// results for every input.
+//
 ANEMONE_STATIC
 ANEMONE_INLINE
-double anemone_strtod_from_parts (double significand, int exponent)
+int64_t anemone_string_to_ui64_floating (char **pp, char *pe, uint64_t *out_val, int64_t *out_exponent_spill, int64_t *out_significant_digits)
 {
-    if (exponent < -308) {
-        double value;
-        value = anemone_strtod_from_parts_fast (significand, -308);
-        value = anemone_strtod_from_parts_fast (value, exponent + 308);
-        return value;
-    } else {
-        return anemone_strtod_from_parts_fast (significand, exponent);
+    char *in = *pp;
+    if (pe - in == 0) {
+        return 1;
     }
+
+    // Leading zeros are not significant, unless they are all there is
+    if (in[0] == '0') {
+        do {
+            in++;
+        } while (pe - in > 0 && in[0] == '0');
+
+        if (pe - in == 0 || !anemone_is_digit (in[0])) {
+            *out_val = 0;
+            *pp      = in;
+            *out_exponent_spill = 0;
+            *out_significant_digits = 1;
+            return 0;
+        }
+    }
+
+    // We can hold 19 digits, any more are counted and thrown away
+    uint64_t int_out = 0;
+    int64_t  significant_digits = 0;
+    while (pe - in > 0 && anemone_is_digit (in[0]) && significant_digits < 19) {
+        int_out = int_out * 10 + (in[0] - '0');
+        significant_digits++;
+        in++;
+    }
+
+    if (significant_digits == 0) {
+        return 1;
+    }
+
+    int64_t exponent_spill = 0;
+    while (pe - in > 0 && anemone_is_digit (in[0])) {
+        exponent_spill++;
+        in++;
+    }
+
+    *out_val = int_out;
+    *pp      = in;
+    *out_exponent_spill = exponent_spill;
+    *out_significant_digits = significant_digits;
+    return 0;
 }
 
-error_t anemone_strtod (char **pp, char *pe, double *output_ptr)
+ANEMONE_SSE42
+ANEMONE_STATIC
+ANEMONE_INLINE
+int64_t anemone_string_to_ui64_sse42_floating (char **pp, char *pe, uint64_t *out_val, int64_t *out_exponent_spill, int64_t *out_significant_digits)
+{
+    return anemone_string_to_ui64_v128_floating (pp, pe, out_val, out_exponent_spill, out_significant_digits);
+}
+
+ANEMONE_AVX2
+ANEMONE_STATIC
+ANEMONE_INLINE
+int64_t anemone_string_to_ui64_avx2_floating (char **pp, char *pe, uint64_t *out_val, int64_t *out_exponent_spill, int64_t *out_significant_digits)
+{
+    // Near the end of the buffer the vector load has to be padded by copying,
+    // which costs more than the scalar loop does on a short number. This is
+    // always the case when the buffer is a single field.
+    if (ANEMONE_UNLIKELY (pe - *pp < 32)) {
+        return anemone_string_to_ui64_floating (pp, pe, out_val, out_exponent_spill, out_significant_digits);
+    }
+
+    return anemone_string_to_ui64_v256_floating (pp, pe, out_val, out_exponent_spill, out_significant_digits);
+}
+
+//
+// The parser is instantiated once for each way of parsing digits, so that the
+// SSE4.2 or AVX2 version can be chosen when the library is loaded.
+//
+ANEMONE_STATIC
+ANEMONE_INLINE
+error_t inline_strtod (anemone_strtod_digits_t parse_digits, char **pp, char *pe, double *output_ptr)
 {
     char *p = *pp;
     if (!p) return 1;
 
+    char *start = p;
+
     // Check for sign
     int64_t sign = 1;
     if (pe - p > 0 && p[0] == '-') {
@@ -151,12 +321,15 @@ error_t anemone_strtod (char **pp, char *pe, double *output_ptr)
     // 123e1 = 1230 ~~ 1234
     int64_t int_leftovers;
     int64_t int_digits;
-    if (anemone_string_to_ui64_v128_floating (&p, pe, &int_part, &int_leftovers, &int_digits)) return 1;
+    if (parse_digits (&p, pe, &int_part, &int_leftovers, &int_digits)) return 1;
     int64_t int_digits_total = int_digits + int_leftovers;
 
     int64_t exponent    = int_leftovers;
     // The significand must be unsigned to store largest 19-digit
     uint64_t significand = int_part;
+    // Whether any digits were thrown away, so the real significand is
+    // somewhere between significand and significand + 1
+    int truncated = int_leftovers > 0;
 
     // Parse the fractional part
     if (pe - p > 0 && p[0] == '.') {
@@ -169,14 +342,16 @@ error_t anemone_strtod (char **pp, char *pe, double *output_ptr)
         uint64_t frac_part;
         int64_t frac_leftovers;
         int64_t frac_digits;
-        if (anemone_string_to_ui64_v128_floating (&p, pe, &frac_part, &frac_leftovers, &frac_digits)) return 1;
+        if (parse_digits (&p, pe, &frac_part, &frac_leftovers, &frac_digits)) return 1;
         int64_t frac_digits_incl_zero = (p - frac_part_start) - frac_leftovers;
+        truncated |= frac_leftovers > 0;
 
         // If the int part and the frac part are more than 19, we have more than we can hold.
         // We need to throw away some of the precision on the fractional part.
         // However, if the integer part is zero, do not throw anything away! We can just shift the exponent.
         if (int_digits_total + frac_digits_incl_zero > 19 && significand != 0) {
           int num_over = (int_digits_total + frac_digits_incl_zero) - 19;
+          truncated = 1;
           frac_digits_incl_zero -= num_over;
           if (num_over < 19 && frac_digits_incl_zero > 0) {
             // Only call ipow with small numbers, otherwise unsafe
@@ -210,7 +385,7 @@ error_t anemone_strtod (char **pp, char *pe, double *output_ptr)
         uint64_t exp_part;
         int64_t exp_leftovers;
         int64_t exp_digits;
-        if (anemone_string_to_ui64_v128_floating (&p, pe, &exp_part, &exp_leftovers, &exp_digits)) return 1;
+        if (parse_digits (&p, pe, &exp_part, &exp_leftovers, &exp_digits)) return 1;
         // We convert this to a signed int, so make sure we don't overflow
         if (exp_part > INT64_MAX || exp_leftovers) exp_part = INT64_MAX;
 
@@ -218,13 +393,29 @@ error_t anemone_strtod (char **pp, char *pe, double *output_ptr)
     }
 
     if (significand == 0) {
-        *output_ptr = sign * 0;
-    } else if (exponent > 308) {
-        *output_ptr = sign * INFINITY;
-    } else {
-        // Convert significand to double before potentially negating it
+        // an integer zero would lose the sign of "-0"
+        *output_ptr = sign * 0.0;
+    } else if (!truncated && significand <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+        // Both the significand and the power of ten are exact doubles, so a
+        // single multiply or divide is correctly rounded
         double sig_double = significand;
-        *output_ptr = anemone_strtod_from_parts (sign * sig_double, exponent);
+        if (exponent >= 0)
+            sig_double *= anemone_strtod_unsafe_dpow10 (exponent);
+        else
+            sig_double /= anemone_strtod_unsafe_dpow10 (-exponent);
+        *output_ptr = sign * sig_double;
+    } else {
+        uint64_t bits = anemone_strtod_eisel_lemire (significand, exponent);
+
+        // If throwing away digits could have changed the rounding, ask the C
+        // library about the whole token
+        if (truncated && bits != anemone_strtod_eisel_lemire (significand + 1, exponent)) {
+            if (anemone_strtod_slow (start, p, output_ptr)) return 1;
+        } else {
+            double value;
+            memcpy (&value, &bits, sizeof (value));
+            *output_ptr = sign * value;
+        }
     }
 
     *pp         = p;
@@ -232,3 +423,96 @@ error_t anemone_strtod (char **pp, char *pe, double *output_ptr)
     return 0;
 }
 
+ANEMONE_SSE42
+ANEMONE_STATIC
+error_t strtod_sse42 (char **pp, char *pe, double *output_ptr)
+{
+    return inline_strtod (anemone_string_to_ui64_sse42_floating, pp, pe, output_ptr);
+}
+
+ANEMONE_AVX2
+ANEMONE_STATIC
+error_t strtod_avx2 (char **pp, char *pe, double *output_ptr)
+{
+    return inline_strtod (anemone_string_to_ui64_avx2_floating, pp, pe, output_ptr);
+}
+
+error_t anemone_strtod_scalar (char **pp, char *pe, double *output_ptr)
+{
+    return inline_strtod (anemone_string_to_ui64_floating, pp, pe, output_ptr);
+}
+
+ANEMONE_SSE42
+ANEMONE_STATIC
+ANEMONE_INLINE
+error_t strtod_field_sse42 (const char **pp, const char *pe, void *out, int64_t i)
+{
+    double *values = out;
+
+    return inline_strtod (anemone_string_to_ui64_sse42_floating, (char **) pp, (char *) pe, values + i);
+}
+
+ANEMONE_AVX2
+ANEMONE_STATIC
+ANEMONE_INLINE
+error_t strtod_field_avx2 (const char **pp, const char *pe, void *out, int64_t i)
+{
+    double *values = out;
+
+    return inline_strtod (anemone_string_to_ui64_avx2_floating, (char **) pp, (char *) pe, values + i);
+}
+
+ANEMONE_STATIC
+ANEMONE_INLINE
+error_t strtod_field_scalar (const char **pp, const char *pe, void *out, int64_t i)
+{
+    double *values = out;
+
+    return inline_strtod (anemone_string_to_ui64_floating, (char **) pp, (char *) pe, values + i);
+}
+
+ANEMONE_SSE42
+ANEMONE_STATIC
+int64_t strtod_column_sse42 (const char **pp, const char *pe, char sep, char term, int64_t n, double *out, uint64_t *valid)
+{
+    return anemone_column_parse (strtod_field_sse42, anemone_column_delimiter_sse42, pp, pe, sep, term, n, out, sizeof (*out), valid);
+}
+
+ANEMONE_AVX2
+ANEMONE_STATIC
+int64_t strtod_column_avx2 (const char **pp, const char *pe, char sep, char term, int64_t n, double *out, uint64_t *valid)
+{
+    return anemone_column_parse (strtod_field_avx2, anemone_column_delimiter_sse42, pp, pe, sep, term, n, out, sizeof (*out), valid);
+}
+
+ANEMONE_STATIC
+int64_t strtod_column_scalar (const char **pp, const char *pe, char sep, char term, int64_t n, double *out, uint64_t *valid)
+{
+    return anemone_column_parse (strtod_field_scalar, anemone_column_delimiter_scalar, pp, pe, sep, term, n, out, sizeof (*out), valid);
+}
+
+static error_t (*resolved_strtod) (char **pp, char *pe, double *output_ptr) = anemone_strtod_scalar;
+static int64_t (*resolved_strtod_column) (const char **pp, const char *pe, char sep, char term, int64_t n, double *out, uint64_t *valid) = strtod_column_scalar;
+
+ANEMONE_CONSTRUCTOR
+ANEMONE_STATIC
+void anemone_strtod_init ()
+{
+    if (anemone_cpu_supports (ANEMONE_CPU_AVX2)) {
+        resolved_strtod = strtod_avx2;
+        resolved_strtod_column = strtod_column_avx2;
+    } else if (anemone_cpu_supports (ANEMONE_CPU_SSE42)) {
+        resolved_strtod = strtod_sse42;
+        resolved_strtod_column = strtod_column_sse42;
+    }
+}
+
+error_t anemone_strtod (char **pp, char *pe, double *output_ptr)
+{
+    return resolved_strtod (pp, pe, output_ptr);
+}
+
+int64_t anemone_strtod_column (const char **pp, const char *pe, char sep, char term, int64_t n, double *out, uint64_t *valid)
+{
+    return resolved_strtod_column (pp, pe, sep, term, n, out, valid);
+}
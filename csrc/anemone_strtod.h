@@ -3,6 +3,44 @@
 
 #include "anemone_base.h"
 
+/* gives the nearest double, rounding halfway cases to even, for any number of digits */
 error_t anemone_strtod (char **pp, char *pe, double *output_ptr);
 
+/* the version used when the CPU does not support SSE4.2, which gives the same results */
+error_t anemone_strtod_scalar (char **pp, char *pe, double *output_ptr);
+
+//
+// Parses a buffer of delimited doubles in one call, as for a CSV or PSV
+// column.
+//
+// pp:
+//   pointer to start of buffer, moved past the last field parsed and its
+//   delimiter
+//
+// pe:
+//   pointer to end of buffer
+//
+// sep:
+//   field separator
+//
+// term:
+//   record terminator, a field ends at either this or 'sep'
+//
+// n:
+//   maximum number of fields to parse
+//
+// out:
+//   pointer to an array of at least 'n' values, the value of an invalid
+//   field is zero
+//
+// valid:
+//   pointer to a bitmap of at least (n + 63) / 64 words, bit i is set if
+//   field i was valid
+//
+// *returns*
+//   the number of fields parsed, which is less than 'n' if the end of the
+//   buffer was reached first
+//
+int64_t anemone_strtod_column (const char **pp, const char *pe, char sep, char term, int64_t n, double *out, uint64_t *valid);
+
 #endif//__ANEMONE_STRTOD_H
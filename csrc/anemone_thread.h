@@ -0,0 +1,34 @@
+#ifndef __ANEMONE_THREAD_H
+#define __ANEMONE_THREAD_H
+
+//
+// Helpers for the kernels which run on many threads. This header is private
+// to the C sources, it is not installed or embedded.
+//
+
+#include "anemone_base.h"
+
+#include <pthread.h>
+
+// Run 'f (shared)' on 'threads' threads, including the calling thread, and
+// wait for them all to finish. 'pthreads' must have room for 'threads'
+// handles. The work should be taken from shared counters, so any threads
+// which could not be started are made up for by the others.
+ANEMONE_INLINE
+void anemone_thread_run (void *shared, int threads, pthread_t *pthreads, void * (*f) (void *))
+{
+    int started = 1;
+    for (; started < threads; started++) {
+        if (pthread_create (&pthreads[started], NULL, f, shared)) {
+            break;
+        }
+    }
+
+    f (shared);
+
+    for (int t = 1; t < started; t++) {
+        pthread_join (pthreads[t], NULL);
+    }
+}
+
+#endif//__ANEMONE_THREAD_H
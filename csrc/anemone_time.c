@@ -1,20 +1,21 @@
 #include "anemone_atoi.h"
+#include "anemone_itoa.h"
 #include "anemone_time.h"
+#include "anemone_column.h"
+
+//
+// Checks that "yyyy-mm-dd" is at the start of the buffer, and converts it to
+// the year, month and day, returning false if it is not.
+//
+typedef bool_t (*anemone_date_prefix_t) (const char *p, const char *pe, int64_t *fields);
 
 ANEMONE_STATIC
 ANEMONE_INLINE
-error_t inline_parse_gregorian (
-    const char **pp
-  , const char *pe
-  , int64_t *out_year
-  , int64_t *out_month
-  , int64_t *out_day
-  )
+bool_t anemone_date_prefix_scalar (const char *p, const char *pe, int64_t *fields)
 {
                                /* p + 0123456789 */
     const size_t date_size = sizeof ("yyyy-mm-dd") - 1 /* nul */;
 
-    const char *p = *pp;
     const size_t size = pe - p;
 
     if (size >= date_size &&
@@ -29,21 +30,83 @@ error_t inline_parse_gregorian (
         anemone_is_digit (p[8]) &&
         anemone_is_digit (p[9])) {
 
-        const int64_t year =
+        fields[0] =
             (p[0] - '0') * 1000 +
             (p[1] - '0') * 100 +
             (p[2] - '0') * 10 +
             (p[3] - '0');
 
-        const int64_t month =
+        fields[1] =
             (p[5] - '0') * 10 +
             (p[6] - '0');
 
-        const int64_t day =
+        fields[2] =
             (p[8] - '0') * 10 +
-
             (p[9] - '0');
 
+        return ANEMONE_TRUE;
+    }
+
+    return ANEMONE_FALSE;
+}
+
+//
+// The same check as anemone_timestamp_prefix_sse42 below, on just the first
+// 10 bytes of the load. Near the end of the buffer, where a whole vector
+// cannot be loaded, this falls back to the scalar version.
+//
+ANEMONE_SSE42
+ANEMONE_STATIC
+ANEMONE_INLINE
+bool_t anemone_date_prefix_sse42 (const char *p, const char *pe, int64_t *fields)
+{
+    if (ANEMONE_UNLIKELY (pe - p < 16)) {
+        return anemone_date_prefix_scalar (p, pe, fields);
+    }
+
+    const __m128i base   = _mm_setr_epi8 ('0', '0', '0', '0', '-', '0', '0', '-', '0', '0', 0, 0, 0, 0, 0, 0);
+    const __m128i limit  = _mm_setr_epi8 ( 9,   9,   9,   9,   0,   9,   9,   0,   9,   9,  0, 0, 0, 0, 0, 0);
+    const __m128i gather = _mm_setr_epi8 (0, 1, 2, 3, 5, 6, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i tens   = _mm_setr_epi8 (10, 1, 10, 1, 10, 1, 10, 1, 0, 0, 0, 0, 0, 0, 0, 0);
+
+    __m128i digits = _mm_sub_epi8 (anemone_sse_load128 (p), base);
+    __m128i within = _mm_cmpeq_epi8 (_mm_max_epu8 (digits, limit), limit);
+
+    if (ANEMONE_UNLIKELY ((_mm_movemask_epi8 (within) & 0x3FF) != 0x3FF)) {
+        return ANEMONE_FALSE;
+    }
+
+    uint16_t pairs[8];
+    _mm_storeu_si128 ((__m128i *) pairs, _mm_maddubs_epi16 (_mm_shuffle_epi8 (digits, gather), tens));
+
+    fields[0] = pairs[0] * 100 + pairs[1];
+    fields[1] = pairs[2];
+    fields[2] = pairs[3];
+
+    return ANEMONE_TRUE;
+}
+
+ANEMONE_STATIC
+ANEMONE_INLINE
+error_t inline_parse_gregorian (
+    anemone_date_prefix_t prefix
+  , const char **pp
+  , const char *pe
+  , int64_t *out_year
+  , int64_t *out_month
+  , int64_t *out_day
+  )
+{
+    const size_t date_size = sizeof ("yyyy-mm-dd") - 1 /* nul */;
+
+    const char *p = *pp;
+    int64_t fields[3];
+
+    if (prefix (p, pe, fields)) {
+        const int64_t year = fields[0];
+        const int64_t month = fields[1];
+        const int64_t day = fields[2];
+
         *out_year = year;
         *out_month = month;
         *out_day = day;
@@ -71,7 +134,7 @@ error_t anemone_parse_gregorian (
   , int64_t *out_day
   )
 {
-    return inline_parse_gregorian (pp, pe, out_year, out_month, out_day);
+    return inline_parse_gregorian (anemone_date_prefix_scalar, pp, pe, out_year, out_month, out_day);
 }
 
 error_t anemone_parse_gregorian_as_modified_julian (
@@ -82,12 +145,378 @@ error_t anemone_parse_gregorian_as_modified_julian (
 {
     int64_t year, month, day;
 
-    error_t err = inline_parse_gregorian (pp, pe, &year, &month, &day);
-    *out_modified_julian = anemone_gregorian_to_modified_julian (year, month, day);
+    error_t err = inline_parse_gregorian (anemone_date_prefix_scalar, pp, pe, &year, &month, &day);
+    *out_modified_julian = anemone_gregorian_to_modified_julian_fast (year, month, day);
 
     return err;
 }
 
+ANEMONE_SSE42
+ANEMONE_STATIC
+ANEMONE_INLINE
+error_t anemone_parse_gregorian_as_modified_julian_field_sse42 (const char **pp, const char *pe, void *out, int64_t i)
+{
+    int64_t *values = out;
+    int64_t year, month, day;
+
+    error_t err = inline_parse_gregorian (anemone_date_prefix_sse42, pp, pe, &year, &month, &day);
+    values[i] = anemone_gregorian_to_modified_julian_fast (year, month, day);
+
+    return err;
+}
+
+ANEMONE_STATIC
+ANEMONE_INLINE
+error_t anemone_parse_gregorian_as_modified_julian_field_scalar (const char **pp, const char *pe, void *out, int64_t i)
+{
+    int64_t *values = out;
+    int64_t year, month, day;
+
+    error_t err = inline_parse_gregorian (anemone_date_prefix_scalar, pp, pe, &year, &month, &day);
+    values[i] = anemone_gregorian_to_modified_julian_fast (year, month, day);
+
+    return err;
+}
+
+ANEMONE_SSE42
+ANEMONE_STATIC
+int64_t parse_gregorian_as_modified_julian_column_sse42 (const char **pp, const char *pe, char sep, char term, int64_t n, int64_t *out, uint64_t *valid)
+{
+    return anemone_column_parse (anemone_parse_gregorian_as_modified_julian_field_sse42, anemone_column_delimiter_sse42, pp, pe, sep, term, n, out, sizeof (*out), valid);
+}
+
+ANEMONE_STATIC
+int64_t parse_gregorian_as_modified_julian_column_scalar (const char **pp, const char *pe, char sep, char term, int64_t n, int64_t *out, uint64_t *valid)
+{
+    return anemone_column_parse (anemone_parse_gregorian_as_modified_julian_field_scalar, anemone_column_delimiter_scalar, pp, pe, sep, term, n, out, sizeof (*out), valid);
+}
+
+//
+// A timestamp starts with the fixed width "yyyy-mm-ddThh:mm:ss", the
+// variations in length all come after it. The first 16 bytes of that,
+// "yyyy-mm-ddThh:mm", fit in one vector, so it is checked and converted to
+// the year, month, day, hour and minute by one of these, which return false
+// if it does not match.
+//
+typedef bool_t (*anemone_timestamp_prefix_t) (const char *p, int64_t *fields);
+
+ANEMONE_STATIC
+ANEMONE_INLINE
+bool_t anemone_timestamp_prefix_scalar (const char *p, int64_t *fields)
+{
+    if (anemone_is_digit (p[0])  &&
+        anemone_is_digit (p[1])  &&
+        anemone_is_digit (p[2])  &&
+        anemone_is_digit (p[3])  &&
+                   '-' == p[4]   &&
+        anemone_is_digit (p[5])  &&
+        anemone_is_digit (p[6])  &&
+                   '-' == p[7]   &&
+        anemone_is_digit (p[8])  &&
+        anemone_is_digit (p[9])  &&
+                   'T' == p[10]  &&
+        anemone_is_digit (p[11]) &&
+        anemone_is_digit (p[12]) &&
+                   ':' == p[13]  &&
+        anemone_is_digit (p[14]) &&
+        anemone_is_digit (p[15])) {
+
+        fields[0] =
+            (p[0] - '0') * 1000 +
+            (p[1] - '0') * 100 +
+            (p[2] - '0') * 10 +
+            (p[3] - '0');
+        fields[1] = (p[5] - '0') * 10 + (p[6] - '0');
+        fields[2] = (p[8] - '0') * 10 + (p[9] - '0');
+        fields[3] = (p[11] - '0') * 10 + (p[12] - '0');
+        fields[4] = (p[14] - '0') * 10 + (p[15] - '0');
+
+        return ANEMONE_TRUE;
+    }
+
+    return ANEMONE_FALSE;
+}
+
+ANEMONE_SSE42
+ANEMONE_STATIC
+ANEMONE_INLINE
+bool_t anemone_timestamp_prefix_sse42 (const char *p, int64_t *fields)
+{
+    // '0' under each digit and the separator itself under the others, so
+    // subtracting it leaves the value of each digit and zero for each
+    // separator which matches. Anything else is above the limit, bytes below
+    // the base wrap around to 0xd0 or more.
+    const __m128i base  = _mm_setr_epi8 ('0', '0', '0', '0', '-', '0', '0', '-', '0', '0', 'T', '0', '0', ':', '0', '0');
+    const __m128i limit = _mm_setr_epi8 ( 9,   9,   9,   9,   0,   9,   9,   0,   9,   9,   0,   9,   9,   0,   9,   9 );
+
+    // The digits of each field next to each other, so each pair of bytes can
+    // be multiplied and added to a 16-bit number in one pmaddubsw
+    const __m128i gather = _mm_setr_epi8 (0, 1, 2, 3, 5, 6, 8, 9, 11, 12, 14, 15, -1, -1, -1, -1);
+    const __m128i tens   = _mm_setr_epi8 (10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 0, 0, 0, 0);
+
+    __m128i digits = _mm_sub_epi8 (anemone_sse_load128 (p), base);
+    __m128i within = _mm_cmpeq_epi8 (_mm_max_epu8 (digits, limit), limit);
+
+    if (ANEMONE_UNLIKELY (_mm_movemask_epi8 (within) != 0xFFFF)) {
+        return ANEMONE_FALSE;
+    }
+
+    uint16_t pairs[8];
+    _mm_storeu_si128 ((__m128i *) pairs, _mm_maddubs_epi16 (_mm_shuffle_epi8 (digits, gather), tens));
+
+    fields[0] = pairs[0] * 100 + pairs[1];
+    fields[1] = pairs[2];
+    fields[2] = pairs[3];
+    fields[3] = pairs[4];
+    fields[4] = pairs[5];
+
+    return ANEMONE_TRUE;
+}
+
+ANEMONE_STATIC
+ANEMONE_INLINE
+error_t inline_parse_timestamp (
+    anemone_timestamp_prefix_t prefix
+  , const char **pp
+  , const char *pe
+  , int64_t *out_seconds
+  , int64_t *out_nanos
+  )
+{
+    // 10^(9 - digits), to scale a fraction with fewer than 9 digits to nanos
+    static const int64_t nanos_scale[10] = {
+        1000000000, 100000000, 10000000, 1000000, 100000, 10000, 1000, 100, 10, 1
+    };
+                                /* p + 0123456789012345678 */
+    const size_t prefix_size = sizeof ("yyyy-mm-ddThh:mm:ss") - 1 /* nul */;
+
+    const char *p = *pp;
+    int64_t fields[5];
+
+    *out_seconds = 0;
+    *out_nanos = 0;
+
+    if ((size_t) (pe - p) < prefix_size ||
+        !prefix (p, fields) ||
+                   ':' != p[16] ||
+        !anemone_is_digit (p[17]) ||
+        !anemone_is_digit (p[18])) {
+        return ANEMONE_TIME_PARSE_ERROR;
+    }
+
+    const int64_t year   = fields[0];
+    const int64_t month  = fields[1];
+    const int64_t day    = fields[2];
+    const int64_t hour   = fields[3];
+    const int64_t minute = fields[4];
+    const int64_t second = (p[17] - '0') * 10 + (p[18] - '0');
+
+    p += prefix_size;
+
+    //
+    // Any number of fractional digits, only the first 9 are kept, so anything
+    // below a nanosecond is truncated.
+    //
+    int64_t nanos = 0;
+    if (p < pe && *p == '.') {
+        const char *fraction = ++p;
+
+        while (p < pe && anemone_is_digit (*p)) {
+            if (p - fraction < 9) {
+                nanos = nanos * 10 + (*p - '0');
+            }
+            p++;
+        }
+
+        const int64_t digits = p - fraction;
+        if (ANEMONE_UNLIKELY (digits == 0)) {
+            return ANEMONE_TIME_PARSE_ERROR;
+        }
+        if (digits < 9) {
+            nanos *= nanos_scale[digits];
+        }
+    }
+
+    //
+    // 'Z' or "+hh:mm" / "-hh:mm", a timestamp without an offset is in UTC.
+    //
+    int64_t offset = 0;
+    bool_t offset_valid = ANEMONE_TRUE;
+    if (p < pe && *p == 'Z') {
+        p++;
+    } else if (p < pe && (*p == '+' || *p == '-')) {
+        if (pe - p < 6 ||
+            !anemone_is_digit (p[1]) ||
+            !anemone_is_digit (p[2]) ||
+                       ':' != p[3]  ||
+            !anemone_is_digit (p[4]) ||
+            !anemone_is_digit (p[5])) {
+            return ANEMONE_TIME_PARSE_ERROR;
+        }
+
+        const int64_t offset_hour   = (p[1] - '0') * 10 + (p[2] - '0');
+        const int64_t offset_minute = (p[4] - '0') * 10 + (p[5] - '0');
+
+        offset_valid = offset_hour <= 23 && offset_minute <= 59;
+        offset = (offset_hour * 3600 + offset_minute * 60) * (*p == '-' ? -1 : 1);
+        p += 6;
+    }
+
+    *pp = p;
+
+    if (!anemone_gregorian_valid (year, month, day)) {
+        return ANEMONE_TIME_INVALID_DATE;
+    }
+
+    // A leap second is allowed, it is the same instant as the first second of
+    // the next minute
+    if (hour > 23 || minute > 59 || second > 60 || !offset_valid) {
+        return ANEMONE_TIME_INVALID_TIME;
+    }
+
+    const int64_t days = anemone_gregorian_to_modified_julian_fast (year, month, day) - ANEMONE_TIME_UNIX_EPOCH_MODIFIED_JULIAN;
+
+    *out_seconds = days * 86400 + hour * 3600 + minute * 60 + second - offset;
+    *out_nanos = nanos;
+
+    return ANEMONE_TIME_SUCCESS;
+}
+
+ANEMONE_SSE42
+ANEMONE_STATIC
+error_t parse_timestamp_sse42 (const char **pp, const char *pe, int64_t *out_seconds, int64_t *out_nanos)
+{
+    return inline_parse_timestamp (anemone_timestamp_prefix_sse42, pp, pe, out_seconds, out_nanos);
+}
+
+ANEMONE_STATIC
+error_t parse_timestamp_scalar (const char **pp, const char *pe, int64_t *out_seconds, int64_t *out_nanos)
+{
+    return inline_parse_timestamp (anemone_timestamp_prefix_scalar, pp, pe, out_seconds, out_nanos);
+}
+
+ANEMONE_SSE42
+ANEMONE_STATIC
+ANEMONE_INLINE
+error_t anemone_parse_timestamp_field_sse42 (const char **pp, const char *pe, void *out, int64_t i)
+{
+    anemone_timestamp_t *values = out;
+    return inline_parse_timestamp (anemone_timestamp_prefix_sse42, pp, pe, &values[i].seconds, &values[i].nanos);
+}
+
+ANEMONE_STATIC
+ANEMONE_INLINE
+error_t anemone_parse_timestamp_field_scalar (const char **pp, const char *pe, void *out, int64_t i)
+{
+    anemone_timestamp_t *values = out;
+    return inline_parse_timestamp (anemone_timestamp_prefix_scalar, pp, pe, &values[i].seconds, &values[i].nanos);
+}
+
+ANEMONE_SSE42
+ANEMONE_STATIC
+int64_t parse_timestamp_column_sse42 (const char **pp, const char *pe, char sep, char term, int64_t n, anemone_timestamp_t *out, uint64_t *valid)
+{
+    return anemone_column_parse (anemone_parse_timestamp_field_sse42, anemone_column_delimiter_sse42, pp, pe, sep, term, n, out, sizeof (*out), valid);
+}
+
+ANEMONE_STATIC
+int64_t parse_timestamp_column_scalar (const char **pp, const char *pe, char sep, char term, int64_t n, anemone_timestamp_t *out, uint64_t *valid)
+{
+    return anemone_column_parse (anemone_parse_timestamp_field_scalar, anemone_column_delimiter_scalar, pp, pe, sep, term, n, out, sizeof (*out), valid);
+}
+
+static int64_t (*resolved_parse_gregorian_as_modified_julian_column) (const char **pp, const char *pe, char sep, char term, int64_t n, int64_t *out, uint64_t *valid) = parse_gregorian_as_modified_julian_column_scalar;
+static error_t (*resolved_parse_timestamp) (const char **pp, const char *pe, int64_t *out_seconds, int64_t *out_nanos) = parse_timestamp_scalar;
+static int64_t (*resolved_parse_timestamp_column) (const char **pp, const char *pe, char sep, char term, int64_t n, anemone_timestamp_t *out, uint64_t *valid) = parse_timestamp_column_scalar;
+
+ANEMONE_CONSTRUCTOR
+ANEMONE_STATIC
+void anemone_time_init ()
+{
+    if (anemone_cpu_supports (ANEMONE_CPU_SSE42)) {
+        resolved_parse_gregorian_as_modified_julian_column = parse_gregorian_as_modified_julian_column_sse42;
+        resolved_parse_timestamp = parse_timestamp_sse42;
+        resolved_parse_timestamp_column = parse_timestamp_column_sse42;
+    }
+}
+
+int64_t anemone_parse_gregorian_as_modified_julian_column (const char **pp, const char *pe, char sep, char term, int64_t n, int64_t *out, uint64_t *valid)
+{
+    return resolved_parse_gregorian_as_modified_julian_column (pp, pe, sep, term, n, out, valid);
+}
+
+error_t anemone_parse_timestamp (const char **pp, const char *pe, int64_t *out_seconds, int64_t *out_nanos)
+{
+    return resolved_parse_timestamp (pp, pe, out_seconds, out_nanos);
+}
+
+int64_t anemone_parse_timestamp_column (const char **pp, const char *pe, char sep, char term, int64_t n, anemone_timestamp_t *out, uint64_t *valid)
+{
+    return resolved_parse_timestamp_column (pp, pe, sep, term, n, out, valid);
+}
+
+error_t anemone_modified_julian_to_string (int64_t modified_julian, char *output_ptr)
+{
+    if (ANEMONE_UNLIKELY (modified_julian < ANEMONE_TIME_MODIFIED_JULIAN_MIN ||
+                          modified_julian > ANEMONE_TIME_MODIFIED_JULIAN_MAX)) {
+        return ANEMONE_TIME_INVALID_DATE;
+    }
+
+    int64_t year, month, day;
+    anemone_modified_julian_to_gregorian (modified_julian, &year, &month, &day);
+
+    // All eight digits at once as "yyyymmdd", then moved apart for the dashes
+    char digits[8];
+    anemone_u32_to_string_eight ((uint32_t) (year * 10000 + month * 100 + day), digits);
+
+    memcpy (output_ptr + 0, digits + 0, 4);
+    output_ptr[4] = '-';
+    memcpy (output_ptr + 5, digits + 4, 2);
+    output_ptr[7] = '-';
+    memcpy (output_ptr + 8, digits + 6, 2);
+
+    return ANEMONE_TIME_SUCCESS;
+}
+
+error_t anemone_modified_julian_column_to_string (anemone_buffer_t *buffer, const int64_t *values, int64_t n, uint8_t delim)
+{
+    static const int64_t chunk = 256;
+
+    for (int64_t i = 0; i < n; i += chunk) {
+        int64_t count = n - i < chunk ? n - i : chunk;
+
+        char *dst = (char *) anemone_buffer_reserve (buffer, count * (ANEMONE_TIME_DATE_STRING_SIZE + 1));
+        if (ANEMONE_UNLIKELY(dst == NULL)) return ANEMONE_TIME_OUT_OF_MEMORY;
+
+        char *p = dst;
+        for (int64_t j = 0; j < count; j++) {
+            if (ANEMONE_UNLIKELY (anemone_modified_julian_to_string (values[i + j], p))) {
+                anemone_buffer_commit (buffer, p - dst);
+                return ANEMONE_TIME_INVALID_DATE;
+            }
+            p += ANEMONE_TIME_DATE_STRING_SIZE;
+            *p++ = delim;
+        }
+
+        anemone_buffer_commit (buffer, p - dst);
+    }
+
+    return ANEMONE_TIME_SUCCESS;
+}
+
+error_t hs_anemone_modified_julian_column_to_string (anemone_mempool_t *pool, const int64_t *values, int64_t n, uint8_t delim, void **out, size_t *size)
+{
+    anemone_buffer_t buffer;
+    anemone_buffer_init (&buffer, pool, n * (ANEMONE_TIME_DATE_STRING_SIZE + 1));
+
+    error_t err = anemone_modified_julian_column_to_string (&buffer, values, n, delim);
+    if (err) return err;
+
+    *size = buffer.size;
+    *out = anemone_buffer_freeze (&buffer);
+    return ANEMONE_TIME_SUCCESS;
+}
+
 //
 // Functions to be called from Haskell only, the other side will assume we've
 // consumed 10 bytes if the call succeeds, this avoids a call to 'alloca' on
@@ -99,7 +528,7 @@ error_t anemone_parse_gregorian_as_modified_julian (
 int64_t anemone_parse_gregorian_hs (const char *p, const char *pe)
 {
     int64_t year0, month0, day0;
-    int64_t err = inline_parse_gregorian (&p, pe, &year0, &month0, &day0);
+    int64_t err = inline_parse_gregorian (anemone_date_prefix_scalar, &p, pe, &year0, &month0, &day0);
 
     int64_t year = (int16_t) year0;
     int64_t month = (int8_t) month0;
@@ -111,7 +540,7 @@ int64_t anemone_parse_gregorian_hs (const char *p, const char *pe)
 int64_t anemone_parse_gregorian_as_modified_julian_hs (const char *p, const char *pe)
 {
     int64_t year0, month0, day0;
-    int64_t err = inline_parse_gregorian (&p, pe, &year0, &month0, &day0);
+    int64_t err = inline_parse_gregorian (anemone_date_prefix_scalar, &p, pe, &year0, &month0, &day0);
 
     if (err) {
         int64_t year = (int16_t) year0;
@@ -121,7 +550,7 @@ int64_t anemone_parse_gregorian_as_modified_julian_hs (const char *p, const char
         return (err & 0xFFFFFFFF) | (year << 48) | (month << 40) | (day << 32);
     }
 
-    int64_t modified_julian0 = anemone_gregorian_to_modified_julian (year0, month0, day0);
+    int64_t modified_julian0 = anemone_gregorian_to_modified_julian_fast (year0, month0, day0);
 
     // truncate but keep sign
     int64_t modified_julian = (int32_t) modified_julian0;
@@ -129,3 +558,15 @@ int64_t anemone_parse_gregorian_as_modified_julian_hs (const char *p, const char
     // err == 0
     return modified_julian << 32;
 }
+
+//
+// A timestamp has no fixed length, so the number of bytes consumed is
+// returned in the upper half instead, with the error in the lower half.
+//
+int64_t anemone_parse_timestamp_hs (const char *p, const char *pe, anemone_timestamp_t *out)
+{
+    const char *q = p;
+    int64_t err = resolved_parse_timestamp (&q, pe, &out->seconds, &out->nanos);
+
+    return (err & 0xFFFFFFFF) | ((int64_t) (q - p) << 32);
+}
@@ -2,12 +2,33 @@
 #define __ANEMONE_TIME_H
 
 #include "anemone_base.h"
+#include "anemone_buffer.h"
 
 #include <stdio.h>
 
 #define ANEMONE_TIME_SUCCESS 0x0
 #define ANEMONE_TIME_INVALID_DATE 0x1
 #define ANEMONE_TIME_PARSE_ERROR 0x2
+#define ANEMONE_TIME_INVALID_TIME 0x3
+#define ANEMONE_TIME_OUT_OF_MEMORY 0x4
+
+// 1970-01-01, the day unix time starts from
+#define ANEMONE_TIME_UNIX_EPOCH_MODIFIED_JULIAN 40587
+
+// 0000-01-01 and 9999-12-31, the days with a four digit year
+#define ANEMONE_TIME_MODIFIED_JULIAN_MIN (-678941)
+#define ANEMONE_TIME_MODIFIED_JULIAN_MAX 2973483
+
+// "yyyy-mm-dd"
+#define ANEMONE_TIME_DATE_STRING_SIZE 10
+
+// An instant as unix time, the nanoseconds are always positive, so an instant
+// before 1970 has negative seconds and nanoseconds added on to that.
+typedef struct {
+  int64_t seconds;
+  // 0 <= nanos < 1000000000
+  int64_t nanos;
+} anemone_timestamp_t;
 
 ANEMONE_INLINE
 bool_t anemone_is_leap_year (int64_t year)
@@ -103,6 +124,70 @@ int64_t anemone_gregorian_to_modified_julian (int64_t year, int64_t month, int64
     return anemone_gregorian_to_julian (year, month, day) - 2400001;
 }
 
+//
+// The same as anemone_gregorian_to_modified_julian, but only for years 0 to
+// 9999, which is every year that can be parsed from "yyyy-mm-dd".
+//
+// This is the calendar algorithm from Neri & Schneider, "Euclidean affine
+// functions and their application to calendar algorithms". Counting from the
+// 1st of March puts the leap day at the end of the year, so the days before
+// a month are a linear function of it, and starting 400 years before year
+// zero keeps everything positive. That leaves divisions by 4, 32 and 100,
+// which are done with shifts and a multiply, where the julian formula above
+// needs four signed divisions.
+//
+ANEMONE_INLINE
+int64_t anemone_gregorian_to_modified_julian_fast (int64_t year, int64_t month, int64_t day)
+{
+    const uint32_t jan_feb = month <= 2;
+    const uint32_t y = (uint32_t) year + 400 - jan_feb;
+    const uint32_t m = jan_feb ? (uint32_t) month + 12 : (uint32_t) month;
+
+    // y / 100, exact for y < 43699
+    const uint32_t century = (y * 5243) >> 19;
+
+    const uint32_t year_days = ((1461 * y) >> 2) - century + (century >> 2);
+    const uint32_t month_days = (979 * m - 2919) >> 5;
+
+    // 1858-11-17 is day 824979
+    return (int64_t) (year_days + month_days + (uint32_t) day) - 824979;
+}
+
+//
+// The inverse of anemone_gregorian_to_modified_julian_fast, for days from
+// ANEMONE_TIME_MODIFIED_JULIAN_MIN to ANEMONE_TIME_MODIFIED_JULIAN_MAX. The
+// same paper's algorithm, the remaining divisions are by constants.
+//
+ANEMONE_INLINE
+void anemone_modified_julian_to_gregorian (int64_t modified_julian, int64_t *out_year, int64_t *out_month, int64_t *out_day)
+{
+    // days since the 1st of March, 400 years before year zero
+    const uint32_t days = (uint32_t) (modified_julian + 824978);
+
+    // the century and the day within it
+    const uint32_t n_century = 4 * days + 3;
+    const uint32_t century = n_century / 146097;
+    const uint32_t day_of_century = (n_century % 146097) / 4;
+
+    // the year within the century and the day within it, 2939745 / 2^32 is
+    // just above 4 / 1461 so the high half is the year and the low half is
+    // the remainder scaled up
+    const uint64_t n_year = (uint64_t) 2939745 * (4 * day_of_century + 3);
+    const uint32_t year_of_century = (uint32_t) (n_year >> 32);
+    const uint32_t day_of_year = (uint32_t) n_year / 2939745 / 4;
+
+    // months counted from March, so January and February are 13 and 14
+    const uint32_t n_month = 2141 * day_of_year + 197913;
+    const uint32_t month = n_month >> 16;
+    const uint32_t day = (n_month & 0xFFFF) / 2141;
+
+    const uint32_t jan_feb = day_of_year >= 306;
+
+    *out_year = (int64_t) (100 * century + year_of_century + jan_feb) - 400;
+    *out_month = jan_feb ? month - 12 : month;
+    *out_day = day + 1;
+}
+
 error_t anemone_parse_gregorian (
     const char **pp
   , const char *pe
@@ -117,4 +202,101 @@ error_t anemone_parse_gregorian_as_modified_julian (
   , int64_t *out_modified_julian
   );
 
+//
+// Parses a buffer of delimited yyyy-mm-dd dates as modified julian days in one call, as for a CSV or PSV
+// column.
+//
+// pp:
+//   pointer to start of buffer, moved past the last field parsed and its
+//   delimiter
+//
+// pe:
+//   pointer to end of buffer
+//
+// sep:
+//   field separator
+//
+// term:
+//   record terminator, a field ends at either this or 'sep'
+//
+// n:
+//   maximum number of fields to parse
+//
+// out:
+//   pointer to an array of at least 'n' values, the value of an invalid
+//   field is zero
+//
+// valid:
+//   pointer to a bitmap of at least (n + 63) / 64 words, bit i is set if
+//   field i was valid
+//
+// *returns*
+//   the number of fields parsed, which is less than 'n' if the end of the
+//   buffer was reached first
+//
+int64_t anemone_parse_gregorian_as_modified_julian_column (const char **pp, const char *pe, char sep, char term, int64_t n, int64_t *out, uint64_t *valid);
+
+//
+// Parses an ISO-8601 / RFC-3339 timestamp, "yyyy-mm-ddThh:mm:ss", followed by
+// an optional fraction of a second with any number of digits, and an optional
+// offset, 'Z' or "+hh:mm" / "-hh:mm". A timestamp without an offset is in UTC.
+//
+// Digits of the fraction past nanoseconds are skipped, so it is truncated
+// rather than rounded. A leap second, ss = 60, is the same instant as the
+// first second of the next minute.
+//
+// out_seconds / out_nanos:
+//   the instant as unix time, both zero if the timestamp was not valid
+//
+// *returns*
+//   ANEMONE_TIME_SUCCESS, with '*pp' moved past the timestamp
+//   ANEMONE_TIME_INVALID_DATE, if the date is not in the gregorian calendar,
+//     with '*pp' moved past the timestamp
+//   ANEMONE_TIME_INVALID_TIME, if the time of day or the offset is out of
+//     range, with '*pp' moved past the timestamp
+//   ANEMONE_TIME_PARSE_ERROR, with '*pp' left where it was
+//
+error_t anemone_parse_timestamp (
+    const char **pp
+  , const char *pe
+  , int64_t *out_seconds
+  , int64_t *out_nanos
+  );
+
+//
+// Parses a buffer of delimited timestamps in one call, the same as
+// anemone_parse_gregorian_as_modified_julian_column. Each field is as for
+// anemone_parse_timestamp, an invalid field is zero seconds and nanoseconds.
+//
+int64_t anemone_parse_timestamp_column (const char **pp, const char *pe, char sep, char term, int64_t n, anemone_timestamp_t *out, uint64_t *valid);
+
+//
+// Writes a day as "yyyy-mm-dd", which is exactly ANEMONE_TIME_DATE_STRING_SIZE
+// bytes, not null terminated.
+//
+// *returns*
+//   ANEMONE_TIME_SUCCESS
+//   ANEMONE_TIME_INVALID_DATE, if the year does not have four digits, in
+//     which case nothing is written
+//
+error_t anemone_modified_julian_to_string (int64_t modified_julian, char *output_ptr);
+
+//
+// Writes a column of days as "yyyy-mm-dd" to the end of a buffer, each
+// followed by 'delim', the inverse of
+// anemone_parse_gregorian_as_modified_julian_column.
+//
+// *returns*
+//   ANEMONE_TIME_SUCCESS
+//   ANEMONE_TIME_INVALID_DATE, if a day is outside the four digit years
+//   ANEMONE_TIME_OUT_OF_MEMORY, if the buffer could not be grown
+//
+//   on failure the days before the one which failed are kept
+//
+error_t anemone_modified_julian_column_to_string (anemone_buffer_t *buffer, const int64_t *values, int64_t n, uint8_t delim);
+
+// Write a column to a new buffer in the pool, for calling from Haskell,
+// setting 'out' and 'size' on success.
+error_t hs_anemone_modified_julian_column_to_string (anemone_mempool_t *pool, const int64_t *values, int64_t n, uint8_t delim, void **out, size_t *size);
+
 #endif//__ANEMONE_ATOI_H
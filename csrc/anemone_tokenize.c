@@ -0,0 +1,235 @@
+#include "anemone_tokenize.h"
+#include "anemone_cpu.h"
+#include "anemone_sse.h"
+
+#include <string.h>
+
+// The bits of one 64 byte block which match each of the bytes.
+typedef struct {
+  uint64_t delims;
+  uint64_t terms;
+  uint64_t quotes;
+} tokenize_masks_t;
+
+typedef void (*tokenize_block_t) (const char *block, char sep, char term, char quote, tokenize_masks_t *masks);
+
+ANEMONE_STATIC
+ANEMONE_INLINE
+uint64_t tokenize_movemask_sse2 (__m128i m0, __m128i m1, __m128i m2, __m128i m3, __m128i c)
+{
+    const uint64_t b0 = (uint32_t) _mm_movemask_epi8 (_mm_cmpeq_epi8 (m0, c));
+    const uint64_t b1 = (uint32_t) _mm_movemask_epi8 (_mm_cmpeq_epi8 (m1, c));
+    const uint64_t b2 = (uint32_t) _mm_movemask_epi8 (_mm_cmpeq_epi8 (m2, c));
+    const uint64_t b3 = (uint32_t) _mm_movemask_epi8 (_mm_cmpeq_epi8 (m3, c));
+    return b0 | b1 << 16 | b2 << 32 | b3 << 48;
+}
+
+ANEMONE_STATIC
+ANEMONE_INLINE
+void tokenize_block_sse2 (const char *block, char sep, char term, char quote, tokenize_masks_t *masks)
+{
+    const __m128i m0 = anemone_sse_load128 (block);
+    const __m128i m1 = anemone_sse_load128 (block + 16);
+    const __m128i m2 = anemone_sse_load128 (block + 32);
+    const __m128i m3 = anemone_sse_load128 (block + 48);
+
+    const uint64_t terms = tokenize_movemask_sse2 (m0, m1, m2, m3, _mm_set1_epi8 (term));
+    masks->delims = terms | tokenize_movemask_sse2 (m0, m1, m2, m3, _mm_set1_epi8 (sep));
+    masks->terms = terms;
+    masks->quotes = tokenize_movemask_sse2 (m0, m1, m2, m3, _mm_set1_epi8 (quote));
+}
+
+ANEMONE_AVX2
+ANEMONE_STATIC
+ANEMONE_INLINE
+uint64_t tokenize_movemask_avx2 (__m256i m0, __m256i m1, __m256i c)
+{
+    const uint64_t b0 = (uint32_t) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (m0, c));
+    const uint64_t b1 = (uint32_t) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (m1, c));
+    return b0 | b1 << 32;
+}
+
+ANEMONE_AVX2
+ANEMONE_STATIC
+ANEMONE_INLINE
+void tokenize_block_avx2 (const char *block, char sep, char term, char quote, tokenize_masks_t *masks)
+{
+    const __m256i m0 = _mm256_loadu_si256 ((const __m256i *) block);
+    const __m256i m1 = _mm256_loadu_si256 ((const __m256i *) (block + 32));
+
+    const uint64_t terms = tokenize_movemask_avx2 (m0, m1, _mm256_set1_epi8 (term));
+    masks->delims = terms | tokenize_movemask_avx2 (m0, m1, _mm256_set1_epi8 (sep));
+    masks->terms = terms;
+    masks->quotes = tokenize_movemask_avx2 (m0, m1, _mm256_set1_epi8 (quote));
+}
+
+// Bit i of the result is the XOR of bits 0 to i of 'x'.
+ANEMONE_STATIC
+ANEMONE_INLINE
+uint64_t tokenize_prefix_xor (uint64_t x)
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+//
+// Find the delimiters outside quotes in the block at 'p', of which only the
+// first 'len' bytes are input. A short block is copied to a buffer padded
+// with zeros, and the bits for the padding are cleared.
+//
+ANEMONE_STATIC
+ANEMONE_INLINE
+void tokenize_next (tokenize_block_t block, uint64_t *in_quote, const char *p, int64_t len, char sep, char term, int quote, tokenize_masks_t *masks)
+{
+    if (ANEMONE_LIKELY (len >= 64)) {
+        block (p, sep, term, (char) quote, masks);
+    } else {
+        char buffer[64];
+        memset (buffer, 0, sizeof (buffer));
+        memcpy (buffer, p, len);
+        block (buffer, sep, term, (char) quote, masks);
+
+        const uint64_t valid = (1ULL << len) - 1;
+        masks->delims &= valid;
+        masks->terms &= valid;
+        masks->quotes &= valid;
+    }
+
+    if (quote == ANEMONE_TOKENIZE_NO_QUOTE) {
+        return;
+    }
+
+    // the top bit is the parity of all the quotes, including the ones before
+    // this block, so it carries to the next one
+    const uint64_t inside = tokenize_prefix_xor (masks->quotes) ^ *in_quote;
+    *in_quote = (uint64_t) ((int64_t) inside >> 63);
+
+    masks->delims &= ~inside;
+    masks->terms &= ~inside;
+}
+
+ANEMONE_STATIC
+ANEMONE_INLINE
+int64_t tokenize_expand_word (uint64_t word, int64_t base, int64_t *offsets)
+{
+    int64_t n = 0;
+    while (word) {
+        offsets[n++] = base + __builtin_ctzll (word);
+        word &= word - 1;
+    }
+    return n;
+}
+
+ANEMONE_STATIC
+ANEMONE_INLINE
+void tokenize_bitmap (tokenize_block_t block, anemone_tokenize_state_t *state, const char *p, const char *pe, char sep, char term, int quote, uint64_t *delims, uint64_t *terms)
+{
+    uint64_t in_quote = state->in_quote;
+
+    for (int64_t i = 0; p < pe; i++, p += 64) {
+        tokenize_masks_t masks;
+        tokenize_next (block, &in_quote, p, pe - p, sep, term, quote, &masks);
+
+        delims[i] = masks.delims;
+        if (terms) {
+            terms[i] = masks.terms;
+        }
+    }
+
+    state->in_quote = in_quote;
+}
+
+ANEMONE_STATIC
+ANEMONE_INLINE
+int64_t tokenize_offsets (tokenize_block_t block, anemone_tokenize_state_t *state, const char **pp, const char *pe, char sep, char term, int quote, int64_t *offsets, int64_t max)
+{
+    const char *start = *pp;
+    const char *p = start;
+    uint64_t in_quote = state->in_quote;
+    int64_t n = 0;
+
+    while (p < pe && max - n >= 64) {
+        tokenize_masks_t masks;
+        tokenize_next (block, &in_quote, p, pe - p, sep, term, quote, &masks);
+
+        n += tokenize_expand_word (masks.delims, p - start, offsets + n);
+        p = pe - p < 64 ? pe : p + 64;
+    }
+
+    state->in_quote = in_quote;
+    *pp = p;
+    return n;
+}
+
+ANEMONE_STATIC
+void tokenize_bitmap_sse2 (anemone_tokenize_state_t *state, const char *p, const char *pe, char sep, char term, int quote, uint64_t *delims, uint64_t *terms)
+{
+    tokenize_bitmap (tokenize_block_sse2, state, p, pe, sep, term, quote, delims, terms);
+}
+
+ANEMONE_AVX2
+ANEMONE_STATIC
+void tokenize_bitmap_avx2 (anemone_tokenize_state_t *state, const char *p, const char *pe, char sep, char term, int quote, uint64_t *delims, uint64_t *terms)
+{
+    tokenize_bitmap (tokenize_block_avx2, state, p, pe, sep, term, quote, delims, terms);
+}
+
+ANEMONE_STATIC
+int64_t tokenize_offsets_sse2 (anemone_tokenize_state_t *state, const char **pp, const char *pe, char sep, char term, int quote, int64_t *offsets, int64_t max)
+{
+    return tokenize_offsets (tokenize_block_sse2, state, pp, pe, sep, term, quote, offsets, max);
+}
+
+ANEMONE_AVX2
+ANEMONE_STATIC
+int64_t tokenize_offsets_avx2 (anemone_tokenize_state_t *state, const char **pp, const char *pe, char sep, char term, int quote, int64_t *offsets, int64_t max)
+{
+    return tokenize_offsets (tokenize_block_avx2, state, pp, pe, sep, term, quote, offsets, max);
+}
+
+// SSE2 is always there on x86-64, so it is the fallback rather than scalar code
+static void (*resolved_tokenize_bitmap) (anemone_tokenize_state_t *state, const char *p, const char *pe, char sep, char term, int quote, uint64_t *delims, uint64_t *terms) = tokenize_bitmap_sse2;
+static int64_t (*resolved_tokenize_offsets) (anemone_tokenize_state_t *state, const char **pp, const char *pe, char sep, char term, int quote, int64_t *offsets, int64_t max) = tokenize_offsets_sse2;
+
+ANEMONE_CONSTRUCTOR
+ANEMONE_STATIC
+void anemone_tokenize_dispatch_init ()
+{
+    if (anemone_cpu_supports (ANEMONE_CPU_AVX2)) {
+        resolved_tokenize_bitmap = tokenize_bitmap_avx2;
+        resolved_tokenize_offsets = tokenize_offsets_avx2;
+    }
+}
+
+void anemone_tokenize_bitmap (anemone_tokenize_state_t *state, const char *p, const char *pe, char sep, char term, int quote, uint64_t *delims, uint64_t *terms)
+{
+    resolved_tokenize_bitmap (state, p, pe, sep, term, quote, delims, terms);
+}
+
+int64_t anemone_tokenize_offsets (anemone_tokenize_state_t *state, const char **pp, const char *pe, char sep, char term, int quote, int64_t *offsets, int64_t max)
+{
+    return resolved_tokenize_offsets (state, pp, pe, sep, term, quote, offsets, max);
+}
+
+int64_t anemone_tokenize_count (const uint64_t *bitmap, int64_t words)
+{
+    int64_t n = 0;
+    for (int64_t i = 0; i < words; i++) {
+        n += __builtin_popcountll (bitmap[i]);
+    }
+    return n;
+}
+
+int64_t anemone_tokenize_expand (const uint64_t *bitmap, int64_t words, int64_t *offsets)
+{
+    int64_t n = 0;
+    for (int64_t i = 0; i < words; i++) {
+        n += tokenize_expand_word (bitmap[i], i * 64, offsets + n);
+    }
+    return n;
+}
@@ -0,0 +1,79 @@
+#ifndef __ANEMONE_TOKENIZE_H
+#define __ANEMONE_TOKENIZE_H
+
+//
+// Finding the delimiters of a CSV-like buffer, 64 bytes at a time.
+//
+// Each block of 64 bytes is compared against the separator, terminator and
+// quote bytes with SSE2 (or AVX2 where the CPU has it), giving one bit per
+// byte for each. A delimiter is only structural when it is outside quotes,
+// and a byte is inside quotes when an odd number of quotes come before it,
+// which is the prefix XOR of the quote bits. An escaped quote is written as
+// two quotes, which toggle the state twice, so they need no special case.
+//
+// The state carries whether the previous block ended inside quotes, so a
+// large buffer can be done in pieces. Every piece but the last must be a
+// multiple of 64 bytes long.
+//
+// The result is either a bitmap with one bit per byte of input, or the
+// offsets of the delimiters, which say where each field ends and so where
+// the next one starts for the column parsers.
+//
+
+#include "anemone_base.h"
+
+// Quote byte for input which has no quoted fields
+#define ANEMONE_TOKENIZE_NO_QUOTE (-1)
+
+typedef struct {
+  // All ones if the input so far ends inside quotes, zero otherwise
+  uint64_t in_quote;
+} anemone_tokenize_state_t;
+
+ANEMONE_INLINE
+void anemone_tokenize_init (anemone_tokenize_state_t *state)
+{
+    state->in_quote = 0;
+}
+
+//
+// Find the separators and terminators outside quotes between 'p' and 'pe'.
+//
+// The quote is a byte, or ANEMONE_TOKENIZE_NO_QUOTE.
+//
+// delims:
+//   bitmap of (pe - p + 63) / 64 words, bit i is set if byte i is a
+//   separator or terminator outside quotes
+//
+// terms:
+//   bitmap of the same size for the terminators only, or null if it is not
+//   needed
+//
+void anemone_tokenize_bitmap (anemone_tokenize_state_t *state, const char *p, const char *pe, char sep, char term, int quote, uint64_t *delims, uint64_t *terms);
+
+// The number of bits set in 'words' words of a bitmap.
+int64_t anemone_tokenize_count (const uint64_t *bitmap, int64_t words);
+
+//
+// Write the index of every bit set in 'words' words of a bitmap to 'offsets',
+// which must have room for anemone_tokenize_count of them, returning how
+// many there were.
+//
+int64_t anemone_tokenize_expand (const uint64_t *bitmap, int64_t words, int64_t *offsets);
+
+//
+// Find the separators and terminators outside quotes as for
+// anemone_tokenize_bitmap, writing their offsets from '*pp' to 'offsets'.
+//
+// The input is done a block of 64 bytes at a time, and only while there is
+// room for a whole block's worth of offsets, so 'max' must be at least 64
+// for any progress to be made. '*pp' is moved to the end of the last block
+// done, and the state is updated to match, so it can be called again with
+// the rest of the input.
+//
+// *returns*
+//   the number of offsets written
+//
+int64_t anemone_tokenize_offsets (anemone_tokenize_state_t *state, const char **pp, const char *pe, char sep, char term, int quote, int64_t *offsets, int64_t max);
+
+#endif//__ANEMONE_TOKENIZE_H
@@ -1,5 +1,7 @@
 #include "anemone_vint.h"
 #include "anemone_twiddle.h"
+#include "anemone_cpu.h"
+#include "anemone_sse.h"
 
 #include <string.h>
 
@@ -99,6 +101,118 @@ uint8_t* vint_write (int64_t v, uint8_t *pout)
     return pout;
 }
 
+//
+// The number of bytes after the first which 'vint_write' uses for a
+// multi-byte integer, minus one. This is the number of whole bytes below the
+// highest set bit of 'v', or of '~v' for negative integers.
+//
+ANEMONE_STATIC
+ANEMONE_INLINE
+int64_t vint_extra (int64_t v)
+{
+    uint64_t u = v ^ (v >> 63);
+    return (64 - __builtin_clzll (u | 1)) >> 3;
+}
+
+ANEMONE_STATIC
+ANEMONE_INLINE
+bool_t vint_wide (int64_t v)
+{
+    // v < -112 || v > 127
+    return (uint64_t) v + 112 >= 240;
+}
+
+//
+// The size of the integer, computed with arithmetic rather than a branch,
+// as the sizes in an array are usually unpredictable.
+//
+ANEMONE_STATIC
+ANEMONE_INLINE
+int64_t vint_size (int64_t v)
+{
+    return 1 + ((1 + vint_extra (v)) & -(int64_t) vint_wide (v));
+}
+
+//
+// Writes the same bytes as 'vint_write' without branching on the size, by
+// always storing eight bytes after the first. There must be
+// ANEMONE_MAX_VINT_SIZE bytes available at 'pout', and the bytes past the
+// integer are garbage, for the next integer to overwrite.
+//
+ANEMONE_STATIC
+ANEMONE_INLINE
+uint8_t* vint_write_wide (int64_t v, uint8_t *pout)
+{
+    int64_t sign = v >> 63;
+    int64_t extra = vint_extra (v);
+    int64_t wide = vint_wide (v);
+
+    // -113 - extra for positive integers, and -121 - extra for negative,
+    // selected with a mask as compilers like to branch on a ternary here
+    uint8_t prefix = -113 + (sign & -8) - extra;
+    *pout = (uint8_t) v ^ (((uint8_t) v ^ prefix) & (uint8_t) -wide);
+
+    // the low 'extra + 1' bytes of 'v' (or '~v'), most significant first
+    uint64_t bytes = anemone_bswap64 ((uint64_t) (v ^ sign) << (8 * (7 - extra)));
+    memcpy (pout + 1, &bytes, 8);
+
+    return pout + 1 + ((1 + extra) & -wide);
+}
+
+//
+// Checks whether the eight integers at 'p' each fit in a single byte.
+//
+ANEMONE_STATIC
+ANEMONE_INLINE
+bool_t vint_singles8 (const int64_t *p)
+{
+    uint64_t wide = 0;
+
+    for (int i = 0; i < 8; i++) {
+        wide |= vint_wide (p[i]);
+    }
+
+    return !wide;
+}
+
+//
+// Writes the eight single-byte integers at 'p' with one store.
+//
+ANEMONE_STATIC
+ANEMONE_INLINE
+void vint_narrow8 (const int64_t *p, uint8_t *pout)
+{
+    uint8_t bytes[8];
+
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = p[i];
+    }
+
+    memcpy (pout, bytes, 8);
+}
+
+//
+// Writes eight integers with 'vint_write_wide', there must be
+// 8 * ANEMONE_MAX_VINT_SIZE bytes available at 'pout'. Runs of single-byte
+// integers are common, so when all eight fit in a byte they are written with
+// one store.
+//
+ANEMONE_STATIC
+ANEMONE_INLINE
+uint8_t* vint_write_wide8 (const int64_t *p, uint8_t *pout)
+{
+    if (vint_singles8 (p)) {
+        vint_narrow8 (p, pout);
+        return pout + 8;
+    }
+
+    for (int i = 0; i < 8; i++) {
+        pout = vint_write_wide (p[i], pout);
+    }
+
+    return pout;
+}
+
 ANEMONE_STATIC
 ANEMONE_INLINE
 bool_t vint_single (int8_t first)
@@ -154,14 +268,157 @@ error_t vint_read (const uint8_t **pp, const uint8_t *pe, int64_t *out)
     return 0;
 }
 
+//
+// Reads a multi-byte integer whose first byte is at 'p', there must be at
+// least ANEMONE_MAX_VINT_SIZE bytes readable from 'p'.
+//
+// Rather than looping over the bytes, this loads all eight which could
+// follow the first byte, swaps them to big-endian order, and shifts away
+// the ones which belong to the next integer.
+//
+ANEMONE_STATIC
+ANEMONE_INLINE
+const uint8_t *vint_read_wide (const uint8_t *p, int64_t *out)
+{
+    int8_t first = *p;
+    int remaining = vint_remaining (first);
+
+    uint64_t bytes;
+    memcpy (&bytes, p + 1, 8);
+
+    int64_t x = anemone_bswap64 (bytes) >> (64 - 8 * remaining);
+
+    *out = vint_negative (first) ? ~x : x;
+
+    return p + 1 + remaining;
+}
+
+//
+// Sign-extends the first 'count' bytes of 'v', which are all single-byte
+// integers, and writes them to 'out'. Only writes 'count' integers, so that
+// the output past a corrupt integer is left alone, as in the scalar loop.
+//
+ANEMONE_SSE42
+ANEMONE_STATIC
+ANEMONE_INLINE
+void vint_widen (__m128i v, int count, int64_t *out)
+{
+    int i = 0;
+
+    for (; i + 2 <= count; i += 2) {
+        _mm_storeu_si128 ((__m128i *)(out + i), _mm_cvtepi8_epi64 (v));
+        v = _mm_srli_si128 (v, 2);
+    }
+
+    if (i < count) {
+        _mm_storel_epi64 ((__m128i *)(out + i), _mm_cvtepi8_epi64 (v));
+    }
+}
+
+//
+// Advances '*pp' past up to 'n' integers, stopping early at 'pe' or at an
+// integer which is cut off by 'pe'.
+//
+// Only the first byte of each integer is looked at, so like the vectorised
+// part of 'anemone_read_vint_array', this classifies 16 bytes at a time and
+// skips a run of single-byte integers in one go. It only needs SSE2, which
+// every x86-64 CPU has.
+//
+// *returns*
+//   the number of integers skipped
+//
+ANEMONE_STATIC
+ANEMONE_INLINE
+int64_t vint_scan (const uint8_t **pp, const uint8_t *pe, int64_t n)
+{
+    const uint8_t *p = *pp;
+    int64_t i = 0;
+
+    const __m128i high_nibble = _mm_set1_epi8 (0xF0);
+    const __m128i prefix_nibble = _mm_set1_epi8 (0x80);
+
+    while (n - i >= 16 && pe - p >= 16) {
+        __m128i v = anemone_sse_load128 (p);
+
+        uint32_t prefixes = _mm_movemask_epi8 (
+            _mm_cmpeq_epi8 (_mm_and_si128 (v, high_nibble), prefix_nibble));
+
+        int singles = __builtin_ctz (prefixes | 0x10000);
+        p += singles;
+        i += singles;
+
+        if (singles < 16 && pe - p >= ANEMONE_MAX_VINT_SIZE) {
+            p += 1 + vint_remaining (*p);
+            i++;
+        }
+    }
+
+    for (; i < n && p < pe; i++) {
+        int8_t first = *p;
+        int64_t size = vint_single (first) ? 1 : 1 + vint_remaining (first);
+
+        if (pe - p < size) break;
+
+        p += size;
+    }
+
+    *pp = p;
+    return i;
+}
+
 uint8_t* anemone_write_vint (int64_t x, uint8_t *pout)
 {
-    return vint_write (x, pout);
+    return vint_write_wide (x, pout);
 }
 
 uint8_t* anemone_write_vint_array (int64_t n, const int64_t *p, uint8_t *pout)
 {
-    for (int i = 0; i < n; i++) {
+    int64_t i = 0;
+
+    // the buffer has room for every integer to be the largest, so every
+    // integer has ANEMONE_MAX_VINT_SIZE bytes available
+    for (; i + 8 <= n; i += 8) {
+        pout = vint_write_wide8 (p + i, pout);
+    }
+
+    for (; i < n; i++) {
+        pout = vint_write_wide (p[i], pout);
+    }
+
+    return pout;
+}
+
+int64_t anemone_vint_size (int64_t x)
+{
+    return vint_size (x);
+}
+
+int64_t anemone_vint_size_array (int64_t n, const int64_t *p)
+{
+    int64_t size = 0;
+
+    for (int64_t i = 0; i < n; i++) {
+        size += vint_size (p[i]);
+    }
+
+    return size;
+}
+
+uint8_t* anemone_write_vint_array_sized (int64_t n, const int64_t *p, uint8_t *pout, const uint8_t *pe)
+{
+    int64_t i = 0;
+
+    // the bytes past each integer are overwritten by the ones after it, so
+    // the wide writes only need to stay inside the buffer
+    for (; i + 8 <= n && pe - pout >= 8 * ANEMONE_MAX_VINT_SIZE; i += 8) {
+        pout = vint_write_wide8 (p + i, pout);
+    }
+
+    for (; i < n && pe - pout >= ANEMONE_MAX_VINT_SIZE; i++) {
+        pout = vint_write_wide (p[i], pout);
+    }
+
+    for (; i < n; i++) {
         pout = vint_write (p[i], pout);
     }
 
@@ -173,12 +430,75 @@ error_t anemone_read_vint (const uint8_t **pp, const uint8_t *pe, int64_t *pout)
     return vint_read (pp, pe, pout);
 }
 
+//
+// Decodes integers while there are 16 bytes of input, classifying all of them
+// at once: a byte is the first of a multi-byte integer iff its high nibble is
+// 0x8 (-113 to -128). Each step sign-extends the run of single-byte integers
+// at the start of the window in one go, then reads the multi-byte integer
+// which ends the run with a single load, without branching on which comes
+// first. The load is only done when all ANEMONE_MAX_VINT_SIZE bytes it could
+// need are there, so only the scalar loop on the tail can find corrupt input.
+//
+// *returns*
+//   the number of integers decoded
+//
+ANEMONE_SSE42
+ANEMONE_STATIC
+int64_t vint_read_array_sse42 (const uint8_t **pp, const uint8_t *pe, int64_t n, int64_t *pout)
+{
+    const uint8_t *p = *pp;
+    int64_t i = 0;
+
+    const __m128i high_nibble = _mm_set1_epi8 (0xF0);
+    const __m128i prefix_nibble = _mm_set1_epi8 (0x80);
+
+    while (n - i >= 16 && pe - p >= 16) {
+        __m128i v = anemone_sse_load128 (p);
+
+        uint32_t prefixes = _mm_movemask_epi8 (
+            _mm_cmpeq_epi8 (_mm_and_si128 (v, high_nibble), prefix_nibble));
+
+        int singles = __builtin_ctz (prefixes | 0x10000);
+        vint_widen (v, singles, pout + i);
+        p += singles;
+        i += singles;
+
+        if (singles < 16 && pe - p >= ANEMONE_MAX_VINT_SIZE) {
+            p = vint_read_wide (p, pout + i);
+            i++;
+        }
+    }
+
+    *pp = p;
+    return i;
+}
+
+// Decodes nothing, so without SSE4.2 the scalar loop in
+// anemone_read_vint_array decodes the whole array.
+ANEMONE_STATIC
+int64_t vint_read_array_none (const uint8_t **pp, const uint8_t *pe, int64_t n, int64_t *pout)
+{
+    return 0;
+}
+
+static int64_t (*resolved_vint_read_array) (const uint8_t **pp, const uint8_t *pe, int64_t n, int64_t *pout) = vint_read_array_none;
+
+ANEMONE_CONSTRUCTOR
+ANEMONE_STATIC
+void anemone_vint_init ()
+{
+    if (anemone_cpu_supports (ANEMONE_CPU_SSE42)) {
+        resolved_vint_read_array = vint_read_array_sse42;
+    }
+}
+
 error_t anemone_read_vint_array (const uint8_t **pp, const uint8_t *pe, int64_t n, int64_t *pout)
 {
     const uint8_t *p = *pp;
     error_t err = 0;
+    int64_t i = resolved_vint_read_array (&p, pe, n, pout);
 
-    for (int i = 0; i < n; i++) {
+    for (; i < n; i++) {
         err = vint_read (&p, pe, pout + i);
         if (err) goto done;
     }
@@ -187,3 +507,49 @@ done:
     *pp = p;
     return err;
 }
+
+error_t anemone_vint_skip (const uint8_t **pp, const uint8_t *pe, int64_t n)
+{
+    const uint8_t *p = *pp;
+
+    error_t err = vint_scan (&p, pe, n) != n;
+
+    *pp = p;
+    return err;
+}
+
+error_t anemone_vint_count (const uint8_t *p, const uint8_t *pe, int64_t *pout)
+{
+    *pout = vint_scan (&p, pe, INT64_MAX);
+
+    return p != pe;
+}
+
+error_t anemone_vint_index (const uint8_t *p, const uint8_t *pe, int64_t stride, int64_t *offsets)
+{
+    const uint8_t *start = p;
+
+    if (stride < 1) return 1;
+
+    for (int64_t k = 0; p < pe; k++) {
+        offsets[k] = p - start;
+
+        // a short stride is only allowed at the end of the stream
+        if (vint_scan (&p, pe, stride) != stride && p != pe) return 1;
+    }
+
+    return 0;
+}
+
+error_t anemone_vint_seek (const uint8_t *p, const uint8_t *pe, int64_t stride, int64_t entries, const int64_t *offsets, int64_t k, const uint8_t **pout)
+{
+    if (k < 0 || stride < 1 || k / stride >= entries) return 1;
+
+    const uint8_t *q = p + offsets[k / stride];
+    int64_t remaining = k % stride;
+
+    if (vint_scan (&q, pe, remaining) != remaining || q == pe) return 1;
+
+    *pout = q;
+    return 0;
+}
@@ -38,6 +38,55 @@ uint8_t* anemone_write_vint (int64_t x, uint8_t *pout);
 //
 uint8_t* anemone_write_vint_array (int64_t n, const int64_t *p, uint8_t *pout);
 
+//
+// Calculates the number of bytes 'anemone_write_vint' uses for an integer.
+//
+// x:
+//   an integer to pack
+//
+// *returns*
+//   the size of the packed integer, between 1 and ANEMONE_MAX_VINT_SIZE
+//
+int64_t anemone_vint_size (int64_t x);
+
+//
+// Calculates the exact number of bytes 'anemone_write_vint_array' uses for
+// an array of integers.
+//
+// n:
+//   number of integers to pack
+//
+// p:
+//   pointer to start of integers
+//
+// *returns*
+//   the total size of the packed integers
+//
+int64_t anemone_vint_size_array (int64_t n, const int64_t *p);
+
+//
+// Writes an array of Hadoop-style zero-compressed integers to a buffer which
+// only needs to be as large as the packed integers.
+//
+// n:
+//   number of integers to pack
+//
+// p:
+//   pointer to start of integers
+//
+// pout:
+//   pointer to a buffer large enough to hold the packed integers
+//   (anemone_vint_size_array (n, p))
+//
+// pe:
+//   pointer to end of buffer
+//
+// *returns*
+//   pointer to the part of the 'pout' buffer which is unused
+//   (number of bytes used = return value - pout)
+//
+uint8_t* anemone_write_vint_array_sized (int64_t n, const int64_t *p, uint8_t *pout, const uint8_t *pe);
+
 //
 // Reads a single Hadoop-style zero-compressed integer.
 //
@@ -75,4 +124,99 @@ error_t anemone_read_vint (const uint8_t **pp, const uint8_t *pe, int64_t *pout)
 //
 error_t anemone_read_vint_array (const uint8_t **pp, const uint8_t *pe, int64_t n, int64_t *pout);
 
+//
+// Skips over an array of Hadoop-style zero-compressed integers, without
+// decoding them.
+//
+// pp:
+//   pointer to start of buffer
+//
+// pe:
+//   pointer to end of buffer
+//
+// n:
+//   number of integers to skip
+//
+// *returns*
+//   zero on success, non-zero if the input was corrupt, in which case 'pp'
+//   points to the integer which was cut off, as for 'anemone_read_vint_array'.
+//
+error_t anemone_vint_skip (const uint8_t **pp, const uint8_t *pe, int64_t n);
+
+//
+// Counts the Hadoop-style zero-compressed integers in a buffer, without
+// decoding them.
+//
+// p:
+//   pointer to start of buffer
+//
+// pe:
+//   pointer to end of buffer
+//
+// pout:
+//   pointer to an integer for the number of integers in the buffer
+//
+// *returns*
+//   zero on success, non-zero if the last integer was cut off by the end of
+//   the buffer, in which case 'pout' does not count it.
+//
+error_t anemone_vint_count (const uint8_t *p, const uint8_t *pe, int64_t *pout);
+
+//
+// Builds a sparse index of a buffer of Hadoop-style zero-compressed integers,
+// so that 'anemone_vint_seek' can find an integer by skipping at most
+// 'stride - 1' others.
+//
+// p:
+//   pointer to start of buffer
+//
+// pe:
+//   pointer to end of buffer
+//
+// stride:
+//   number of integers between entries in the index
+//
+// offsets:
+//   pointer to a buffer large enough to hold the index, which is one entry
+//   per 'stride' integers, rounded up ((count + stride - 1) / stride, where
+//   count is from 'anemone_vint_count'). Entry k is the offset in bytes of
+//   integer 'k * stride'.
+//
+// *returns*
+//   zero on success, non-zero if the input was corrupt or 'stride' is not
+//   positive.
+//
+error_t anemone_vint_index (const uint8_t *p, const uint8_t *pe, int64_t stride, int64_t *offsets);
+
+//
+// Finds an integer in a buffer of Hadoop-style zero-compressed integers,
+// using an index from 'anemone_vint_index'.
+//
+// p:
+//   pointer to start of buffer
+//
+// pe:
+//   pointer to end of buffer
+//
+// stride:
+//   number of integers between entries in the index
+//
+// entries:
+//   number of entries in the index
+//
+// offsets:
+//   pointer to the index
+//
+// k:
+//   the integer to find, counting from zero
+//
+// pout:
+//   pointer for the start of integer 'k', which can be read with
+//   'anemone_read_vint'
+//
+// *returns*
+//   zero on success, non-zero if there is no integer 'k' in the buffer.
+//
+error_t anemone_vint_seek (const uint8_t *p, const uint8_t *pe, int64_t stride, int64_t entries, const int64_t *offsets, int64_t k, const uint8_t **pout);
+
 #endif//__ANEMONE_VINT_H
@@ -0,0 +1,58 @@
+#include "anemone_buffer.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+// Test that appending to a buffer keeps its contents, and that it grows in place
+// while it is the only thing being allocated and fits in a block.
+// Every interleave appends an unrelated allocation from the same pool, forcing copies.
+// On failure, prints to stderr and returns false.
+bool_t test_buffer_append(int iterations, size_t chunk_bytes, int interleave)
+{
+  anemone_mempool_t *pool = anemone_mempool_create();
+  uint8_t chunk[chunk_bytes + 1];
+
+  anemone_buffer_t buffer;
+  anemone_buffer_init (&buffer, pool, 1);
+  uint8_t *start = buffer.data;
+
+  for (int i = 0; i != iterations; ++i) {
+    memset (chunk, i, chunk_bytes);
+    if (anemone_buffer_append (&buffer, chunk, chunk_bytes) || anemone_buffer_append_byte (&buffer, i)) {
+      fprintf (stderr, "iteration %d: append failed\n", i);
+      return 0;
+    }
+
+    if (interleave > 0 && i % interleave == 0) {
+      memset (anemone_mempool_alloc (pool, chunk_bytes), 0xFF, chunk_bytes);
+    }
+  }
+
+  size_t size = buffer.size;
+  uint8_t *data = anemone_buffer_freeze (&buffer);
+
+  // Allocating after freezing must not overwrite the contents
+  memset (anemone_mempool_alloc (pool, 1000), 0xFF, 1000);
+
+  if (size != iterations * (chunk_bytes + 1)) {
+    fprintf (stderr, "buffer has %zu bytes, expected %zu\n", size, iterations * (chunk_bytes + 1));
+    return 0;
+  }
+
+  if (interleave == 0 && size <= anemone_block_size - 8 && data != start) {
+    fprintf (stderr, "buffer of %zu bytes was moved from %p to %p\n", size, start, data);
+    return 0;
+  }
+
+  for (size_t byte = 0; byte != size; ++byte) {
+    uint8_t expected = byte / (chunk_bytes + 1);
+    if (data[byte] != expected) {
+      fprintf (stderr, "byte %zu: %" PRIu8 " /= %" PRIu8 "\n", byte, data[byte], expected);
+      return 0;
+    }
+  }
+
+  anemone_mempool_free(pool);
+
+  return 1;
+}
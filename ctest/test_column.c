@@ -0,0 +1,62 @@
+#include "anemone_atoi_sse.h"
+#include "anemone_chunk.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+  const char *input;
+  // number of fields, and which of them are valid
+  int64_t fields;
+  uint64_t valid;
+} test_column_case_t;
+
+// Test where fields start and end around the delimiters, in particular that
+// an empty field before a delimiter is a field, and a separator at the very
+// end of the buffer starts another one, but a terminator does not. The field count used by the
+// chunked driver must agree with the parser.
+// On failure, prints to stderr and returns false.
+bool_t test_column_trailing ()
+{
+  const test_column_case_t cases[] = {
+      { "",            0, 0x0 }
+    , { ",",           2, 0x0 }
+    , { "\n",          1, 0x0 }
+    , { "1",           1, 0x1 }
+    , { "1,",          2, 0x1 }
+    , { "1\n",         1, 0x1 }
+    , { "1,\n",        2, 0x1 }
+    , { "1,,2",        3, 0x5 }
+    , { "1,2,",        3, 0x3 }
+    , { "1,2,\n",      3, 0x3 }
+    , { "1,2\n3,",     4, 0x7 }
+    , { "1,2\n3,\n",   4, 0x7 }
+    , { "1,2\n3\n",    3, 0x7 }
+    , { ",1",          2, 0x2 }
+  };
+
+  for (size_t c = 0; c != sizeof (cases) / sizeof (cases[0]); ++c) {
+    const char *p = cases[c].input;
+    const char *pe = p + strlen (p);
+
+    int64_t out[8];
+    uint64_t valid[1] = { 0 };
+
+    int64_t counted = anemone_chunk_count_fields (p, pe, ',', '\n');
+    int64_t parsed = anemone_string_to_i64_v128_column (&p, pe, ',', '\n', 8, out, valid);
+
+    if (parsed != cases[c].fields || counted != cases[c].fields) {
+      fprintf (stderr, "\"%s\": parsed %" PRId64 " and counted %" PRId64 " fields, expected %" PRId64 "\n", cases[c].input, parsed, counted, cases[c].fields);
+      return 0;
+    } else if (parsed > 0 && valid[0] != cases[c].valid) {
+      fprintf (stderr, "\"%s\": valid bits %#" PRIx64 ", expected %#" PRIx64 "\n", cases[c].input, valid[0], cases[c].valid);
+      return 0;
+    } else if (p != pe) {
+      fprintf (stderr, "\"%s\": stopped %td bytes before the end\n", cases[c].input, pe - p);
+      return 0;
+    }
+  }
+
+  return 1;
+}
@@ -0,0 +1,71 @@
+#define _GNU_SOURCE 1
+
+#include "anemone_memcmp.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+ANEMONE_STATIC
+int sign (int x)
+{
+  return (x > 0) - (x < 0);
+}
+
+// Compare two 'len' byte buffers which end right before an unmapped page,
+// so any load past the end of either one faults.
+// Both buffers hold the same bytes except at 'diff_at', when it is less than 'len',
+// where the first buffer has 'a_byte' and the second has 'b_byte'.
+// On failure, prints to stderr and returns false.
+bool_t test_memcmp_page_end (size_t len, size_t diff_at, uint8_t a_byte, uint8_t b_byte)
+{
+  const size_t page = ANEMONE_MEMCMP_PAGE_SIZE;
+  const size_t pages = (len + page - 1) / page + 1;
+  const size_t mapped = pages * page;
+
+  // two buffers, each followed by a guard page
+  uint8_t *mem = mmap (NULL, 2 * (mapped + page), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    fprintf (stderr, "mmap failed\n");
+    return 0;
+  }
+
+  uint8_t *a_guard = mem + mapped;
+  uint8_t *b_guard = a_guard + page + mapped;
+  mprotect (a_guard, page, PROT_NONE);
+  mprotect (b_guard, page, PROT_NONE);
+
+  uint8_t *a = a_guard - len;
+  uint8_t *b = b_guard - len;
+  for (size_t i = 0; i != len; ++i) {
+    a[i] = b[i] = (uint8_t) (i * 7 + 1);
+  }
+  if (diff_at < len) {
+    a[diff_at] = a_byte;
+    b[diff_at] = b_byte;
+  }
+
+  bool_t ok = 1;
+  const int expected = sign (memcmp (a, b, len));
+
+  int actual = sign (anemone_memcmp (a, b, len));
+  if (actual != expected) {
+    fprintf (stderr, "len %zu, diff at %zu: anemone_memcmp %d /= memcmp %d\n", len, diff_at, actual, expected);
+    ok = 0;
+  }
+
+  if (len == 8 || len == 16 || len == 32) {
+    if (len == 8)  actual = sign (anemone_memcmp_fixed8 (a, b));
+    if (len == 16) actual = sign (anemone_memcmp_fixed16 (a, b));
+    if (len == 32) actual = sign (anemone_memcmp_fixed32 (a, b));
+
+    if (actual != expected) {
+      fprintf (stderr, "len %zu, diff at %zu: anemone_memcmp_fixed%zu %d /= memcmp %d\n", len, diff_at, len, actual, expected);
+      ok = 0;
+    }
+  }
+
+  munmap (mem, 2 * (mapped + page));
+
+  return ok;
+}
@@ -2,6 +2,7 @@
 
 #include <errno.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <sys/resource.h>
 
@@ -160,3 +161,306 @@ bool_t test_mempool_size(uint64_t iterations, size_t bytes)
 
   return 1;
 }
+
+
+// Per-thread state for test_mempool_concurrent
+typedef struct {
+  anemone_mempool_t *root;
+  int iterations;
+  size_t max_bytes;
+  uint8_t tag;
+  uint8_t **pointers;
+  size_t *sizes;
+} test_mempool_worker_t;
+
+static void * test_mempool_worker (void *arg)
+{
+  test_mempool_worker_t *worker = arg;
+  anemone_mempool_t *arena = anemone_mempool_arena_create (worker->root);
+
+  // Vary the sizes so that some threads are adding blocks while others are bump allocating
+  for (int i = 0; i != worker->iterations; ++i) {
+    size_t bytes = (worker->max_bytes / (i + 1)) + 1;
+    uint8_t *value = anemone_mempool_alloc (arena, bytes);
+    memset (value, worker->tag, bytes);
+    worker->pointers[i] = value;
+    worker->sizes[i] = bytes;
+  }
+
+  return NULL;
+}
+
+// Test that thread arenas sharing a root allocate non-overlapping memory,
+// and that all of it is still alive after the threads finish.
+// On failure, prints to stderr and returns false.
+bool_t test_mempool_concurrent(int threads, int iterations, size_t max_bytes)
+{
+  anemone_mempool_t *root = anemone_mempool_create();
+
+  pthread_t ids[threads];
+  test_mempool_worker_t workers[threads];
+
+  for (int t = 0; t != threads; ++t) {
+    workers[t].root = root;
+    workers[t].iterations = iterations;
+    workers[t].max_bytes = max_bytes;
+    workers[t].tag = (uint8_t)t;
+    workers[t].pointers = calloc (iterations, sizeof (uint8_t *));
+    workers[t].sizes = calloc (iterations, sizeof (size_t));
+    if (pthread_create (&ids[t], NULL, test_mempool_worker, &workers[t])) {
+      fprintf (stderr, "pthread_create failed, thread %d\n", t);
+      return 0;
+    }
+  }
+
+  for (int t = 0; t != threads; ++t) {
+    pthread_join (ids[t], NULL);
+  }
+
+  // Every thread wrote its tag over its own allocations, so an overlap shows up as a wrong tag.
+  int64_t requested = 0;
+  for (int t = 0; t != threads; ++t) {
+    for (int i = 0; i != iterations; ++i) {
+      uint8_t *value = workers[t].pointers[i];
+      requested += workers[t].sizes[i];
+      for (size_t byte = 0; byte != workers[t].sizes[i]; ++byte) {
+        if (value[byte] != workers[t].tag) {
+          fprintf (stderr, "thread %d, iteration %d, the %zu-th byte expected to be %d but got %d\n", t, i, byte, workers[t].tag, value[byte]);
+          return 0;
+        }
+      }
+    }
+    free (workers[t].pointers);
+    free (workers[t].sizes);
+  }
+
+  int64_t allocated = anemone_mempool_total_alloc_size (root);
+  if (allocated < requested) {
+    fprintf (stderr, "the memory pool allocated less than was requested.\n\tallocated=%" PRId64 "\n\trequested=%" PRId64 "\n", allocated, requested);
+    return 0;
+  }
+
+  anemone_mempool_free(root);
+
+  return 1;
+}
+
+// Test that resetting a pool reuses its blocks: allocating the same sizes again should
+// give back exactly the same pointers, apart from the oversized allocations.
+// On failure, prints to stderr and returns false.
+bool_t test_mempool_reset(int iterations, size_t max_bytes)
+{
+  void *pointers[iterations];
+  size_t sizes[iterations];
+  anemone_mempool_t *pool = anemone_mempool_create();
+
+  for (int i = 0; i != iterations; ++i) {
+    sizes[i] = (max_bytes / (i + 1)) + 1;
+    pointers[i] = anemone_mempool_alloc (pool, sizes[i]);
+  }
+
+  for (int batch = 0; batch != 3; ++batch) {
+    anemone_mempool_reset (pool);
+
+    if (pool->total_alloc_size != anemone_block_size) {
+      fprintf (stderr, "batch %d: after reset, total_alloc_size=%" PRId64 "\n", batch, pool->total_alloc_size);
+      return 0;
+    }
+
+    for (int i = 0; i != iterations; ++i) {
+      void *value = anemone_mempool_alloc (pool, sizes[i]);
+      if (sizes[i] <= anemone_block_size && value != pointers[i]) {
+        fprintf (stderr, "batch %d, iteration %d: expected block to be reused, %p /= %p\n", batch, i, value, pointers[i]);
+        return 0;
+      }
+      memset (value, batch, sizes[i]);
+    }
+  }
+
+  anemone_mempool_free(pool);
+
+  return 1;
+}
+
+// Test that rewinding to a mark releases scratch allocations: every record allocates
+// the same scratch sizes, so after rewinding each record should get the same pointers,
+// and the pool should not grow. Memory allocated before the mark must be untouched.
+// On failure, prints to stderr and returns false.
+bool_t test_mempool_mark_rewind(int records, int iterations, size_t max_bytes)
+{
+  anemone_mempool_t *pool = anemone_mempool_create();
+
+  uint8_t *before = anemone_mempool_alloc (pool, 100);
+  memset (before, 0xAB, 100);
+
+  anemone_mempool_mark_t mark;
+  anemone_mempool_mark (pool, &mark);
+
+  void *first[iterations];
+
+  for (int r = 0; r != records; ++r) {
+    for (int i = 0; i != iterations; ++i) {
+      size_t bytes = (max_bytes / (i + 1)) + 1;
+      void *value = anemone_mempool_alloc (pool, bytes);
+      memset (value, r, bytes);
+
+      if (r == 0) {
+        first[i] = value;
+      } else if (bytes <= anemone_block_size && value != first[i]) {
+        fprintf (stderr, "record %d, iteration %d: expected scratch to be reused, %p /= %p\n", r, i, value, first[i]);
+        return 0;
+      }
+    }
+
+    anemone_mempool_rewind (pool, &mark);
+
+    if (pool->total_alloc_size != mark.total_alloc_size) {
+      fprintf (stderr, "record %d: after rewind, total_alloc_size=%" PRId64 " but mark was %" PRId64 "\n", r, pool->total_alloc_size, mark.total_alloc_size);
+      return 0;
+    }
+  }
+
+  for (int byte = 0; byte != 100; ++byte) {
+    if (before[byte] != 0xAB) {
+      fprintf (stderr, "allocation before the mark was overwritten at byte %d\n", byte);
+      return 0;
+    }
+  }
+
+  anemone_mempool_free(pool);
+
+  return 1;
+}
+
+// Test a pool created with options: every allocation must be usable and distinct, blocks
+// must follow the growth policy, and resetting must reuse the blocks.
+// On failure, prints to stderr and returns false.
+bool_t test_mempool_config(int backing, int growth_factor, int iterations, size_t max_bytes)
+{
+  anemone_mempool_config_t config = { 64 * 1024, growth_factor, 4 * 1024 * 1024, backing };
+  anemone_mempool_t *pool = anemone_mempool_create_with (&config);
+
+  uint8_t *pointers[iterations];
+  size_t sizes[iterations];
+
+  for (int batch = 0; batch != 2; ++batch) {
+    for (int i = 0; i != iterations; ++i) {
+      sizes[i] = (max_bytes / (i + 1)) + 1;
+      uint8_t *value = anemone_mempool_alloc (pool, sizes[i]);
+      if (batch == 1 && sizes[i] <= config.block_size && value != pointers[i]) {
+        fprintf (stderr, "iteration %d: expected block to be reused after reset, %p /= %p\n", i, value, pointers[i]);
+        return 0;
+      }
+      pointers[i] = value;
+      memset (value, i, sizes[i]);
+    }
+
+    for (int i = 0; i != iterations; ++i) {
+      for (size_t byte = 0; byte != sizes[i]; ++byte) {
+        if (pointers[i][byte] != (uint8_t) i) {
+          fprintf (stderr, "iteration %d: allocation was overwritten at byte %zu\n", i, byte);
+          return 0;
+        }
+      }
+    }
+
+    // Standard blocks grow by the growth factor, and never past the maximum except by page rounding
+    for (anemone_block_t *block = pool->last; block != NULL && block->prev != NULL; block = block->prev) {
+      size_t expected = block->prev->size * growth_factor;
+      if (block->size < expected && block->size < config.max_block_size) {
+        fprintf (stderr, "block of %zu bytes is too small after a block of %zu bytes\n", block->size, block->prev->size);
+        return 0;
+      }
+      if (block->size > expected && block->size > config.max_block_size + 2 * 1024 * 1024) {
+        fprintf (stderr, "block of %zu bytes is too large after a block of %zu bytes\n", block->size, block->prev->size);
+        return 0;
+      }
+    }
+
+    anemone_mempool_reset (pool);
+  }
+
+  anemone_mempool_free(pool);
+
+  return 1;
+}
+
+// Test that the counters add up: every byte of every standard block is either allocated,
+// wasted at the tail of an earlier block, or still free in the current block.
+// On failure, prints to stderr and returns false.
+bool_t test_mempool_stats(int iterations, size_t max_bytes)
+{
+  anemone_mempool_t *pool = anemone_mempool_create();
+
+  uint64_t requested = 0;
+  uint64_t rounded   = 0;
+  uint64_t large     = 0;
+
+  for (int i = 0; i != iterations; ++i) {
+    size_t bytes = (max_bytes / (i + 1)) + 1;
+    anemone_mempool_alloc (pool, bytes);
+    requested += bytes;
+    if (bytes <= anemone_block_size) {
+      rounded += round_up_allocation (bytes);
+    } else {
+      large += bytes;
+    }
+  }
+
+  anemone_mempool_stats_t stats;
+  anemone_mempool_stats (pool, &stats);
+
+  uint64_t remaining = pool->maximum_ptr - pool->current_ptr;
+  uint64_t standard  = stats.blocks * anemone_block_size;
+
+  if (stats.bytes_requested != requested) {
+    fprintf (stderr, "bytes_requested=%" PRIu64 " but requested %" PRIu64 "\n", stats.bytes_requested, requested);
+    return 0;
+  } else if (stats.large_bytes != large) {
+    fprintf (stderr, "large_bytes=%" PRIu64 " but expected %" PRIu64 "\n", stats.large_bytes, large);
+    return 0;
+  } else if (standard != rounded + stats.bytes_wasted + remaining) {
+    fprintf (stderr, "%" PRIu64 " bytes in standard blocks, but %" PRIu64 " rounded, %" PRIu64 " wasted and %" PRIu64 " remaining\n",
+        standard, rounded, stats.bytes_wasted, remaining);
+    return 0;
+  } else if (stats.high_water != (uint64_t) pool->total_alloc_size || stats.high_water != standard + large) {
+    fprintf (stderr, "high_water=%" PRIu64 " but total_alloc_size=%" PRId64 "\n", stats.high_water, pool->total_alloc_size);
+    return 0;
+  }
+
+  anemone_mempool_reset (pool);
+  anemone_mempool_stats (pool, &stats);
+
+  if (stats.bytes_requested != requested || stats.high_water < (uint64_t) pool->total_alloc_size) {
+    fprintf (stderr, "counters changed after reset\n");
+    return 0;
+  }
+
+  anemone_mempool_free(pool);
+
+  return 1;
+}
+
+// Test a pool whose block sizes are not a multiple of the alignment: an allocation which
+// fits the requested block size must still fit the block, however the blocks have grown.
+// On failure, prints to stderr and returns false.
+bool_t test_mempool_odd_block_size(size_t block_size, int growth_factor, int iterations)
+{
+  anemone_mempool_config_t config = { block_size, growth_factor, block_size * growth_factor * 3 + 1, ANEMONE_BACKING_MALLOC };
+  anemone_mempool_t *pool = anemone_mempool_create_with (&config);
+
+  for (int i = 0; i != iterations; ++i) {
+    // Sizes from the whole block down to a single byte, so each one can need a new block
+    size_t bytes = block_size - (i % block_size);
+    uint8_t *value = anemone_mempool_calloc (pool, 1, bytes);
+    if (!value) {
+      fprintf (stderr, "iteration %d: anemone_mempool_calloc returned null for %zu bytes with block size %zu\n", i, bytes, block_size);
+      return 0;
+    }
+    memset (value, i, bytes);
+  }
+
+  anemone_mempool_free(pool);
+
+  return 1;
+}
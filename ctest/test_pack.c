@@ -0,0 +1,182 @@
+#include "anemone_pack.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+// Test that the unpack kernels for every instruction set supported by this CPU give back
+// the values which were packed, using pseudo-random values which need exactly |bits| bits.
+// On failure, prints to stderr and returns false.
+bool_t test_pack_unpack_isa(uint64_t seed, int blocks, int bits)
+{
+  int count = blocks * 64;
+  uint64_t mask = bits == 64 ? UINT64_MAX : (UINT64_C(1) << bits) - 1;
+
+  uint64_t values[count];
+  uint64_t unpacked[count];
+  // Exactly the packed size on the heap, so reading past the end is caught by the sanitizers
+  uint8_t *packed = malloc (count * bits / 8 + (bits == 0));
+
+  // xorshift64, so the values are reproducible from the seed
+  uint64_t x = seed | 1;
+  for (int i = 0; i != count; ++i) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    values[i] = x & mask;
+  }
+
+  if (anemone_pack64_64 (blocks, bits, values, packed)) {
+    fprintf (stderr, "anemone_pack64_64 failed for %d bits\n", bits);
+    return 0;
+  }
+
+  for (uint64_t isa = ANEMONE_PACK_SCALAR; isa <= anemone_pack_isa (); ++isa) {
+    memset (unpacked, 0xFF, sizeof (unpacked));
+
+    if (anemone_unpack64_64_isa (isa, blocks, bits, packed, unpacked)) {
+      fprintf (stderr, "anemone_unpack64_64_isa failed for %d bits, isa %" PRIu64 "\n", bits, isa);
+      return 0;
+    }
+
+    for (int i = 0; i != count; ++i) {
+      if (unpacked[i] != values[i]) {
+        fprintf (stderr, "%d bits, isa %" PRIu64 ", value %d: %" PRIu64 " /= %" PRIu64 "\n", bits, isa, i, unpacked[i], values[i]);
+        return 0;
+      }
+    }
+  }
+
+  free (packed);
+
+  return 1;
+}
+
+// Test that the 128 value block kernels for every instruction set supported by this CPU give
+// back the values which were packed, and that they pack to the same bytes as blocks of 64.
+// On failure, prints to stderr and returns false.
+bool_t test_pack128_unpack_isa(uint64_t seed, int blocks, int bits)
+{
+  int count = blocks * 128;
+  int size = count * bits / 8;
+  uint64_t mask = bits == 64 ? UINT64_MAX : (UINT64_C(1) << bits) - 1;
+
+  uint64_t values[count];
+  uint64_t unpacked[count];
+  uint8_t *packed = malloc (size + (bits == 0));
+  uint8_t *packed64 = malloc (size + (bits == 0));
+
+  uint64_t x = seed | 1;
+  for (int i = 0; i != count; ++i) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    values[i] = x & mask;
+  }
+
+  if (anemone_pack64_128 (blocks, bits, values, packed) || anemone_pack64_64 (blocks * 2, bits, values, packed64)) {
+    fprintf (stderr, "anemone_pack64_128 failed for %d bits\n", bits);
+    return 0;
+  }
+
+  if (memcmp (packed, packed64, size)) {
+    fprintf (stderr, "%d bits: blocks of 128 are not packed like blocks of 64\n", bits);
+    return 0;
+  }
+
+  for (uint64_t isa = ANEMONE_PACK_SCALAR; isa <= anemone_pack_isa (); ++isa) {
+    memset (unpacked, 0xFF, sizeof (unpacked));
+
+    if (anemone_unpack64_128_isa (isa, blocks, bits, packed, unpacked)) {
+      fprintf (stderr, "anemone_unpack64_128_isa failed for %d bits, isa %" PRIu64 "\n", bits, isa);
+      return 0;
+    }
+
+    for (int i = 0; i != count; ++i) {
+      if (unpacked[i] != values[i]) {
+        fprintf (stderr, "%d bits, isa %" PRIu64 ", value %d: %" PRIu64 " /= %" PRIu64 "\n", bits, isa, i, unpacked[i], values[i]);
+        return 0;
+      }
+    }
+  }
+
+  free (packed);
+  free (packed64);
+
+  return 1;
+}
+
+// Test that encoding with |codec| and decoding with every instruction set supported by
+// this CPU gives back the values, using values which suit the codec: offsets of up to
+// |bits| bits from a large base, sorted values with gaps of up to |bits| bits, or signed
+// values with magnitudes up to |bits| bits. Blocks are decoded from an unaligned buffer.
+// On failure, prints to stderr and returns false.
+bool_t test_codec_isa(uint64_t seed, int codec, int blocks, int bits)
+{
+  int count = blocks * 64;
+  uint64_t mask = bits == 64 ? UINT64_MAX : (UINT64_C(1) << bits) - 1;
+
+  uint64_t values[count];
+  uint64_t decoded[count];
+  uint8_t *encoded = malloc (anemone_encode64_64_bound (blocks) + 1);
+  uint64_t encoded_size;
+
+  uint64_t x = seed | 1;
+  uint64_t sum = seed;
+  for (int i = 0; i != count; ++i) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    switch (codec) {
+      case ANEMONE_CODEC_FOR:
+        values[i] = seed + (x & mask);
+        break;
+      case ANEMONE_CODEC_DELTA:
+        sum += x & mask;
+        values[i] = sum;
+        break;
+      case ANEMONE_CODEC_ZIGZAG:
+        values[i] = (x & 1) ? (x & mask) >> 1 : 0 - ((x & mask) >> 1);
+        break;
+      default:
+        values[i] = x & mask;
+        break;
+    }
+  }
+
+  if (anemone_encode64_64 (codec, blocks, values, encoded + 1, &encoded_size)) {
+    fprintf (stderr, "anemone_encode64_64 failed for codec %d\n", codec);
+    return 0;
+  }
+
+  if (encoded_size > blocks * (ANEMONE_CODEC_HEADER_SIZE + bits * 8)) {
+    fprintf (stderr, "codec %d, %d bits: encoded to %" PRIu64 " bytes\n", codec, bits, encoded_size);
+    return 0;
+  }
+
+  for (uint64_t isa = ANEMONE_PACK_SCALAR; isa <= anemone_pack_isa (); ++isa) {
+    memset (decoded, 0xFF, sizeof (decoded));
+
+    if (anemone_decode64_64_isa (isa, codec, blocks, encoded + 1, encoded_size, decoded)) {
+      fprintf (stderr, "anemone_decode64_64_isa failed for codec %d, %d bits, isa %" PRIu64 "\n", codec, bits, isa);
+      return 0;
+    }
+
+    for (int i = 0; i != count; ++i) {
+      if (decoded[i] != values[i]) {
+        fprintf (stderr, "codec %d, %d bits, isa %" PRIu64 ", value %d: %" PRIu64 " /= %" PRIu64 "\n", codec, bits, isa, i, decoded[i], values[i]);
+        return 0;
+      }
+    }
+
+    // Truncated input must be rejected rather than read past
+    if (!anemone_decode64_64_isa (isa, codec, blocks, encoded + 1, encoded_size - 1, decoded)) {
+      fprintf (stderr, "codec %d, %d bits, isa %" PRIu64 ": decoding truncated input succeeded\n", codec, bits, isa);
+      return 0;
+    }
+  }
+
+  free (encoded);
+
+  return 1;
+}
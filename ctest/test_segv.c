@@ -0,0 +1,145 @@
+#include "anemone_segv.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Burn CPU time, so the profiling timer goes off.
+ANEMONE_STATIC
+uint64_t test_prof_spin (double seconds)
+{
+  uint64_t x = 1;
+  clock_t end = clock () + (clock_t) (seconds * CLOCKS_PER_SEC);
+  while (clock () < end) {
+    for (int i = 0; i != 10000; ++i) {
+      x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+  }
+  return x;
+}
+
+// Profile a busy loop at 'hz' samples per second, keeping 'depth' frames, and
+// check the samples that come out. The capacity must be a power of two.
+// On failure, prints to stderr and returns false.
+bool_t test_prof_samples (int hz, int depth, size_t capacity)
+{
+  const char *user_data = "test_prof_samples";
+
+  if (anemone_prof_start (hz, depth, capacity, user_data, strlen (user_data))) {
+    fprintf (stderr, "anemone_prof_start failed\n");
+    return 0;
+  }
+
+  // a second start while it is running is an error
+  if (!anemone_prof_start (hz, depth, capacity, user_data, strlen (user_data))) {
+    fprintf (stderr, "anemone_prof_start succeeded while running\n");
+    anemone_prof_stop ();
+    return 0;
+  }
+
+  // long enough for a couple of samples at a low rate
+  volatile uint64_t x = test_prof_spin (hz < 10 ? 2.0 / hz : 0.2);
+  (void) x;
+
+  anemone_prof_stop ();
+
+  if (strcmp (anemone_prof_user_data (), user_data) != 0) {
+    fprintf (stderr, "user data %s /= %s\n", anemone_prof_user_data (), user_data);
+    return 0;
+  }
+
+  anemone_prof_sample_t samples[64];
+  int64_t total = 0;
+  int64_t n;
+
+  while ((n = anemone_prof_drain (samples, 64)) > 0) {
+    for (int64_t i = 0; i != n; ++i) {
+      if (samples[i].depth < 1 || samples[i].depth > depth) {
+        fprintf (stderr, "sample %" PRId64 " has depth %d, expected 1 to %d\n", total + i, samples[i].depth, depth);
+        return 0;
+      }
+
+      char symbol[256];
+      if (anemone_prof_symbol (samples[i].frames[0], symbol, sizeof (symbol)) <= 0) {
+        fprintf (stderr, "sample %" PRId64 " has no symbol\n", total + i);
+        return 0;
+      }
+    }
+    total += n;
+  }
+
+  if (total == 0 || (size_t) total > capacity) {
+    fprintf (stderr, "%" PRId64 " samples, expected 1 to %zu\n", total, capacity);
+    return 0;
+  }
+
+  // a busy loop is sampled more often than this, so the ring must have filled up
+  if (capacity <= 2 && anemone_prof_dropped () == 0) {
+    fprintf (stderr, "no samples were dropped from a ring of %zu\n", capacity);
+    return 0;
+  }
+
+  return 1;
+}
+
+ANEMONE_STATIC
+void * test_prof_spin_thread (void *arg)
+{
+  volatile uint64_t x = test_prof_spin (*(double *) arg);
+  (void) x;
+  return NULL;
+}
+
+// Stop and restart the profiler over and over while other threads burn CPU, so
+// there are handlers running on those threads when it stops. The ring from one
+// run is freed by the next start, which must not happen under a handler.
+// On failure, prints to stderr and returns false.
+bool_t test_prof_restart (int threads, int rounds)
+{
+  const char *user_data = "test_prof_restart";
+
+  pthread_t ids[threads];
+  double seconds = 0.5;
+
+  for (int t = 0; t != threads; ++t) {
+    if (pthread_create (&ids[t], NULL, test_prof_spin_thread, &seconds)) {
+      fprintf (stderr, "pthread_create failed, thread %d\n", t);
+      return 0;
+    }
+  }
+
+  bool_t ok = 1;
+
+  for (int r = 0; r != rounds && ok; ++r) {
+    // the smallest ring, as every start frees the previous one
+    if (anemone_prof_start (100000, 4, 2, user_data, strlen (user_data))) {
+      fprintf (stderr, "round %d: anemone_prof_start failed\n", r);
+      ok = 0;
+      break;
+    }
+
+    volatile uint64_t x = test_prof_spin (0.001);
+    (void) x;
+
+    anemone_prof_stop ();
+
+    anemone_prof_sample_t samples[2];
+    int64_t n;
+    while ((n = anemone_prof_drain (samples, 2)) > 0) {
+      for (int64_t i = 0; i != n; ++i) {
+        if (samples[i].depth < 1 || samples[i].depth > 4) {
+          fprintf (stderr, "round %d: sample has depth %d, expected 1 to 4\n", r, samples[i].depth);
+          ok = 0;
+        }
+      }
+    }
+  }
+
+  for (int t = 0; t != threads; ++t) {
+    pthread_join (ids[t], NULL);
+  }
+
+  return ok;
+}
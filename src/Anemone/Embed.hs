@@ -1,16 +1,112 @@
 {-# LANGUAGE NoImplicitPrelude #-}
+{-# LANGUAGE OverloadedStrings #-}
 {-# LANGUAGE TemplateHaskell #-}
 module Anemone.Embed (
-    anemone_base_h
+    anemone_h
+  , anemone_headers
+
+  , anemone_base_h
   , anemone_mempool_h
   , anemone_mempool_c
+  , anemone_buffer_h
+  , anemone_buffer_c
   , anemone_grisu2_h
   , anemone_grisu2_c
+  , anemone_itoa_h
+  , anemone_itoa_c
+  , anemone_ryu_h
+  , anemone_ryu_c
   ) where
 
 import           Data.ByteString (ByteString)
+import qualified Data.ByteString as B
+import qualified Data.ByteString.Char8 as Char8
 import qualified Data.FileEmbed as FileEmbed
+import qualified Data.List as List
+
+import           P
+
+import           System.IO (FilePath)
+
+
+-- | Every kernel header in one file, which needs no include path.
+--
+--   The headers are in dependency order, with their includes of each other
+--   removed, and a @#line@ before each one so errors point at the original
+--   files. The functions are defined in this library, so code compiled
+--   against this header can be linked with, or loaded in to a process which
+--   has already loaded, Anemone.
+--
+anemone_h :: ByteString
+anemone_h =
+  let
+    local line =
+      "#include \"anemone_" `B.isPrefixOf` Char8.dropWhile (== ' ') line
+
+    -- the include is kept as a blank line, so the line numbers still match
+    strip line =
+      if local line then "" else line
+
+    header (name, text) =
+      "#line 1 \"" <> Char8.pack name <> "\"\n" <>
+      Char8.unlines (fmap strip $ Char8.lines text)
+  in
+    B.concat $ fmap header anemone_headers
 
+-- | The headers which make up 'anemone_h', in the order they appear in it.
+--
+--   The headers which are only for benchmarking, and those which are only
+--   included by the library's own C files, are left out.
+--
+anemone_headers :: [(FilePath, ByteString)]
+anemone_headers =
+  List.zip [
+      "anemone_base.h"
+    , "anemone_cpu.h"
+    , "anemone_sse.h"
+    , "anemone_twiddle.h"
+    , "anemone_mempool.h"
+    , "anemone_buffer.h"
+    , "anemone_atoi.h"
+    , "anemone_atoi_sse.h"
+    , "anemone_chunk.h"
+    , "anemone_column.h"
+    , "anemone_grisu2.h"
+    , "anemone_hash.h"
+    , "anemone_intern.h"
+    , "anemone_itoa.h"
+    , "anemone_memcmp.h"
+    , "anemone_pack.h"
+    , "anemone_ryu.h"
+    , "anemone_sort.h"
+    , "anemone_strtod.h"
+    , "anemone_time.h"
+    , "anemone_tokenize.h"
+    , "anemone_vint.h"
+    ] [
+      $(FileEmbed.embedFile "csrc/anemone_base.h")
+    , $(FileEmbed.embedFile "csrc/anemone_cpu.h")
+    , $(FileEmbed.embedFile "csrc/anemone_sse.h")
+    , $(FileEmbed.embedFile "csrc/anemone_twiddle.h")
+    , $(FileEmbed.embedFile "csrc/anemone_mempool.h")
+    , $(FileEmbed.embedFile "csrc/anemone_buffer.h")
+    , $(FileEmbed.embedFile "csrc/anemone_atoi.h")
+    , $(FileEmbed.embedFile "csrc/anemone_atoi_sse.h")
+    , $(FileEmbed.embedFile "csrc/anemone_chunk.h")
+    , $(FileEmbed.embedFile "csrc/anemone_column.h")
+    , $(FileEmbed.embedFile "csrc/anemone_grisu2.h")
+    , $(FileEmbed.embedFile "csrc/anemone_hash.h")
+    , $(FileEmbed.embedFile "csrc/anemone_intern.h")
+    , $(FileEmbed.embedFile "csrc/anemone_itoa.h")
+    , $(FileEmbed.embedFile "csrc/anemone_memcmp.h")
+    , $(FileEmbed.embedFile "csrc/anemone_pack.h")
+    , $(FileEmbed.embedFile "csrc/anemone_ryu.h")
+    , $(FileEmbed.embedFile "csrc/anemone_sort.h")
+    , $(FileEmbed.embedFile "csrc/anemone_strtod.h")
+    , $(FileEmbed.embedFile "csrc/anemone_time.h")
+    , $(FileEmbed.embedFile "csrc/anemone_tokenize.h")
+    , $(FileEmbed.embedFile "csrc/anemone_vint.h")
+    ]
 
 anemone_base_h :: ByteString
 anemone_base_h =
@@ -24,6 +120,14 @@ anemone_mempool_c :: ByteString
 anemone_mempool_c =
   $(FileEmbed.embedFile "csrc/anemone_mempool.c")
 
+anemone_buffer_h :: ByteString
+anemone_buffer_h =
+  $(FileEmbed.embedFile "csrc/anemone_buffer.h")
+
+anemone_buffer_c :: ByteString
+anemone_buffer_c =
+  $(FileEmbed.embedFile "csrc/anemone_buffer.c")
+
 anemone_grisu2_h :: ByteString
 anemone_grisu2_h =
   $(FileEmbed.embedFile "csrc/anemone_grisu2.h")
@@ -31,3 +135,19 @@ anemone_grisu2_h =
 anemone_grisu2_c :: ByteString
 anemone_grisu2_c =
   $(FileEmbed.embedFile "csrc/anemone_grisu2.c")
+
+anemone_itoa_h :: ByteString
+anemone_itoa_h =
+  $(FileEmbed.embedFile "csrc/anemone_itoa.h")
+
+anemone_itoa_c :: ByteString
+anemone_itoa_c =
+  $(FileEmbed.embedFile "csrc/anemone_itoa.c")
+
+anemone_ryu_h :: ByteString
+anemone_ryu_h =
+  $(FileEmbed.embedFile "csrc/anemone_ryu.h")
+
+anemone_ryu_c :: ByteString
+anemone_ryu_c =
+  $(FileEmbed.embedFile "csrc/anemone_ryu.c")
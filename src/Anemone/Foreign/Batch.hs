@@ -0,0 +1,62 @@
+{-# LANGUAGE BangPatterns #-}
+{-# LANGUAGE NoImplicitPrelude #-}
+-- | Marshalling for the batch kernels, which take an array of pointers and an
+--   array of lengths, and write one result per key.
+--
+module Anemone.Foreign.Batch (
+    withKeys
+  ) where
+
+import           Anemone.Foreign.Data
+
+import           Data.ByteString.Internal (ByteString(..))
+import qualified Data.Vector as Boxed
+import qualified Data.Vector.Storable as Storable
+import qualified Data.Vector.Storable.Mutable as MStorable
+import           Data.Word (Word8)
+
+import           Foreign.ForeignPtr (touchForeignPtr)
+import           Foreign.ForeignPtr.Unsafe (unsafeForeignPtrToPtr)
+import           Foreign.Ptr (Ptr, plusPtr)
+import           Foreign.Storable (Storable)
+
+import           P
+
+import           System.IO (IO)
+
+
+-- | Pass the number of keys, their pointers and their lengths to a batch
+--   function, along with an output array with room for one result per key.
+withKeys ::
+     Storable b
+  => Boxed.Vector ByteString
+  -> (Int64 -> Ptr (Ptr Word8) -> Ptr CSize -> Ptr b -> IO a)
+  -> IO (a, Storable.Vector b)
+withKeys bss f = do
+  let
+    !n =
+      Boxed.length bss
+
+    ptrs =
+      Storable.convert $
+        fmap (\(PS fp off _) -> unsafeForeignPtrToPtr fp `plusPtr` off) bss
+
+    lens =
+      Storable.convert $
+        fmap (\(PS _ _ len) -> fromIntegral len) bss
+
+  out <- MStorable.new n
+
+  x <-
+    MStorable.unsafeWith out $ \pout ->
+    Storable.unsafeWith ptrs $ \pptrs ->
+    Storable.unsafeWith lens $ \plens ->
+      f (fromIntegral n) pptrs plens pout
+
+  -- the pointers were taken out of the foreign pointers, so they must be
+  -- kept alive until after the call
+  Boxed.mapM_ (\(PS fp _ _) -> touchForeignPtr fp) bss
+
+  ys <- Storable.unsafeFreeze out
+  pure (x, ys)
+{-# INLINE withKeys #-}
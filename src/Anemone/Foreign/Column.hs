@@ -0,0 +1,291 @@
+{-# LANGUAGE BangPatterns #-}
+{-# LANGUAGE ForeignFunctionInterface #-}
+{-# LANGUAGE NoImplicitPrelude #-}
+{-# LANGUAGE ScopedTypeVariables #-}
+module Anemone.Foreign.Column (
+    Column(..)
+  , columnLength
+  , columnIndex
+  , columnToList
+  , columnFirstInvalid
+
+  , parseInt64Column
+  , parseDoubleColumn
+  , parseModifiedJulianColumn
+  , parseTimestampColumn
+
+  , parseInt64ColumnParallel
+  , parseDoubleColumnParallel
+  , parseModifiedJulianColumnParallel
+  , parseTimestampColumnParallel
+  ) where
+
+import           Anemone.Foreign.Data
+import           Anemone.Foreign.Mempool (Mempool)
+import qualified Anemone.Foreign.Mempool as Mempool
+import           Anemone.Foreign.Time (Timestamp)
+
+import           Control.Exception (bracket)
+
+import           Data.Bits ((.&.), complement, countTrailingZeros, shiftL, testBit)
+import           Data.ByteString.Internal (ByteString(..))
+import qualified Data.List as List
+import qualified Data.Vector.Storable as Storable
+import           Data.Void (Void)
+import           Data.Word (Word8, Word64)
+
+import           Foreign.ForeignPtr (withForeignPtr)
+import           Foreign.Marshal.Alloc (alloca)
+import           Foreign.Ptr (FunPtr, Ptr, plusPtr, minusPtr)
+import           Foreign.Storable (Storable, sizeOf, peek, poke)
+
+import           GHC.ForeignPtr (mallocPlainForeignPtrBytes)
+
+import           P
+
+import qualified Prelude as Savage
+
+import           System.IO (IO)
+import           System.IO.Unsafe (unsafePerformIO)
+
+
+-- | The values parsed from a delimited column, with a bitmap of which fields
+--   were valid. The value of an invalid field is zero.
+data Column a =
+  Column {
+      columnValues :: !(Storable.Vector a)
+    , columnValid :: !(Storable.Vector Word64)
+    } deriving (Eq, Show)
+
+columnLength :: Storable a => Column a -> Int
+columnLength =
+  Storable.length . columnValues
+
+-- | The value of a field, or 'Nothing' if it was invalid or out of range.
+columnIndex :: Storable a => Column a -> Int -> Maybe a
+columnIndex (Column values valid) i =
+  if i < 0 || i >= Storable.length values then
+    Nothing
+  else if testBit (Storable.unsafeIndex valid (i `div` 64)) (i `mod` 64) then
+    Just $ Storable.unsafeIndex values i
+  else
+    Nothing
+
+columnToList :: Storable a => Column a -> [Maybe a]
+columnToList column =
+  fmap (columnIndex column) $ List.take (columnLength column) [0..]
+
+-- | The index of the first invalid field, if there is one. This looks at one
+--   word of the bitmap per 64 fields, rather than at each field.
+columnFirstInvalid :: Storable a => Column a -> Maybe Int
+columnFirstInvalid (Column values valid) =
+  let
+    !n =
+      Storable.length values
+
+    -- the bits past the last field are not set, so they must be ignored
+    mask k =
+      if k == n `div` 64 then
+        (1 `shiftL` (n `mod` 64)) - 1
+      else
+        complement 0
+
+    invalid k =
+      complement (Storable.unsafeIndex valid k) .&. mask k
+  in
+    case List.find (\k -> invalid k /= 0) [0 .. Storable.length valid - 1] of
+      Nothing ->
+        Nothing
+      Just k ->
+        Just $ k * 64 + countTrailingZeros (invalid k)
+
+-- | Parses up to @n@ integers, each ending in the separator or the record
+--   terminator, returning the rest of the input.
+parseInt64Column :: Word8 -> Word8 -> Int -> ByteString -> (Column Int64, ByteString)
+parseInt64Column =
+  wrapColumn c_string_to_i64_v128_column
+{-# INLINE parseInt64Column #-}
+
+parseDoubleColumn :: Word8 -> Word8 -> Int -> ByteString -> (Column Double, ByteString)
+parseDoubleColumn =
+  wrapColumn c_strtod_column
+{-# INLINE parseDoubleColumn #-}
+
+-- | Parses up to @n@ @yyyy-mm-dd@ dates, as modified julian days.
+parseModifiedJulianColumn :: Word8 -> Word8 -> Int -> ByteString -> (Column Int64, ByteString)
+parseModifiedJulianColumn =
+  wrapColumn c_parse_gregorian_as_modified_julian_column
+{-# INLINE parseModifiedJulianColumn #-}
+
+-- | Parses up to @n@ ISO-8601 timestamps, as for 'Anemone.Foreign.Time.parseTimestamp'.
+parseTimestampColumn :: Word8 -> Word8 -> Int -> ByteString -> (Column Timestamp, ByteString)
+parseTimestampColumn =
+  wrapColumn c_parse_timestamp_column
+{-# INLINE parseTimestampColumn #-}
+
+-- | Parses every integer in the input, splitting it in to chunks of about
+--   the given number of bytes, each ending in a record terminator, and
+--   parsing the chunks on up to the given number of threads.
+--
+--   The result is the same as 'parseInt64Column' with no limit on the number
+--   of fields. A chunk size of zero gives the default of 1MB.
+--
+parseInt64ColumnParallel :: Int -> Int -> Word8 -> Word8 -> ByteString -> Column Int64
+parseInt64ColumnParallel =
+  wrapColumnParallel c_chunk_parser_i64
+{-# INLINE parseInt64ColumnParallel #-}
+
+parseDoubleColumnParallel :: Int -> Int -> Word8 -> Word8 -> ByteString -> Column Double
+parseDoubleColumnParallel =
+  wrapColumnParallel c_chunk_parser_double
+{-# INLINE parseDoubleColumnParallel #-}
+
+parseModifiedJulianColumnParallel :: Int -> Int -> Word8 -> Word8 -> ByteString -> Column Int64
+parseModifiedJulianColumnParallel =
+  wrapColumnParallel c_chunk_parser_modified_julian
+{-# INLINE parseModifiedJulianColumnParallel #-}
+
+parseTimestampColumnParallel :: Int -> Int -> Word8 -> Word8 -> ByteString -> Column Timestamp
+parseTimestampColumnParallel =
+  wrapColumnParallel c_chunk_parser_timestamp
+{-# INLINE parseTimestampColumnParallel #-}
+
+type ColumnT_Raw a =
+     Ptr (Ptr Word8)
+  -> Ptr Word8
+  -> Word8
+  -> Word8
+  -> Int64
+  -> Ptr a
+  -> Ptr Word64
+  -> IO Int64
+
+wrapColumn :: forall a. Storable a => ColumnT_Raw a -> Word8 -> Word8 -> Int -> ByteString -> (Column a, ByteString)
+wrapColumn f sep term n0 (PS fp_in off_in len_in) =
+  unsafePerformIO $ do
+    let
+      !n =
+        max 0 n0
+
+      !blocks =
+        (n + 63) `div` 64
+
+    fp_values <- mallocPlainForeignPtrBytes (n * sizeOf (Savage.undefined :: a))
+    fp_valid <- mallocPlainForeignPtrBytes (blocks * 8)
+
+    (count, used) <-
+      withForeignPtr fp_values $ \ptr_values ->
+      withForeignPtr fp_valid $ \ptr_valid ->
+      withForeignPtr fp_in $ \ptr_in0 ->
+      alloca $ \pptr_in -> do
+        let
+          !ptr_in1 =
+            ptr_in0 `plusPtr` off_in
+
+        poke pptr_in ptr_in1
+
+        !count <-
+          f pptr_in
+            (ptr_in1 `plusPtr` len_in)
+            sep
+            term
+            (fromIntegral n)
+            ptr_values
+            ptr_valid
+
+        ptr_in2 <- peek pptr_in
+
+        pure $! (fromIntegral count, ptr_in2 `minusPtr` ptr_in1)
+
+    pure
+      ( Column
+          (Storable.unsafeFromForeignPtr0 fp_values count)
+          (Storable.unsafeFromForeignPtr0 fp_valid ((count + 63) `div` 64))
+      , PS fp_in (off_in + used) (len_in - used)
+      )
+{-# INLINE wrapColumn #-}
+
+-- | The chunks are parsed in to a pool which only lives for the call, and
+--   copied out of it in order.
+wrapColumnParallel :: forall a. Storable a => FunPtr (ColumnT_Raw a) -> Int -> Int -> Word8 -> Word8 -> ByteString -> Column a
+wrapColumnParallel parse threads chunk_bytes sep term (PS fp_in off_in len_in) =
+  unsafePerformIO .
+  bracket Mempool.create Mempool.free $ \pool ->
+  withForeignPtr fp_in $ \ptr_in0 ->
+  alloca $ \pptr_chunks ->
+  alloca $ \pcount -> do
+    let
+      !ptr_in =
+        ptr_in0 `plusPtr` off_in
+
+      !size =
+        sizeOf (Savage.undefined :: a)
+
+    err <-
+      c_chunk_parse pool parse (fromIntegral size)
+        ptr_in
+        (ptr_in `plusPtr` len_in)
+        sep
+        term
+        (fromIntegral (max 0 chunk_bytes))
+        (fromIntegral threads)
+        pptr_chunks
+        pcount
+
+    when (err /= 0) $
+      Savage.error "Anemone.Foreign.Column.parseColumnParallel: out of memory"
+
+    ptr_chunks <- peek pptr_chunks
+    chunks <- peek pcount
+    count <- fromIntegral <$> c_chunk_total ptr_chunks chunks
+
+    let
+      !blocks =
+        (count + 63) `div` 64
+
+    fp_values <- mallocPlainForeignPtrBytes (count * size)
+    fp_valid <- mallocPlainForeignPtrBytes (blocks * 8)
+
+    withForeignPtr fp_values $ \ptr_values ->
+      withForeignPtr fp_valid $ \ptr_valid ->
+        c_chunk_concat ptr_chunks chunks (fromIntegral size) ptr_values ptr_valid
+
+    pure $
+      Column
+        (Storable.unsafeFromForeignPtr0 fp_values count)
+        (Storable.unsafeFromForeignPtr0 fp_valid blocks)
+{-# INLINE wrapColumnParallel #-}
+
+foreign import ccall unsafe "anemone_string_to_i64_v128_column"
+  c_string_to_i64_v128_column :: ColumnT_Raw Int64
+
+foreign import ccall unsafe "anemone_strtod_column"
+  c_strtod_column :: ColumnT_Raw Double
+
+foreign import ccall unsafe "anemone_parse_gregorian_as_modified_julian_column"
+  c_parse_gregorian_as_modified_julian_column :: ColumnT_Raw Int64
+
+foreign import ccall unsafe "anemone_parse_timestamp_column"
+  c_parse_timestamp_column :: ColumnT_Raw Timestamp
+
+foreign import ccall unsafe "&anemone_chunk_parser_i64"
+  c_chunk_parser_i64 :: FunPtr (ColumnT_Raw Int64)
+
+foreign import ccall unsafe "&anemone_chunk_parser_double"
+  c_chunk_parser_double :: FunPtr (ColumnT_Raw Double)
+
+foreign import ccall unsafe "&anemone_chunk_parser_modified_julian"
+  c_chunk_parser_modified_julian :: FunPtr (ColumnT_Raw Int64)
+
+foreign import ccall unsafe "&anemone_chunk_parser_timestamp"
+  c_chunk_parser_timestamp :: FunPtr (ColumnT_Raw Timestamp)
+
+-- | Safe, as it can run for a long time, and waits on the threads it starts.
+foreign import ccall safe "anemone_chunk_parse"
+  c_chunk_parse :: Mempool -> FunPtr (ColumnT_Raw a) -> CSize -> Ptr Word8 -> Ptr Word8 -> Word8 -> Word8 -> CSize -> CInt -> Ptr (Ptr Void) -> Ptr Int64 -> IO CError
+
+foreign import ccall unsafe "anemone_chunk_total"
+  c_chunk_total :: Ptr Void -> Int64 -> IO Int64
+
+foreign import ccall unsafe "anemone_chunk_concat"
+  c_chunk_concat :: Ptr Void -> Int64 -> CSize -> Ptr a -> Ptr Word64 -> IO ()
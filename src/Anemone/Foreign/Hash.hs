@@ -1,3 +1,4 @@
+{-# LANGUAGE BangPatterns #-}
 {-# LANGUAGE NoImplicitPrelude #-}
 {-# LANGUAGE ForeignFunctionInterface #-}
 module Anemone.Foreign.Hash (
@@ -8,18 +9,41 @@ module Anemone.Foreign.Hash (
 
   , fasthash64
   , fasthash64'
+
+  , fasthash64Chunks
+
+  , fasthash64Lazy
+  , fasthash64Lazy'
+
+  , fasthash64Handle
+  , fasthash64Handle'
+
+  , fasthash64Batch
+  , fasthash64Batch'
+
+  , fasthash64Word64
+  , fasthash64Word64'
   ) where
 
+import           Anemone.Foreign.Batch (withKeys)
+
+import qualified Data.ByteString as B
 import           Data.ByteString.Internal (ByteString(..))
+import qualified Data.ByteString.Lazy as Lazy
+import qualified Data.Vector as Boxed
+import qualified Data.Vector.Storable as Storable
 import           Data.Word (Word8, Word32, Word64)
 
 import           Foreign.C.Types (CSize(..))
+import           Foreign.Marshal.Alloc (allocaBytes)
 import           Foreign.ForeignPtr (withForeignPtr)
 import           Foreign.Ptr (Ptr, plusPtr)
 
+import           GHC.ForeignPtr (mallocPlainForeignPtrBytes)
+
 import           P
 
-import           System.IO (IO)
+import           System.IO (IO, Handle, hFileSize, hTell)
 import           System.IO.Unsafe (unsafePerformIO)
 
 
@@ -50,6 +74,113 @@ fasthash64' seed (PS fp off len) =
     c_fasthash64 seed (ptr `plusPtr` off) (fromIntegral len)
 {-# INLINE fasthash64' #-}
 
+-- | The same as 'fasthash64'' on the chunks put together, without copying
+--   them in to one buffer. fasthash starts with the total length, so it must
+--   be given up front, and the hash is only the same if the chunks add up to
+--   it. The chunks are hashed as the list is consumed, so a lazily produced
+--   list is never all in memory at once.
+fasthash64Chunks :: Word64 -> Int -> [ByteString] -> Word64
+fasthash64Chunks seed len bss =
+  unsafePerformIO . withFasthashState seed len $ \state ->
+    mapM_ (fasthashUpdate state) bss
+{-# INLINE fasthash64Chunks #-}
+
+-- | The same as 'fasthash64' on the strict version, without copying the
+--   chunks in to one buffer.
+--
+--   The length is needed before the first chunk is hashed, so the whole of
+--   the lazy bytestring is read, and kept, before it is hashed. Use
+--   'fasthash64Chunks' when the length is known, or 'fasthash64Handle' for a
+--   file, to hash in one pass without holding on to the chunks.
+fasthash64Lazy :: Lazy.ByteString -> Word64
+fasthash64Lazy bs =
+  fasthash64Lazy' defaultSeed bs
+{-# INLINE fasthash64Lazy #-}
+
+fasthash64Lazy' :: Word64 -> Lazy.ByteString -> Word64
+fasthash64Lazy' seed bs =
+  fasthash64Chunks seed (fromIntegral $ Lazy.length bs) (Lazy.toChunks bs)
+{-# INLINE fasthash64Lazy' #-}
+
+-- | The same as 'fasthash64' on the rest of a file, from the handle's
+--   position to the end, reading it a chunk at a time. The length comes from
+--   the size of the file, so the handle must be to a regular file which does
+--   not change while it is hashed.
+fasthash64Handle :: Handle -> IO Word64
+fasthash64Handle h =
+  fasthash64Handle' defaultSeed h
+{-# INLINE fasthash64Handle #-}
+
+fasthash64Handle' :: Word64 -> Handle -> IO Word64
+fasthash64Handle' seed h = do
+  size <- hFileSize h
+  pos <- hTell h
+
+  withFasthashState seed (fromIntegral $ size - pos) $ \state ->
+    let
+      loop = do
+        bs <- B.hGetSome h fasthashChunkSize
+        unless (B.null bs) $ do
+          fasthashUpdate state bs
+          loop
+    in
+      loop
+
+fasthashChunkSize :: Int
+fasthashChunkSize =
+  64 * 1024
+
+withFasthashState :: Word64 -> Int -> (Ptr FasthashState -> IO ()) -> IO Word64
+withFasthashState seed len f =
+  allocaBytes (fromIntegral c_fasthash64_state_size) $ \state -> do
+    c_fasthash64_init state seed (fromIntegral len)
+    f state
+    c_fasthash64_final state
+{-# INLINE withFasthashState #-}
+
+fasthashUpdate :: Ptr FasthashState -> ByteString -> IO ()
+fasthashUpdate state (PS fp off len) =
+  withForeignPtr fp $ \ptr ->
+    c_fasthash64_update state (ptr `plusPtr` off) (fromIntegral len)
+{-# INLINE fasthashUpdate #-}
+
+data FasthashState
+
+-- | The same as 'fasthash64' on each key, in one call.
+fasthash64Batch :: Boxed.Vector ByteString -> Storable.Vector Word64
+fasthash64Batch bss =
+  fasthash64Batch' defaultSeed bss
+{-# INLINE fasthash64Batch #-}
+
+fasthash64Batch' :: Word64 -> Boxed.Vector ByteString -> Storable.Vector Word64
+fasthash64Batch' seed bss =
+  unsafePerformIO . fmap snd . withKeys bss $ \n pptrs plens pout ->
+    c_fasthash64_batch seed pptrs plens n pout
+{-# INLINE fasthash64Batch' #-}
+
+-- | The same as 'fasthash64' on the 8 bytes of each key, in one call.
+fasthash64Word64 :: Storable.Vector Word64 -> Storable.Vector Word64
+fasthash64Word64 xs =
+  fasthash64Word64' defaultSeed xs
+{-# INLINE fasthash64Word64 #-}
+
+fasthash64Word64' :: Word64 -> Storable.Vector Word64 -> Storable.Vector Word64
+fasthash64Word64' seed xs =
+  unsafePerformIO $ do
+    let
+      !n =
+        Storable.length xs
+
+    fpout <- mallocPlainForeignPtrBytes (n * 8)
+
+    withForeignPtr fpout $ \pout ->
+      Storable.unsafeWith xs $ \pxs ->
+        c_fasthash64_u64_batch seed pxs (fromIntegral n) pout
+
+    pure $
+      Storable.unsafeFromForeignPtr0 fpout n
+{-# INLINE fasthash64Word64' #-}
+
 -- | uint32_t anemone_fasthash32 (uint64_t seed, const uint8_t *buf, size_t len);
 foreign import ccall unsafe "anemone_fasthash32"
   c_fasthash32 :: Word64 -> Ptr Word8 -> CSize -> IO Word32
@@ -57,3 +188,27 @@ foreign import ccall unsafe "anemone_fasthash32"
 -- | uint64_t anemone_fasthash64 (uint64_t seed, const uint8_t *buf, size_t len);
 foreign import ccall unsafe "anemone_fasthash64"
   c_fasthash64 :: Word64 -> Ptr Word8 -> CSize -> IO Word64
+
+-- | size_t hs_anemone_fasthash64_state_size ();
+foreign import ccall unsafe "hs_anemone_fasthash64_state_size"
+  c_fasthash64_state_size :: CSize
+
+-- | void anemone_fasthash64_init (anemone_fasthash_state_t *state, uint64_t seed, size_t total_len);
+foreign import ccall unsafe "anemone_fasthash64_init"
+  c_fasthash64_init :: Ptr FasthashState -> Word64 -> CSize -> IO ()
+
+-- | void anemone_fasthash64_update (anemone_fasthash_state_t *state, const uint8_t *buf, size_t len);
+foreign import ccall unsafe "anemone_fasthash64_update"
+  c_fasthash64_update :: Ptr FasthashState -> Ptr Word8 -> CSize -> IO ()
+
+-- | uint64_t anemone_fasthash64_final (const anemone_fasthash_state_t *state);
+foreign import ccall unsafe "anemone_fasthash64_final"
+  c_fasthash64_final :: Ptr FasthashState -> IO Word64
+
+-- | void anemone_fasthash64_batch (uint64_t seed, const uint8_t *const *ptrs, const size_t *lens, int64_t n, uint64_t *out);
+foreign import ccall unsafe "anemone_fasthash64_batch"
+  c_fasthash64_batch :: Word64 -> Ptr (Ptr Word8) -> Ptr CSize -> Int64 -> Ptr Word64 -> IO ()
+
+-- | void anemone_fasthash64_u64_batch (uint64_t seed, const uint64_t *keys, int64_t n, uint64_t *out);
+foreign import ccall unsafe "anemone_fasthash64_u64_batch"
+  c_fasthash64_u64_batch :: Word64 -> Ptr Word64 -> Int64 -> Ptr Word64 -> IO ()
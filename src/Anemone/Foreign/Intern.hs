@@ -0,0 +1,144 @@
+{-# LANGUAGE ForeignFunctionInterface #-}
+{-# LANGUAGE GeneralizedNewtypeDeriving #-}
+{-# LANGUAGE NoImplicitPrelude #-}
+module Anemone.Foreign.Intern (
+    Interner(..)
+  , missing
+  , create
+  , createWithSeed
+  , free
+  , size
+  , key
+  , intern
+  , internBatch
+  , lookupId
+  , lookupIdBatch
+  ) where
+
+import           Anemone.Foreign.Batch (withKeys)
+import           Anemone.Foreign.Data
+import           Anemone.Foreign.Hash (defaultSeed)
+
+import qualified Data.ByteString as B
+import           Data.ByteString.Internal (ByteString(..))
+import qualified Data.Vector as Boxed
+import qualified Data.Vector.Storable as Storable
+import           Data.Void (Void)
+import           Data.Word (Word8, Word32, Word64)
+
+import           Foreign.ForeignPtr (withForeignPtr)
+import           Foreign.Marshal.Alloc (alloca)
+import           Foreign.Ptr (Ptr, castPtr, nullPtr, plusPtr)
+import           Foreign.Storable (Storable, peek)
+
+import           P
+
+import qualified Prelude as Savage
+
+import           System.IO (IO)
+
+
+-- | The Interner constructor must be exposed to work in FFI calls.
+--   However, it must not be used in any other places.
+--   The only way to construct an Interner is by calling @create@.
+--
+--   An interner gives each distinct byte string a dense id, in the order
+--   they were first interned.
+--
+newtype Interner =
+  Interner (Ptr Void)
+  deriving (Eq, Ord, Show, Storable)
+
+-- | The id 'lookupIdBatch' gives for a key which has not been interned.
+missing :: Word32
+missing =
+  0xFFFFFFFF
+
+create :: IO Interner
+create =
+  createWithSeed defaultSeed
+
+createWithSeed :: Word64 -> IO Interner
+createWithSeed seed = do
+  interner@(Interner ptr) <- c_create seed
+  if ptr == nullPtr then
+    Savage.error "Anemone.Foreign.Intern.create: out of memory"
+  else
+    pure interner
+
+-- | Number of keys interned.
+size :: Interner -> IO Int
+size interner =
+  fromIntegral <$> c_size interner
+
+-- | A copy of the key with the given id.
+key :: Interner -> Word32 -> IO (Maybe ByteString)
+key interner ident = do
+  n <- c_size interner
+  if ident >= n then
+    pure Nothing
+  else
+    alloca $ \plen -> do
+      ptr <- c_key interner ident plen
+      len <- peek plen
+      Just <$> B.packCStringLen (castPtr ptr, fromIntegral len)
+
+-- | The id of a key, giving it the next id if it is new.
+intern :: Interner -> ByteString -> IO Word32
+intern interner (PS fp off len) =
+  withForeignPtr fp $ \ptr ->
+  alloca $ \pid -> do
+    err <- c_insert interner (ptr `plusPtr` off) (fromIntegral len) pid
+    if err /= 0 then
+      Savage.error "Anemone.Foreign.Intern.intern: out of memory"
+    else
+      peek pid
+
+-- | The same as 'intern' on each key, in one call.
+internBatch :: Interner -> Boxed.Vector ByteString -> IO (Storable.Vector Word32)
+internBatch interner bss =
+  fmap snd . withKeys bss $ \n pptrs plens pout -> do
+    err <- c_insert_batch interner pptrs plens n pout
+    when (err /= 0) $
+      Savage.error "Anemone.Foreign.Intern.internBatch: out of memory"
+
+-- | The id of a key, if it has been interned.
+lookupId :: Interner -> ByteString -> IO (Maybe Word32)
+lookupId interner (PS fp off len) =
+  withForeignPtr fp $ \ptr -> do
+    ident <- c_lookup interner (ptr `plusPtr` off) (fromIntegral len)
+    if ident == missing then
+      pure Nothing
+    else
+      pure $ Just ident
+
+-- | The same as 'lookupId' on each key, in one call, with 'missing' for the
+--   keys which have not been interned.
+lookupIdBatch :: Interner -> Boxed.Vector ByteString -> IO (Storable.Vector Word32)
+lookupIdBatch interner bss =
+  fmap snd . withKeys bss $ \n pptrs plens pout ->
+    c_lookup_batch interner pptrs plens n pout
+
+foreign import ccall unsafe "anemone_intern_create"
+  c_create :: Word64 -> IO Interner
+
+foreign import ccall unsafe "anemone_intern_free"
+  free :: Interner -> IO ()
+
+foreign import ccall unsafe "anemone_intern_size"
+  c_size :: Interner -> IO Word32
+
+foreign import ccall unsafe "anemone_intern_key"
+  c_key :: Interner -> Word32 -> Ptr CSize -> IO (Ptr Word8)
+
+foreign import ccall unsafe "anemone_intern_insert"
+  c_insert :: Interner -> Ptr Word8 -> CSize -> Ptr Word32 -> IO CError
+
+foreign import ccall unsafe "anemone_intern_lookup"
+  c_lookup :: Interner -> Ptr Word8 -> CSize -> IO Word32
+
+foreign import ccall unsafe "anemone_intern_insert_batch"
+  c_insert_batch :: Interner -> Ptr (Ptr Word8) -> Ptr CSize -> Int64 -> Ptr Word32 -> IO CError
+
+foreign import ccall unsafe "anemone_intern_lookup_batch"
+  c_lookup_batch :: Interner -> Ptr (Ptr Word8) -> Ptr CSize -> Int64 -> Ptr Word32 -> IO ()
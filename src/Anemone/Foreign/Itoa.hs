@@ -0,0 +1,72 @@
+{-# LANGUAGE NoImplicitPrelude #-}
+{-# LANGUAGE ForeignFunctionInterface #-}
+module Anemone.Foreign.Itoa (
+    itoa
+  , utoa
+  , renderInt64Column
+  ) where
+
+import           Anemone.Foreign.Data
+import           Anemone.Foreign.Mempool (Mempool)
+import qualified Anemone.Foreign.Mempool as Mempool
+
+import           Control.Exception (bracket)
+
+import           Data.ByteString (ByteString)
+import qualified Data.ByteString as B
+import qualified Data.ByteString.Internal as ByteString
+import qualified Data.Vector.Storable as Storable
+import           Data.Word (Word8, Word64)
+
+import           Foreign.Marshal.Alloc (alloca)
+import           Foreign.Ptr (Ptr, castPtr, nullPtr)
+import           Foreign.Storable (peek)
+
+import           P
+
+import qualified Prelude as Savage
+
+import           System.IO (IO)
+import           System.IO.Unsafe (unsafePerformIO)
+
+
+-- | Render a signed integer in decimal, with a leading @-@ when negative.
+itoa :: Int64 -> ByteString
+itoa x =
+  ByteString.unsafeCreateUptoN maxInt64Length $ \ptr ->
+    fromIntegral <$> c_anemone_i64_to_string x ptr
+{-# INLINE itoa #-}
+
+-- | Render an unsigned integer in decimal.
+utoa :: Word64 -> ByteString
+utoa x =
+  ByteString.unsafeCreateUptoN maxInt64Length $ \ptr ->
+    fromIntegral <$> c_anemone_u64_to_string x ptr
+{-# INLINE utoa #-}
+
+-- | Render a column of integers, each one followed by the delimiter.
+renderInt64Column :: Word8 -> Storable.Vector Int64 -> ByteString
+renderInt64Column delim xs =
+  unsafePerformIO .
+  bracket Mempool.create Mempool.free $ \pool ->
+  Storable.unsafeWith xs $ \values ->
+  alloca $ \psize -> do
+    out <- c_anemone_i64_column_to_string pool values (fromIntegral $ Storable.length xs) delim psize
+    if out == nullPtr then
+      Savage.error "Anemone.Foreign.Itoa.renderInt64Column: out of memory"
+    else do
+      size <- peek psize
+      B.packCStringLen (castPtr out, fromIntegral size)
+
+maxInt64Length :: Int
+maxInt64Length =
+  20
+
+foreign import ccall unsafe "hs_anemone_i64_to_string"
+  c_anemone_i64_to_string :: Int64 -> Ptr Word8 -> IO CSize
+
+foreign import ccall unsafe "hs_anemone_u64_to_string"
+  c_anemone_u64_to_string :: Word64 -> Ptr Word8 -> IO CSize
+
+foreign import ccall unsafe "hs_anemone_i64_column_to_string"
+  c_anemone_i64_column_to_string :: Mempool -> Ptr Int64 -> Int64 -> Word8 -> Ptr CSize -> IO (Ptr Word8)
@@ -4,6 +4,7 @@ module Anemone.Foreign.Memcmp.Export (
     memcmp
   , memcmp8
   , memcmp64
+  , memcmp128
   , memcmp128_unsafe
   , memcmp_partial_load64
   ) where
@@ -33,6 +34,9 @@ memcmp8 = wrapCmp hs_anemone_memcmp8
 memcmp64 :: B.ByteString -> B.ByteString -> Ordering
 memcmp64 = wrapCmp hs_anemone_memcmp64
 
+memcmp128 :: B.ByteString -> B.ByteString -> Ordering
+memcmp128 = wrapCmp hs_anemone_memcmp128
+
 memcmp128_unsafe :: B.ByteString -> B.ByteString -> Ordering
 memcmp128_unsafe = wrapCmp hs_anemone_memcmp128_unsafe
 
@@ -51,6 +55,10 @@ foreign import ccall unsafe
     hs_anemone_memcmp_partial_load64
     :: MemcmpT_Raw
 
+foreign import ccall unsafe
+    hs_anemone_memcmp128
+    :: MemcmpT_Raw
+
 foreign import ccall unsafe
     hs_anemone_memcmp128_unsafe
     :: MemcmpT_Raw
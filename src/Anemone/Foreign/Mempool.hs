@@ -5,21 +5,35 @@
 {-# LANGUAGE ScopedTypeVariables #-}
 module Anemone.Foreign.Mempool (
     Mempool(..)
+  , Mark
+  , Config(..)
+  , Backing(..)
+  , Stats(..)
+  , defaultConfig
   , create
+  , createWith
+  , createArena
   , alloc
   , allocBytes
   , calloc
   , callocBytes
   , free
+  , reset
+  , mark
+  , rewind
   , totalAllocSize
+  , stats
   , isPointerAligned
   ) where
 
 import           Anemone.Foreign.Data ( CBool(..) )
 
 import           Data.Void (Void)
+import           Data.Word (Word32, Word64)
 
 import           Foreign.C.Types ( CInt (..), CSize(..) )
+import           Foreign.ForeignPtr ( ForeignPtr, mallocForeignPtrBytes, withForeignPtr )
+import           Foreign.Marshal.Array ( allocaArray )
 import           Foreign.Ptr ( Ptr )
 import           Foreign.Storable ( Storable(..) )
 
@@ -43,6 +57,53 @@ newtype Mempool =
 foreign import ccall unsafe "anemone_mempool_create"
   create :: IO Mempool
 
+-- | Where the memory for a pool's blocks comes from.
+--   The mmap backings fall back to the next best option when the system refuses them.
+data Backing =
+    BackingMalloc
+  -- ^ Plain malloc, the default.
+  | BackingMmap
+  -- ^ Anonymous mmap, returning memory straight to the OS when freed.
+  | BackingMmapTHP
+  -- ^ Anonymous mmap, asking for transparent huge pages.
+  | BackingMmapHugeTLB
+  -- ^ Anonymous mmap from the reserved huge page pool.
+    deriving (Eq, Ord, Show, Enum, Bounded, Generic)
+
+-- | Options for creating a pool.
+data Config =
+  Config {
+      configBlockSize :: !CSize
+    -- ^ Payload size of the first block.
+    , configGrowthFactor :: !Word32
+    -- ^ Each new block is this many times larger than the previous one.
+    , configMaxBlockSize :: !CSize
+    -- ^ The largest a block can grow to.
+    , configBacking :: !Backing
+    } deriving (Eq, Ord, Show, Generic)
+
+-- | The options used by @create@: fixed size 1MB blocks taken from malloc.
+defaultConfig :: Config
+defaultConfig =
+  Config (1024 * 1024) 1 (1024 * 1024) BackingMalloc
+
+-- | Create a pool with the given options.
+--   Large pools should use a bigger or growing block size.
+createWith :: Config -> IO Mempool
+createWith (Config size growth maxSize backing) =
+  c_create_with size growth maxSize (fromIntegral $ fromEnum backing)
+
+foreign import ccall unsafe "hs_anemone_mempool_create_with"
+  c_create_with :: CSize -> Word32 -> CSize -> CInt -> IO Mempool
+
+-- | Create a thread arena which allocates on behalf of a shared root pool.
+--   Each arena must only be used by one thread at a time, but everything
+--   allocated from it lives until the root is freed.
+--   Arenas are freed along with their root.
+--
+foreign import ccall unsafe "anemone_mempool_arena_create"
+  createArena :: Mempool -> IO Mempool
+
 foreign import ccall unsafe "hs_anemone_mempool_alloc"
   allocBytes :: Mempool -> CSize -> IO (Ptr a)
 
@@ -52,9 +113,80 @@ foreign import ccall unsafe "hs_anemone_mempool_calloc"
 foreign import ccall unsafe "anemone_mempool_free"
   free :: Mempool -> IO ()
 
+-- | Reset a pool so its memory can be reused, invalidating everything
+--   allocated from it. The pool keeps the blocks it needed for the last batch,
+--   so repeatedly allocating the same amount does not call malloc.
+--
+foreign import ccall unsafe "anemone_mempool_reset"
+  reset :: Mempool -> IO ()
+
+-- | A checkpoint in a pool, which can be rewound to.
+newtype Mark =
+  Mark (ForeignPtr Mark)
+
+-- | Save the current position of a pool.
+mark :: Mempool -> IO Mark
+mark mp = do
+  fp <- mallocForeignPtrBytes (fromIntegral c_mark_size)
+  withForeignPtr fp $ c_mark mp
+  return (Mark fp)
+
+-- | Release everything allocated since the mark was taken.
+--   The mark can be rewound to again, but not after rewinding to an earlier mark.
+rewind :: Mempool -> Mark -> IO ()
+rewind mp (Mark fp) =
+  withForeignPtr fp $ c_rewind mp
+
+foreign import ccall unsafe "hs_anemone_mempool_mark"
+  c_mark :: Mempool -> Ptr Mark -> IO ()
+
+foreign import ccall unsafe "hs_anemone_mempool_rewind"
+  c_rewind :: Mempool -> Ptr Mark -> IO ()
+
+foreign import ccall unsafe "hs_anemone_mempool_mark_size"
+  c_mark_size :: CSize
+
 foreign import ccall unsafe "anemone_mempool_total_alloc_size"
   totalAllocSize :: Mempool -> IO Int64
 
+-- | Allocation counters for a pool. These are cumulative over the life of the
+--   pool, apart from the high water mark which is the largest total alloc size seen.
+data Stats =
+  Stats {
+      statsBytesRequested :: !Word64
+    -- ^ Bytes asked for.
+    , statsBytesRounded :: !Word64
+    -- ^ Bytes asked for, after rounding up for alignment.
+    , statsBytesWasted :: !Word64
+    -- ^ Bytes left unused at the end of a block when the pool moved on to a new one.
+    , statsBlocks :: !Word64
+    -- ^ Number of standard blocks the pool has started allocating from.
+    , statsLargeBlocks :: !Word64
+    -- ^ Number of blocks made for oversized allocations.
+    , statsLargeBytes :: !Word64
+    -- ^ Total size of the blocks made for oversized allocations.
+    , statsHighWater :: !Word64
+    -- ^ The largest total alloc size the pool has reached.
+    } deriving (Eq, Ord, Show, Generic)
+
+-- | Take a snapshot of a pool's counters, including its thread arenas.
+stats :: Mempool -> IO Stats
+stats mp =
+  -- anemone_mempool_stats_t is seven uint64_t fields
+  allocaArray 7 $ \ptr -> do
+    c_stats mp ptr
+    Stats
+      <$> peekElemOff ptr 0
+      <*> peekElemOff ptr 1
+      <*> peekElemOff ptr 2
+      <*> peekElemOff ptr 3
+      <*> peekElemOff ptr 4
+      <*> peekElemOff ptr 5
+      <*> peekElemOff ptr 6
+
+foreign import ccall unsafe "anemone_mempool_stats"
+  c_stats :: Mempool -> Ptr Word64 -> IO ()
+
 foreign import ccall unsafe "anemone_is_pointer_aligned"
   isPointerAligned :: Ptr Void -> IO CBool
 
@@ -5,6 +5,24 @@ module Anemone.Foreign.Pack (
     Packed64(..)
   , pack64
   , unpack64
+  , index64
+  , Packed32(..)
+  , pack32
+  , unpack32
+  , Packed128(..)
+  , pack128
+  , unpack128
+  , gather64
+
+  , Aggregate64(..)
+  , aggregate64
+  , Predicate(..)
+  , select64
+
+  , Codec(..)
+  , Encoded64(..)
+  , encode64
+  , decode64
 
   , bitsof
   ) where
@@ -15,10 +33,13 @@ import           Data.Bits ((.|.))
 import           Data.ByteString.Internal (ByteString(..))
 import qualified Data.ByteString.Internal as B
 import qualified Data.Vector.Storable as Storable
-import           Data.Word (Word8, Word64)
+import           Data.Word (Word8, Word32, Word64)
 
 import           Foreign.ForeignPtr (withForeignPtr)
+import           Foreign.Marshal.Alloc (alloca)
+import           Foreign.Marshal.Array (allocaArray, peekArray)
 import           Foreign.Ptr
+import           Foreign.Storable (peek)
 
 import           GHC.ForeignPtr (mallocPlainForeignPtrBytes)
 
@@ -105,6 +126,370 @@ unpack64 (Packed64 blocks bits (PS fpin off len))
    outputCount
     = blocks * 64
 
+data Packed32
+ = Packed32
+ { packed32Blocks :: !Int
+ , packed32Bits   :: !Int
+ , packed32Bytes  :: !ByteString
+ } deriving (Eq, Ord, Read, Show)
+
+-- | Packs 64n x 32-bit words, returns Nothing if the length of the input
+--   vector was not a multiple of 64. The bytes are the same as 'pack64'
+--   would give for the same values.
+pack32 :: Storable.Vector Word32 -> Maybe Packed32
+pack32 xs
+ | remains /= 0
+ = Nothing
+
+ | otherwise
+ = Just . Packed32 blocks bits . unsafePerformIO .
+    withForeignPtr fp $ \pin ->
+    B.create outputSize $ \pout -> do
+     -- c_pack32_64 can fail, but only if the bits is > 32.
+     ok <- c_pack32_64
+          (fromIntegral blocks)
+          (fromIntegral bits)
+          pin
+          pout
+     case ok of
+      0 -> return ()
+      _ -> Savage.error ("Anemone.Foreign.Pack.pack32: impossible: call to c_pack32_64 failed with error code " <> show ok)
+
+ where
+  (fp, _)
+   = Storable.unsafeToForeignPtr0 xs
+
+  (blocks, remains)
+   = Storable.length xs `divMod` 64
+
+  bits
+   = bitsof . fromIntegral $ Storable.foldl' (.|.) 0 xs
+
+  outputSize
+   = fromIntegral $ (bits * blocks * 64) `div` 8
+
+-- | Unpacks 64n x 32-bit words.
+unpack32 :: Packed32 -> Maybe (Storable.Vector Word32)
+unpack32 (Packed32 blocks bits (PS fpin off len))
+ | len /= inputSize
+ = Nothing
+
+ | otherwise
+ = unsafePerformIO $ do
+    fpout <- mallocPlainForeignPtrBytes outputSize
+
+    ok <- withForeignPtr fpout $ \pout ->
+           withForeignPtr fpin $ \pin -> do
+            c_unpack32_64
+             (fromIntegral blocks)
+             (fromIntegral bits)
+             (pin `plusPtr` off)
+             pout
+
+    case ok of
+     0 ->
+      return . Just $
+       Storable.unsafeFromForeignPtr0 fpout outputCount
+     _ ->
+      return Nothing
+ where
+   inputSize
+    = (bits * blocks * 64) `div` 8
+
+   outputSize
+    = outputCount * 4
+
+   outputCount
+    = blocks * 64
+
+data Packed128
+ = Packed128
+ { packed128Blocks :: !Int
+ , packed128Bits   :: !Int
+ , packed128Bytes  :: !ByteString
+ } deriving (Eq, Ord, Read, Show)
+
+-- | Packs 128n x 64-bit words, returns Nothing if the length of the input
+--   vector was not a multiple of 128.
+pack128 :: Storable.Vector Word64 -> Maybe Packed128
+pack128 xs
+ | remains /= 0
+ = Nothing
+
+ | otherwise
+ = Just . Packed128 blocks bits . unsafePerformIO .
+    withForeignPtr fp $ \pin ->
+    B.create outputSize $ \pout -> do
+     -- c_pack64_128 can fail, but only if the bits is > 64.
+     ok <- c_pack64_128
+          (fromIntegral blocks)
+          (fromIntegral bits)
+          pin
+          pout
+     case ok of
+      0 -> return ()
+      _ -> Savage.error ("Anemone.Foreign.Pack.pack128: impossible: call to c_pack64_128 failed with error code " <> show ok)
+
+ where
+  (fp, _)
+   = Storable.unsafeToForeignPtr0 xs
+
+  (blocks, remains)
+   = Storable.length xs `divMod` 128
+
+  bits
+   = bitsof $ Storable.foldl' (.|.) 0 xs
+
+  outputSize
+   = fromIntegral $ (bits * blocks * 128) `div` 8
+
+-- | Unpacks 128n x 64-bit words.
+unpack128 :: Packed128 -> Maybe (Storable.Vector Word64)
+unpack128 (Packed128 blocks bits (PS fpin off len))
+ | len /= inputSize
+ = Nothing
+
+ | otherwise
+ = unsafePerformIO $ do
+    fpout <- mallocPlainForeignPtrBytes outputSize
+
+    ok <- withForeignPtr fpout $ \pout ->
+           withForeignPtr fpin $ \pin -> do
+            c_unpack64_128
+             (fromIntegral blocks)
+             (fromIntegral bits)
+             (pin `plusPtr` off)
+             pout
+
+    case ok of
+     0 ->
+      return . Just $
+       Storable.unsafeFromForeignPtr0 fpout outputCount
+     _ ->
+      return Nothing
+ where
+   inputSize
+    = (bits * blocks * 128) `div` 8
+
+   outputSize
+    = outputCount * 8
+
+   outputCount
+    = blocks * 128
+
+-- | Reads a single value without unpacking its block, returns Nothing if
+--   the index is out of range.
+index64 :: Packed64 -> Int -> Maybe Word64
+index64 (Packed64 blocks bits (PS fpin off len)) ix
+ | len /= inputSize || ix < 0 || ix >= blocks * 64
+ = Nothing
+
+ | otherwise
+ = Just . unsafePerformIO .
+    withForeignPtr fpin $ \pin ->
+     c_pack_get
+      (fromIntegral bits)
+      (pin `plusPtr` off)
+      (fromIntegral ix)
+ where
+   inputSize
+    = (bits * blocks * 64) `div` 8
+
+-- | Reads the values at each index without unpacking their blocks, returns
+--   Nothing if any index is out of range.
+gather64 :: Packed64 -> Storable.Vector Word64 -> Maybe (Storable.Vector Word64)
+gather64 (Packed64 blocks bits (PS fpin off len)) ixs
+ | len /= inputSize || Storable.any (>= fromIntegral (blocks * 64)) ixs
+ = Nothing
+
+ | otherwise
+ = unsafePerformIO $ do
+    fpout <- mallocPlainForeignPtrBytes outputSize
+
+    ok <- withForeignPtr fpout $ \pout ->
+           withForeignPtr fpin $ \pin ->
+           Storable.unsafeWith ixs $ \pixs -> do
+            c_pack_gather
+             (fromIntegral bits)
+             (pin `plusPtr` off)
+             (fromIntegral outputCount)
+             pixs
+             pout
+
+    case ok of
+     0 ->
+      return . Just $
+       Storable.unsafeFromForeignPtr0 fpout outputCount
+     _ ->
+      return Nothing
+ where
+   inputSize
+    = (bits * blocks * 64) `div` 8
+
+   outputSize
+    = outputCount * 8
+
+   outputCount
+    = Storable.length ixs
+
+data Aggregate64
+ = Aggregate64
+ { aggregateSum :: !Word64
+ , aggregateMin :: !Word64
+ , aggregateMax :: !Word64
+ } deriving (Eq, Ord, Read, Show)
+
+-- | The sum, min and max of packed values, without unpacking them.
+--   The sum wraps on overflow, and without any values the min is 'maxBound'.
+aggregate64 :: Packed64 -> Maybe Aggregate64
+aggregate64 (Packed64 blocks bits (PS fpin off len))
+ | len /= inputSize
+ = Nothing
+
+ | otherwise
+ = unsafePerformIO .
+    withForeignPtr fpin $ \pin ->
+    allocaArray 3 $ \pout -> do
+     ok <- c_pack_aggregate
+      (fromIntegral blocks)
+      (fromIntegral bits)
+      (pin `plusPtr` off)
+      pout
+      (pout `plusPtr` 8)
+      (pout `plusPtr` 16)
+     case ok of
+      0 -> do
+       [s, lo, hi] <- peekArray 3 pout
+       return . Just $ Aggregate64 s lo hi
+      _ ->
+       return Nothing
+ where
+   inputSize
+    = (bits * blocks * 64) `div` 8
+
+-- | A comparison against packed values.
+data Predicate =
+    Equal !Word64
+  | LessThan !Word64
+  | Between !Word64 !Word64
+  -- ^ Inclusive of both bounds.
+    deriving (Eq, Ord, Read, Show)
+
+-- | Compares packed values without unpacking them, giving a mask per block
+--   where bit i is set if value i matched.
+select64 :: Predicate -> Packed64 -> Maybe (Storable.Vector Word64)
+select64 predicate (Packed64 blocks bits (PS fpin off len))
+ | len /= inputSize
+ = Nothing
+
+ | otherwise
+ = unsafePerformIO $ do
+    fpout <- mallocPlainForeignPtrBytes outputSize
+
+    ok <- withForeignPtr fpout $ \pout ->
+           withForeignPtr fpin $ \pin ->
+            case predicate of
+             Equal x ->
+              c_pack_eq (fromIntegral blocks) (fromIntegral bits) (pin `plusPtr` off) x pout
+             LessThan x ->
+              c_pack_lt (fromIntegral blocks) (fromIntegral bits) (pin `plusPtr` off) x pout
+             Between lo hi ->
+              c_pack_between (fromIntegral blocks) (fromIntegral bits) (pin `plusPtr` off) lo hi pout
+
+    case ok of
+     0 ->
+      return . Just $
+       Storable.unsafeFromForeignPtr0 fpout blocks
+     _ ->
+      return Nothing
+ where
+   inputSize
+    = (bits * blocks * 64) `div` 8
+
+   outputSize
+    = blocks * 8
+
+-- | A block codec, each block of 64 values picks its own bits per value.
+data Codec =
+    CodecRaw
+  -- ^ Values are packed as they are.
+  | CodecFrameOfReference
+  -- ^ The minimum of each block, plus packed offsets from it.
+  | CodecDelta
+  -- ^ The first value of each block, plus packed differences between values.
+  --   This suits sorted values, but any values roundtrip.
+  | CodecZigZag
+  -- ^ Values are treated as signed, so small negative values take few bits.
+    deriving (Eq, Ord, Show, Read, Enum, Bounded)
+
+data Encoded64
+ = Encoded64
+ { encodedCodec  :: !Codec
+ , encodedBlocks :: !Int
+ , encodedBytes  :: !ByteString
+ } deriving (Eq, Ord, Read, Show)
+
+-- | Encodes 64n x 64-bit words, returns Nothing if the length of the input
+--   vector was not a multiple of 64.
+encode64 :: Codec -> Storable.Vector Word64 -> Maybe Encoded64
+encode64 codec xs
+ | remains /= 0
+ = Nothing
+
+ | otherwise
+ = Just . Encoded64 codec blocks . unsafePerformIO .
+    withForeignPtr fp $ \pin ->
+    B.createAndTrim outputBound $ \pout ->
+    alloca $ \psize -> do
+     -- c_encode64_64 can fail, but only if the codec is not known.
+     ok <- c_encode64_64
+          (fromIntegral $ fromEnum codec)
+          (fromIntegral blocks)
+          pin
+          pout
+          psize
+     case ok of
+      0 -> fromIntegral <$> peek psize
+      _ -> Savage.error ("Anemone.Foreign.Pack.encode64: impossible: call to c_encode64_64 failed with error code " <> show ok)
+
+ where
+  (fp, _)
+   = Storable.unsafeToForeignPtr0 xs
+
+  (blocks, remains)
+   = Storable.length xs `divMod` 64
+
+  outputBound
+   = fromIntegral $ c_encode64_64_bound (fromIntegral blocks)
+
+-- | Decodes 64n x 64-bit words, returns Nothing if the input is malformed.
+decode64 :: Encoded64 -> Maybe (Storable.Vector Word64)
+decode64 (Encoded64 codec blocks (PS fpin off len))
+ = unsafePerformIO $ do
+    fpout <- mallocPlainForeignPtrBytes outputSize
+
+    ok <- withForeignPtr fpout $ \pout ->
+           withForeignPtr fpin $ \pin -> do
+            c_decode64_64
+             (fromIntegral $ fromEnum codec)
+             (fromIntegral blocks)
+             (pin `plusPtr` off)
+             (fromIntegral len)
+             pout
+
+    case ok of
+     0 ->
+      return . Just $
+       Storable.unsafeFromForeignPtr0 fpout outputCount
+     _ ->
+      return Nothing
+ where
+   outputSize
+    = outputCount * 8
+
+   outputCount
+    = blocks * 64
+
 -- | Gets the number of bits required to store a value.
 bitsof :: Word64 -> Int
 bitsof
@@ -118,6 +503,58 @@ foreign import ccall unsafe "anemone_pack64_64"
 foreign import ccall unsafe "anemone_unpack64_64"
   c_unpack64_64 :: Word64 -> Word64 -> Ptr Word8 -> Ptr Word64 -> IO CError
 
+-- | error_t anemone_pack32_64 (uint64_t blocks, const uint64_t bits, const uint32_t *in, uint8_t *out)
+foreign import ccall unsafe "anemone_pack32_64"
+  c_pack32_64 :: Word64 -> Word64 -> Ptr Word32 -> Ptr Word8 -> IO CError
+
+-- | error_t anemone_unpack32_64 (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint32_t *out)
+foreign import ccall unsafe "anemone_unpack32_64"
+  c_unpack32_64 :: Word64 -> Word64 -> Ptr Word8 -> Ptr Word32 -> IO CError
+
+-- | error_t anemone_pack64_128 (uint64_t blocks, const uint64_t bits, const uint64_t *in, uint8_t *out)
+foreign import ccall unsafe "anemone_pack64_128"
+  c_pack64_128 :: Word64 -> Word64 -> Ptr Word64 -> Ptr Word8 -> IO CError
+
+-- | error_t anemone_unpack64_128 (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t *out)
+foreign import ccall unsafe "anemone_unpack64_128"
+  c_unpack64_128 :: Word64 -> Word64 -> Ptr Word8 -> Ptr Word64 -> IO CError
+
+-- | uint64_t anemone_pack_get (uint64_t bits, const uint8_t *in, uint64_t index)
+foreign import ccall unsafe "anemone_pack_get"
+  c_pack_get :: Word64 -> Ptr Word8 -> Word64 -> IO Word64
+
+-- | error_t anemone_pack_gather (uint64_t bits, const uint8_t *in, uint64_t count, const uint64_t *indices, uint64_t *out)
+foreign import ccall unsafe "anemone_pack_gather"
+  c_pack_gather :: Word64 -> Ptr Word8 -> Word64 -> Ptr Word64 -> Ptr Word64 -> IO CError
+
+-- | error_t anemone_pack_aggregate (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t *sum, uint64_t *min, uint64_t *max)
+foreign import ccall unsafe "anemone_pack_aggregate"
+  c_pack_aggregate :: Word64 -> Word64 -> Ptr Word8 -> Ptr Word64 -> Ptr Word64 -> Ptr Word64 -> IO CError
+
+-- | error_t anemone_pack_between (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t lo, uint64_t hi, uint64_t *out)
+foreign import ccall unsafe "anemone_pack_between"
+  c_pack_between :: Word64 -> Word64 -> Ptr Word8 -> Word64 -> Word64 -> Ptr Word64 -> IO CError
+
+-- | error_t anemone_pack_eq (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t value, uint64_t *out)
+foreign import ccall unsafe "anemone_pack_eq"
+  c_pack_eq :: Word64 -> Word64 -> Ptr Word8 -> Word64 -> Ptr Word64 -> IO CError
+
+-- | error_t anemone_pack_lt (uint64_t blocks, const uint64_t bits, const uint8_t *in, uint64_t value, uint64_t *out)
+foreign import ccall unsafe "anemone_pack_lt"
+  c_pack_lt :: Word64 -> Word64 -> Ptr Word8 -> Word64 -> Ptr Word64 -> IO CError
+
+-- | uint64_t anemone_encode64_64_bound (uint64_t blocks)
+foreign import ccall unsafe "anemone_encode64_64_bound"
+  c_encode64_64_bound :: Word64 -> Word64
+
+-- | error_t anemone_encode64_64 (uint64_t codec, uint64_t blocks, const uint64_t *in, uint8_t *out, uint64_t *out_size)
+foreign import ccall unsafe "anemone_encode64_64"
+  c_encode64_64 :: Word64 -> Word64 -> Ptr Word64 -> Ptr Word8 -> Ptr Word64 -> IO CError
+
+-- | error_t anemone_decode64_64 (uint64_t codec, uint64_t blocks, const uint8_t *in, uint64_t in_size, uint64_t *out)
+foreign import ccall unsafe "anemone_decode64_64"
+  c_decode64_64 :: Word64 -> Word64 -> Ptr Word8 -> Word64 -> Ptr Word64 -> IO CError
+
 -- | uint64_t anemone_bitsof (uint64_t value)
 foreign import ccall unsafe "anemone_bitsof"
   c_bitsof :: Word64 -> Word64
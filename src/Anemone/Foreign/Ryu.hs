@@ -0,0 +1,45 @@
+{-# LANGUAGE NoImplicitPrelude #-}
+{-# LANGUAGE ForeignFunctionInterface #-}
+module Anemone.Foreign.Ryu (
+    ryu
+  , fixed
+  ) where
+
+import           Anemone.Foreign.Data
+
+import           Data.ByteString (ByteString)
+import qualified Data.ByteString.Internal as ByteString
+import           Data.Word (Word8)
+
+import           Foreign.Ptr (Ptr)
+
+import           System.IO (IO)
+
+import           P
+
+
+-- | The shortest decimal which reads back as exactly the same 'Double', in
+--   the same format as 'Anemone.Foreign.Grisu2.grisu2'.
+ryu :: Double -> ByteString
+ryu x =
+  ByteString.unsafeCreateUptoN maxDoubleLength $ \ptr ->
+    fromIntegral <$> c_anemone_ryu x ptr
+{-# INLINE ryu #-}
+
+-- | A 'Double' with a fixed number of digits after the point, the same as
+--   @printf "%.*f"@.
+fixed :: Int -> Double -> ByteString
+fixed precision x =
+  ByteString.unsafeCreateUptoN (312 + max 0 precision) $ \ptr ->
+    fromIntegral <$> c_anemone_fixed x (fromIntegral precision) ptr
+{-# INLINE fixed #-}
+
+maxDoubleLength :: Int
+maxDoubleLength =
+  32
+
+foreign import ccall unsafe "anemone_ryu"
+  c_anemone_ryu :: Double -> Ptr Word8 -> IO CSize
+
+foreign import ccall unsafe "anemone_fixed"
+  c_anemone_fixed :: Double -> CInt -> Ptr Word8 -> IO CSize
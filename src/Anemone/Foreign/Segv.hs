@@ -5,18 +5,43 @@ module Anemone.Foreign.Segv (
     withSegv
   , segvInstall
   , segvRemove
+
+  -- * Sampling profiler
+  , Sample(..)
+  , withProfile
+  , profStart
+  , profStop
+  , profDrain
+  , profDropped
+  , profUserData
+  , profSymbol
+  , profMaxDepth
   ) where
 
+import           Anemone.Foreign.Data
+
 import           Control.Exception (bracket_)
 
+import           Data.Int (Int32)
 import           Data.String (String)
 import qualified Data.ByteString.Char8 as B
 import qualified Data.ByteString.Unsafe as B
+import qualified Data.List as List
+import qualified Data.Vector as Boxed
+import qualified Data.Vector.Storable as Storable
+import           Data.Void (Void)
+import           Data.Word (Word64)
 
 import           Foreign.C.String (CString)
+import           Foreign.Marshal.Alloc (allocaBytes)
+import           Foreign.Marshal.Array (peekArray)
+import           Foreign.Ptr (Ptr, plusPtr)
+import           Foreign.Storable (peekByteOff)
 
 import           P
 
+import qualified Prelude as Savage
+
 import           System.IO (IO)
 
 
@@ -39,3 +64,119 @@ foreign import ccall unsafe
     segvRemove
     :: IO ()
 
+
+
+-- | One sample from the profiler, the interrupted program counter followed
+--   by its callers.
+newtype Sample =
+  Sample {
+      sampleFrames :: Storable.Vector (Ptr Void)
+    } deriving (Eq, Show)
+
+-- | Most frames kept per sample, ANEMONE_PROF_MAX_DEPTH.
+profMaxDepth :: Int
+profMaxDepth =
+  fromIntegral hs_anemone_prof_max_depth
+
+-- | sizeof (anemone_prof_sample_t)
+sampleSize :: Int
+sampleSize =
+  fromIntegral hs_anemone_prof_sample_size
+
+-- | offsetof (anemone_prof_sample_t, frames)
+sampleFramesOffset :: Int
+sampleFramesOffset =
+  fromIntegral hs_anemone_prof_sample_frames_offset
+
+-- | Profile an action, returning the samples taken while it ran.
+withProfile :: Int -> Int -> Int -> String -> IO a -> IO (a, Boxed.Vector Sample)
+withProfile hz depth capacity example io = do
+  x <- bracket_ (profStart hz depth capacity (B.pack example)) profStop io
+  samples <- profDrain
+  pure (x, samples)
+
+-- | Start sampling @hz@ times per second of CPU time, keeping up to @depth@
+--   frames per sample, at most 'profMaxDepth', and up to @capacity@ samples
+--   before they are drained.
+profStart :: Int -> Int -> Int -> B.ByteString -> IO ()
+profStart hz depth capacity a = do
+  err <-
+    B.unsafeUseAsCString a $ \a' ->
+      anemone_prof_start (fromIntegral hz) (fromIntegral depth) (fromIntegral capacity) a' (fromIntegral $ B.length a)
+  when (err /= 0) $
+    Savage.error "Anemone.Foreign.Segv.profStart: could not start the profiler"
+
+-- | Every sample which has not been drained yet, oldest first.
+profDrain :: IO (Boxed.Vector Sample)
+profDrain =
+  allocaBytes (chunk * sampleSize) $ \buffer ->
+  let
+    go acc = do
+      n <- anemone_prof_drain buffer (fromIntegral chunk)
+      samples <- Boxed.fromList <$> Savage.mapM (peekSample . plusPtr buffer . (* sampleSize)) [0 .. fromIntegral n - 1]
+      if fromIntegral n < chunk then
+        pure . Boxed.concat $ List.reverse (samples : acc)
+      else
+        go (samples : acc)
+  in
+    go []
+ where
+  chunk =
+    1024
+
+peekSample :: Ptr Sample -> IO Sample
+peekSample ptr = do
+  depth <- peekByteOff ptr 0 :: IO Int32
+  frames <- peekArray (fromIntegral depth) (ptr `plusPtr` sampleFramesOffset)
+  pure . Sample $ Storable.fromList frames
+
+-- | Describe a program counter as @object(symbol+0xoffset)@.
+profSymbol :: Ptr Void -> IO B.ByteString
+profSymbol pc =
+  allocaBytes 1024 $ \buffer -> do
+    _ <- anemone_prof_symbol pc buffer 1024
+    B.packCString buffer
+
+-- | The user data given to 'profStart'.
+profUserData :: IO B.ByteString
+profUserData =
+  anemone_prof_user_data >>= B.packCString
+
+foreign import ccall unsafe
+    anemone_prof_start
+    :: CInt -> CInt -> CSize -> CString -> CSize -> IO CError
+
+foreign import ccall unsafe
+    "anemone_prof_stop"
+    profStop
+    :: IO ()
+
+foreign import ccall unsafe
+    anemone_prof_drain
+    :: Ptr Sample -> Int64 -> IO Int64
+
+-- | Number of samples dropped because the ring was full.
+foreign import ccall unsafe
+    "anemone_prof_dropped"
+    profDropped
+    :: IO Word64
+
+foreign import ccall unsafe
+    anemone_prof_user_data
+    :: IO CString
+
+foreign import ccall unsafe
+    anemone_prof_symbol
+    :: Ptr Void -> CString -> CSize -> IO CInt
+
+foreign import ccall unsafe
+    hs_anemone_prof_sample_size
+    :: CSize
+
+foreign import ccall unsafe
+    hs_anemone_prof_sample_frames_offset
+    :: CSize
+
+foreign import ccall unsafe
+    hs_anemone_prof_max_depth
+    :: CInt
@@ -0,0 +1,63 @@
+{-# LANGUAGE ForeignFunctionInterface #-}
+{-# LANGUAGE NoImplicitPrelude #-}
+module Anemone.Foreign.Sort (
+    sort
+  , sortIndices
+  , sortIndicesParallel
+  ) where
+
+import qualified Anemone.Foreign.Batch as Batch
+import           Anemone.Foreign.Data
+
+import           Data.ByteString (ByteString)
+import qualified Data.Vector as Boxed
+import qualified Data.Vector.Storable as Storable
+import           Data.Word (Word8)
+
+import           Foreign.Ptr (Ptr)
+
+import           P
+
+import qualified Prelude as Savage
+
+import           System.IO (IO)
+import           System.IO.Unsafe (unsafePerformIO)
+
+
+-- | Sort byte strings in the same order as 'compare'.
+sort :: Boxed.Vector ByteString -> Boxed.Vector ByteString
+sort bss =
+  Boxed.backpermute bss . Boxed.map fromIntegral . Storable.convert $
+    sortIndices bss
+
+-- | The index of each byte string, in sorted order. Equal byte strings keep
+--   their original order.
+sortIndices :: Boxed.Vector ByteString -> Storable.Vector Int64
+sortIndices bss =
+  runSort bss $ \n pptrs plens pout ->
+    c_sort_bytes pptrs plens n pout
+
+-- | The same as 'sortIndices', using up to the given number of threads for
+--   large inputs.
+sortIndicesParallel :: Int -> Boxed.Vector ByteString -> Storable.Vector Int64
+sortIndicesParallel threads bss =
+  runSort bss $ \n pptrs plens pout ->
+    c_sort_bytes_parallel pptrs plens n pout (fromIntegral threads)
+
+runSort :: Boxed.Vector ByteString -> (Int64 -> Ptr (Ptr Word8) -> Ptr CSize -> Ptr Int64 -> IO CError) -> Storable.Vector Int64
+runSort bss f =
+  unsafePerformIO $ do
+    (err, indices) <- Batch.withKeys bss f
+
+    when (err /= 0) $
+      Savage.error "Anemone.Foreign.Sort: out of memory"
+
+    pure indices
+{-# INLINE runSort #-}
+
+foreign import ccall unsafe "anemone_sort_bytes"
+  c_sort_bytes :: Ptr (Ptr Word8) -> Ptr CSize -> Int64 -> Ptr Int64 -> IO CError
+
+-- safe, as this can take a while and starts its own threads
+foreign import ccall safe "anemone_sort_bytes_parallel"
+  c_sort_bytes_parallel :: Ptr (Ptr Word8) -> Ptr CSize -> Int64 -> Ptr Int64 -> CInt -> IO CError
@@ -4,6 +4,7 @@
 module Anemone.Foreign.Strtod (
     StrtodT
   , strtod
+  , strtod_scalar
   ) where
 
 import           Anemone.Foreign.Data
@@ -25,6 +26,11 @@ strtod :: StrtodT
 strtod bs
  = wrapStrtod anemone_strtod bs (B.length bs)
 
+-- | The version 'strtod' uses when the CPU does not support SSE4.2.
+strtod_scalar :: StrtodT
+strtod_scalar bs
+ = wrapStrtod anemone_strtod_scalar bs (B.length bs)
+
 
 
 
@@ -63,4 +69,6 @@ foreign import ccall unsafe
     anemone_strtod
     :: StrtodT_Raw
 
-
+foreign import ccall unsafe
+    anemone_strtod_scalar
+    :: StrtodT_Raw
@@ -9,24 +9,42 @@ module Anemone.Foreign.Time (
     TimeError(..)
   , renderTimeError
 
+  , Timestamp(..)
+
   , parseDay
   , parseYearMonthDay
+  , parseTimestamp
+
+  , renderDay
+  , renderDayColumn
   ) where
 
+import           Anemone.Foreign.Data
+import           Anemone.Foreign.Mempool (Mempool)
+import qualified Anemone.Foreign.Mempool as Mempool
+
+import           Control.Exception (bracket)
+
 import           Data.Bits ((.&.), shiftR)
 import qualified Data.ByteString as B
 import           Data.ByteString.Internal (ByteString(..))
+import qualified Data.ByteString.Internal as ByteString
 import qualified Data.Text as T
 import           Data.Thyme.Calendar (YearMonthDay(..), Day(..))
+import qualified Data.Vector.Storable as Storable
 import           Data.Word (Word8, Word64)
 
 import           Foreign.ForeignPtr (withForeignPtr)
-import           Foreign.Ptr (Ptr, plusPtr)
+import           Foreign.Marshal.Alloc (alloca)
+import           Foreign.Ptr (Ptr, castPtr, plusPtr)
+import           Foreign.Storable (Storable(..))
 
 import           GHC.Generics (Generic)
 
 import           P
 
+import qualified Prelude as Savage
+
 import           System.IO (IO)
 import           System.IO.Unsafe (unsafePerformIO)
 
@@ -36,10 +54,35 @@ import           Text.Printf (printf)
 data TimeError =
     TimeParseError !ByteString
   | TimeInvalidDate !YearMonthDay
+  | TimeInvalidTimestamp !ByteString
     deriving (Eq, Ord, Show, Generic)
 
 instance NFData TimeError
 
+-- | An instant as unix time. The nanoseconds are always positive, so an
+--   instant before 1970 has negative seconds and nanoseconds added to that.
+data Timestamp =
+  Timestamp {
+      timestampSeconds :: !Int64
+    , timestampNanos :: !Int64
+    } deriving (Eq, Ord, Show, Generic)
+
+instance NFData Timestamp
+
+-- | The same layout as @anemone_timestamp_t@.
+instance Storable Timestamp where
+  sizeOf _ =
+    16
+  alignment _ =
+    8
+  peek ptr =
+    Timestamp
+      <$> peekByteOff ptr 0
+      <*> peekByteOff ptr 8
+  poke ptr (Timestamp seconds nanos) = do
+    pokeByteOff ptr 0 seconds
+    pokeByteOff ptr 8 nanos
+
 renderTimeError :: TimeError -> Text
 renderTimeError = \case
   TimeParseError bs0 ->
@@ -54,6 +97,8 @@ renderTimeError = \case
   TimeInvalidDate (YearMonthDay y m d) ->
     T.pack $
       printf "Parsed date was not in the gregorian calendar: %04d-%02d-%02d" y m d
+  TimeInvalidTimestamp bs ->
+    "Parsed timestamp was out of range: " <> T.pack (show bs)
 
 parseDay :: ByteString -> Either TimeError (Day, ByteString)
 parseDay bs@(PS fp off len) =
@@ -130,6 +175,81 @@ parseYearMonthDay bs@(PS fp off len) =
         Left $ TimeParseError bs
 {-# INLINE parseYearMonthDay #-}
 
+-- | Parses an ISO-8601 timestamp, @yyyy-mm-ddThh:mm:ss@, with an optional
+--   fraction of a second and an optional offset, @Z@ or @+hh:mm@ / @-hh:mm@.
+--   A timestamp without an offset is in UTC.
+parseTimestamp :: ByteString -> Either TimeError (Timestamp, ByteString)
+parseTimestamp bs@(PS fp off len) =
+  let
+    (!result, !timestamp) =
+      unsafePerformIO . withForeignPtr fp $ \p0 ->
+      alloca $ \ptr -> do
+        let
+          !p =
+            p0 `plusPtr` off
+
+          !pe =
+            p `plusPtr` len
+
+        !r <- c_parse_timestamp p pe ptr
+        !t <- peek ptr
+        pure (r, t)
+
+    -- the number of bytes used is in the upper half, as it is not fixed
+    !used =
+      fromIntegral $ result `shiftR` 32
+
+    !err =
+      result .&. 0x00000000FFFFFFFF
+  in
+    case err of
+      0 ->
+        Right (timestamp, PS fp (off + used) (len - used))
+      2 ->
+        Left $ TimeParseError bs
+      _ ->
+        Left $ TimeInvalidTimestamp (B.take used bs)
+{-# INLINE parseTimestamp #-}
+
+-- | Render a day as @yyyy-mm-dd@, or 'Nothing' if its year is not between
+--   0 and 9999.
+renderDay :: Day -> Maybe ByteString
+renderDay (ModifiedJulianDay mjd) =
+  unsafePerformIO $ do
+    fp <- ByteString.mallocByteString dateLength
+    err <- withForeignPtr fp $ \ptr ->
+      c_modified_julian_to_string (fromIntegral mjd) ptr
+    if err == 0 then
+      pure . Just $ PS fp 0 dateLength
+    else
+      pure Nothing
+{-# INLINE renderDay #-}
+
+-- | Render a column of modified julian days as @yyyy-mm-dd@, each one
+--   followed by the delimiter, or 'Nothing' if any year is not between 0 and
+--   9999.
+renderDayColumn :: Word8 -> Storable.Vector Int64 -> Maybe ByteString
+renderDayColumn delim xs =
+  unsafePerformIO .
+  bracket Mempool.create Mempool.free $ \pool ->
+  Storable.unsafeWith xs $ \values ->
+  alloca $ \pout ->
+  alloca $ \psize -> do
+    err <- c_modified_julian_column_to_string pool values (fromIntegral $ Storable.length xs) delim pout psize
+    case err of
+      0 -> do
+        out <- peek pout
+        size <- peek psize
+        Just <$> B.packCStringLen (castPtr out, fromIntegral size)
+      1 ->
+        pure Nothing
+      _ ->
+        Savage.error "Anemone.Foreign.Time.renderDayColumn: out of memory"
+
+dateLength :: Int
+dateLength =
+  10
+
 -- | Do an arithmetic right shift on a 'Word64' (i.e. maintain the sign bit)
 shiftAR :: Word64 -> Int -> Int64
 shiftAR !x !n =
@@ -141,3 +261,12 @@ foreign import ccall unsafe "anemone_parse_gregorian_hs"
 
 foreign import ccall unsafe "anemone_parse_gregorian_as_modified_julian_hs"
   c_parse_gregorian_as_modified_julian :: Ptr Word8 -> Ptr Word8 -> IO Word64
+
+foreign import ccall unsafe "anemone_parse_timestamp_hs"
+  c_parse_timestamp :: Ptr Word8 -> Ptr Word8 -> Ptr Timestamp -> IO Word64
+
+foreign import ccall unsafe "anemone_modified_julian_to_string"
+  c_modified_julian_to_string :: Int64 -> Ptr Word8 -> IO CError
+
+foreign import ccall unsafe "hs_anemone_modified_julian_column_to_string"
+  c_modified_julian_column_to_string :: Mempool -> Ptr Int64 -> Int64 -> Word8 -> Ptr (Ptr Word8) -> Ptr CSize -> IO CError
@@ -0,0 +1,96 @@
+{-# LANGUAGE BangPatterns #-}
+{-# LANGUAGE ForeignFunctionInterface #-}
+{-# LANGUAGE NoImplicitPrelude #-}
+module Anemone.Foreign.Tokenize (
+    delimiterBitmap
+  , delimiterOffsets
+  ) where
+
+import           Anemone.Foreign.Data
+
+import           Data.ByteString.Internal (ByteString(..))
+import qualified Data.Vector.Storable as Storable
+import           Data.Word (Word8, Word64)
+
+import           Foreign.ForeignPtr (withForeignPtr)
+import           Foreign.Marshal.Alloc (alloca)
+import           Foreign.Ptr (Ptr, nullPtr, plusPtr)
+import           Foreign.Storable (poke)
+
+import           GHC.ForeignPtr (mallocPlainForeignPtrBytes)
+
+import           P
+
+import           System.IO (IO)
+import           System.IO.Unsafe (unsafePerformIO)
+
+
+-- | A bitmap with one bit per byte of the input, set for each separator or
+--   terminator which is not inside quotes.
+--
+--   A field is quoted when it is between two of the quote bytes, and a quote
+--   inside a quoted field is written as two of them. With no quote byte,
+--   every separator and terminator is set.
+--
+delimiterBitmap :: Word8 -> Word8 -> Maybe Word8 -> ByteString -> Storable.Vector Word64
+delimiterBitmap sep term quote (PS fp off len) =
+  unsafePerformIO $ do
+    let
+      !blocks =
+        (len + 63) `div` 64
+
+    fp_delims <- mallocPlainForeignPtrBytes (blocks * 8)
+
+    withForeignPtr fp $ \ptr ->
+      withForeignPtr fp_delims $ \ptr_delims ->
+      alloca $ \pstate -> do
+        let
+          !ptr_in =
+            ptr `plusPtr` off
+
+        poke pstate (0 :: Word64)
+        c_tokenize_bitmap pstate ptr_in (ptr_in `plusPtr` len) sep term (fromQuote quote) ptr_delims nullPtr
+
+    pure $
+      Storable.unsafeFromForeignPtr0 fp_delims blocks
+
+-- | The offset of each separator or terminator which is not inside quotes,
+--   as for 'delimiterBitmap'. Each is the end of a field, and the byte after
+--   it is the start of the next one.
+--
+delimiterOffsets :: Word8 -> Word8 -> Maybe Word8 -> ByteString -> Storable.Vector Int64
+delimiterOffsets sep term quote bs =
+  unsafePerformIO $ do
+    let
+      !bitmap =
+        delimiterBitmap sep term quote bs
+
+      !blocks =
+        Storable.length bitmap
+
+    Storable.unsafeWith bitmap $ \ptr_bitmap -> do
+      count <- fromIntegral <$> c_tokenize_count ptr_bitmap (fromIntegral blocks)
+      fp_offsets <- mallocPlainForeignPtrBytes (count * 8)
+
+      _ <-
+        withForeignPtr fp_offsets $ \ptr_offsets ->
+          c_tokenize_expand ptr_bitmap (fromIntegral blocks) ptr_offsets
+
+      pure $
+        Storable.unsafeFromForeignPtr0 fp_offsets count
+
+-- | ANEMONE_TOKENIZE_NO_QUOTE when there is no quote byte.
+fromQuote :: Maybe Word8 -> CInt
+fromQuote =
+  maybe (-1) fromIntegral
+
+-- | The state is a single word, saying whether the input so far ends inside
+--   quotes.
+foreign import ccall unsafe "anemone_tokenize_bitmap"
+  c_tokenize_bitmap :: Ptr Word64 -> Ptr Word8 -> Ptr Word8 -> Word8 -> Word8 -> CInt -> Ptr Word64 -> Ptr Word64 -> IO ()
+
+foreign import ccall unsafe "anemone_tokenize_count"
+  c_tokenize_count :: Ptr Word64 -> Int64 -> IO Int64
+
+foreign import ccall unsafe "anemone_tokenize_expand"
+  c_tokenize_expand :: Ptr Word64 -> Int64 -> Ptr Int64 -> IO Int64
@@ -9,6 +9,13 @@ module Anemone.Foreign.VInt (
 
   , decodeVInt
   , decodeVIntArray
+
+  , skipVInts
+  , countVInts
+
+  , VIntIndex(..)
+  , indexVInts
+  , seekVInt
   ) where
 
 import           Anemone.Foreign.Data
@@ -24,6 +31,7 @@ import           Data.Word (Word8)
 import           Foreign.C.Types (CInt(..))
 import           Foreign.ForeignPtr (withForeignPtr)
 import           Foreign.Marshal.Alloc (alloca)
+import           Foreign.Marshal.Utils (with)
 import           Foreign.Ptr (Ptr, plusPtr, minusPtr)
 import           Foreign.Storable (peek, poke)
 
@@ -51,23 +59,23 @@ encodeVInt x =
       !ptr_end <- c_write_vint x ptr_out
       pure $! ptr_end `minusPtr` ptr_out
 
+-- | Encodes an array of integers, in to a buffer which is allocated at
+--   exactly the size needed rather than the size of the largest encoding.
 encodeVIntArray :: Storable.Vector Int64 -> ByteString
 encodeVIntArray xs =
   let
     n =
       Storable.length xs
 
-    maxSize =
-      maxVIntSize * n
-
     (fp_in, _) =
       Storable.unsafeToForeignPtr0 xs
   in
     unsafePerformIO $
-      withForeignPtr fp_in $ \ptr_in ->
-      B.createUptoN maxSize $ \ptr_out -> do
-        !ptr_end <- c_write_vint_array (fromIntegral n) ptr_in ptr_out
-        pure $! ptr_end `minusPtr` ptr_out
+      withForeignPtr fp_in $ \ptr_in -> do
+        !size <- fromIntegral <$> c_vint_size_array (fromIntegral n) ptr_in
+        B.create size $ \ptr_out -> do
+          !_ <- c_write_vint_array_sized (fromIntegral n) ptr_in ptr_out (ptr_out `plusPtr` size)
+          pure ()
 
 decodeVInt :: ByteString -> Maybe (Int64, ByteString)
 decodeVInt (PS fp_in off_in len_in) =
@@ -140,17 +148,169 @@ decodeVIntArray n (PS fp_in off_in len_in) =
         _ ->
           pure Nothing
 
+-- | Skips over some integers without decoding them, returning the rest of
+--   the input.
+skipVInts :: Int -> ByteString -> Maybe ByteString
+skipVInts n (PS fp_in off_in len_in) =
+  if n < 0 then
+    Nothing
+  else
+    unsafePerformIO $ do
+      (code, used) <-
+        withForeignPtr fp_in $ \ptr_in0 ->
+        alloca $ \pptr_in -> do
+          let
+            !ptr_in1 =
+              ptr_in0 `plusPtr` off_in
+
+          poke pptr_in ptr_in1
+
+          !code <-
+            c_vint_skip
+              pptr_in
+              (ptr_in1 `plusPtr` len_in)
+              (fromIntegral n)
+
+          ptr_in2 <- peek pptr_in
+
+          pure $! (code, ptr_in2 `minusPtr` ptr_in1)
+
+      case code of
+        0 ->
+          pure . Just $
+            PS fp_in (off_in + used) (len_in - used)
+        _ ->
+          pure Nothing
+
+-- | Counts the integers in some input, without decoding them.
+countVInts :: ByteString -> Maybe Int
+countVInts (PS fp_in off_in len_in) =
+  unsafePerformIO $ do
+    (code, count) <-
+      withForeignPtr fp_in $ \ptr_in0 ->
+      alloca $ \ptr_count -> do
+        let
+          !ptr_in1 =
+            ptr_in0 `plusPtr` off_in
+
+        !code <-
+          c_vint_count
+            ptr_in1
+            (ptr_in1 `plusPtr` len_in)
+            ptr_count
+
+        count <- peek ptr_count
+
+        pure $! (code, count)
+
+    case code of
+      0 ->
+        pure . Just $ fromIntegral count
+      _ ->
+        pure Nothing
+
+-- | A sparse index of some encoded integers, with the byte offset of every
+--   'vintIndexStride'th integer.
+data VIntIndex =
+  VIntIndex {
+      vintIndexStride :: !Int
+    , vintIndexOffsets :: !(Storable.Vector Int64)
+    } deriving (Eq, Show)
+
+-- | Builds an index with an entry every @stride@ integers, so that
+--   'seekVInt' only needs to skip @stride - 1@ integers at most.
+indexVInts :: Int -> ByteString -> Maybe VIntIndex
+indexVInts stride bs@(PS fp_in off_in len_in) =
+  if stride < 1 then
+    Nothing
+  else do
+    count <- countVInts bs
+
+    let
+      entries =
+        (count + stride - 1) `div` stride
+
+    unsafePerformIO $ do
+      fp_out <- mallocPlainForeignPtrBytes (entries * 8)
+
+      code <-
+        withForeignPtr fp_out $ \ptr_out ->
+        withForeignPtr fp_in $ \ptr_in0 -> do
+          let
+            !ptr_in1 =
+              ptr_in0 `plusPtr` off_in
+
+          c_vint_index
+            ptr_in1
+            (ptr_in1 `plusPtr` len_in)
+            (fromIntegral stride)
+            ptr_out
+
+      case code of
+        0 ->
+          pure . Just . VIntIndex stride $
+            Storable.unsafeFromForeignPtr0 fp_out entries
+        _ ->
+          pure Nothing
+
+-- | Finds an integer using an index built by 'indexVInts' over the same
+--   input, returning the input starting from that integer.
+seekVInt :: VIntIndex -> Int -> ByteString -> Maybe ByteString
+seekVInt (VIntIndex stride offsets) k (PS fp_in off_in len_in) =
+  let
+    (fp_offsets, entries) =
+      Storable.unsafeToForeignPtr0 offsets
+  in
+    unsafePerformIO $ do
+      (code, used) <-
+        withForeignPtr fp_offsets $ \ptr_offsets ->
+        withForeignPtr fp_in $ \ptr_in0 ->
+        with ptr_in0 $ \pptr_out -> do
+          let
+            !ptr_in1 =
+              ptr_in0 `plusPtr` off_in
+
+          poke pptr_out ptr_in1
+
+          !code <-
+            c_vint_seek
+              ptr_in1
+              (ptr_in1 `plusPtr` len_in)
+              (fromIntegral stride)
+              (fromIntegral entries)
+              ptr_offsets
+              (fromIntegral k)
+              pptr_out
+
+          ptr_out <- peek pptr_out
+
+          pure $! (code, ptr_out `minusPtr` ptr_in1)
+
+      case code of
+        0 ->
+          pure . Just $
+            PS fp_in (off_in + used) (len_in - used)
+        _ ->
+          pure Nothing
+
 foreign import ccall unsafe "anemone_write_vint"
   c_write_vint ::
     Int64 ->
     Ptr Word8 ->
     IO (Ptr Word8)
 
-foreign import ccall unsafe "anemone_write_vint_array"
-  c_write_vint_array ::
+foreign import ccall unsafe "anemone_vint_size_array"
+  c_vint_size_array ::
+    Int64 ->
+    Ptr Int64 ->
+    IO Int64
+
+foreign import ccall unsafe "anemone_write_vint_array_sized"
+  c_write_vint_array_sized ::
     Int64 ->
     Ptr Int64 ->
     Ptr Word8 ->
+    Ptr Word8 ->
     IO (Ptr Word8)
 
 foreign import ccall unsafe "anemone_read_vint"
@@ -167,3 +327,36 @@ foreign import ccall unsafe "anemone_read_vint_array"
     Int64 ->
     Ptr Int64 ->
     IO CError
+
+foreign import ccall unsafe "anemone_vint_skip"
+  c_vint_skip ::
+    Ptr (Ptr Word8) ->
+    Ptr Word8 ->
+    Int64 ->
+    IO CError
+
+foreign import ccall unsafe "anemone_vint_count"
+  c_vint_count ::
+    Ptr Word8 ->
+    Ptr Word8 ->
+    Ptr Int64 ->
+    IO CError
+
+foreign import ccall unsafe "anemone_vint_index"
+  c_vint_index ::
+    Ptr Word8 ->
+    Ptr Word8 ->
+    Int64 ->
+    Ptr Int64 ->
+    IO CError
+
+foreign import ccall unsafe "anemone_vint_seek"
+  c_vint_seek ::
+    Ptr Word8 ->
+    Ptr Word8 ->
+    Int64 ->
+    Int64 ->
+    Ptr Int64 ->
+    Int64 ->
+    Ptr (Ptr Word8) ->
+    IO CError
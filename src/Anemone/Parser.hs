@@ -1,4 +1,7 @@
+{-# LANGUAGE BangPatterns #-}
+{-# LANGUAGE LambdaCase #-}
 {-# LANGUAGE NoImplicitPrelude #-}
+{-# LANGUAGE OverloadedStrings #-}
 -- | This module is a simplified interface to all of Anemone's fast parsing
 --   functionality.
 --
@@ -10,16 +13,31 @@ module Anemone.Parser (
   , parseDouble
   , parseDay
   , parseYearMonthDay
+
+  , ColumnError(..)
+  , renderColumnError
+
+  , parseInt64s
+  , parseDoubles
+  , parseDays
   ) where
 
 
 import qualified Anemone.Foreign.Atoi as Foreign
+import           Anemone.Foreign.Column (Column(..), columnFirstInvalid)
+import qualified Anemone.Foreign.Column as Foreign
 import qualified Anemone.Foreign.Strtod as Foreign
 import           Anemone.Foreign.Time (TimeError(..), renderTimeError)
 import qualified Anemone.Foreign.Time as Foreign
 
 import           Data.ByteString (ByteString)
-import           Data.Thyme (Day, YearMonthDay)
+import qualified Data.ByteString as B
+import qualified Data.Text as T
+import           Data.Thyme (YearMonthDay)
+import           Data.Thyme.Calendar (Day(..))
+import qualified Data.Vector.Storable as Storable
+import qualified Data.Vector.Unboxed as Unboxed
+import           Data.Word (Word8)
 
 import           P
 
@@ -56,3 +74,75 @@ parseYearMonthDay :: ByteString -> Either TimeError (YearMonthDay, ByteString)
 parseYearMonthDay =
   Foreign.parseYearMonthDay
 {-# INLINE parseYearMonthDay #-}
+
+-- | A field in a column which could not be parsed.
+--
+newtype ColumnError =
+  ColumnInvalidField Int
+  -- ^ The index of the first field which could not be parsed.
+  deriving (Eq, Ord, Show)
+
+renderColumnError :: ColumnError -> Text
+renderColumnError = \case
+  ColumnInvalidField i ->
+    "Field " <> T.pack (show i) <> " of the column could not be parsed"
+
+-- | Parse every field of a column as an 'Int64', in one foreign call.
+--
+--   The fields are separated by the given byte, and a trailing separator is
+--   ignored, so @"1,2,3"@ and @"1,2,3,"@ both have three fields. Each field
+--   must be an integer as accepted by 'parseInt64', with nothing after it.
+--
+parseInt64s :: Word8 -> ByteString -> Either ColumnError (Storable.Vector Int64)
+parseInt64s =
+  wholeColumn Foreign.parseInt64Column
+{-# INLINE parseInt64s #-}
+
+-- | Parse every field of a column as a 'Double', as for 'parseInt64s'.
+--
+parseDoubles :: Word8 -> ByteString -> Either ColumnError (Storable.Vector Double)
+parseDoubles =
+  wholeColumn Foreign.parseDoubleColumn
+{-# INLINE parseDoubles #-}
+
+-- | Parse every field of a column as a 'Day' in the format @YYYY-MM-DD@, as
+--   for 'parseInt64s'. A date which is not valid in the gregorian calendar is
+--   an invalid field.
+--
+parseDays :: Word8 -> ByteString -> Either ColumnError (Unboxed.Vector Day)
+parseDays sep bs = do
+  mjds <- wholeColumn Foreign.parseModifiedJulianColumn sep bs
+  pure $
+    Unboxed.generate (Storable.length mjds) $ \i ->
+      ModifiedJulianDay . fromIntegral $ Storable.unsafeIndex mjds i
+{-# INLINE parseDays #-}
+
+-- | Parse all of the fields with a column parser. The fields are counted
+--   first, which is a vectorised search, so the values can be allocated once
+--   at the right size and parsed in a single call.
+--
+wholeColumn ::
+     Storable a
+  => (Word8 -> Word8 -> Int -> ByteString -> (Column a, ByteString))
+  -> Word8
+  -> ByteString
+  -> Either ColumnError (Storable.Vector a)
+wholeColumn parseColumn sep bs =
+  let
+    !n =
+      if B.null bs then
+        0
+      else if B.last bs == sep then
+        B.count sep bs
+      else
+        B.count sep bs + 1
+
+    (column, _) =
+      parseColumn sep sep n bs
+  in
+    case columnFirstInvalid column of
+      Nothing ->
+        Right $ columnValues column
+      Just i ->
+        Left $ ColumnInvalidField i
+{-# INLINE wholeColumn #-}
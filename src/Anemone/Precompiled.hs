@@ -0,0 +1,131 @@
+{-# LANGUAGE LambdaCase #-}
+{-# LANGUAGE NoImplicitPrelude #-}
+{-# LANGUAGE OverloadedStrings #-}
+-- | Precompiling 'Anemone.Embed.anemone_h', so code compiled at runtime does
+--   not have to parse the headers every time.
+--
+--   Most of the time it takes to compile a small file against the headers is
+--   spent parsing them, and the intrinsics headers they include. GCC and
+--   Clang can save the parsed headers to a file, which is used in place of
+--   the header when it is included with the same compiler and flags.
+--
+module Anemone.Precompiled (
+    PrecompiledError(..)
+  , renderPrecompiledError
+
+  , precompileHeader
+  , headerFlags
+  ) where
+
+import           Anemone.Embed (anemone_h)
+import           Anemone.Foreign.Hash (fasthash64)
+
+import           Control.Exception (catch, throwIO)
+
+import qualified Data.ByteString as B
+import qualified Data.ByteString.Char8 as Char8
+import qualified Data.List as List
+import qualified Data.Text as T
+
+import           P
+
+import           System.Directory (createDirectoryIfMissing, doesFileExist, renameFile, removeFile)
+import           System.Exit (ExitCode(..))
+import           System.FilePath ((</>), takeDirectory)
+import           System.IO (IO, FilePath, hClose, openTempFile)
+import           System.IO.Error (isDoesNotExistError)
+import           System.Process (readProcessWithExitCode)
+
+import           Text.Printf (printf)
+
+
+data PrecompiledError =
+    PrecompiledCompilerFailed !FilePath ![String] !Int !Text
+  -- ^ The compiler, its arguments, its exit code and what it printed.
+    deriving (Eq, Show)
+
+renderPrecompiledError :: PrecompiledError -> Text
+renderPrecompiledError = \case
+  PrecompiledCompilerFailed compiler args code out ->
+    "Precompiling the Anemone header failed, " <>
+    T.pack compiler <> " " <> T.pack (List.unwords args) <>
+    " exited with " <> T.pack (show code) <> ":\n" <> out
+
+-- | Precompile the header with the given compiler and flags, caching it
+--   under the directory given, and return the flags which include it.
+--
+--   The flags must be the same as the ones the header will be used with, or
+--   the compiler will ignore the precompiled header and parse the header
+--   itself. That is still correct, but it is as slow as not precompiling.
+--
+--   The cache is keyed on a hash of the header, the compiler's version and
+--   the flags, so only the first call for each of those pays for compiling
+--   the header. It is safe for processes to share a cache directory: the
+--   files are written under temporary names and renamed in to place, so they
+--   are either missing or complete.
+--
+precompileHeader :: FilePath -> [String] -> FilePath -> IO (Either PrecompiledError [String])
+precompileHeader compiler flags cache = do
+  (_, version, _) <- readProcessWithExitCode compiler ["--version"] ""
+
+  let
+    key =
+      fasthash64 $ B.intercalate "\0" [
+          anemone_h
+        , Char8.pack compiler
+        , Char8.pack version
+        , Char8.pack (List.unwords flags)
+        ]
+
+    header =
+      cache </> printf "anemone-%016x" key </> "anemone.h"
+
+    -- the name GCC looks for next to the header, which Clang also finds
+    pch =
+      header <> ".gch"
+
+  exists <- doesFileExist pch
+  if exists then
+    pure . Right $ headerFlags header
+  else do
+    createDirectoryIfMissing True $ takeDirectory header
+
+    header_tmp <- tempFile header
+    B.writeFile header_tmp anemone_h
+    renameFile header_tmp header
+
+    pch_tmp <- tempFile pch
+    let
+      args =
+        flags <> ["-x", "c-header", header, "-o", pch_tmp]
+
+    (code, out, err) <- readProcessWithExitCode compiler args ""
+    case code of
+      ExitSuccess -> do
+        renameFile pch_tmp pch
+        pure . Right $ headerFlags header
+      ExitFailure n -> do
+        -- GCC removes its output when it fails, but other compilers may not
+        removeIfExists pch_tmp
+        pure . Left $ PrecompiledCompilerFailed compiler args n (T.pack (out <> err))
+
+-- | The flags which include the header at the given path before anything
+--   else in the file. The compiler uses the precompiled header next to it
+--   when there is one that matches.
+headerFlags :: FilePath -> [String]
+headerFlags header =
+  ["-include", header]
+
+removeIfExists :: FilePath -> IO ()
+removeIfExists path =
+  removeFile path `catch` \e ->
+    unless (isDoesNotExistError e) $
+      throwIO e
+
+-- | A new empty file in the same directory as the given path, so it can be
+--   renamed over it once it has been written.
+tempFile :: FilePath -> IO FilePath
+tempFile path = do
+  (tmp, h) <- openTempFile (takeDirectory path) "anemone.tmp"
+  hClose h
+  pure tmp
@@ -1,21 +1,41 @@
 {-# LANGUAGE NoImplicitPrelude #-}
 module Anemone.Pretty (
-    renderDouble
+    renderInt64
+  , renderDouble
+  , renderFixed
   ) where
 
-import Anemone.Foreign.Grisu2
+import Anemone.Foreign.Itoa
+import Anemone.Foreign.Ryu
 
 import Data.ByteString (ByteString)
 
 import P
 
--- | Render a 64-bit floating point number using the Grisu 2 [1] algorithm.
+-- | Render a signed integer in decimal, as 'Anemone.Parser.parseInt64' reads it.
 --
---   1. Printing Floating-Point Numbers Quickly and Accurately with Integers
---      Florian Loitsch
---      http://www.cs.tufts.edu/~nr/cs257/archive/florian-loitsch/printf.pdf
+renderInt64 :: Int64 -> ByteString
+renderInt64 x =
+  itoa x
+{-# INLINE renderInt64 #-}
+
+-- | Render a 64-bit floating point number as the shortest decimal which
+--   parses back to the same number, using the Ryu [1] algorithm.
+--
+--   1. Ryu: Fast Float-to-String Conversion
+--      Ulf Adams
+--      https://dl.acm.org/doi/10.1145/3192366.3192369
 --
 renderDouble :: Double -> ByteString
 renderDouble x =
-  grisu2 x
+  ryu x
 {-# INLINE renderDouble #-}
+
+-- | Render a 64-bit floating point number with a fixed number of digits
+--   after the decimal point, rounding the exact value half to even, the same
+--   as @printf "%.*f"@.
+--
+renderFixed :: Int -> Double -> ByteString
+renderFixed precision x =
+  fixed precision x
+{-# INLINE renderFixed #-}
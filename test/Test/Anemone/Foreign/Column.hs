@@ -0,0 +1,182 @@
+{-# LANGUAGE ForeignFunctionInterface #-}
+{-# LANGUAGE NoImplicitPrelude #-}
+{-# LANGUAGE OverloadedStrings #-}
+{-# LANGUAGE TemplateHaskell #-}
+module Test.Anemone.Foreign.Column where
+
+import           Anemone.Foreign.Atoi (atoi)
+import           Anemone.Foreign.Data (CBool(..))
+import           Anemone.Foreign.Column
+import           Anemone.Foreign.Strtod (strtod)
+import           Anemone.Foreign.Time (parseDay)
+import           Anemone.Parser (ColumnError(..), parseInt64s, parseDoubles, parseDays)
+
+import           Data.ByteString (ByteString)
+import qualified Data.ByteString as B
+import qualified Data.ByteString.Char8 as Char8
+import qualified Data.List as List
+import           Data.Maybe (isNothing, mapMaybe)
+import           Data.Thyme.Calendar (Day(..))
+import qualified Data.Vector.Storable as Storable
+import qualified Data.Vector.Unboxed as Unboxed
+import           Data.Word (Word8)
+
+import           Foreign.Storable (Storable)
+
+import           Hedgehog
+import qualified Hedgehog.Gen as Gen
+import qualified Hedgehog.Range as Range
+
+import           P
+
+import           System.IO (IO)
+import           Text.Printf (printf)
+
+
+-- A mix of valid fields of each type, and fields which are not valid for any
+-- of them, so every parser sees both.
+genField :: Gen ByteString
+genField =
+  Gen.choice [
+      Char8.pack . show <$> Gen.int64 Range.linearBounded
+    , Char8.pack . show <$> Gen.double (Range.linearFracFrom 0 (-1e10) 1e10)
+    , genDate
+    , Gen.element ["", "-", "x", "12x", "1.5.5", " 1", "2016-02-30"]
+    ]
+
+genDate :: Gen ByteString
+genDate = do
+  y <- Gen.int (Range.linear 0 9999)
+  m <- Gen.int (Range.linear 1 12)
+  d <- Gen.int (Range.linear 1 31)
+  pure . Char8.pack $ printf "%04d-%02d-%02d" y m d
+
+genDelimited :: Gen ByteString
+genDelimited = do
+  fields <- Gen.list (Range.linear 0 200) genField
+  delimiters <- Gen.list (Range.singleton (List.length fields)) (Gen.element [",", "\n"])
+  end <- Gen.element ["", ",", "\n"]
+  pure . B.drop 1 . B.concat $ List.zipWith (<>) delimiters fields <> [end]
+
+-- Parsing a column agrees with splitting the input and parsing each field.
+checkColumn :: (Eq a, Show a, Storable a) => (ByteString -> Maybe a) -> (Word8 -> Word8 -> Int -> ByteString -> (Column a, ByteString)) -> PropertyT IO ()
+checkColumn parse parseColumn = do
+  bs <- forAll genDelimited
+  let
+    fields =
+      if B.null bs then
+        []
+      -- a separator at the end is followed by an empty field, a terminator is not
+      else if Char8.last bs == '\n' then
+        List.init $ Char8.splitWith (\c -> c == ',' || c == '\n') bs
+      else
+        Char8.splitWith (\c -> c == ',' || c == '\n') bs
+
+  n <- forAll $ Gen.int (Range.linear 0 (List.length fields + 1))
+  let
+    (column, rest) =
+      parseColumn 44 10 n bs
+
+    used =
+      List.sum . fmap ((+ 1) . B.length) $ List.take n fields
+
+  columnToList column === fmap parse (List.take n fields)
+  rest === B.drop used bs
+
+whole :: (ByteString -> Maybe (a, ByteString)) -> ByteString -> Maybe a
+whole parse bs =
+  case parse bs of
+    Just (x, rest) | B.null rest ->
+      Just x
+    _ ->
+      Nothing
+
+prop_int64_column :: Property
+prop_int64_column =
+  property $ checkColumn (whole atoi) parseInt64Column
+
+prop_double_column :: Property
+prop_double_column =
+  property $ checkColumn (whole strtod) parseDoubleColumn
+
+prop_modified_julian_column :: Property
+prop_modified_julian_column =
+  property $ checkColumn (whole (fmap (first (fromIntegral . toModifiedJulianDay)) . either (const Nothing) Just . parseDay)) parseModifiedJulianColumn
+
+-- Parsing in chunks on many threads agrees with parsing the whole input in
+-- one go, with chunks small enough that there are plenty of them.
+checkParallelColumn :: (Eq a, Show a, Storable a) => (Word8 -> Word8 -> Int -> ByteString -> (Column a, ByteString)) -> (Int -> Int -> Word8 -> Word8 -> ByteString -> Column a) -> PropertyT IO ()
+checkParallelColumn parseColumn parseColumnParallel = do
+  bs <- forAll genDelimited
+  threads <- forAll $ Gen.int (Range.linear 1 4)
+  chunk <- forAll $ Gen.int (Range.linear 1 200)
+  parseColumnParallel threads chunk 44 10 bs === fst (parseColumn 44 10 (B.length bs + 1) bs)
+
+prop_int64_column_parallel :: Property
+prop_int64_column_parallel =
+  property $ checkParallelColumn parseInt64Column parseInt64ColumnParallel
+
+prop_double_column_parallel :: Property
+prop_double_column_parallel =
+  property $ checkParallelColumn parseDoubleColumn parseDoubleColumnParallel
+
+prop_modified_julian_column_parallel :: Property
+prop_modified_julian_column_parallel =
+  property $ checkParallelColumn parseModifiedJulianColumn parseModifiedJulianColumnParallel
+
+-- Parsing a whole column gives every value, or the index of the first field
+-- which did not parse.
+checkWhole :: (Eq a, Show a) => (ByteString -> Maybe a) -> (Word8 -> ByteString -> Either ColumnError [a]) -> PropertyT IO ()
+checkWhole parse parseWhole = do
+  fields <- forAll $ Gen.list (Range.linear 0 200) genField
+  end <- forAll $ Gen.element ["", ","]
+  let
+    bs =
+      B.intercalate "," fields <> if List.null fields then "" else end
+
+    -- without a trailing separator, an empty last field looks like one
+    fields' =
+      if end == "" && fmap B.null (lastMaybe fields) == Just True then
+        List.init fields
+      else
+        fields
+
+    expected =
+      case List.findIndex (isNothing . parse) fields' of
+        Nothing ->
+          Right $ mapMaybe parse fields'
+        Just i ->
+          Left $ ColumnInvalidField i
+
+  parseWhole 44 bs === expected
+
+lastMaybe :: [a] -> Maybe a
+lastMaybe xs =
+  if List.null xs then Nothing else Just (List.last xs)
+
+prop_int64s :: Property
+prop_int64s =
+  property $ checkWhole (whole atoi) (\sep -> fmap Storable.toList . parseInt64s sep)
+
+prop_doubles :: Property
+prop_doubles =
+  property $ checkWhole (whole strtod) (\sep -> fmap Storable.toList . parseDoubles sep)
+
+prop_days :: Property
+prop_days =
+  property $ checkWhole (whole (either (const Nothing) Just . parseDay)) (\sep -> fmap Unboxed.toList . parseDays sep)
+
+foreign import ccall unsafe
+  test_column_trailing :: CBool
+
+-- An empty field before a delimiter is a field, and so is the one after a
+-- separator at the very end, but not after a terminator
+prop_column_trailing :: Property
+prop_column_trailing =
+  withTests 1 . property $
+    assert (test_column_trailing /= 0)
+
+return []
+tests :: IO Bool
+tests =
+  checkParallel $$(discover)
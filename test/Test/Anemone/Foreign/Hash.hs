@@ -7,11 +7,22 @@ module Test.Anemone.Foreign.Hash where
 
 import           Anemone.Foreign.Hash
 
+import qualified Data.ByteString as B
+import qualified Data.ByteString.Lazy as BL
+import           Data.ByteString.Builder (toLazyByteString, word64LE)
+import qualified Data.Vector as Boxed
+import qualified Data.Vector.Storable as Storable
+
+import           Control.Exception (bracket)
+
 import           P
 
+import           System.Directory (getTemporaryDirectory, removeFile)
+import           System.IO (SeekMode(..), hClose, hSeek, openBinaryTempFile)
+
 import           Test.QuickCheck (forAllProperties, quickCheckWithResult)
 import           Test.QuickCheck (stdArgs, maxSuccess)
-import           Test.QuickCheck ((===))
+import           Test.QuickCheck ((===), NonNegative(..), ioProperty)
 import           Test.QuickCheck.Instances ()
 
 
@@ -21,6 +32,41 @@ prop_fasthash32 bs =
 prop_fasthash64 bs =
   fasthash64' defaultSeed bs === fasthash64 bs
 
+prop_fasthash64_batch seed bss =
+  Storable.toList (fasthash64Batch' seed (Boxed.fromList bss)) === fmap (fasthash64' seed) bss
+
+-- | Slices of one buffer, so the keys are not all at the start of an allocation.
+prop_fasthash64_batch_slices seed bs offsets =
+  let
+    slices =
+      fmap (\(o, l) -> B.take (l `mod` 41) $ B.drop (o `mod` (B.length bs + 1)) bs) offsets
+  in
+    Storable.toList (fasthash64Batch' seed (Boxed.fromList slices)) === fmap (fasthash64' seed) slices
+
+prop_fasthash64_word64 seed xs =
+  Storable.toList (fasthash64Word64' seed (Storable.fromList xs)) ===
+    fmap (fasthash64' seed . BL.toStrict . toLazyByteString . word64LE) xs
+
+prop_fasthash64_chunks seed bss =
+  fasthash64Chunks seed (sum $ fmap B.length bss) bss === fasthash64' seed (B.concat bss)
+
+prop_fasthash64_lazy seed bss =
+  fasthash64Lazy' seed (BL.fromChunks bss) === fasthash64' seed (B.concat bss)
+
+prop_fasthash64_handle seed bs (NonNegative skip) =
+  let
+    start =
+      skip `mod` (B.length bs + 1)
+  in
+    ioProperty $ do
+      tmp <- getTemporaryDirectory
+      bracket (openBinaryTempFile tmp "anemone-hash") (\(path, h) -> hClose h >> removeFile path) $ \(_, h) -> do
+        B.hPut h bs
+        hSeek h AbsoluteSeek (fromIntegral start)
+        hash <- fasthash64Handle' seed h
+        pure $
+          hash === fasthash64' seed (B.drop start bs)
+
 return []
 tests =
   $forAllProperties $ quickCheckWithResult (stdArgs {maxSuccess = 10000})
@@ -0,0 +1,103 @@
+{-# LANGUAGE NoImplicitPrelude #-}
+{-# LANGUAGE OverloadedStrings #-}
+{-# LANGUAGE TemplateHaskell #-}
+module Test.Anemone.Foreign.Intern where
+
+import           Anemone.Foreign.Intern (Interner)
+import qualified Anemone.Foreign.Intern as Intern
+
+import           Control.Exception (bracket)
+
+import           Data.ByteString (ByteString)
+import qualified Data.ByteString as B
+import qualified Data.List as List
+import qualified Data.Vector as Boxed
+import qualified Data.Vector.Storable as Storable
+
+import           Hedgehog
+import qualified Hedgehog.Gen as Gen
+import qualified Hedgehog.Range as Range
+
+import           P
+
+import           System.IO (IO)
+
+
+-- A small set of keys, so there are plenty of repeats, and enough of them
+-- that the table has to grow a few times.
+genKeys :: Gen [ByteString]
+genKeys = do
+  universe <- Gen.list (Range.linear 1 300) (Gen.bytes (Range.linear 0 40))
+  Gen.list (Range.linear 0 2000) (Gen.element universe)
+
+-- The ids are given out in order of first appearance.
+expectedIds :: [ByteString] -> [Word32]
+expectedIds keys =
+  let
+    distinct =
+      List.nub keys
+  in
+    fmap (\k -> maybe Intern.missing fromIntegral $ List.elemIndex k distinct) keys
+
+withInterner :: (Interner -> IO a) -> PropertyT IO a
+withInterner =
+  evalIO . bracket Intern.create Intern.free
+
+prop_intern :: Property
+prop_intern =
+  property $ do
+    keys <- forAll genKeys
+    (ids, size, back) <- withInterner $ \interner -> do
+      ids <- traverse (Intern.intern interner) keys
+      size <- Intern.size interner
+      back <- traverse (Intern.key interner . fromIntegral) [0 .. size - 1]
+      pure (ids, size, back)
+
+    ids === expectedIds keys
+    size === List.length (List.nub keys)
+    back === fmap Just (List.nub keys)
+
+prop_intern_batch :: Property
+prop_intern_batch =
+  property $ do
+    keys <- forAll genKeys
+    ids <- withInterner $ \interner ->
+      Intern.internBatch interner (Boxed.fromList keys)
+    Storable.toList ids === expectedIds keys
+
+prop_lookup :: Property
+prop_lookup =
+  property $ do
+    keys <- forAll genKeys
+    others <- forAll $ Gen.list (Range.linear 0 100) (Gen.bytes (Range.linear 0 40))
+    let
+      queries =
+        keys <> others
+
+      expected =
+        fmap (\q -> List.lookup q (List.zip keys (expectedIds keys))) queries
+
+    (single, batch) <- withInterner $ \interner -> do
+      _ <- Intern.internBatch interner (Boxed.fromList keys)
+      single <- traverse (Intern.lookupId interner) queries
+      batch <- Intern.lookupIdBatch interner (Boxed.fromList queries)
+      pure (single, batch)
+
+    single === expected
+    Storable.toList batch === fmap (fromMaybe Intern.missing) expected
+
+-- Keys sliced out of one buffer are copied, so they can be freed.
+prop_intern_copies :: Property
+prop_intern_copies =
+  property $ do
+    bs <- forAll $ Gen.bytes (Range.linear 0 200)
+    n <- forAll $ Gen.int (Range.linear 0 200)
+    back <- withInterner $ \interner -> do
+      i <- Intern.intern interner (B.copy (B.take n bs))
+      Intern.key interner i
+    back === Just (B.take n bs)
+
+return []
+tests :: IO Bool
+tests =
+  checkParallel $$(discover)
@@ -0,0 +1,74 @@
+{-# LANGUAGE NoImplicitPrelude #-}
+{-# LANGUAGE OverloadedStrings #-}
+{-# LANGUAGE TemplateHaskell #-}
+module Test.Anemone.Foreign.Itoa where
+
+import           Anemone.Foreign.Atoi (atoi)
+import           Anemone.Foreign.Column
+import           Anemone.Foreign.Itoa
+
+import qualified Data.ByteString.Char8 as Char8
+import qualified Data.List as List
+import qualified Data.Vector.Storable as Storable
+
+import           Hedgehog
+import qualified Hedgehog.Gen as Gen
+import qualified Hedgehog.Range as Range
+
+import           P
+
+import           System.IO (IO)
+
+
+-- Numbers of every length, rather than mostly 19 digits.
+genInt64 :: Gen Int64
+genInt64 =
+  Gen.choice [
+      Gen.int64 Range.linearBounded
+    , Gen.int64 (Range.exponential 0 maxBound)
+    , negate <$> Gen.int64 (Range.exponential 0 maxBound)
+    , Gen.element [0, 9, 10, 99999999, 100000000, maxBound, minBound, minBound + 1]
+    ]
+
+prop_itoa_show :: Property
+prop_itoa_show =
+  property $ do
+    x <- forAll genInt64
+    Char8.unpack (itoa x) === show x
+
+prop_utoa_show :: Property
+prop_utoa_show =
+  property $ do
+    x <- forAll $ Gen.choice [
+        Gen.word64 Range.linearBounded
+      , Gen.word64 (Range.exponential 0 maxBound)
+      ]
+    Char8.unpack (utoa x) === show x
+
+prop_itoa_atoi :: Property
+prop_itoa_atoi =
+  property $ do
+    x <- forAll genInt64
+    atoi (itoa x) === Just (x, "")
+
+prop_int64_column :: Property
+prop_int64_column =
+  property $ do
+    xs <- forAll $ Gen.list (Range.linear 0 1000) genInt64
+    let
+      rendered =
+        renderInt64Column 10 (Storable.fromList xs)
+
+    Char8.unpack rendered === List.concatMap (\x -> show x <> "\n") xs
+
+    let
+      (column, rest) =
+        parseInt64Column 44 10 (List.length xs) rendered
+
+    columnToList column === fmap Just xs
+    rest === ""
+
+return []
+tests :: IO Bool
+tests =
+  checkParallel $$(discover)
@@ -1,12 +1,16 @@
 {-# LANGUAGE NoImplicitPrelude #-}
 {-# LANGUAGE TemplateHaskell #-}
 {-# LANGUAGE OverloadedStrings #-}
+{-# LANGUAGE ForeignFunctionInterface #-}
 {-# OPTIONS_GHC -fno-warn-missing-signatures #-}
 
 module Test.Anemone.Foreign.Memcmp where
 
 import qualified  Anemone.Foreign.Memcmp.Export as Export
 
+import            Anemone.Foreign.Data
+import            Data.Word (Word8)
+
 import            P
 import            Test.QuickCheck
 import            Test.QuickCheck.Instances()
@@ -36,11 +40,33 @@ prop_memcmp8
  = testCmp Export.memcmp8
 prop_memcmp64
  = testCmp Export.memcmp64
+prop_memcmp128
+ = testCmp Export.memcmp128
 prop_memcmp128_unsafe
  = testCmp Export.memcmp128_unsafe
 prop_memcmp_partial_load64
  = testCmp Export.memcmp_partial_load64
 
 
+foreign import ccall unsafe
+    test_memcmp_page_end
+    :: CSize -> CSize -> Word8 -> Word8 -> CBool
+
+-- Buffers which end right before an unmapped page, with at most one byte different
+prop_memcmp_page_end
+ = forAll (choose (0, 300)) $ \len ->
+   forAll (choose (0, len)) $ \diff_at ->
+   forAll arbitrary $ \a ->
+   forAll arbitrary $ \b ->
+   test_memcmp_page_end (fromIntegral (len :: Int)) (fromIntegral diff_at) a b /= 0
+
+prop_memcmp_page_end_fixed
+ = forAll (elements [8, 16, 32]) $ \len ->
+   forAll (choose (0, len)) $ \diff_at ->
+   forAll arbitrary $ \a ->
+   forAll arbitrary $ \b ->
+   test_memcmp_page_end (fromIntegral (len :: Int)) (fromIntegral diff_at) a b /= 0
+
+
 return []
 tests = $quickCheckAll
@@ -10,6 +10,7 @@ module Test.Anemone.Foreign.Mempool where
 import Anemone.Foreign.Data
 import qualified Anemone.Foreign.Mempool as Mempool
 import qualified Foreign.Marshal.Array as Marshal
+import Foreign.Ptr (Ptr, nullPtr)
 
 import            P
 import            Test.QuickCheck
@@ -37,6 +38,34 @@ foreign import ccall unsafe
     test_mempool_size
     :: CInt -> CSize -> CBool
 
+foreign import ccall unsafe
+    test_mempool_reset
+    :: CInt -> CSize -> CBool
+
+foreign import ccall unsafe
+    test_mempool_mark_rewind
+    :: CInt -> CInt -> CSize -> CBool
+
+foreign import ccall unsafe
+    test_mempool_config
+    :: CInt -> CInt -> CInt -> CSize -> CBool
+
+foreign import ccall unsafe
+    test_mempool_odd_block_size
+    :: CSize -> CInt -> CInt -> CBool
+
+foreign import ccall unsafe
+    test_mempool_stats
+    :: CInt -> CSize -> CBool
+
+foreign import ccall unsafe
+    test_buffer_append
+    :: CInt -> CSize -> CInt -> CBool
+
+foreign import ccall safe
+    test_mempool_concurrent
+    :: CInt -> CInt -> CSize -> IO CBool
+
 
 prop_mempool_nonoverlap :: Property
 prop_mempool_nonoverlap
@@ -52,6 +81,126 @@ prop_mempool_track_size
    test_mempool_size a b /= 0
 
 
+prop_mempool_reset :: Property
+prop_mempool_reset
+ = forAll iterations $ \a ->
+   forAll megabytes $ \b ->
+   test_mempool_reset a b /= 0
+
+prop_mempool_mark_rewind :: Property
+prop_mempool_mark_rewind
+ = forAll (choose (1, 10)) $ \records ->
+   forAll iterations $ \a ->
+   forAll megabytes $ \b ->
+   test_mempool_mark_rewind records a b /= 0
+
+-- Rewinding through the FFI restores the total alloc size at the mark
+prop_mempool_sanity_rewind :: Property
+prop_mempool_sanity_rewind
+ = forAll (listOf megabytes) $ \before ->
+   forAll (listOf megabytes) $ \after ->
+   monadicIO . run $ do
+    pool <- Mempool.create
+    mapM_ (Mempool.allocBytes pool) before
+    size0 <- Mempool.totalAllocSize pool
+    m <- Mempool.mark pool
+    mapM_ (Mempool.allocBytes pool) after
+    Mempool.rewind pool m
+    size1 <- Mempool.totalAllocSize pool
+    Mempool.free pool
+    return (size0 === size1)
+
+prop_mempool_config :: Property
+prop_mempool_config
+ = forAll (elements [minBound .. maxBound]) $ \(backing :: Mempool.Backing) ->
+   forAll (choose (1, 4)) $ \growth ->
+   forAll iterations $ \a ->
+   forAll megabytes $ \b ->
+   test_mempool_config (fromIntegral $ fromEnum backing) growth a b /= 0
+
+-- Pools created with options give distinct pointers too
+prop_mempool_sanity_config :: Property
+prop_mempool_sanity_config
+ = forAll (elements [minBound .. maxBound]) $ \backing ->
+   forAll (listOf megabytes) $ \sizes ->
+   monadicIO . run $ do
+    pool <- Mempool.createWith $ Mempool.Config (64 * 1024) 2 (8 * 1024 * 1024) backing
+    vals <- mapM (Mempool.allocBytes pool) sizes
+    Mempool.free pool
+    let uniqs = List.nub vals
+    return (counterexample (show vals) $ length vals === length uniqs)
+
+-- Block sizes which are not a multiple of the alignment are rounded up, so an
+-- allocation as big as the block still fits, as the blocks grow too
+prop_mempool_odd_block_size :: Property
+prop_mempool_odd_block_size
+ = forAll (choose (1, 1000)) $ \blockSize ->
+   forAll (choose (1, 4)) $ \growth ->
+   forAll iterations $ \a ->
+   test_mempool_odd_block_size blockSize growth a /= 0
+
+-- The Haskell config goes the same way as the C one
+prop_mempool_sanity_odd_block_size :: Property
+prop_mempool_sanity_odd_block_size
+ = forAll (choose (1, 1000)) $ \(blockSize :: CSize) ->
+   forAll (choose (1, 4)) $ \growth ->
+   forAll (listOf (choose (1, blockSize))) $ \sizes ->
+   monadicIO . run $ do
+    pool <- Mempool.createWith $ Mempool.Config blockSize growth (blockSize * 3) Mempool.BackingMalloc
+    vals :: [Ptr ()] <- mapM (Mempool.callocBytes pool 1) sizes
+    Mempool.free pool
+    return (counterexample (show vals) $ List.notElem nullPtr vals)
+
+prop_mempool_stats :: Property
+prop_mempool_stats
+ = forAll iterations $ \a ->
+   forAll megabytes $ \b ->
+   test_mempool_stats a b /= 0
+
+-- The snapshot read through the FFI agrees with what was allocated
+prop_mempool_sanity_stats :: Property
+prop_mempool_sanity_stats
+ = forAll (listOf megabytes) $ \sizes ->
+   monadicIO . run $ do
+    pool <- Mempool.create
+    mapM_ (Mempool.allocBytes pool) sizes
+    total <- Mempool.totalAllocSize pool
+    s <- Mempool.stats pool
+    Mempool.free pool
+    return $
+      Mempool.statsBytesRequested s === fromIntegral (List.sum sizes) .&&.
+      Mempool.statsHighWater s === fromIntegral total
+
+prop_buffer_append :: Property
+prop_buffer_append
+ = forAll iterations $ \a ->
+   forAll (choose (0, 100000)) $ \b ->
+   forAll (choose (0, 4)) $ \interleave ->
+   test_buffer_append a b interleave /= 0
+
+prop_mempool_concurrent :: Property
+prop_mempool_concurrent
+ = forAll (choose (1, 8)) $ \threads ->
+   forAll iterations $ \a ->
+   forAll megabytes $ \b ->
+   monadicIO . run $ do
+    ok <- test_mempool_concurrent threads a b
+    return (ok /= 0)
+
+-- Allocations made from arenas stay alive until the root is freed
+prop_mempool_arena_sanity :: Property
+prop_mempool_arena_sanity
+ = forAll (listOf (listOf megabytes)) $ \sizess ->
+  monadicIO . run $ do
+    pool <- Mempool.create
+    vals <- fmap List.concat . flip mapM sizess $ \sizes -> do
+      arena <- Mempool.createArena pool
+      mapM (Mempool.allocBytes arena) sizes
+    Mempool.free pool
+    let uniqs = List.nub vals
+    return (counterexample (show vals) $ length vals === length uniqs)
+
+
 -- Really simple sanity test of the FFI
 -- Create a pool, allocate a whole bunch of pointers and make sure the pointers are distinct
 prop_mempool_sanity :: Property
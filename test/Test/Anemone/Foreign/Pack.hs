@@ -1,3 +1,4 @@
+{-# LANGUAGE ForeignFunctionInterface #-}
 {-# LANGUAGE NoImplicitPrelude #-}
 {-# LANGUAGE OverloadedStrings #-}
 {-# LANGUAGE ScopedTypeVariables #-}
@@ -5,17 +6,23 @@
 {-# OPTIONS_GHC -fno-warn-missing-signatures #-}
 module Test.Anemone.Foreign.Pack where
 
+import           Anemone.Foreign.Data (CBool(..))
 import           Anemone.Foreign.Pack
 
+import           Data.Bits ((.|.), bit)
 import qualified Data.List as List
 import qualified Data.Vector.Storable as Storable
-import           Data.Word (Word64)
+import           Data.Word (Word32, Word64)
+
+import           Foreign.C.Types (CInt(..))
 
 import           P
 
 import qualified Prelude
 
 import           Test.QuickCheck (Property, NonEmptyList(..), (===), counterexample)
+import           Test.QuickCheck (forAll, choose, elements)
+import           Test.QuickCheck (Arbitrary(..))
 import           Test.QuickCheck (forAllProperties, quickCheckWithResult)
 import           Test.QuickCheck (stdArgs, maxSuccess)
 import           Test.QuickCheck.Instances ()
@@ -40,6 +47,150 @@ prop_pack_unpack_tripping (n :: Int) (NonEmpty (xs :: [Word64])) =
    = fromMaybe
      (Prelude.error $ "prop_pack_unpack_tripping: could not encode " <> show n <> " integers")
 
+prop_pack32_unpack32_tripping (n :: Int) (NonEmpty (xs :: [Word32])) =
+ tripping (impossible . pack32) unpack32 ys
+ where
+  ys
+   = Storable.fromList
+   $ List.take (n * 64)
+   $ List.cycle xs
+
+  impossible
+   = fromMaybe
+     (Prelude.error $ "prop_pack32_unpack32_tripping: could not encode " <> show n <> " integers")
+
+-- 32-bit values pack to the same bytes as when they are widened
+prop_pack32_pack64 (n :: Int) (NonEmpty (xs :: [Word32])) =
+ let
+  ys = Storable.fromList . List.take (n * 64) $ List.cycle xs
+ in
+  fmap packed32Bytes (pack32 ys)
+  ===
+  fmap packedBytes (pack64 $ Storable.map fromIntegral ys)
+
+prop_pack128_unpack128_tripping (n :: Int) (NonEmpty (xs :: [Word64])) =
+ tripping (impossible . pack128) unpack128 ys
+ where
+  ys
+   = Storable.fromList
+   $ List.take (n * 128)
+   $ List.cycle xs
+
+  impossible
+   = fromMaybe
+     (Prelude.error $ "prop_pack128_unpack128_tripping: could not encode " <> show n <> " integers")
+
+foreign import ccall unsafe
+  test_pack128_unpack_isa :: Word64 -> CInt -> CInt -> CBool
+
+-- Every instruction set agrees on blocks of 128, which are packed like two blocks of 64
+prop_unpack128_isa (seed :: Word64) =
+  forAll (choose (1, 4)) $ \blocks ->
+  forAll (choose (0, 64)) $ \bits ->
+   test_pack128_unpack_isa seed blocks bits /= 0
+
+prop_index_gather (n :: Int) (NonEmpty (xs :: [Word64])) (ixs :: [Int]) =
+ let
+  ys = Storable.fromList . List.take (max 1 n * 64) $ List.cycle xs
+  Just packed = pack64 ys
+  valid = fmap (`mod` Storable.length ys) ixs
+ in
+  counterexample (show packed) $
+   (traverse (index64 packed) valid, gather64 packed (Storable.fromList $ fmap fromIntegral valid))
+   ===
+   (Just $ fmap (ys Storable.!) valid, Just . Storable.fromList $ fmap (ys Storable.!) valid)
+
+prop_index_out_of_range (n :: Int) (NonEmpty (xs :: [Word64])) =
+ let
+  ys = Storable.fromList . List.take (max 1 n * 64) $ List.cycle xs
+  Just packed = pack64 ys
+ in
+  (index64 packed (Storable.length ys), gather64 packed (Storable.singleton . fromIntegral $ Storable.length ys))
+  ===
+  (Nothing, Nothing)
+
+prop_aggregate (n :: Int) (NonEmpty (xs :: [Word64])) =
+ let
+  ys = Storable.fromList . List.take (n * 64) $ List.cycle xs
+  Just packed = pack64 ys
+ in
+  aggregate64 packed
+  ===
+  Just (Aggregate64 (Storable.sum ys) (Storable.foldl' min maxBound ys) (Storable.foldl' max 0 ys))
+
+-- Compare against values which are in the input, so that some of them match
+prop_select (n :: Int) (NonEmpty (xs :: [Word64])) (i :: Int) (j :: Int) =
+ let
+  a = xs List.!! (i `mod` List.length xs)
+  b = xs List.!! (j `mod` List.length xs)
+ in
+  forAll (elements [Equal a, LessThan a, Between (min a b) (max a b), Between b a]) $ \predicate ->
+   selects predicate n xs
+
+selects :: Predicate -> Int -> [Word64] -> Property
+selects predicate n xs =
+ let
+  ys = Storable.fromList . List.take (n * 64) $ List.cycle xs
+  Just packed = pack64 ys
+
+  matches x =
+   case predicate of
+    Equal y -> x == y
+    LessThan y -> x < y
+    Between lo hi -> lo <= x && x <= hi
+
+  mask block =
+   List.foldl' (.|.) 0
+    [ bit i | i <- [0..63], matches (ys Storable.! (block * 64 + i)) ]
+ in
+  select64 predicate packed
+  ===
+  Just (Storable.fromList $ fmap mask [0 .. Storable.length ys `div` 64 - 1])
+
+prop_encode_decode_tripping (codec :: Codec) (n :: Int) (NonEmpty (xs :: [Word64])) =
+ tripping (impossible . encode64 codec) decode64 ys
+ where
+  ys
+   = Storable.fromList
+   $ List.take (n * 64)
+   $ List.cycle xs
+
+  impossible
+   = fromMaybe
+     (Prelude.error $ "prop_encode_decode_tripping: could not encode " <> show n <> " integers")
+
+-- Sorted values are what delta is for, so make sure they pack small
+prop_encode_delta_sorted (n :: Int) (NonEmpty (xs :: [Word64])) =
+ let
+  ys = Storable.fromList . List.sort . List.take (max 1 n * 64) $ List.cycle xs
+  Just zs = encode64 CodecDelta ys
+ in
+  counterexample (show zs) $
+   decode64 zs === Just ys
+
+foreign import ccall unsafe
+  test_pack_unpack_isa :: Word64 -> CInt -> CInt -> CBool
+
+-- Every vectorised unpack kernel supported by this CPU agrees with the scalar one
+prop_unpack_isa (seed :: Word64) =
+  forAll (choose (1, 8)) $ \blocks ->
+  forAll (choose (0, 64)) $ \bits ->
+   test_pack_unpack_isa seed blocks bits /= 0
+
+foreign import ccall unsafe
+  test_codec_isa :: Word64 -> CInt -> CInt -> CInt -> CBool
+
+-- Every vectorised decode kernel supported by this CPU agrees with the scalar one
+prop_codec_isa (seed :: Word64) =
+  forAll (elements [minBound .. maxBound]) $ \(codec :: Codec) ->
+  forAll (choose (1, 8)) $ \blocks ->
+  forAll (choose (0, 64)) $ \bits ->
+   test_codec_isa seed (fromIntegral $ fromEnum codec) blocks bits /= 0
+
+instance Arbitrary Codec where
+  arbitrary =
+    elements [minBound .. maxBound]
+
 return []
 tests =
   $forAllProperties $ quickCheckWithResult (stdArgs {maxSuccess = 10000})
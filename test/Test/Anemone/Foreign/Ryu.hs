@@ -0,0 +1,108 @@
+{-# LANGUAGE NoImplicitPrelude #-}
+{-# LANGUAGE OverloadedStrings #-}
+{-# LANGUAGE TemplateHaskell #-}
+module Test.Anemone.Foreign.Ryu where
+
+import           Anemone.Foreign.Ryu
+import           Anemone.Foreign.Strtod (strtod)
+
+import qualified Data.ByteString.Char8 as Char8
+import qualified Data.List as List
+
+import           Hedgehog
+import qualified Hedgehog.Gen as Gen
+import           Hedgehog.Gen.QuickCheck (arbitrary)
+import qualified Hedgehog.Range as Range
+
+import           Numeric (floatToDigits)
+
+import           P
+
+import           System.IO (IO)
+
+
+-- Every magnitude, including subnormals, and the short decimals which
+-- reports are full of.
+genDouble :: Gen Double
+genDouble =
+  Gen.choice [
+      arbitrary
+    , do m <- Gen.double (Range.linearFrac (-1) 1)
+         e <- Gen.int (Range.linear (-325) 308)
+         pure $ m * 10 ^^ e
+    , do m <- Gen.int (Range.linear (-1000000) 1000000)
+         e <- Gen.int (Range.linear 0 6)
+         pure $ fromIntegral m / 10 ^ e
+    , Gen.element [0, 5e-324, 2.2250738585072014e-308, 1.7976931348623157e308, 1e21, 1e-6, 0.1, 2 ** (-24)]
+    ]
+
+-- The significant digits of a rendered number, without the sign, point,
+-- exponent or any zeros around them.
+significant :: [Char] -> [Char]
+significant =
+  List.dropWhileEnd (== '0') .
+  List.dropWhile (== '0') .
+  List.filter (/= '.') .
+  List.takeWhile (/= 'e') .
+  List.dropWhile (== '-')
+
+prop_ryu_roundtrip :: Property
+prop_ryu_roundtrip =
+  property $ do
+    x <- forAll genDouble
+    strtod (ryu x) === Just (x, "")
+
+prop_ryu_shortest :: Property
+prop_ryu_shortest =
+  property $ do
+    x <- forAll genDouble
+    let
+      digits =
+        significant . Char8.unpack $ ryu x
+    when (x /= 0) $
+      List.length digits === List.length (fst $ floatToDigits 10 (abs x))
+
+-- The exact value, rounded half to even by 'round', with the point put back.
+expectedFixed :: Int -> Double -> [Char]
+expectedFixed precision x =
+  let
+    n =
+      round (abs (toRational x) * 10 ^ precision) :: Integer
+
+    padded =
+      List.replicate (precision + 1 - List.length (show n)) '0' <> show n
+
+    (whole, frac) =
+      List.splitAt (List.length padded - precision) padded
+
+    sign =
+      if x < 0 || isNegativeZero x then "-" else ""
+  in
+    if precision == 0 then
+      sign <> whole
+    else
+      sign <> whole <> "." <> frac
+
+prop_fixed_exact :: Property
+prop_fixed_exact =
+  property $ do
+    x <- forAll genDouble
+    precision <- forAll $ Gen.int (Range.linear 0 25)
+    Char8.unpack (fixed precision x) === expectedFixed precision x
+
+prop_fixed_ties :: Property
+prop_fixed_ties =
+  property $ do
+    m <- forAll $ Gen.int (Range.linear (-100000) 100000)
+    precision <- forAll $ Gen.int (Range.linear 0 4)
+    -- Times 10^precision this is (2m + 1) * 5^precision / 2, so it is exactly
+    -- halfway between two numbers with 'precision' digits
+    let
+      x =
+        fromIntegral (2 * m + 1) / 2 ^ (precision + 1)
+    Char8.unpack (fixed precision x) === expectedFixed precision x
+
+return []
+tests :: IO Bool
+tests =
+  checkParallel $$(discover)
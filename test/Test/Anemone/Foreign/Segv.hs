@@ -0,0 +1,59 @@
+{-# LANGUAGE NoImplicitPrelude #-}
+{-# LANGUAGE TemplateHaskell #-}
+{-# LANGUAGE OverloadedStrings #-}
+{-# LANGUAGE ForeignFunctionInterface #-}
+{-# OPTIONS_GHC -fno-warn-missing-signatures #-}
+
+module Test.Anemone.Foreign.Segv where
+
+import            Anemone.Foreign.Data
+import            Anemone.Foreign.Segv
+
+import            Control.Exception (evaluate)
+
+import qualified  Data.List as List
+import qualified  Data.Vector as Boxed
+import qualified  Data.Vector.Storable as Storable
+
+import            P
+
+import            Test.QuickCheck
+import            Test.QuickCheck.Monadic
+
+foreign import ccall unsafe
+    test_prof_samples
+    :: CInt -> CInt -> CSize -> CBool
+
+-- The profiler is global, so each property only runs it once at a time
+prop_prof_samples
+ = once
+ $ conjoin
+ [ counterexample (show (hz, depth, capacity))
+ $ test_prof_samples hz depth capacity /= 0
+ | (hz, depth, capacity) <- [(1000, 1, 1024), (1000, 4, 1024), (1000, 16, 4096), (1000, 8, 2), (1, 1, 1024)]
+ ]
+
+foreign import ccall safe
+    test_prof_restart
+    :: CInt -> CInt -> IO CBool
+
+-- Handlers still running on other threads when it stops must not see the next
+-- start free their ring
+prop_prof_restart
+ = once . monadicIO $ do
+    ok <- run $ test_prof_restart 4 200
+    assert (ok /= 0)
+
+prop_prof_drain
+ = once . monadicIO $ do
+    (_, samples) <- run . withProfile 1000 4 4096 "prop_prof_drain" $
+      evaluate $ List.foldl' (+) 0 [1 .. 200000000 :: Int]
+    user <- run profUserData
+    stop $
+           user === "prop_prof_drain"
+      .&&. counterexample "no samples" (not $ Boxed.null samples)
+      .&&. counterexample (show samples)
+             (Boxed.all (\s -> Storable.length (sampleFrames s) >= 1 && Storable.length (sampleFrames s) <= 4) samples)
+
+return []
+tests = $quickCheckAll
@@ -0,0 +1,65 @@
+{-# LANGUAGE NoImplicitPrelude #-}
+{-# LANGUAGE OverloadedStrings #-}
+{-# LANGUAGE TemplateHaskell #-}
+module Test.Anemone.Foreign.Sort where
+
+import           Anemone.Foreign.Sort
+
+import           Data.ByteString (ByteString)
+import qualified Data.ByteString as B
+import qualified Data.ByteString.Char8 as Char8
+import qualified Data.List as List
+import qualified Data.Vector as Boxed
+import qualified Data.Vector.Storable as Storable
+
+import           Hedgehog
+import qualified Hedgehog.Gen as Gen
+import qualified Hedgehog.Range as Range
+
+import           P
+
+import           System.IO (IO)
+
+
+-- Keys from a small alphabet, with a shared prefix of any length, so there
+-- are plenty of duplicates, keys which are prefixes of each other, and keys
+-- which only differ after the first 8 bytes.
+genKeys :: Gen [ByteString]
+genKeys = do
+  prefix <- Gen.bytes (Range.linear 0 12)
+  Gen.list (Range.linear 0 200) $ do
+    suffix <- fmap B.pack . Gen.list (Range.linear 0 12) $ Gen.element [0, 1, 0x7F, 0x80, 0xFF]
+    Gen.element [suffix, prefix <> suffix]
+
+expectedIndices :: [ByteString] -> [Int64]
+expectedIndices xs =
+  fmap snd . List.sort $ List.zip xs [0..]
+
+prop_sort :: Property
+prop_sort =
+  property $ do
+    xs <- forAll genKeys
+    Boxed.toList (sort (Boxed.fromList xs)) === List.sort xs
+
+prop_sortIndices_stable :: Property
+prop_sortIndices_stable =
+  property $ do
+    xs <- forAll genKeys
+    Storable.toList (sortIndices (Boxed.fromList xs)) === expectedIndices xs
+
+prop_sortIndicesParallel :: Property
+prop_sortIndicesParallel =
+  withTests 10 . property $ do
+    threads <- forAll $ Gen.int (Range.linear 1 8)
+    modulus <- forAll $ Gen.int (Range.linear 1 100000)
+    let
+      -- enough keys to be sorted in parallel
+      xs =
+        fmap (\i -> Char8.pack . show $ (i * 7919) `mod` modulus) [0 .. 70000 :: Int]
+
+    Storable.toList (sortIndicesParallel threads (Boxed.fromList xs)) === expectedIndices xs
+
+return []
+tests :: IO Bool
+tests =
+  checkParallel $$(discover)
@@ -23,6 +23,8 @@ import           Data.List (replicate, takeWhile)
 
 import qualified Text.Read          as Read
 
+import           Prelude (isNegativeZero)
+
 
 strtod :: B.ByteString -> Maybe Double
 strtod = fmap fst . Strtod.strtod
@@ -75,23 +77,29 @@ testStrtodWellformed a
       cex  = concat ["|", show x, " - ", show y, "| > ɛ"]
       prop = x AEq.~== y
 
- -- There is a bug where zero with a very large exponent becomes Infinite!
- --
- -- > > read "0e12345678901234567890" :: Double
- -- > Infinity
- --
- -- So what else? Strip the stuff before the 'e' and check if it's zero. If it is, return zero.
-  readIgnoreInfinite ss
-   = case Read.readMaybe ss of
-      Just dbl
-       | isInfinite dbl
-       , Just zero <- Read.readMaybe (takeWhile (\c -> c /= 'e' && c /= 'E') ss)
-       , zero == (0 :: Double)
-       -> return 0
-       | otherwise
-       -> return dbl
-      Nothing
-       -> Nothing
+-- There is a bug where zero with a very large exponent becomes Infinite!
+--
+-- > > read "0e12345678901234567890" :: Double
+-- > Infinity
+--
+-- So what else? Strip the stuff before the 'e' and check if it's zero. If it is, return zero.
+readIgnoreInfinite :: [Char] -> Maybe Double
+readIgnoreInfinite ss
+ = case Read.readMaybe ss of
+    Just dbl
+     | isInfinite dbl
+     , Just zero <- Read.readMaybe (takeWhile (\c -> c /= 'e' && c /= 'E') ss)
+     , zero == (0 :: Double)
+     -> return 0
+     | otherwise
+     -> return dbl
+    Nothing
+     -> Nothing
+
+-- read gives the nearest double, and so should we, not just something close.
+testStrtodExact :: [Char] -> Property
+testStrtodExact a
+ = readIgnoreInfinite a === strtod (BC.pack a)
 
 prop_strtod_wellformed
  = forAll (genWellformed 19 19 19)
@@ -162,10 +170,56 @@ prop_strtod_length_20_20_3_suffix
 
 
 
+-- The scalar version is only used on CPUs without SSE4.2, so check it
+-- gives exactly the same results, including where parts have too many digits
+-- or the input is not a number at all.
+prop_strtod_scalar_wellformed
+ = forAll (oneof [genWellformed 40 40 3, genWellformedZeroPrefix 20 20 20 20 3 20])
+ $ \a -> let bs = BC.pack a in Strtod.strtod_scalar bs === Strtod.strtod bs
+
+prop_strtod_scalar_arbitrary :: B.ByteString -> Property
+prop_strtod_scalar_arbitrary bs
+ = Strtod.strtod_scalar bs === Strtod.strtod bs
+
+prop_strtod_exact_40_40_3
+ = forAll (genWellformed 40 40 3)
+ $ withSegv'
+ $ testStrtodExact
+
+prop_strtod_exact_negative_exponent
+ = forAll (genWellformed 40 40 1) $ \dbl ->
+   forAll (choose (0, 400 :: Int)) $ \e ->
+   withSegv' testStrtodExact (takeWhile (/= 'e') dbl <> "e-" <> show e)
+
+prop_strtod_exact_zeroprefix
+ = forAll (genWellformedZeroPrefix 20 20 20 20 3 0)
+ $ withSegv'
+ $ testStrtodExact
+
+prop_strtod_exact_double :: Double -> Property
+prop_strtod_exact_double
+ = withSegv' (testStrtodExact . show)
+
 prop_strtod_double :: Double -> Property
 prop_strtod_double
  = withSegv' (testStrtodWellformed . show)
 
+-- The sign of a zero is kept, whether it is written as zero or underflows,
+-- which the other properties can not see as -0.0 == 0.0.
+testStrtodSignedZero :: [Char] -> Property
+testStrtodSignedZero a
+ = counterexample (show (strtod (BC.pack a)))
+ $ fmap isNegativeZero (readIgnoreInfinite a) === fmap isNegativeZero (strtod (BC.pack a))
+
+prop_strtod_signed_zero
+ = forAll (elements ["", "-"]) $ \sign ->
+   forAll (elements ["0", "00", "0.0", "0.000", "0e5", "0.0e-3", "0e400", "1e-400", "2.5e-330", "1.5"]) $ \a ->
+   withSegv' testStrtodSignedZero (sign <> a)
+
+prop_strtod_signed_zero_double :: Double -> Property
+prop_strtod_signed_zero_double d
+ = withSegv' testStrtodSignedZero (show d)
+
 -- strtod cannot parse all things that read can.
 -- If the integral or fractional part requires more precision than
 -- can be stored in a uint64 (and therefore more than an exact double),
@@ -1,3 +1,4 @@
+{-# LANGUAGE LambdaCase #-}
 {-# LANGUAGE NoImplicitPrelude #-}
 {-# LANGUAGE OverloadedStrings #-}
 {-# LANGUAGE ScopedTypeVariables #-}
@@ -6,9 +7,12 @@
 {-# OPTIONS_GHC -fno-warn-missing-signatures #-}
 module Test.Anemone.Foreign.Time where
 
+import           Anemone.Foreign.Column (parseModifiedJulianColumn, parseTimestampColumn, columnToList)
 import           Anemone.Foreign.Time
 
 import qualified Data.ByteString.Char8 as Char8
+import qualified Data.List as List
+import qualified Data.Vector.Storable as Storable
 import           Data.Thyme.Calendar (Day(..), YearMonthDay(..), gregorianValid)
 
 import           Hedgehog
@@ -84,6 +88,161 @@ prop_parseRenderError = property $ do
 
   first renderTimeError (parseYearMonthDay str) === first renderTimeError eymd
 
+genDate :: Gen (YearMonthDay, Day)
+genDate =
+  Gen.just $ do
+    y <- Gen.int (Range.linear 0 9999)
+    m <- Gen.int (Range.linear 1 12)
+    d <- Gen.int (Range.linear 1 31)
+    let
+      ymd =
+        YearMonthDay y m d
+    pure . fmap (ymd,) $ gregorianValid ymd
+
+data TimestampParts =
+  TimestampParts {
+      partsDate :: YearMonthDay
+    , partsDay :: Day
+    , partsClock :: (Int, Int, Int)
+    , partsFraction :: [Int]
+    , partsOffset :: Maybe (Maybe (Int, Int))
+    } deriving (Show)
+
+genTimestampParts :: Gen TimestampParts
+genTimestampParts = do
+  (date, day) <- genDate
+  clock <- (,,)
+    <$> Gen.int (Range.linear 0 23)
+    <*> Gen.int (Range.linear 0 59)
+    <*> Gen.int (Range.linear 0 60)
+  fraction <- Gen.list (Range.linear 0 15) (Gen.int (Range.linear 0 9))
+  offset <- Gen.maybe . Gen.maybe $ (,)
+    <$> Gen.int (Range.linear (-23) 23)
+    <*> Gen.int (Range.linear 0 59)
+  pure $ TimestampParts date day clock fraction offset
+
+renderTimestampParts :: TimestampParts -> [Char]
+renderTimestampParts (TimestampParts (YearMonthDay y m d) _ (h, mi, s) fraction offset) =
+  let
+    renderFraction =
+      if List.null fraction then
+        ""
+      else
+        "." <> List.concatMap show fraction
+
+    renderOffset = \case
+      Nothing ->
+        ""
+      Just Nothing ->
+        "Z"
+      Just (Just (oh, om)) ->
+        printf "%c%02d:%02d" (if oh < 0 then '-' else '+') (abs oh) om
+  in
+    printf "%04d-%02d-%02dT%02d:%02d:%02d" y m d h mi s <>
+    renderFraction <>
+    renderOffset offset
+
+expectedTimestamp :: TimestampParts -> Timestamp
+expectedTimestamp (TimestampParts _ day (h, mi, s) fraction offset) =
+  let
+    offsetSeconds =
+      case offset of
+        Just (Just (oh, om)) ->
+          (if oh < 0 then -1 else 1) * (abs oh * 3600 + om * 60)
+        _ ->
+          0
+
+    nanos =
+      List.foldl' (\acc x -> acc * 10 + x) 0 . List.take 9 $ fraction <> List.replicate 9 0
+  in
+    Timestamp
+      (fromIntegral $ (toModifiedJulianDay day - 40587) * 86400 + h * 3600 + mi * 60 + s - offsetSeconds)
+      (fromIntegral nanos)
+
+prop_parseTimestamp :: Property
+prop_parseTimestamp = property $ do
+  parts <- forAll genTimestampParts
+  let
+    str =
+      Char8.pack $ renderTimestampParts parts
+  parseTimestamp (str <> ",rest") === Right (expectedTimestamp parts, ",rest")
+
+prop_parseTimestampInvalid :: Property
+prop_parseTimestampInvalid = property $ do
+  str <- forAll $ Gen.element [
+      "2019-02-29T00:00:00Z"
+    , "2020-01-01T24:00:00Z"
+    , "2020-01-01T00:60:00Z"
+    , "2020-01-01T00:00:61Z"
+    , "2020-01-01T00:00:00+24:00"
+    ]
+  parseTimestamp str === Left (TimeInvalidTimestamp str)
+
+prop_parseTimestampError :: Property
+prop_parseTimestampError = property $ do
+  str <- forAll $ Gen.element [
+      ""
+    , "2020-01-01"
+    , "2020-01-01 00:00:00"
+    , "2020-01-01T00:00"
+    , "2020-01-01T00:00:00."
+    , "2020-01-01T00:00:00+05"
+    , "2020-1-01T00:00:00Z"
+    ]
+  parseTimestamp str === Left (TimeParseError str)
+
+prop_parseTimestampColumn :: Property
+prop_parseTimestampColumn = property $ do
+  xs <- forAll $ Gen.list (Range.linear 0 200) (Gen.maybe genTimestampParts)
+  let
+    str =
+      Char8.pack . List.concatMap ((<> "\n") . maybe "x" renderTimestampParts) $ xs
+
+    (column, rest) =
+      parseTimestampColumn 44 10 (List.length xs) str
+
+  columnToList column === fmap (fmap expectedTimestamp) xs
+  rest === ""
+
+prop_renderDay :: Property
+prop_renderDay = property $ do
+  (YearMonthDay y m d, day) <- forAll genDate
+  let
+    str =
+      Char8.pack $ printf "%04d-%02d-%02d" y m d
+  renderDay day === Just str
+  parseDay str === Right (day, "")
+
+prop_renderDayRange :: Property
+prop_renderDayRange = property $ do
+  -- 0000-01-01 and 9999-12-31
+  mjd <- forAll $ Gen.choice [
+      Gen.int (Range.linear (-1000000) (-678942))
+    , Gen.int (Range.linear 2973484 4000000)
+    ]
+  renderDay (ModifiedJulianDay (-678941)) === Just "0000-01-01"
+  renderDay (ModifiedJulianDay 2973483) === Just "9999-12-31"
+  renderDay (ModifiedJulianDay mjd) === Nothing
+
+prop_renderDayColumn :: Property
+prop_renderDayColumn = property $ do
+  days <- forAll $ Gen.list (Range.linear 0 1000) (snd <$> genDate)
+  let
+    mjds =
+      fmap (fromIntegral . toModifiedJulianDay) days
+
+  case renderDayColumn 10 (Storable.fromList mjds) of
+    Nothing ->
+      failure
+    Just rendered -> do
+      let
+        (column, rest) =
+          parseModifiedJulianColumn 44 10 (List.length days) rendered
+
+      Just rendered === fmap (List.foldl' (<>) "" . fmap (<> "\n")) (traverse renderDay days)
+      columnToList column === fmap Just mjds
+      rest === ""
+
 return []
 tests :: IO Bool
 tests =
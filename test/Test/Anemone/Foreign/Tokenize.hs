@@ -0,0 +1,76 @@
+{-# LANGUAGE NoImplicitPrelude #-}
+{-# LANGUAGE TemplateHaskell #-}
+module Test.Anemone.Foreign.Tokenize where
+
+import           Anemone.Foreign.Tokenize
+
+import           Data.Bits (popCount)
+import           Data.ByteString (ByteString)
+import qualified Data.ByteString as B
+import qualified Data.List as List
+import qualified Data.Vector.Storable as Storable
+import           Data.Word (Word8)
+
+import           Hedgehog
+import qualified Hedgehog.Gen as Gen
+import qualified Hedgehog.Range as Range
+
+import           P
+
+import           System.IO (IO)
+
+
+-- Mostly delimiters and quotes, so there are plenty of quoted fields, empty
+-- fields and escaped quotes, long enough to cross several blocks.
+genInput :: Gen ByteString
+genInput =
+  fmap B.pack . Gen.list (Range.linear 0 300) $
+    Gen.frequency [
+        (4, Gen.element [97, 98])
+      , (2, Gen.element [44, 10])
+      , (1, pure 34)
+      , (1, pure 0)
+      ]
+
+genQuote :: Gen (Maybe Word8)
+genQuote =
+  Gen.element [Nothing, Just 34]
+
+-- The offsets from a byte at a time walk which tracks the quotes.
+expectedOffsets :: Word8 -> Word8 -> Maybe Word8 -> ByteString -> [Int64]
+expectedOffsets sep term quote =
+  let
+    go (inside, acc) (i, c) =
+      if Just c == quote then
+        (not inside, acc)
+      else if not inside && (c == sep || c == term) then
+        (inside, i : acc)
+      else
+        (inside, acc)
+  in
+    List.reverse . snd . List.foldl' go (False, []) . List.zip [0..] . B.unpack
+
+prop_offsets :: Property
+prop_offsets =
+  property $ do
+    bs <- forAll genInput
+    sep <- forAll $ Gen.element [44, 0]
+    quote <- forAll genQuote
+    Storable.toList (delimiterOffsets sep 10 quote bs) === expectedOffsets sep 10 quote bs
+
+prop_bitmap :: Property
+prop_bitmap =
+  property $ do
+    bs <- forAll genInput
+    quote <- forAll genQuote
+    let
+      bitmap =
+        delimiterBitmap 44 10 quote bs
+
+    Storable.length bitmap === (B.length bs + 63) `div` 64
+    Storable.sum (Storable.map popCount bitmap) === List.length (expectedOffsets 44 10 quote bs)
+
+return []
+tests :: IO Bool
+tests =
+  checkParallel $$(discover)
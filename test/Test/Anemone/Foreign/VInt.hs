@@ -9,6 +9,7 @@ import           Data.ByteString (ByteString)
 import qualified Data.ByteString as B
 import qualified Data.ByteString.Builder as Builder
 import qualified Data.ByteString.Lazy as Lazy
+import qualified Data.List as List
 import qualified Data.Vector.Storable as Storable
 
 import           Hedgehog
@@ -45,6 +46,96 @@ prop_roundtrip_vint_array =
       ss = Storable.fromList as
     tripping ss encodeVIntArray (fmap noLeftovers . decodeVIntArray (Storable.length ss))
 
+-- Mostly small values, so that runs of single-byte integers are mixed with
+-- multi-byte ones, and the vectorised decoder takes every path.
+genMixed :: Gen Int64
+genMixed =
+  Gen.frequency [
+      (4, Gen.int64 (Range.linear (-112) 127))
+    , (1, Gen.int64 (Range.linearFrom 0 (-100000) 100000))
+    , (1, Gen.enumBounded)
+    ]
+
+prop_roundtrip_vint_array_mixed :: Property
+prop_roundtrip_vint_array_mixed =
+  property $ do
+    as <- forAll $ Gen.list (Range.linear 1 10000) genMixed
+    let
+      ss = Storable.fromList as
+    tripping ss encodeVIntArray (fmap noLeftovers . decodeVIntArray (Storable.length ss))
+
+-- The array encoder is sized exactly, and writes the same bytes as the
+-- single integer encoder.
+prop_encode_vint_array_exact :: Property
+prop_encode_vint_array_exact =
+  property $ do
+    as <- forAll $ Gen.list (Range.linear 0 1000) genMixed
+    encodeVIntArray (Storable.fromList as) === B.concat (fmap encodeVInt as)
+
+-- Decoding an array agrees with decoding one integer at a time, including
+-- where the input is truncated or is not made of integers at all.
+prop_decode_vint_array_scalar :: Property
+prop_decode_vint_array_scalar =
+  property $ do
+    as <- forAll $ Gen.list (Range.linear 0 200) genMixed
+    cut <- forAll $ Gen.int (Range.linear 0 (Storable.length (encodeVIntArray (Storable.fromList as)) + 1))
+    junk <- forAll $ Gen.bool
+    bytes <- forAll $ Gen.bytes (Range.linear 0 500)
+    let
+      bs =
+        if junk then
+          bytes
+        else
+          B.take cut . encodeVIntArray $ Storable.fromList as
+
+      decodeScalar :: Int -> ByteString -> Maybe ([Int64], ByteString)
+      decodeScalar 0 xs =
+        Just ([], xs)
+      decodeScalar k xs = do
+        (y, xs') <- decodeVInt xs
+        (ys, xs'') <- decodeScalar (k - 1) xs'
+        pure (y : ys, xs'')
+
+    fmap (first Storable.toList) (decodeVIntArray (List.length as) bs) === decodeScalar (List.length as) bs
+
+-- Skipping and counting agree with decoding, on the same inputs.
+prop_skip_count_vint :: Property
+prop_skip_count_vint =
+  property $ do
+    as <- forAll $ Gen.list (Range.linear 0 200) genMixed
+    cut <- forAll $ Gen.int (Range.linear 0 (B.length (encodeVIntArray (Storable.fromList as)) + 1))
+    k <- forAll $ Gen.int (Range.linear 0 (List.length as + 1))
+    let
+      bs =
+        B.take cut . encodeVIntArray $ Storable.fromList as
+
+      decodeAll xs =
+        if B.null xs then
+          Just 0
+        else do
+          (_, xs') <- decodeVInt xs
+          (+ 1) <$> decodeAll xs'
+
+    skipVInts k bs === fmap snd (decodeVIntArray k bs)
+    countVInts bs === decodeAll bs
+
+-- Seeking with an index finds the same integer as decoding from the start.
+prop_seek_vint :: Property
+prop_seek_vint =
+  property $ do
+    as <- forAll $ Gen.list (Range.linear 0 500) genMixed
+    stride <- forAll $ Gen.int (Range.linear 1 100)
+    k <- forAll $ Gen.int (Range.linear 0 (List.length as))
+    let
+      bs =
+        encodeVIntArray $ Storable.fromList as
+
+    case indexVInts stride bs of
+      Nothing ->
+        failure
+      Just ix ->
+        fmap fst (decodeVInt =<< seekVInt ix k bs) === List.lookup k (List.zip [0..] as)
+
 noLeftovers :: (a, ByteString) -> a
 noLeftovers (xs, bs) =
   if B.null bs then
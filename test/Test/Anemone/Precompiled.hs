@@ -0,0 +1,75 @@
+{-# LANGUAGE NoImplicitPrelude #-}
+{-# LANGUAGE TemplateHaskell #-}
+module Test.Anemone.Precompiled where
+
+import           Anemone.Precompiled
+
+import           Control.Monad.IO.Class (liftIO)
+
+import           Hedgehog
+
+import           P
+
+import           System.Directory (getTemporaryDirectory)
+import           System.Exit (ExitCode(..))
+import           System.FilePath ((</>))
+import           System.IO (IO)
+import           System.Process (readProcessWithExitCode)
+
+
+-- A file which uses kernels from several of the headers, with nothing but
+-- the precompiled header included.
+source :: String
+source =
+  "int64_t f (char *p, char *pe) {\n" <>
+  "    int64_t i = 0;\n" <>
+  "    anemone_string_to_i64 (&p, pe, &i);\n" <>
+  "    return i + anemone_fasthash64 (0, (const uint8_t *) p, pe - p) + anemone_memcmp (p, pe, 0);\n" <>
+  "}\n"
+
+compile :: [String] -> IO (ExitCode, String, String)
+compile flags =
+  readProcessWithExitCode "cc" (flags <> ["-fsyntax-only", "-x", "c", "-"]) source
+
+prop_precompiled_header :: Property
+prop_precompiled_header =
+  withTests 1 . property $ do
+    tmp <- liftIO getTemporaryDirectory
+    let
+      cache =
+        tmp </> "anemone-test-precompiled"
+
+      flags =
+        ["-std=c99", "-O2"]
+
+    included <- evalEither =<< liftIO (precompileHeader "cc" flags cache)
+
+    -- the second time is from the cache
+    cached <- evalEither =<< liftIO (precompileHeader "cc" flags cache)
+    included === cached
+
+    (code, _, err) <- liftIO . compile $ flags <> ["-Winvalid-pch", "-Werror"] <> included
+    annotate err
+    code === ExitSuccess
+
+-- A flag which breaks the header is a compiler error, not an exception
+prop_precompiled_header_failed :: Property
+prop_precompiled_header_failed =
+  withTests 1 . property $ do
+    tmp <- liftIO getTemporaryDirectory
+    let
+      cache =
+        tmp </> "anemone-test-precompiled"
+
+    result <- liftIO $ precompileHeader "cc" ["-std=c99", "-Dint64_t=@"] cache
+    case result of
+      Left (PrecompiledCompilerFailed _ _ _ _) ->
+        success
+      Right included -> do
+        annotateShow included
+        failure
+
+return []
+tests :: IO Bool
+tests =
+  checkParallel $$(discover)
@@ -1,25 +1,41 @@
 import           Hedgehog.Main
 
 import qualified Test.Anemone.Foreign.Atoi
+import qualified Test.Anemone.Foreign.Column
 import qualified Test.Anemone.Foreign.Hash
+import qualified Test.Anemone.Foreign.Intern
+import qualified Test.Anemone.Foreign.Itoa
 import qualified Test.Anemone.Foreign.Memcmp
 import qualified Test.Anemone.Foreign.Mempool
 import qualified Test.Anemone.Foreign.Pack
+import qualified Test.Anemone.Foreign.Ryu
+import qualified Test.Anemone.Foreign.Segv
+import qualified Test.Anemone.Foreign.Sort
 import qualified Test.Anemone.Foreign.Strtod
 import qualified Test.Anemone.Foreign.Time
+import qualified Test.Anemone.Foreign.Tokenize
 import qualified Test.Anemone.Foreign.VInt
+import qualified Test.Anemone.Precompiled
 import qualified Test.Anemone.Roundtrip
 
 main :: IO ()
 main =
   defaultMain
     [ Test.Anemone.Foreign.Atoi.tests
+    , Test.Anemone.Foreign.Column.tests
     , Test.Anemone.Foreign.Hash.tests
+    , Test.Anemone.Foreign.Intern.tests
+    , Test.Anemone.Foreign.Itoa.tests
     , Test.Anemone.Foreign.Memcmp.tests
     , Test.Anemone.Foreign.Mempool.tests
     , Test.Anemone.Foreign.Pack.tests
+    , Test.Anemone.Foreign.Ryu.tests
+    , Test.Anemone.Foreign.Segv.tests
+    , Test.Anemone.Foreign.Sort.tests
     , Test.Anemone.Foreign.Strtod.tests
     , Test.Anemone.Foreign.Time.tests
+    , Test.Anemone.Foreign.Tokenize.tests
     , Test.Anemone.Foreign.VInt.tests
+    , Test.Anemone.Precompiled.tests
     , Test.Anemone.Roundtrip.tests
     ]